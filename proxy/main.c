@@ -0,0 +1,192 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "proxy.h"
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -s, --socket PATH          Unix socket to listen on (default %s)\n"
+            "  -m, --mode MODE            Octal permissions of the socket (default %o)\n"
+            "  -c, --config PATH          libdomain config of upstream connections (required)\n"
+            "  -p, --pool SIZE            Number of upstream connections (default %d)\n"
+            "  -C, --cache-capacity N     Maximum number of cached searches, 0 disables cache (default %d)\n"
+            "  -t, --cache-ttl MS         Lifetime of cached search in milliseconds (default %d)\n"
+            "  -T, --timeout MS           Time upstream has to answer a search (default %d)\n"
+            "  -n, --max-clients N        Maximum number of connected clients (default %d)\n"
+            "  -P, --max-pending N        Maximum number of searches in progress per client (default %d)\n"
+            "  -h, --help                 Show this message\n",
+            program, PROXY_DEFAULT_SOCKET, PROXY_DEFAULT_SOCKET_MODE, PROXY_DEFAULT_POOL_SIZE,
+            PROXY_DEFAULT_CACHE_CAPACITY, PROXY_DEFAULT_CACHE_TTL, PROXY_DEFAULT_REQUEST_TIMEOUT,
+            PROXY_DEFAULT_MAX_CLIENTS, PROXY_DEFAULT_MAX_PENDING);
+}
+
+static bool parse_number(const char *text, int base, int minimum, int *value)
+{
+    char *end = NULL;
+    long result = strtol(text, &end, base);
+
+    if (!*text || *end || result < minimum || result > INT32_MAX)
+    {
+        return false;
+    }
+
+    *value = (int)result;
+    return true;
+}
+
+static void on_signal(verto_ctx *ctx, verto_ev *ev)
+{
+    ld_info("on_signal - received signal %d, stopping\n", verto_get_signal(ev));
+
+    verto_break(ctx);
+}
+
+static void on_reload(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    ld_info("on_reload - received signal %d, reloading upstream configuration\n", verto_get_signal(ev));
+
+    proxy_server_reload(verto_get_private(ev));
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] =
+    {
+        { "socket",         required_argument, NULL, 's' },
+        { "mode",           required_argument, NULL, 'm' },
+        { "config",         required_argument, NULL, 'c' },
+        { "pool",           required_argument, NULL, 'p' },
+        { "cache-capacity", required_argument, NULL, 'C' },
+        { "cache-ttl",      required_argument, NULL, 't' },
+        { "timeout",        required_argument, NULL, 'T' },
+        { "max-clients",    required_argument, NULL, 'n' },
+        { "max-pending",    required_argument, NULL, 'P' },
+        { "help",           no_argument,       NULL, 'h' },
+        { NULL,             0,                 NULL, 0   }
+    };
+
+    proxy_config_t config =
+    {
+        .socket_path = PROXY_DEFAULT_SOCKET,
+        .socket_mode = PROXY_DEFAULT_SOCKET_MODE,
+        .upstream_config = NULL,
+        .pool_size = PROXY_DEFAULT_POOL_SIZE,
+        .cache_capacity = PROXY_DEFAULT_CACHE_CAPACITY,
+        .cache_ttl = PROXY_DEFAULT_CACHE_TTL,
+        .request_timeout = PROXY_DEFAULT_REQUEST_TIMEOUT,
+        .max_clients = PROXY_DEFAULT_MAX_CLIENTS,
+        .max_pending = PROXY_DEFAULT_MAX_PENDING,
+    };
+
+    int option = 0;
+    while ((option = getopt_long(argc, argv, "s:m:c:p:C:t:T:n:P:h", options, NULL)) != -1)
+    {
+        bool valid = true;
+
+        switch (option)
+        {
+        case 's':
+            config.socket_path = optarg;
+            break;
+        case 'm':
+            valid = parse_number(optarg, 8, 0, &config.socket_mode) && config.socket_mode <= 0777;
+            break;
+        case 'c':
+            config.upstream_config = optarg;
+            break;
+        case 'p':
+            valid = parse_number(optarg, 10, 1, &config.pool_size);
+            break;
+        case 'C':
+            valid = parse_number(optarg, 10, 0, &config.cache_capacity);
+            break;
+        case 't':
+            valid = parse_number(optarg, 10, 0, &config.cache_ttl);
+            break;
+        case 'T':
+            valid = parse_number(optarg, 10, 1, &config.request_timeout);
+            break;
+        case 'n':
+            valid = parse_number(optarg, 10, 1, &config.max_clients);
+            break;
+        case 'P':
+            valid = parse_number(optarg, 10, 1, &config.max_pending);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            valid = false;
+            break;
+        }
+
+        if (!valid)
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!config.upstream_config || optind != argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    verto_ctx *base = verto_default(NULL, VERTO_EV_TYPE_IO | VERTO_EV_TYPE_TIMEOUT | VERTO_EV_TYPE_SIGNAL);
+    if (!base)
+    {
+        ld_error("main - unable to create event loop!\n");
+        return EXIT_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    proxy_server_t *server = proxy_server_new(talloc_ctx, base, &config);
+    verto_ev *reload_event = server ? verto_add_signal(base, VERTO_EV_FLAG_PERSIST, on_reload, SIGHUP) : NULL;
+    if (!server
+        || !reload_event
+        || !verto_add_signal(base, VERTO_EV_FLAG_PERSIST, on_signal, SIGINT)
+        || !verto_add_signal(base, VERTO_EV_FLAG_PERSIST, on_signal, SIGTERM)
+        || !verto_add_signal(base, VERTO_EV_FLAG_PERSIST, VERTO_SIG_IGN, SIGPIPE))
+    {
+        talloc_free(talloc_ctx);
+        verto_free(base);
+        return EXIT_FAILURE;
+    }
+
+    verto_set_private(reload_event, server, NULL);
+
+    verto_run(base);
+
+    talloc_free(talloc_ctx);
+    verto_free(base);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_PROXY_H
+#define LIB_DOMAIN_PROXY_H
+
+#include <common.h>
+#include <domain.h>
+#include <entry.h>
+
+#include <lber.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROXY_DEFAULT_SOCKET "/run/libdomain/proxy.sock"
+#define PROXY_DEFAULT_SOCKET_MODE 0660
+#define PROXY_DEFAULT_POOL_SIZE 4
+#define PROXY_DEFAULT_CACHE_CAPACITY 4096
+#define PROXY_DEFAULT_CACHE_TTL 60000
+#define PROXY_DEFAULT_REQUEST_TIMEOUT 30000
+#define PROXY_DEFAULT_MAX_CLIENTS 256
+#define PROXY_DEFAULT_MAX_PENDING 64
+
+/*!
+ * @brief proxy_config_t - Settings of the proxy daemon.
+ */
+typedef struct proxy_config_s
+{
+    const char *socket_path;         //!< Path of the Unix socket to listen on.
+    int socket_mode;                 //!< Permissions of the socket, they control who may use the proxy.
+    const char *upstream_config;     //!< Path of libdomain config of upstream connections.
+    int pool_size;                   //!< Number of upstream connections.
+    int cache_capacity;              //!< Maximum number of cached search results, 0 disables cache.
+    int cache_ttl;                   //!< Lifetime of cached search result in milliseconds.
+    int request_timeout;             //!< Time in milliseconds upstream has to answer a search.
+    int max_clients;                 //!< Maximum number of simultaneously connected clients.
+    int max_pending;                 //!< Maximum number of searches in progress per client.
+} proxy_config_t;
+
+/*!
+ * @brief proxy_search_t - Decoded SearchRequest.
+ */
+typedef struct proxy_search_s
+{
+    char *base;                      //!< Base of the search.
+    int scope;                       //!< Scope of the search.
+    int size_limit;                  //!< Maximum number of entries to return, 0 means no limit.
+    bool attributes_only;            //!< Return attribute names without values.
+    char *filter;                    //!< Filter converted to RFC 4515 string.
+    char **attributes;               //!< Requested attributes, NULL terminated, NULL if none were requested.
+} proxy_search_t;
+
+/*!
+ * @brief proxy_request_t - Decoded LDAPMessage of a client.
+ */
+typedef struct proxy_request_s
+{
+    int msgid;                       //!< Message id assigned by client.
+    ber_tag_t operation;             //!< Tag of protocol operation.
+
+    int version;                     //!< Version of BindRequest.
+    char *bind_dn;                   //!< Name of BindRequest.
+    ber_tag_t bind_method;           //!< Authentication choice of BindRequest.
+    char *sasl_mechanism;            //!< SASL mechanism of BindRequest.
+    bool has_credentials;            //!< BindRequest carries password or SASL credentials.
+
+    int abandon_msgid;               //!< Message id of AbandonRequest.
+
+    proxy_search_t *search;          //!< Decoded SearchRequest.
+} proxy_request_t;
+
+/*!
+ * @brief proxy_result_t - Search result, every element is encoded SearchResultEntry without LDAPMessage envelope.
+ */
+typedef struct proxy_result_s
+{
+    struct berval *entries;          //!< Encoded entries.
+    int n_entries;                   //!< Number of entries.
+} proxy_result_t;
+
+typedef struct proxy_cache_s proxy_cache_t;
+typedef struct proxy_pool_s proxy_pool_t;
+typedef struct proxy_server_s proxy_server_t;
+
+// proxy_protocol.c
+proxy_request_t *proxy_protocol_decode(TALLOC_CTX *ctx, BerElement *ber);
+char *proxy_protocol_decode_filter(TALLOC_CTX *ctx, BerElement *ber);
+proxy_result_t *proxy_protocol_encode_entries(TALLOC_CTX *ctx, ld_entry_t **entries, int n_entries,
+                                              bool attributes_only);
+struct berval *proxy_protocol_message(TALLOC_CTX *ctx, int msgid, const struct berval *operation);
+struct berval *proxy_protocol_result(TALLOC_CTX *ctx, int msgid, ber_tag_t tag, int code, const char *message);
+ber_tag_t proxy_protocol_response_tag(ber_tag_t operation);
+
+// proxy_cache.c
+proxy_cache_t *proxy_cache_new(TALLOC_CTX *ctx, int capacity, int ttl);
+char *proxy_cache_key(TALLOC_CTX *ctx, const proxy_search_t *search);
+const proxy_result_t *proxy_cache_get(proxy_cache_t *cache, const char *key, int64_t now);
+void proxy_cache_put(proxy_cache_t *cache, const char *key, proxy_result_t *result, int64_t now);
+int proxy_cache_size(const proxy_cache_t *cache);
+void proxy_cache_clear(proxy_cache_t *cache);
+
+// proxy_pool.c
+proxy_pool_t *proxy_pool_new(TALLOC_CTX *ctx, verto_ctx *base, const ld_config_t *config, int size);
+LDHandle *proxy_pool_acquire(proxy_pool_t *pool);
+int proxy_pool_ready(const proxy_pool_t *pool);
+void proxy_pool_reload(proxy_pool_t *pool, const ld_config_t *config);
+
+// proxy_server.c
+proxy_server_t *proxy_server_new(TALLOC_CTX *ctx, verto_ctx *base, const proxy_config_t *config);
+bool proxy_server_reload(proxy_server_t *server);
+
+#endif //LIB_DOMAIN_PROXY_H
@@ -0,0 +1,278 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "proxy.h"
+
+#include <matching_rule.h>
+
+#include <glib.h>
+
+#include <string.h>
+
+/*!
+ * @brief proxy_cache_item_t - Cached search result, items form list ordered from most to least recently used.
+ */
+typedef struct proxy_cache_item_s
+{
+    char *key;                              //!< Key of the search.
+    proxy_result_t *result;                 //!< Encoded entries.
+    int64_t expires;                        //!< Monotonic time in milliseconds when result becomes stale.
+
+    struct proxy_cache_item_s *prev;        //!< More recently used item.
+    struct proxy_cache_item_s *next;        //!< Less recently used item.
+} proxy_cache_item_t;
+
+/*!
+ * @brief proxy_cache_t - Search results bounded by count and lifetime.
+ */
+struct proxy_cache_s
+{
+    GHashTable *items;                      //!< Items by key.
+    proxy_cache_item_t *head;               //!< Most recently used item.
+    proxy_cache_item_t *tail;               //!< Least recently used item.
+    int capacity;                           //!< Maximum number of items.
+    int ttl;                                //!< Lifetime of item in milliseconds.
+};
+
+static void cache_unlink(proxy_cache_t *cache, proxy_cache_item_t *item)
+{
+    if (item->prev)
+    {
+        item->prev->next = item->next;
+    }
+    else
+    {
+        cache->head = item->next;
+    }
+
+    if (item->next)
+    {
+        item->next->prev = item->prev;
+    }
+    else
+    {
+        cache->tail = item->prev;
+    }
+
+    item->prev = NULL;
+    item->next = NULL;
+}
+
+static void cache_push_front(proxy_cache_t *cache, proxy_cache_item_t *item)
+{
+    item->prev = NULL;
+    item->next = cache->head;
+
+    if (cache->head)
+    {
+        cache->head->prev = item;
+    }
+    cache->head = item;
+
+    if (!cache->tail)
+    {
+        cache->tail = item;
+    }
+}
+
+static void cache_remove(proxy_cache_t *cache, proxy_cache_item_t *item)
+{
+    cache_unlink(cache, item);
+    g_hash_table_remove(cache->items, item->key);
+    talloc_free(item);
+}
+
+static int cache_destructor(TALLOC_CTX *ctx)
+{
+    proxy_cache_t *cache = talloc_get_type_abort(ctx, proxy_cache_t);
+
+    if (cache->items)
+    {
+        g_hash_table_destroy(cache->items);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief proxy_cache_new Creates cache of search results.
+ * @param[in] ctx      Memory context to allocate cache on.
+ * @param[in] capacity Maximum number of results, 0 disables caching.
+ * @param[in] ttl      Lifetime of result in milliseconds.
+ * @return
+ *        - NULL on failure.
+ *        - cache.
+ */
+proxy_cache_t *proxy_cache_new(TALLOC_CTX *ctx, int capacity, int ttl)
+{
+    proxy_cache_t *cache = talloc_zero(ctx, proxy_cache_t);
+    if (!cache)
+    {
+        ld_error("proxy_cache_new - out of memory!\n");
+        return NULL;
+    }
+
+    talloc_set_destructor((void*)cache, cache_destructor);
+
+    cache->items = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->capacity = capacity > 0 ? capacity : 0;
+    cache->ttl = ttl > 0 ? ttl : 0;
+
+    if (!cache->items)
+    {
+        ld_error("proxy_cache_new - out of memory!\n");
+        talloc_free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+static char *cache_key_append(char *key, const char *part)
+{
+    // Length prefix keeps parts apart whatever characters they contain.
+    return key ? talloc_asprintf_append_buffer(key, "%zu:%s", part ? strlen(part) : 0, part ? part : "") : NULL;
+}
+
+/**
+ * @brief proxy_cache_key Builds key identifying search, base is normalized so different spellings share results.
+ * @param[in] ctx    Memory context to allocate key on.
+ * @param[in] search Search to build key of.
+ * @return
+ *        - NULL on failure.
+ *        - key.
+ */
+char *proxy_cache_key(TALLOC_CTX *ctx, const proxy_search_t *search)
+{
+    size_t length = matching_rule_normalize(MATCHING_RULE_DN, search->base, NULL, 0);
+
+    char *base = talloc_array(NULL, char, length + 1);
+    if (!base)
+    {
+        return NULL;
+    }
+    matching_rule_normalize(MATCHING_RULE_DN, search->base, base, length + 1);
+
+    char *key = talloc_asprintf(ctx, "%d%c", search->scope, search->attributes_only ? 't' : 'f');
+    key = cache_key_append(key, base);
+    key = cache_key_append(key, search->filter);
+
+    for (int i = 0; search->attributes && search->attributes[i]; ++i)
+    {
+        key = cache_key_append(key, search->attributes[i]);
+    }
+
+    talloc_free(base);
+
+    return key;
+}
+
+/**
+ * @brief proxy_cache_get Looks up result of the search, stale results are dropped.
+ * @param[in] cache Cache to use.
+ * @param[in] key   Key of the search.
+ * @param[in] now   Current monotonic time in milliseconds.
+ * @return
+ *        - NULL if there is no fresh result.
+ *        - result, valid until next change of the cache.
+ */
+const proxy_result_t *proxy_cache_get(proxy_cache_t *cache, const char *key, int64_t now)
+{
+    proxy_cache_item_t *item = g_hash_table_lookup(cache->items, key);
+    if (!item)
+    {
+        return NULL;
+    }
+
+    if (item->expires <= now)
+    {
+        cache_remove(cache, item);
+        return NULL;
+    }
+
+    cache_unlink(cache, item);
+    cache_push_front(cache, item);
+
+    return item->result;
+}
+
+/**
+ * @brief proxy_cache_put Stores result of the search, least recently used result is evicted when cache is full.
+ * @param[in] cache  Cache to use.
+ * @param[in] key    Key of the search.
+ * @param[in] result Result to store, cache takes ownership of it.
+ * @param[in] now    Current monotonic time in milliseconds.
+ */
+void proxy_cache_put(proxy_cache_t *cache, const char *key, proxy_result_t *result, int64_t now)
+{
+    if (cache->capacity == 0 || cache->ttl == 0)
+    {
+        talloc_free(result);
+        return;
+    }
+
+    proxy_cache_item_t *previous = g_hash_table_lookup(cache->items, key);
+    if (previous)
+    {
+        cache_remove(cache, previous);
+    }
+
+    while ((int)g_hash_table_size(cache->items) >= cache->capacity && cache->tail)
+    {
+        cache_remove(cache, cache->tail);
+    }
+
+    proxy_cache_item_t *item = talloc_zero(cache, proxy_cache_item_t);
+    if (!item || !(item->key = talloc_strdup(item, key)))
+    {
+        ld_error("proxy_cache_put - out of memory!\n");
+        talloc_free(item);
+        talloc_free(result);
+        return;
+    }
+
+    item->result = talloc_steal(item, result);
+    item->expires = now + cache->ttl;
+
+    g_hash_table_insert(cache->items, item->key, item);
+    cache_push_front(cache, item);
+}
+
+/**
+ * @brief proxy_cache_size Returns number of stored results, including stale ones not yet dropped.
+ * @param[in] cache Cache to use.
+ * @return Number of results.
+ */
+int proxy_cache_size(const proxy_cache_t *cache)
+{
+    return cache ? (int)g_hash_table_size(cache->items) : 0;
+}
+
+/**
+ * @brief proxy_cache_clear Drops every stored result.
+ * @param[in] cache Cache to clear.
+ */
+void proxy_cache_clear(proxy_cache_t *cache)
+{
+    while (cache->head)
+    {
+        cache_remove(cache, cache->head);
+    }
+}
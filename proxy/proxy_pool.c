@@ -0,0 +1,274 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "proxy.h"
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <domain_p.h>
+
+#define PROXY_POOL_UPDATE_INTERVAL 100
+#define PROXY_POOL_RESTART_DELAY 5000
+
+/*!
+ * @brief proxy_upstream_t - Upstream connection of the pool.
+ */
+typedef struct proxy_upstream_s
+{
+    LDHandle *handle;                       //!< Handle of the connection, NULL while connection is restarted.
+    int64_t error_since;                    //!< Time when connection entered error state, 0 if it is healthy.
+    int64_t restart_at;                     //!< Time when handle is created again.
+} proxy_upstream_t;
+
+/*!
+ * @brief proxy_pool_t - Upstream connections shared by every client of the proxy.
+ */
+struct proxy_pool_s
+{
+    verto_ctx *base;                        //!< Event loop connections run on.
+    const ld_config_t *config;              //!< Configuration of connections.
+    proxy_upstream_t *upstreams;            //!< Connections.
+    int size;                               //!< Number of connections.
+    int next;                               //!< Connection to try first, spreads equal load.
+    verto_ev *timer;                        //!< Persistent event driving connection state machines.
+};
+
+static bool pool_is_running(const proxy_upstream_t *upstream)
+{
+    return upstream->handle && upstream->handle->connection_ctx->state_machine
+           && csm_is_in_state(upstream->handle->connection_ctx->state_machine, LDAP_CONNECTION_STATE_RUN);
+}
+
+static void pool_start(proxy_pool_t *pool, proxy_upstream_t *upstream)
+{
+    ld_init_with_event_loop(&upstream->handle, pool->config, pool->base);
+
+    if (!upstream->handle || !upstream->handle->connection_ctx || !upstream->handle->connection_ctx->state_machine)
+    {
+        ld_error("pool_start - unable to create upstream connection!\n");
+        upstream->restart_at = ld_now() + PROXY_POOL_RESTART_DELAY;
+        upstream->handle = NULL;
+        return;
+    }
+
+    upstream->error_since = 0;
+}
+
+/**
+ * @brief pool_update Drives connections which are not running yet and restarts connections which gave up reconnecting.
+ */
+static void pool_update(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    proxy_pool_t *pool = verto_get_private(ev);
+    int64_t now = ld_now();
+
+    for (int i = 0; i < pool->size; ++i)
+    {
+        proxy_upstream_t *upstream = &pool->upstreams[i];
+
+        if (!upstream->handle)
+        {
+            if (now >= upstream->restart_at)
+            {
+                pool_start(pool, upstream);
+            }
+            continue;
+        }
+
+        if (pool_is_running(upstream))
+        {
+            continue;
+        }
+
+        state_machine_ctx_t *state_machine = upstream->handle->connection_ctx->state_machine;
+
+        if (!csm_is_in_state(state_machine, LDAP_CONNECTION_STATE_ERROR))
+        {
+            upstream->error_since = 0;
+        }
+        else if (upstream->error_since == 0)
+        {
+            upstream->error_since = now;
+        }
+        else if (now - upstream->error_since >= PROXY_POOL_RESTART_DELAY)
+        {
+            ld_warning("pool_update - restarting upstream connection %d\n", i);
+
+            ld_free(upstream->handle);
+            upstream->handle = NULL;
+            upstream->restart_at = now;
+            continue;
+        }
+
+        csm_next_state(state_machine);
+    }
+}
+
+static int pool_destructor(TALLOC_CTX *ctx)
+{
+    proxy_pool_t *pool = talloc_get_type_abort(ctx, proxy_pool_t);
+
+    if (pool->timer)
+    {
+        verto_del(pool->timer);
+    }
+
+    for (int i = 0; i < pool->size; ++i)
+    {
+        if (pool->upstreams[i].handle)
+        {
+            ld_free(pool->upstreams[i].handle);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief proxy_pool_new Creates upstream connections, they are established in background.
+ * @param[in] ctx    Memory context to allocate pool on.
+ * @param[in] base   Event loop to run connections on.
+ * @param[in] config Configuration of connections, must outlive the pool.
+ * @param[in] size   Number of connections.
+ * @return
+ *        - NULL on failure.
+ *        - pool.
+ */
+proxy_pool_t *proxy_pool_new(TALLOC_CTX *ctx, verto_ctx *base, const ld_config_t *config, int size)
+{
+    if (!base || !config || size <= 0)
+    {
+        ld_error("proxy_pool_new - invalid parameters!\n");
+        return NULL;
+    }
+
+    proxy_pool_t *pool = talloc_zero(ctx, proxy_pool_t);
+    if (!pool || !(pool->upstreams = talloc_zero_array(pool, proxy_upstream_t, size)))
+    {
+        ld_error("proxy_pool_new - out of memory!\n");
+        talloc_free(pool);
+        return NULL;
+    }
+
+    pool->base = base;
+    pool->config = config;
+    pool->size = size;
+
+    talloc_set_destructor((void*)pool, pool_destructor);
+
+    pool->timer = verto_add_timeout(base, VERTO_EV_FLAG_PERSIST, pool_update, PROXY_POOL_UPDATE_INTERVAL);
+    if (!pool->timer)
+    {
+        ld_error("proxy_pool_new - unable to add timer!\n");
+        talloc_free(pool);
+        return NULL;
+    }
+    verto_set_private(pool->timer, pool, NULL);
+
+    for (int i = 0; i < size; ++i)
+    {
+        pool_start(pool, &pool->upstreams[i]);
+    }
+
+    return pool;
+}
+
+/**
+ * @brief proxy_pool_reload Applies new configuration to every connection, connections which have to reconnect
+ * do so once their outstanding operations complete.
+ * @param[in] pool   Pool to use.
+ * @param[in] config New configuration of connections, must outlive the pool.
+ */
+void proxy_pool_reload(proxy_pool_t *pool, const ld_config_t *config)
+{
+    pool->config = config;
+
+    for (int i = 0; i < pool->size; ++i)
+    {
+        if (pool->upstreams[i].handle && ld_reload_config(pool->upstreams[i].handle, config) != RETURN_CODE_SUCCESS)
+        {
+            ld_warning("proxy_pool_reload - restarting upstream connection %d\n", i);
+
+            ld_free(pool->upstreams[i].handle);
+            pool_start(pool, &pool->upstreams[i]);
+        }
+    }
+}
+
+/**
+ * @brief proxy_pool_acquire Returns running connection with the least operations in flight.
+ * @param[in] pool Pool to use.
+ * @return
+ *        - NULL if no connection is running or every connection has its request window full.
+ *        - handle.
+ */
+LDHandle *proxy_pool_acquire(proxy_pool_t *pool)
+{
+    LDHandle *result = NULL;
+    int result_load = 0;
+    int result_index = 0;
+
+    for (int i = 0; i < pool->size; ++i)
+    {
+        int index = (pool->next + i) % pool->size;
+        proxy_upstream_t *upstream = &pool->upstreams[index];
+
+        if (!pool_is_running(upstream))
+        {
+            continue;
+        }
+
+        struct ldap_connection_ctx_t *connection = upstream->handle->connection_ctx;
+        int load = connection_requests_in_flight(connection);
+
+        if (load < connection->request_window && (!result || load < result_load))
+        {
+            result = upstream->handle;
+            result_load = load;
+            result_index = index;
+        }
+    }
+
+    if (result)
+    {
+        pool->next = (result_index + 1) % pool->size;
+    }
+
+    return result;
+}
+
+/**
+ * @brief proxy_pool_ready Returns number of running connections.
+ * @param[in] pool Pool to use.
+ * @return Number of running connections.
+ */
+int proxy_pool_ready(const proxy_pool_t *pool)
+{
+    int result = 0;
+
+    for (int i = 0; pool && i < pool->size; ++i)
+    {
+        result += pool_is_running(&pool->upstreams[i]);
+    }
+
+    return result;
+}
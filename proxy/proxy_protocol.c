@@ -0,0 +1,722 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "proxy.h"
+
+#include <entry_p.h>
+
+#include <ctype.h>
+#include <ldap.h>
+#include <string.h>
+
+#define PROXY_FILTER_MAX_DEPTH 64
+
+static char *protocol_string(TALLOC_CTX *ctx, const struct berval *value)
+{
+    return talloc_strndup(ctx, value->bv_val ? value->bv_val : "", value->bv_len);
+}
+
+/**
+ * @brief protocol_valid_attribute Checks attribute description, it is copied to the filter string verbatim.
+ */
+static bool protocol_valid_attribute(const struct berval *attribute)
+{
+    if (attribute->bv_len == 0)
+    {
+        return false;
+    }
+
+    for (ber_len_t i = 0; i < attribute->bv_len; ++i)
+    {
+        unsigned char c = attribute->bv_val[i];
+
+        if (!isalnum(c) && c != '-' && c != '.' && c != ';')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief protocol_escape Escapes assertion value, unlike ld_filter_escape keeps NUL bytes of binary values.
+ */
+static char *protocol_escape(TALLOC_CTX *ctx, const struct berval *value)
+{
+    char *result = talloc_array(ctx, char, value->bv_len * 3 + 1);
+    if (!result)
+    {
+        return NULL;
+    }
+
+    size_t length = 0;
+
+    for (ber_len_t i = 0; i < value->bv_len; ++i)
+    {
+        unsigned char c = value->bv_val[i];
+
+        if (c == '*' || c == '(' || c == ')' || c == '\\' || c == '\0')
+        {
+            length += sprintf(result + length, "\\%02x", c);
+        }
+        else
+        {
+            result[length++] = c;
+        }
+    }
+    result[length] = '\0';
+
+    return result;
+}
+
+/**
+ * @brief protocol_scan_type Reads attribute description opening a filter item. Elements are read one by one within
+ * bounds of the item, ber_scanf would read past the end of a truncated item into the rest of the message.
+ */
+static bool protocol_scan_type(BerElement *ber, struct berval *attribute, char **last)
+{
+    ber_len_t length = 0;
+
+    return ber_first_element(ber, &length, last) == LBER_OCTETSTRING
+           && ber_scanf(ber, "m", attribute) != LBER_ERROR
+           && protocol_valid_attribute(attribute);
+}
+
+static char *protocol_filter_item(TALLOC_CTX *ctx, BerElement *ber, const char *operation)
+{
+    struct berval attribute = { 0, NULL };
+    struct berval value = { 0, NULL };
+    ber_len_t length = 0;
+    char *last = NULL;
+
+    if (!protocol_scan_type(ber, &attribute, &last)
+        || ber_next_element(ber, &length, last) != LBER_OCTETSTRING
+        || ber_scanf(ber, "m", &value) == LBER_ERROR
+        || ber_next_element(ber, &length, last) != LBER_DEFAULT)
+    {
+        return NULL;
+    }
+
+    char *escaped = protocol_escape(ctx, &value);
+
+    return escaped ? talloc_asprintf(ctx, "(%.*s%s%s)", (int)attribute.bv_len, attribute.bv_val, operation, escaped)
+                   : NULL;
+}
+
+static char *protocol_filter_substrings(TALLOC_CTX *ctx, BerElement *ber)
+{
+    struct berval attribute = { 0, NULL };
+    ber_len_t length = 0;
+    char *last = NULL;
+
+    if (!protocol_scan_type(ber, &attribute, &last) || ber_next_element(ber, &length, last) != LBER_SEQUENCE)
+    {
+        return NULL;
+    }
+
+    char *initial = NULL;
+    char *any = talloc_strdup(ctx, "*");
+    char *final = NULL;
+    int n_parts = 0;
+
+    for (ber_tag_t tag = ber_first_element(ber, &length, &last);
+         tag != LBER_DEFAULT && any;
+         tag = ber_next_element(ber, &length, last))
+    {
+        struct berval part = { 0, NULL };
+
+        if (final || ber_scanf(ber, "m", &part) == LBER_ERROR)
+        {
+            return NULL;
+        }
+
+        char *escaped = protocol_escape(ctx, &part);
+
+        switch (tag)
+        {
+        case LDAP_SUBSTRING_INITIAL:
+            if (n_parts > 0)
+            {
+                return NULL;
+            }
+            initial = escaped;
+            break;
+        case LDAP_SUBSTRING_ANY:
+            any = escaped ? talloc_asprintf_append(any, "%s*", escaped) : NULL;
+            break;
+        case LDAP_SUBSTRING_FINAL:
+            final = escaped;
+            break;
+        default:
+            return NULL;
+        }
+
+        ++n_parts;
+    }
+
+    if (n_parts == 0 || !any)
+    {
+        return NULL;
+    }
+
+    return talloc_asprintf(ctx, "(%.*s=%s%s%s)", (int)attribute.bv_len, attribute.bv_val,
+                           initial ? initial : "", any, final ? final : "");
+}
+
+static char *protocol_filter_extensible(TALLOC_CTX *ctx, BerElement *ber)
+{
+    struct berval rule = { 0, NULL };
+    struct berval attribute = { 0, NULL };
+    struct berval value = { 0, NULL };
+    ber_int_t dn_attributes = 0;
+    bool has_value = false;
+
+    ber_len_t length = 0;
+    char *last = NULL;
+
+    for (ber_tag_t tag = ber_first_element(ber, &length, &last);
+         tag != LBER_DEFAULT;
+         tag = ber_next_element(ber, &length, last))
+    {
+        ber_tag_t rc = LBER_ERROR;
+
+        switch (tag)
+        {
+        case LDAP_FILTER_EXT_OID:
+            rc = ber_scanf(ber, "m", &rule);
+            break;
+        case LDAP_FILTER_EXT_TYPE:
+            rc = ber_scanf(ber, "m", &attribute);
+            break;
+        case LDAP_FILTER_EXT_VALUE:
+            rc = ber_scanf(ber, "m", &value);
+            has_value = true;
+            break;
+        case LDAP_FILTER_EXT_DNATTRS:
+            rc = ber_scanf(ber, "b", &dn_attributes);
+            break;
+        default:
+            break;
+        }
+
+        if (rc == LBER_ERROR)
+        {
+            return NULL;
+        }
+    }
+
+    if (!has_value || (rule.bv_len == 0 && attribute.bv_len == 0)
+        || (rule.bv_len > 0 && !protocol_valid_attribute(&rule))
+        || (attribute.bv_len > 0 && !protocol_valid_attribute(&attribute)))
+    {
+        return NULL;
+    }
+
+    char *escaped = protocol_escape(ctx, &value);
+
+    return escaped ? talloc_asprintf(ctx, "(%.*s%s%s%.*s:=%s)", (int)attribute.bv_len, attribute.bv_val,
+                                     dn_attributes ? ":dn" : "", rule.bv_len > 0 ? ":" : "",
+                                     (int)rule.bv_len, rule.bv_val, escaped)
+                   : NULL;
+}
+
+static char *protocol_filter(TALLOC_CTX *ctx, BerElement *ber, int depth)
+{
+    ber_len_t length = 0;
+    ber_tag_t tag = ber_peek_tag(ber, &length);
+
+    if (depth > PROXY_FILTER_MAX_DEPTH)
+    {
+        return NULL;
+    }
+
+    switch (tag)
+    {
+    case LDAP_FILTER_AND:
+    case LDAP_FILTER_OR:
+    {
+        char *result = talloc_strdup(ctx, tag == LDAP_FILTER_AND ? "(&" : "(|");
+        char *last = NULL;
+
+        for (tag = ber_first_element(ber, &length, &last);
+             tag != LBER_DEFAULT && result;
+             tag = ber_next_element(ber, &length, last))
+        {
+            char *child = protocol_filter(ctx, ber, depth + 1);
+
+            result = child ? talloc_strdup_append(result, child) : NULL;
+        }
+
+        return result ? talloc_strdup_append(result, ")") : NULL;
+    }
+    case LDAP_FILTER_NOT:
+    {
+        if (ber_skip_tag(ber, &length) == LBER_DEFAULT)
+        {
+            return NULL;
+        }
+
+        char *child = protocol_filter(ctx, ber, depth + 1);
+
+        return child ? talloc_asprintf(ctx, "(!%s)", child) : NULL;
+    }
+    case LDAP_FILTER_EQUALITY:
+        return protocol_filter_item(ctx, ber, "=");
+    case LDAP_FILTER_GE:
+        return protocol_filter_item(ctx, ber, ">=");
+    case LDAP_FILTER_LE:
+        return protocol_filter_item(ctx, ber, "<=");
+    case LDAP_FILTER_APPROX:
+        return protocol_filter_item(ctx, ber, "~=");
+    case LDAP_FILTER_SUBSTRINGS:
+        return protocol_filter_substrings(ctx, ber);
+    case LDAP_FILTER_EXT:
+        return protocol_filter_extensible(ctx, ber);
+    case LDAP_FILTER_PRESENT:
+    {
+        struct berval attribute = { 0, NULL };
+
+        if (ber_scanf(ber, "m", &attribute) == LBER_ERROR || !protocol_valid_attribute(&attribute))
+        {
+            return NULL;
+        }
+
+        return talloc_asprintf(ctx, "(%.*s=*)", (int)attribute.bv_len, attribute.bv_val);
+    }
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * @brief proxy_protocol_decode_filter Converts BER encoded Filter to RFC 4515 string.
+ * @param[in] ctx Memory context to allocate string on.
+ * @param[in] ber Element positioned at the filter.
+ * @return
+ *        - NULL if filter is malformed.
+ *        - filter string.
+ */
+char *proxy_protocol_decode_filter(TALLOC_CTX *ctx, BerElement *ber)
+{
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    char *filter = protocol_filter(talloc_ctx, ber, 0);
+    char *result = filter ? talloc_strdup(ctx, filter) : NULL;
+
+    talloc_free(talloc_ctx);
+
+    return result;
+}
+
+static bool protocol_decode_bind(proxy_request_t *request, BerElement *ber)
+{
+    ber_int_t version = 0;
+    struct berval name = { 0, NULL };
+    struct berval credentials = { 0, NULL };
+    ber_len_t length = 0;
+
+    if (ber_scanf(ber, "{im", &version, &name) == LBER_ERROR)
+    {
+        return false;
+    }
+
+    request->version = version;
+    request->bind_dn = protocol_string(request, &name);
+    request->bind_method = ber_peek_tag(ber, &length);
+
+    switch (request->bind_method)
+    {
+    case LDAP_AUTH_SIMPLE:
+        if (ber_scanf(ber, "m", &credentials) == LBER_ERROR)
+        {
+            return false;
+        }
+        request->has_credentials = credentials.bv_len > 0;
+        break;
+    case LDAP_AUTH_SASL:
+        if (ber_scanf(ber, "{m", &credentials) == LBER_ERROR)
+        {
+            return false;
+        }
+        request->sasl_mechanism = protocol_string(request, &credentials);
+        break;
+    default:
+        break;
+    }
+
+    return request->bind_dn != NULL;
+}
+
+static bool protocol_decode_search(proxy_request_t *request, BerElement *ber)
+{
+    struct berval base = { 0, NULL };
+    ber_int_t scope = 0, dereference = 0, size_limit = 0, time_limit = 0, attributes_only = 0;
+
+    if (ber_scanf(ber, "{meeiib", &base, &scope, &dereference, &size_limit, &time_limit, &attributes_only)
+        == LBER_ERROR
+        || scope < LDAP_SCOPE_BASE || scope > LDAP_SCOPE_SUBORDINATE || size_limit < 0)
+    {
+        return false;
+    }
+
+    proxy_search_t *search = talloc_zero(request, proxy_search_t);
+    if (!search)
+    {
+        return false;
+    }
+
+    request->search = search;
+
+    search->base = protocol_string(search, &base);
+    search->scope = scope;
+    search->size_limit = size_limit;
+    search->attributes_only = attributes_only;
+    search->filter = proxy_protocol_decode_filter(search, ber);
+
+    if (!search->base || !search->filter)
+    {
+        return false;
+    }
+
+    ber_len_t length = 0;
+    char *last = NULL;
+    int n_attributes = 0;
+
+    for (ber_tag_t tag = ber_first_element(ber, &length, &last);
+         tag != LBER_DEFAULT;
+         tag = ber_next_element(ber, &length, last))
+    {
+        struct berval attribute = { 0, NULL };
+
+        char **attributes = talloc_realloc(search, search->attributes, char*, n_attributes + 2);
+        if (!attributes || ber_scanf(ber, "m", &attribute) == LBER_ERROR)
+        {
+            return false;
+        }
+
+        search->attributes = attributes;
+        search->attributes[n_attributes] = protocol_string(search->attributes, &attribute);
+        search->attributes[++n_attributes] = NULL;
+    }
+
+    return true;
+}
+
+/**
+ * @brief proxy_protocol_decode Decodes LDAPMessage received from client. Only operations proxy acts upon are
+ * decoded completely, for other operations only message id and tag are filled.
+ * @param[in] ctx Memory context to allocate request on.
+ * @param[in] ber Element filled by ber_get_next, positioned after tag and length of the message.
+ * @return
+ *        - NULL if message is malformed.
+ *        - request.
+ */
+proxy_request_t *proxy_protocol_decode(TALLOC_CTX *ctx, BerElement *ber)
+{
+    ber_int_t msgid = 0;
+    ber_len_t length = 0;
+
+    if (ber_get_int(ber, &msgid) == LBER_ERROR || msgid < 0)
+    {
+        return NULL;
+    }
+
+    proxy_request_t *request = talloc_zero(ctx, proxy_request_t);
+    if (!request)
+    {
+        return NULL;
+    }
+
+    request->msgid = msgid;
+    request->operation = ber_peek_tag(ber, &length);
+
+    bool decoded = true;
+    ber_int_t abandon_msgid = 0;
+
+    switch (request->operation)
+    {
+    case LDAP_REQ_BIND:
+        decoded = protocol_decode_bind(request, ber);
+        break;
+    case LDAP_REQ_SEARCH:
+        decoded = protocol_decode_search(request, ber);
+        break;
+    case LDAP_REQ_ABANDON:
+        decoded = ber_scanf(ber, "i", &abandon_msgid) != LBER_ERROR;
+        request->abandon_msgid = abandon_msgid;
+        break;
+    case LBER_DEFAULT:
+        decoded = false;
+        break;
+    default:
+        break;
+    }
+
+    if (!decoded)
+    {
+        talloc_free(request);
+        return NULL;
+    }
+
+    return request;
+}
+
+/**
+ * @brief protocol_is_reference Checks whether entry was made of SearchResultReference, its dn holds referral URI.
+ */
+static bool protocol_is_reference(const char *dn)
+{
+    const char *scheme = strstr(dn, "://");
+    const char *equals = strchr(dn, '=');
+
+    return scheme && (!equals || scheme < equals);
+}
+
+/**
+ * @brief proxy_protocol_encode_entries Encodes entries as SearchResultEntry operations, so they can be sent to
+ * any client with its own message id.
+ * @param[in] ctx             Memory context to allocate result on.
+ * @param[in] entries         Entries to encode. Entries without dn and referrals are skipped.
+ * @param[in] n_entries       Number of entries.
+ * @param[in] attributes_only Encode attribute names without values.
+ * @return
+ *        - NULL on failure.
+ *        - encoded entries.
+ */
+proxy_result_t *proxy_protocol_encode_entries(TALLOC_CTX *ctx, ld_entry_t **entries, int n_entries,
+                                              bool attributes_only)
+{
+    proxy_result_t *result = talloc_zero(ctx, proxy_result_t);
+    if (!result || !(result->entries = talloc_zero_array(result, struct berval, n_entries > 0 ? n_entries : 1)))
+    {
+        talloc_free(result);
+        return NULL;
+    }
+
+    for (int i = 0; i < n_entries; ++i)
+    {
+        ld_entry_t *entry = entries[i];
+
+        if (!entry || !entry->dn || entry->dn[0] == '\0' || protocol_is_reference(entry->dn))
+        {
+            continue;
+        }
+
+        BerElement *ber = ber_alloc_t(LBER_USE_DER);
+        int rc = ber ? ber_printf(ber, "t{s{", (ber_tag_t)LDAP_RES_SEARCH_ENTRY, entry->dn) : -1;
+
+        GHashTableIter iter;
+        gpointer key = NULL, value = NULL;
+
+        g_hash_table_iter_init(&iter, entry->attributes);
+        while (rc != -1 && g_hash_table_iter_next(&iter, &key, &value))
+        {
+            LDAPAttribute_t *attribute = value;
+
+            rc = ber_printf(ber, "{s[", attribute->name);
+
+            for (int j = 0; rc != -1 && !attributes_only && attribute->values && attribute->values[j]; ++j)
+            {
+                rc = ber_printf(ber, "s", attribute->values[j]);
+            }
+
+            rc = rc != -1 ? ber_printf(ber, "]}") : rc;
+        }
+
+        struct berval encoded = { 0, NULL };
+        rc = rc != -1 ? ber_printf(ber, "}}") : rc;
+        rc = rc != -1 ? ber_flatten2(ber, &encoded, 0) : rc;
+
+        if (rc != -1)
+        {
+            result->entries[result->n_entries].bv_val = talloc_memdup(result->entries, encoded.bv_val,
+                                                                      encoded.bv_len);
+            result->entries[result->n_entries].bv_len = encoded.bv_len;
+        }
+
+        if (ber)
+        {
+            ber_free(ber, 1);
+        }
+
+        if (rc == -1 || !result->entries[result->n_entries].bv_val)
+        {
+            ld_error("proxy_protocol_encode_entries - unable to encode entry %s!\n", entry->dn);
+            talloc_free(result);
+            return NULL;
+        }
+
+        ++result->n_entries;
+    }
+
+    return result;
+}
+
+/**
+ * @brief proxy_protocol_message Wraps encoded protocol operation into LDAPMessage.
+ * @param[in] ctx       Memory context to allocate message on.
+ * @param[in] msgid     Message id of the client request.
+ * @param[in] operation Encoded protocol operation.
+ * @return
+ *        - NULL on failure.
+ *        - encoded message.
+ */
+struct berval *proxy_protocol_message(TALLOC_CTX *ctx, int msgid, const struct berval *operation)
+{
+    uint8_t id[8] = { 0 };
+    size_t id_length = 0;
+
+    // INTEGER holds minimal number of octets, extra zero octet keeps positive values with high bit set positive.
+    uint32_t value = (uint32_t)msgid;
+    uint8_t digits[5] = { 0 };
+    size_t n_digits = 0;
+    do
+    {
+        digits[n_digits++] = value & 0xff;
+        value >>= 8;
+    }
+    while (value);
+    if (digits[n_digits - 1] & 0x80)
+    {
+        digits[n_digits++] = 0;
+    }
+
+    id[id_length++] = LBER_INTEGER;
+    id[id_length++] = n_digits;
+    while (n_digits)
+    {
+        id[id_length++] = digits[--n_digits];
+    }
+
+    size_t content_length = id_length + operation->bv_len;
+
+    uint8_t header[1 + 1 + sizeof(size_t)] = { LDAP_TAG_MESSAGE };
+    size_t header_length = 1;
+
+    if (content_length < 0x80)
+    {
+        header[header_length++] = content_length;
+    }
+    else
+    {
+        size_t n_octets = 0;
+        for (size_t length = content_length; length; length >>= 8)
+        {
+            ++n_octets;
+        }
+
+        header[header_length++] = 0x80 | n_octets;
+        while (n_octets)
+        {
+            header[header_length++] = (content_length >> (8 * --n_octets)) & 0xff;
+        }
+    }
+
+    struct berval *message = talloc_zero(ctx, struct berval);
+    char *data = message ? talloc_size(message, header_length + content_length) : NULL;
+    if (!data)
+    {
+        talloc_free(message);
+        return NULL;
+    }
+
+    memcpy(data, header, header_length);
+    memcpy(data + header_length, id, id_length);
+    memcpy(data + header_length + id_length, operation->bv_val, operation->bv_len);
+
+    message->bv_val = data;
+    message->bv_len = header_length + content_length;
+
+    return message;
+}
+
+/**
+ * @brief proxy_protocol_result Encodes LDAPMessage carrying LDAPResult.
+ * @param[in] ctx     Memory context to allocate message on.
+ * @param[in] msgid   Message id of the client request.
+ * @param[in] tag     Tag of the response operation.
+ * @param[in] code    Result code.
+ * @param[in] message Diagnostic message, can be NULL.
+ * @return
+ *        - NULL on failure.
+ *        - encoded message.
+ */
+struct berval *proxy_protocol_result(TALLOC_CTX *ctx, int msgid, ber_tag_t tag, int code, const char *message)
+{
+    BerElement *ber = ber_alloc_t(LBER_USE_DER);
+    if (!ber)
+    {
+        return NULL;
+    }
+
+    struct berval encoded = { 0, NULL };
+    struct berval *result = NULL;
+
+    if (ber_printf(ber, "{it{ess}}", (ber_int_t)msgid, tag, (ber_int_t)code, "", message ? message : "") != -1
+        && ber_flatten2(ber, &encoded, 0) != -1
+        && (result = talloc_zero(ctx, struct berval)))
+    {
+        result->bv_val = talloc_memdup(result, encoded.bv_val, encoded.bv_len);
+        result->bv_len = encoded.bv_len;
+
+        if (!result->bv_val)
+        {
+            talloc_free(result);
+            result = NULL;
+        }
+    }
+
+    ber_free(ber, 1);
+
+    return result;
+}
+
+/**
+ * @brief proxy_protocol_response_tag Returns tag of the response to the operation.
+ * @param[in] operation Tag of request operation.
+ * @return
+ *        - LBER_DEFAULT if operation has no response.
+ *        - tag of the response.
+ */
+ber_tag_t proxy_protocol_response_tag(ber_tag_t operation)
+{
+    switch (operation)
+    {
+    case LDAP_REQ_BIND:
+        return LDAP_RES_BIND;
+    case LDAP_REQ_SEARCH:
+        return LDAP_RES_SEARCH_RESULT;
+    case LDAP_REQ_MODIFY:
+        return LDAP_RES_MODIFY;
+    case LDAP_REQ_ADD:
+        return LDAP_RES_ADD;
+    case LDAP_REQ_DELETE:
+        return LDAP_RES_DELETE;
+    case LDAP_REQ_MODDN:
+        return LDAP_RES_MODDN;
+    case LDAP_REQ_COMPARE:
+        return LDAP_RES_COMPARE;
+    case LDAP_REQ_EXTENDED:
+        return LDAP_RES_EXTENDED;
+    default:
+        return LBER_DEFAULT;
+    }
+}
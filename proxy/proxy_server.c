@@ -0,0 +1,1205 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "proxy.h"
+
+#include <connection.h>
+#include <domain_p.h>
+#include <entry_p.h>
+
+#include <errno.h>
+#include <glib.h>
+#include <ldap.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define PROXY_DISPATCH_INTERVAL 100
+#define PROXY_MAX_INCOMING (1024 * 1024)
+#define PROXY_MAX_OUTPUT (64 * 1024 * 1024)
+#define PROXY_MESSAGES_PER_READ 32
+
+/*!
+ * @brief proxy_client_t - Connection of a local client.
+ */
+typedef struct proxy_client_s
+{
+    proxy_server_t *server;                 //!< Server client is connected to.
+    unsigned int id;                        //!< Identifier, waiters refer to client by it.
+
+    int fd;                                 //!< Socket of the client.
+    Sockbuf *sockbuf;                       //!< Socket wrapper messages are read through, owns the socket.
+    BerElement *ber;                        //!< Message being received.
+
+    verto_ev *read_event;                   //!< Persistent read event.
+    verto_ev *write_event;                  //!< Write event, present while output is pending.
+    verto_ev *close_event;                  //!< One shot event closing client outside of callbacks using it.
+
+    char *output;                           //!< Encoded responses waiting to be sent.
+    size_t output_length;                   //!< Number of bytes in output.
+    size_t output_offset;                   //!< Number of bytes of output already sent.
+
+    int n_pending;                          //!< Searches waiting for upstream.
+    bool closing;                           //!< Client unbound or violated protocol.
+    bool failed;                            //!< Socket failed or client does not read responses.
+} proxy_client_t;
+
+/*!
+ * @brief proxy_waiter_t - Client request waiting for upstream search.
+ */
+typedef struct proxy_waiter_s
+{
+    unsigned int client;                    //!< Identifier of the client.
+    int msgid;                              //!< Message id of the request.
+    int size_limit;                         //!< Size limit of the request.
+} proxy_waiter_t;
+
+/*!
+ * @brief proxy_fetch_t - Upstream search shared by every client request with the same key.
+ */
+typedef struct proxy_fetch_s
+{
+    proxy_server_t *server;                 //!< Server fetch belongs to.
+    unsigned int id;                        //!< Identifier, upstream callback refers to fetch by it.
+    char *key;                              //!< Cache key of the search.
+    proxy_search_t *search;                 //!< Search to perform.
+
+    proxy_waiter_t *waiters;                //!< Requests waiting for result.
+    int n_waiters;                          //!< Number of waiters.
+
+    verto_ev *timeout;                      //!< One shot event failing fetch if upstream does not answer.
+    bool submitted;                         //!< Search was sent upstream.
+    struct proxy_fetch_s *next;             //!< Next fetch waiting for free upstream connection.
+} proxy_fetch_t;
+
+/*!
+ * @brief proxy_ticket_t - User data of upstream search. Fetch may be gone by the time upstream answers,
+ * so ticket refers to it by identifier.
+ */
+typedef struct proxy_ticket_s
+{
+    proxy_server_t *server;                 //!< Server fetch belongs to.
+    unsigned int fetch;                     //!< Identifier of the fetch.
+} proxy_ticket_t;
+
+/*!
+ * @brief proxy_server_t - Proxy listening on Unix socket.
+ */
+struct proxy_server_s
+{
+    verto_ctx *base;                        //!< Event loop.
+    proxy_config_t config;                  //!< Settings of the proxy.
+    TALLOC_CTX *upstream_ctx;               //!< Memory of upstream configuration, replaced on reload.
+    ld_config_t *upstream_config;           //!< Configuration of upstream connections.
+
+    proxy_pool_t *pool;                     //!< Upstream connections.
+    proxy_cache_t *cache;                   //!< Cached search results.
+
+    int listen_fd;                          //!< Listening socket.
+    verto_ev *listen_event;                 //!< Persistent accept event.
+    verto_ev *dispatch_event;               //!< Persistent event submitting fetches waiting for connection.
+
+    GHashTable *clients;                    //!< Clients by identifier.
+    GHashTable *fetches;                    //!< Fetches in progress by cache key.
+    GHashTable *fetch_ids;                  //!< Fetches in progress by identifier.
+
+    proxy_fetch_t *backlog_head;            //!< First fetch waiting for free upstream connection.
+    proxy_fetch_t *backlog_tail;            //!< Last fetch waiting for free upstream connection.
+
+    unsigned int next_id;                   //!< Last assigned identifier.
+};
+
+static unsigned int server_next_id(proxy_server_t *server)
+{
+    if (++server->next_id == 0)
+    {
+        ++server->next_id;
+    }
+
+    return server->next_id;
+}
+
+static bool client_queue(proxy_client_t *client, const struct berval *message)
+{
+    if (!message || client->failed)
+    {
+        client->failed = true;
+        return false;
+    }
+
+    if (client->output_offset > 0)
+    {
+        memmove(client->output, client->output + client->output_offset,
+                client->output_length - client->output_offset);
+        client->output_length -= client->output_offset;
+        client->output_offset = 0;
+    }
+
+    if (client->output_length + message->bv_len > PROXY_MAX_OUTPUT)
+    {
+        ld_warning("client_queue - client %u does not read responses, disconnecting\n", client->id);
+        client->failed = true;
+        return false;
+    }
+
+    size_t size = talloc_get_size(client->output);
+    if (client->output_length + message->bv_len > size)
+    {
+        size_t new_size = size ? size : 4096;
+        while (new_size < client->output_length + message->bv_len)
+        {
+            new_size *= 2;
+        }
+
+        char *output = talloc_realloc(client, client->output, char, new_size);
+        if (!output)
+        {
+            client->failed = true;
+            return false;
+        }
+        client->output = output;
+    }
+
+    memcpy(client->output + client->output_length, message->bv_val, message->bv_len);
+    client->output_length += message->bv_len;
+
+    return true;
+}
+
+static void client_on_write(verto_ctx *ctx, verto_ev *ev);
+
+/**
+ * @brief client_flush Sends as much output as socket accepts, rest is sent once socket becomes writable.
+ */
+static bool client_flush(proxy_client_t *client)
+{
+    while (!client->failed && client->output_offset < client->output_length)
+    {
+        ssize_t sent = send(client->fd, client->output + client->output_offset,
+                            client->output_length - client->output_offset, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                client->failed = true;
+                break;
+            }
+
+            if (!client->write_event)
+            {
+                client->write_event = verto_add_io(client->server->base,
+                                                   VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_WRITE,
+                                                   client_on_write, client->fd);
+                if (!client->write_event)
+                {
+                    client->failed = true;
+                    break;
+                }
+                verto_set_private(client->write_event, client, NULL);
+            }
+
+            return true;
+        }
+
+        client->output_offset += sent;
+    }
+
+    client->output_offset = 0;
+    client->output_length = 0;
+
+    if (client->write_event)
+    {
+        verto_del(client->write_event);
+        client->write_event = NULL;
+    }
+
+    return !client->failed;
+}
+
+static void client_send_result(proxy_client_t *client, int msgid, ber_tag_t tag, int code, const char *message)
+{
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    client_queue(client, proxy_protocol_result(talloc_ctx, msgid, tag, code, message));
+
+    talloc_free(talloc_ctx);
+}
+
+static void client_send_entries(proxy_client_t *client, int msgid, const proxy_result_t *result, int size_limit)
+{
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    int count = result->n_entries;
+    int code = LDAP_SUCCESS;
+
+    if (size_limit > 0 && count > size_limit)
+    {
+        count = size_limit;
+        code = LDAP_SIZELIMIT_EXCEEDED;
+    }
+
+    for (int i = 0; i < count && !client->failed; ++i)
+    {
+        client_queue(client, proxy_protocol_message(talloc_ctx, msgid, &result->entries[i]));
+    }
+
+    talloc_free(talloc_ctx);
+
+    client_send_result(client, msgid, LDAP_RES_SEARCH_RESULT, code, NULL);
+}
+
+static void client_on_close(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    proxy_client_t *client = verto_get_private(ev);
+
+    // One shot event is freed by the loop once callback returns.
+    client->close_event = NULL;
+
+    talloc_free(client);
+}
+
+/**
+ * @brief client_schedule_close Closes client on next loop iteration, used where client may still be referenced
+ * by the callback being executed.
+ */
+static void client_schedule_close(proxy_client_t *client)
+{
+    client->failed = true;
+
+    if (client->close_event)
+    {
+        return;
+    }
+
+    client->close_event = verto_add_timeout(client->server->base, VERTO_EV_FLAG_NONE, client_on_close, 0);
+    if (client->close_event)
+    {
+        verto_set_private(client->close_event, client, NULL);
+    }
+}
+
+static void server_backlog_remove(proxy_server_t *server, proxy_fetch_t *fetch)
+{
+    proxy_fetch_t *previous = NULL;
+
+    for (proxy_fetch_t *current = server->backlog_head; current; previous = current, current = current->next)
+    {
+        if (current != fetch)
+        {
+            continue;
+        }
+
+        if (previous)
+        {
+            previous->next = current->next;
+        }
+        else
+        {
+            server->backlog_head = current->next;
+        }
+
+        if (server->backlog_tail == current)
+        {
+            server->backlog_tail = previous;
+        }
+
+        fetch->next = NULL;
+        return;
+    }
+}
+
+static int fetch_destructor(TALLOC_CTX *ctx)
+{
+    proxy_fetch_t *fetch = talloc_get_type_abort(ctx, proxy_fetch_t);
+    proxy_server_t *server = fetch->server;
+
+    if (fetch->timeout)
+    {
+        verto_del(fetch->timeout);
+    }
+
+    if (!fetch->submitted)
+    {
+        server_backlog_remove(server, fetch);
+    }
+
+    if (server->fetches)
+    {
+        g_hash_table_remove(server->fetches, fetch->key);
+        g_hash_table_remove(server->fetch_ids, GUINT_TO_POINTER(fetch->id));
+    }
+
+    for (int i = 0; server->clients && i < fetch->n_waiters; ++i)
+    {
+        proxy_client_t *client = g_hash_table_lookup(server->clients, GUINT_TO_POINTER(fetch->waiters[i].client));
+        if (client)
+        {
+            --client->n_pending;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief fetch_finish Answers every waiter with the result or with the error code and frees the fetch.
+ */
+static void fetch_finish(proxy_fetch_t *fetch, const proxy_result_t *result, int code, const char *message)
+{
+    proxy_server_t *server = fetch->server;
+
+    for (int i = 0; i < fetch->n_waiters; ++i)
+    {
+        proxy_waiter_t *waiter = &fetch->waiters[i];
+
+        proxy_client_t *client = g_hash_table_lookup(server->clients, GUINT_TO_POINTER(waiter->client));
+        if (!client)
+        {
+            continue;
+        }
+
+        if (result)
+        {
+            client_send_entries(client, waiter->msgid, result, waiter->size_limit);
+        }
+        else
+        {
+            client_send_result(client, waiter->msgid, LDAP_RES_SEARCH_RESULT, code, message);
+        }
+
+        if (!client_flush(client))
+        {
+            client_schedule_close(client);
+        }
+    }
+
+    talloc_free(fetch);
+}
+
+static void fetch_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    proxy_fetch_t *fetch = verto_get_private(ev);
+
+    // One shot event is freed by the loop once callback returns.
+    fetch->timeout = NULL;
+
+    ld_warning("fetch_on_timeout - search of %s timed out\n", fetch->search->base);
+
+    fetch_finish(fetch, NULL, LDAP_UNAVAILABLE,
+                 fetch->submitted ? "Upstream server did not answer in time"
+                                  : "No upstream connection is available");
+}
+
+/**
+ * @brief server_release_entries Frees entries passed to search callback. Library allocates entries, attributes and
+ * values separately on the handle context, they are released once results are encoded.
+ */
+static void server_release_entries(ld_entry_t **entries)
+{
+    for (int i = 0; entries && entries[i]; ++i)
+    {
+        GHashTableIter iter;
+        gpointer key = NULL, value = NULL;
+
+        g_hash_table_iter_init(&iter, entries[i]->attributes);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+        {
+            LDAPAttribute_t *attribute = value;
+
+            for (int j = 0; attribute->values && attribute->values[j]; ++j)
+            {
+                talloc_free(attribute->values[j]);
+            }
+
+            g_hash_table_iter_remove(&iter);
+
+            talloc_free(attribute->values);
+            talloc_free(attribute->name);
+            talloc_free(attribute);
+        }
+
+        talloc_free(entries[i]);
+    }
+
+    talloc_free(entries);
+}
+
+static enum OperationReturnCode server_on_search(struct ldap_connection_ctx_t *connection,
+                                                 ld_entry_t **entries,
+                                                 void *user_data)
+{
+    (void)(connection);
+
+    proxy_ticket_t *ticket = talloc_get_type_abort(user_data, proxy_ticket_t);
+    proxy_server_t *server = ticket->server;
+
+    proxy_fetch_t *fetch = g_hash_table_lookup(server->fetch_ids, GUINT_TO_POINTER(ticket->fetch));
+
+    talloc_free(ticket);
+
+    if (!fetch)
+    {
+        server_release_entries(entries);
+        return RETURN_CODE_SUCCESS;
+    }
+
+    int n_entries = 0;
+    while (entries && entries[n_entries])
+    {
+        ++n_entries;
+    }
+
+    // Last element is made of SearchResultDone message.
+    proxy_result_t *result = proxy_protocol_encode_entries(server, entries, n_entries > 0 ? n_entries - 1 : 0,
+                                                           fetch->search->attributes_only);
+
+    server_release_entries(entries);
+
+    if (!result)
+    {
+        fetch_finish(fetch, NULL, LDAP_OTHER, "Unable to encode search result");
+        return RETURN_CODE_FAILURE;
+    }
+
+    char *key = talloc_steal(result, fetch->key);
+
+    fetch_finish(fetch, result, LDAP_SUCCESS, NULL);
+
+    proxy_cache_put(server->cache, key, result, ld_now());
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief server_on_search_failed Answers waiters of the fetch with error returned by upstream server, error results
+ * are not cached. Errors detected by the library itself are reported as unavailable upstream.
+ */
+static void server_on_search_failed(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    proxy_ticket_t *ticket = talloc_get_type_abort(user_data, proxy_ticket_t);
+    proxy_server_t *server = ticket->server;
+
+    proxy_fetch_t *fetch = g_hash_table_lookup(server->fetch_ids, GUINT_TO_POINTER(ticket->fetch));
+
+    talloc_free(ticket);
+
+    if (!fetch)
+    {
+        return;
+    }
+
+    ld_warning("server_on_search_failed - search of %s failed: %s\n", fetch->search->base,
+               ldap_err2string(result_code));
+
+    if (LDAP_API_ERROR(result_code))
+    {
+        fetch_finish(fetch, NULL, LDAP_UNAVAILABLE, "Upstream search failed");
+        return;
+    }
+
+    fetch_finish(fetch, NULL, result_code, ldap_err2string(result_code));
+}
+
+/**
+ * @brief server_dispatch Sends fetches waiting in backlog to upstream connections with free capacity.
+ */
+static void server_dispatch(proxy_server_t *server)
+{
+    while (server->backlog_head)
+    {
+        LDHandle *handle = proxy_pool_acquire(server->pool);
+        if (!handle)
+        {
+            return;
+        }
+
+        proxy_fetch_t *fetch = server->backlog_head;
+
+        proxy_ticket_t *ticket = talloc_zero(server, proxy_ticket_t);
+        if (!ticket)
+        {
+            return;
+        }
+
+        ticket->server = server;
+        ticket->fetch = fetch->id;
+
+        enum OperationReturnCode rc = search_ext(handle->connection_ctx, fetch->search->base,
+                                                 fetch->search->scope, fetch->search->filter,
+                                                 fetch->search->attributes, fetch->search->attributes_only,
+                                                 server_on_search, server_on_search_failed, ticket);
+        if (rc == RETURN_CODE_WOULD_BLOCK)
+        {
+            talloc_free(ticket);
+            return;
+        }
+
+        server->backlog_head = fetch->next;
+        if (!server->backlog_head)
+        {
+            server->backlog_tail = NULL;
+        }
+        fetch->next = NULL;
+        fetch->submitted = true;
+
+        if (rc != RETURN_CODE_SUCCESS)
+        {
+            talloc_free(ticket);
+            fetch_finish(fetch, NULL, LDAP_OTHER, "Unable to send search upstream");
+        }
+    }
+}
+
+static void server_on_dispatch(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    server_dispatch(verto_get_private(ev));
+}
+
+static proxy_fetch_t *server_fetch_new(proxy_server_t *server, const char *key, proxy_search_t *search)
+{
+    proxy_fetch_t *fetch = talloc_zero(server, proxy_fetch_t);
+    if (!fetch || !(fetch->key = talloc_strdup(fetch, key)))
+    {
+        talloc_free(fetch);
+        return NULL;
+    }
+
+    fetch->server = server;
+    fetch->id = server_next_id(server);
+    fetch->search = talloc_steal(fetch, search);
+
+    fetch->timeout = verto_add_timeout(server->base, VERTO_EV_FLAG_NONE, fetch_on_timeout,
+                                       server->config.request_timeout);
+    if (!fetch->timeout)
+    {
+        talloc_free(fetch);
+        return NULL;
+    }
+    verto_set_private(fetch->timeout, fetch, NULL);
+
+    if (server->backlog_tail)
+    {
+        server->backlog_tail->next = fetch;
+    }
+    else
+    {
+        server->backlog_head = fetch;
+    }
+    server->backlog_tail = fetch;
+
+    g_hash_table_insert(server->fetches, fetch->key, fetch);
+    g_hash_table_insert(server->fetch_ids, GUINT_TO_POINTER(fetch->id), fetch);
+
+    talloc_set_destructor((void*)fetch, fetch_destructor);
+
+    return fetch;
+}
+
+static void client_search(proxy_client_t *client, proxy_request_t *request)
+{
+    proxy_server_t *server = client->server;
+    proxy_search_t *search = request->search;
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    char *key = proxy_cache_key(talloc_ctx, search);
+    if (!key)
+    {
+        client_send_result(client, request->msgid, LDAP_RES_SEARCH_RESULT, LDAP_OTHER, "Out of memory");
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    const proxy_result_t *result = proxy_cache_get(server->cache, key, ld_now());
+    if (result)
+    {
+        client_send_entries(client, request->msgid, result, search->size_limit);
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    if (client->n_pending >= server->config.max_pending)
+    {
+        client_send_result(client, request->msgid, LDAP_RES_SEARCH_RESULT, LDAP_BUSY, "Too many searches in progress");
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    proxy_fetch_t *fetch = g_hash_table_lookup(server->fetches, key);
+    if (!fetch)
+    {
+        fetch = server_fetch_new(server, key, search);
+    }
+
+    proxy_waiter_t *waiters = fetch ? talloc_realloc(fetch, fetch->waiters, proxy_waiter_t, fetch->n_waiters + 1)
+                                    : NULL;
+    if (!waiters)
+    {
+        client_send_result(client, request->msgid, LDAP_RES_SEARCH_RESULT, LDAP_OTHER, "Out of memory");
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    fetch->waiters = waiters;
+    fetch->waiters[fetch->n_waiters].client = client->id;
+    fetch->waiters[fetch->n_waiters].msgid = request->msgid;
+    fetch->waiters[fetch->n_waiters].size_limit = search->size_limit;
+    ++fetch->n_waiters;
+    ++client->n_pending;
+
+    talloc_free(talloc_ctx);
+}
+
+static void client_abandon(proxy_client_t *client, int msgid)
+{
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, client->server->fetch_ids);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        proxy_fetch_t *fetch = value;
+
+        for (int i = 0; i < fetch->n_waiters; ++i)
+        {
+            if (fetch->waiters[i].client == client->id && fetch->waiters[i].msgid == msgid)
+            {
+                fetch->waiters[i] = fetch->waiters[--fetch->n_waiters];
+                --client->n_pending;
+                return;
+            }
+        }
+    }
+}
+
+static void client_bind(proxy_client_t *client, proxy_request_t *request)
+{
+    int code = LDAP_SUCCESS;
+    const char *message = NULL;
+
+    // Every client shares identity of upstream connections, access is controlled by permissions of the socket.
+    if (request->version != LDAP_VERSION3)
+    {
+        code = LDAP_PROTOCOL_ERROR;
+        message = "Only LDAPv3 is supported";
+    }
+    else if (request->bind_method == LDAP_AUTH_SIMPLE)
+    {
+        if (request->has_credentials || request->bind_dn[0] != '\0')
+        {
+            code = LDAP_INAPPROPRIATE_AUTH;
+            message = "Proxy accepts anonymous and SASL EXTERNAL binds only";
+        }
+    }
+    else if (request->bind_method != LDAP_AUTH_SASL || !request->sasl_mechanism
+             || strcmp(request->sasl_mechanism, "EXTERNAL") != 0)
+    {
+        code = LDAP_AUTH_METHOD_NOT_SUPPORTED;
+        message = "Proxy accepts anonymous and SASL EXTERNAL binds only";
+    }
+
+    client_send_result(client, request->msgid, LDAP_RES_BIND, code, message);
+}
+
+static void client_handle(proxy_client_t *client, proxy_request_t *request)
+{
+    ber_tag_t response = proxy_protocol_response_tag(request->operation);
+
+    switch (request->operation)
+    {
+    case LDAP_REQ_UNBIND:
+        client->closing = true;
+        break;
+    case LDAP_REQ_ABANDON:
+        client_abandon(client, request->abandon_msgid);
+        break;
+    case LDAP_REQ_BIND:
+        client_bind(client, request);
+        break;
+    case LDAP_REQ_SEARCH:
+        client_search(client, request);
+        break;
+    default:
+        if (response == LBER_DEFAULT)
+        {
+            client_send_result(client, 0, LDAP_RES_EXTENDED, LDAP_PROTOCOL_ERROR, "Unknown operation");
+            client->closing = true;
+        }
+        else
+        {
+            client_send_result(client, request->msgid, response, LDAP_UNWILLING_TO_PERFORM,
+                               "Proxy serves read operations only");
+        }
+        break;
+    }
+}
+
+static void client_on_read(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    proxy_client_t *client = verto_get_private(ev);
+    proxy_server_t *server = client->server;
+
+    for (int i = 0; i < PROXY_MESSAGES_PER_READ && !client->closing && !client->failed; ++i)
+    {
+        if (!client->ber && !(client->ber = ber_alloc_t(0)))
+        {
+            client->failed = true;
+            break;
+        }
+
+        ber_len_t length = 0;
+
+        errno = 0;
+        ber_tag_t tag = ber_get_next(client->sockbuf, &length, client->ber);
+
+        if (tag == LBER_DEFAULT)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                client->closing = true;
+            }
+            break;
+        }
+
+        proxy_request_t *request = tag == LDAP_TAG_MESSAGE ? proxy_protocol_decode(client, client->ber) : NULL;
+
+        ber_free(client->ber, 1);
+        client->ber = NULL;
+
+        if (!request)
+        {
+            ld_warning("client_on_read - malformed message from client %u\n", client->id);
+            client_send_result(client, 0, LDAP_RES_EXTENDED, LDAP_PROTOCOL_ERROR, "Malformed message");
+            client->closing = true;
+            break;
+        }
+
+        client_handle(client, request);
+
+        talloc_free(request);
+    }
+
+    server_dispatch(server);
+
+    if (!client_flush(client) || client->closing)
+    {
+        talloc_free(client);
+    }
+}
+
+static void client_on_write(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    proxy_client_t *client = verto_get_private(ev);
+
+    if (!client_flush(client))
+    {
+        talloc_free(client);
+    }
+}
+
+static int client_destructor(TALLOC_CTX *ctx)
+{
+    proxy_client_t *client = talloc_get_type_abort(ctx, proxy_client_t);
+
+    ld_info("client_destructor - client %u disconnected\n", client->id);
+
+    if (client->read_event)
+    {
+        verto_del(client->read_event);
+    }
+
+    if (client->write_event)
+    {
+        verto_del(client->write_event);
+    }
+
+    if (client->close_event)
+    {
+        verto_del(client->close_event);
+    }
+
+    if (client->ber)
+    {
+        ber_free(client->ber, 1);
+    }
+
+    if (client->sockbuf)
+    {
+        // Closes the socket as well.
+        ber_sockbuf_free(client->sockbuf);
+    }
+    else if (client->fd >= 0)
+    {
+        close(client->fd);
+    }
+
+    if (client->server->clients)
+    {
+        g_hash_table_remove(client->server->clients, GUINT_TO_POINTER(client->id));
+    }
+
+    return 0;
+}
+
+static void server_accept(proxy_server_t *server, int fd)
+{
+    if ((int)g_hash_table_size(server->clients) >= server->config.max_clients)
+    {
+        ld_warning("server_accept - too many clients, connection refused\n");
+        close(fd);
+        return;
+    }
+
+    proxy_client_t *client = talloc_zero(server, proxy_client_t);
+    if (!client)
+    {
+        close(fd);
+        return;
+    }
+
+    client->server = server;
+    client->id = server_next_id(server);
+    client->fd = fd;
+
+    talloc_set_destructor((void*)client, client_destructor);
+
+    ber_len_t max_incoming = PROXY_MAX_INCOMING;
+
+    client->sockbuf = ber_sockbuf_alloc();
+    if (!client->sockbuf
+        || ber_sockbuf_add_io(client->sockbuf, &ber_sockbuf_io_fd, LBER_SBIOD_LEVEL_PROVIDER, &client->fd) != 0
+        || ber_sockbuf_ctrl(client->sockbuf, LBER_SB_OPT_SET_MAX_INCOMING, &max_incoming) != 1)
+    {
+        ld_error("server_accept - unable to set up client socket!\n");
+        talloc_free(client);
+        return;
+    }
+
+    client->read_event = verto_add_io(server->base, VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_READ,
+                                      client_on_read, fd);
+    if (!client->read_event)
+    {
+        talloc_free(client);
+        return;
+    }
+    verto_set_private(client->read_event, client, NULL);
+
+    g_hash_table_insert(server->clients, GUINT_TO_POINTER(client->id), client);
+
+    struct ucred credentials;
+    socklen_t credentials_length = sizeof(credentials);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentials_length) == 0)
+    {
+        ld_info("server_accept - client %u connected, pid %d uid %d\n", client->id, (int)credentials.pid,
+                (int)credentials.uid);
+    }
+}
+
+static void server_on_accept(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    proxy_server_t *server = verto_get_private(ev);
+
+    for (;;)
+    {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                ld_warning("server_on_accept - accept failed: %s\n", strerror(errno));
+            }
+
+            if (errno != EINTR)
+            {
+                return;
+            }
+            continue;
+        }
+
+        server_accept(server, fd);
+    }
+}
+
+static int server_listen(proxy_server_t *server)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (strlen(server->config.socket_path) >= sizeof(address.sun_path))
+    {
+        ld_error("server_listen - socket path %s is too long!\n", server->config.socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, server->config.socket_path);
+
+    // Socket left by previous instance is replaced, anything else at the path is kept.
+    struct stat path_stat;
+    if (lstat(address.sun_path, &path_stat) == 0)
+    {
+        if (!S_ISSOCK(path_stat.st_mode))
+        {
+            ld_error("server_listen - %s exists and is not a socket!\n", address.sun_path);
+            return -1;
+        }
+        unlink(address.sun_path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        ld_error("server_listen - unable to create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0
+        || chmod(address.sun_path, server->config.socket_mode) != 0
+        || listen(fd, SOMAXCONN) != 0)
+    {
+        ld_error("server_listen - unable to listen on %s: %s\n", address.sun_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int server_destructor(TALLOC_CTX *ctx)
+{
+    proxy_server_t *server = talloc_get_type_abort(ctx, proxy_server_t);
+
+    if (server->listen_event)
+    {
+        verto_del(server->listen_event);
+    }
+
+    if (server->dispatch_event)
+    {
+        verto_del(server->dispatch_event);
+    }
+
+    if (server->listen_fd >= 0)
+    {
+        close(server->listen_fd);
+        unlink(server->config.socket_path);
+    }
+
+    // Clients and fetches unregister themselves, so they go before the tables.
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    if (server->fetch_ids)
+    {
+        g_hash_table_iter_init(&iter, server->fetch_ids);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+        {
+            proxy_fetch_t *fetch = value;
+
+            g_hash_table_iter_remove(&iter);
+            g_hash_table_remove(server->fetches, fetch->key);
+            talloc_set_destructor((void*)fetch, NULL);
+
+            if (fetch->timeout)
+            {
+                verto_del(fetch->timeout);
+            }
+            talloc_free(fetch);
+        }
+    }
+
+    if (server->clients)
+    {
+        g_hash_table_iter_init(&iter, server->clients);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+        {
+            g_hash_table_iter_remove(&iter);
+            talloc_free(value);
+        }
+    }
+
+    // Upstream connections go before remaining tickets their callbacks refer to.
+    talloc_free(server->pool);
+
+    if (server->clients)
+    {
+        g_hash_table_destroy(server->clients);
+    }
+
+    if (server->fetches)
+    {
+        g_hash_table_destroy(server->fetches);
+    }
+
+    if (server->fetch_ids)
+    {
+        g_hash_table_destroy(server->fetch_ids);
+    }
+
+    server->clients = NULL;
+    server->fetches = NULL;
+    server->fetch_ids = NULL;
+
+    return 0;
+}
+
+/**
+ * @brief proxy_server_new Starts listening on Unix socket and establishing upstream connections.
+ * @param[in] ctx    Memory context to allocate server on, server stops when it is freed.
+ * @param[in] base   Event loop to run on.
+ * @param[in] config Settings of the proxy.
+ * @return
+ *        - NULL on failure.
+ *        - server.
+ */
+proxy_server_t *proxy_server_new(TALLOC_CTX *ctx, verto_ctx *base, const proxy_config_t *config)
+{
+    if (!base || !config || !config->socket_path || !config->upstream_config)
+    {
+        ld_error("proxy_server_new - invalid parameters!\n");
+        return NULL;
+    }
+
+    proxy_server_t *server = talloc_zero(ctx, proxy_server_t);
+    if (!server)
+    {
+        ld_error("proxy_server_new - out of memory!\n");
+        return NULL;
+    }
+
+    server->base = base;
+    server->config = *config;
+    server->config.socket_path = talloc_strdup(server, config->socket_path);
+    server->config.upstream_config = talloc_strdup(server, config->upstream_config);
+    server->listen_fd = -1;
+
+    server->clients = g_hash_table_new(g_direct_hash, g_direct_equal);
+    server->fetches = g_hash_table_new(g_str_hash, g_str_equal);
+    server->fetch_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    talloc_set_destructor((void*)server, server_destructor);
+
+    if (!server->config.socket_path || !server->config.upstream_config
+        || !server->clients || !server->fetches || !server->fetch_ids)
+    {
+        ld_error("proxy_server_new - out of memory!\n");
+        talloc_free(server);
+        return NULL;
+    }
+
+    server->upstream_ctx = talloc_new(server);
+    server->upstream_config = server->upstream_ctx
+            ? ld_load_config(server->upstream_ctx, server->config.upstream_config)
+            : NULL;
+    if (!server->upstream_config)
+    {
+        talloc_free(server);
+        return NULL;
+    }
+
+    server->cache = proxy_cache_new(server, config->cache_capacity, config->cache_ttl);
+    server->pool = proxy_pool_new(server, base, server->upstream_config, config->pool_size);
+    if (!server->cache || !server->pool)
+    {
+        talloc_free(server);
+        return NULL;
+    }
+
+    server->listen_fd = server_listen(server);
+    if (server->listen_fd < 0)
+    {
+        talloc_free(server);
+        return NULL;
+    }
+
+    server->listen_event = verto_add_io(base, VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_READ, server_on_accept,
+                                        server->listen_fd);
+    server->dispatch_event = verto_add_timeout(base, VERTO_EV_FLAG_PERSIST, server_on_dispatch,
+                                               PROXY_DISPATCH_INTERVAL);
+    if (!server->listen_event || !server->dispatch_event)
+    {
+        ld_error("proxy_server_new - unable to add events!\n");
+        talloc_free(server);
+        return NULL;
+    }
+
+    verto_set_private(server->listen_event, server, NULL);
+    verto_set_private(server->dispatch_event, server, NULL);
+
+    ld_info("proxy_server_new - listening on %s\n", server->config.socket_path);
+
+    return server;
+}
+
+/**
+ * @brief proxy_server_reload Reads configuration of upstream connections again and applies it without dropping
+ * searches in progress. Cached results are dropped as they may have been read with previous settings.
+ * @param[in] server Server to use.
+ * @return
+ *        - false if configuration could not be read, previous one stays in use.
+ *        - true on success.
+ */
+bool proxy_server_reload(proxy_server_t *server)
+{
+    TALLOC_CTX *upstream_ctx = talloc_new(server);
+    ld_config_t *upstream_config = upstream_ctx
+            ? ld_load_config(upstream_ctx, server->config.upstream_config)
+            : NULL;
+
+    if (!upstream_config)
+    {
+        ld_error("proxy_server_reload - unable to read %s, keeping previous configuration!\n",
+                 server->config.upstream_config);
+        talloc_free(upstream_ctx);
+        return false;
+    }
+
+    proxy_pool_reload(server->pool, upstream_config);
+    proxy_cache_clear(server->cache);
+
+    talloc_free(server->upstream_ctx);
+    server->upstream_ctx = upstream_ctx;
+    server->upstream_config = upstream_config;
+
+    ld_info("proxy_server_reload - reloaded %s\n", server->config.upstream_config);
+
+    return true;
+}
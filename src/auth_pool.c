@@ -0,0 +1,639 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "auth_pool.h"
+#include "domain_p.h"
+#include "tls_cache.h"
+
+#include <glib-2.0/glib.h>
+#include <string.h>
+
+static const int AUTH_POOL_CONNECT_RETRY_INTERVAL = 50;
+static const int AUTH_POOL_RECONNECT_INTERVAL = 1000;
+
+/*!
+ * @brief auth_slot_state_t - State of pooled connection.
+ */
+typedef enum auth_slot_state_e
+{
+    AUTH_SLOT_STATE_CLOSED,                  //!< Connection is closed and waits for reconnect.
+    AUTH_SLOT_STATE_CONNECTING,              //!< Transport is being established.
+    AUTH_SLOT_STATE_TLS_NEGOTIATION,         //!< StartTLS request is in flight.
+    AUTH_SLOT_STATE_RESET,                   //!< Anonymous bind establishing the connection is in flight.
+    AUTH_SLOT_STATE_READY,                   //!< Connection is idle and may check credentials.
+    AUTH_SLOT_STATE_BIND_IN_PROGRESS,        //!< Bind checking credentials is in flight.
+} auth_slot_state_t;
+
+/*!
+ * @brief auth_request_t - Credential check waiting for connection or in flight.
+ */
+typedef struct auth_request_s
+{
+    char *dn;                                //!< Dn to bind with.
+    struct berval password;                  //!< Password to bind with, wiped once request is freed.
+    auth_callback_fn callback;               //!< Callback to report result to.
+    void *user_data;                         //!< User data to pass to callback.
+} auth_request_t;
+
+/*!
+ * @brief auth_slot_t - Pooled connection.
+ */
+typedef struct auth_slot_s
+{
+    struct ld_auth_pool_s *pool;             //!< Pool connection belongs to.
+    auth_slot_state_t state;                 //!< State of the connection.
+    LDAP *ldap;                              //!< LDAP handle of the connection.
+    verto_ev *read_event;                    //!< Event which fires when responses arrive.
+    verto_ev *timer_event;                   //!< Reconnect, connect retry or request deadline.
+    int msgid;                               //!< Message id of request in flight, -1 if there is none.
+    auth_request_t *request;                 //!< Credential check in flight.
+} auth_slot_t;
+
+/*!
+ * @brief ld_auth_pool_t - Connections which are only used to check credentials with simple bind. They skip
+ * directory detection and schema loading, so credential check takes single round trip.
+ */
+struct ld_auth_pool_s
+{
+    verto_ctx *base;                         //!< Event loop connections are served by.
+    ld_config_t *config;                     //!< Server and TLS settings.
+    tls_cache_t *tls_cache;                  //!< TLS context and session shared by connections.
+    auth_slot_t *slots;                      //!< Pooled connections.
+    int size;                                //!< Number of pooled connections.
+    GQueue *waiting;                         //!< Credential checks waiting for idle connection.
+};
+
+static void auth_slot_connect(auth_slot_t *slot);
+static void auth_slot_start(auth_slot_t *slot);
+static void auth_slot_fail(auth_slot_t *slot, int result_code);
+static void auth_pool_dispatch(ld_auth_pool_t *pool);
+
+static int auth_request_destructor(auth_request_t *request)
+{
+    if (request->password.bv_val)
+    {
+        explicit_bzero(request->password.bv_val, request->password.bv_len);
+    }
+
+    return 0;
+}
+
+static void auth_slot_close(auth_slot_t *slot)
+{
+    if (slot->read_event)
+    {
+        verto_del(slot->read_event);
+        slot->read_event = NULL;
+    }
+
+    if (slot->timer_event)
+    {
+        verto_del(slot->timer_event);
+        slot->timer_event = NULL;
+    }
+
+    if (slot->ldap)
+    {
+        ldap_unbind_ext_s(slot->ldap, NULL, NULL);
+        slot->ldap = NULL;
+    }
+
+    slot->state = AUTH_SLOT_STATE_CLOSED;
+    slot->msgid = -1;
+}
+
+static int auth_pool_destructor(ld_auth_pool_t *pool)
+{
+    for (int i = 0; i < pool->size; ++i)
+    {
+        auth_slot_close(&pool->slots[i]);
+    }
+
+    // Requests are allocated on pool and freed together with it, callbacks are not called.
+    g_queue_free(pool->waiting);
+
+    return 0;
+}
+
+static void auth_slot_on_timer(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    auth_slot_t *slot = verto_get_private(ev);
+
+    // One shot event is freed by the loop once callback returns.
+    slot->timer_event = NULL;
+
+    switch (slot->state)
+    {
+    case AUTH_SLOT_STATE_CLOSED:
+        auth_slot_connect(slot);
+        break;
+    case AUTH_SLOT_STATE_CONNECTING:
+        auth_slot_start(slot);
+        break;
+    default:
+        if (slot->request)
+        {
+            ld_warning("ld_authenticate - bind of %s timed out!\n", slot->request->dn);
+        }
+
+        // Connection with request in flight can not be reused.
+        auth_slot_fail(slot, LDAP_TIMEOUT);
+        break;
+    }
+}
+
+static void auth_slot_set_timer(auth_slot_t *slot, int interval)
+{
+    if (slot->timer_event)
+    {
+        verto_del(slot->timer_event);
+        slot->timer_event = NULL;
+    }
+
+    if (interval < 0)
+    {
+        return;
+    }
+
+    slot->timer_event = verto_add_timeout(slot->pool->base, VERTO_EV_FLAG_NONE, auth_slot_on_timer, interval);
+    if (!slot->timer_event)
+    {
+        ld_error("ld_authenticate - unable to create timer event!\n");
+        return;
+    }
+
+    verto_set_private(slot->timer_event, slot, NULL);
+}
+
+static bool auth_pool_has_connection(ld_auth_pool_t *pool)
+{
+    for (int i = 0; i < pool->size; ++i)
+    {
+        if (pool->slots[i].state == AUTH_SLOT_STATE_READY || pool->slots[i].state == AUTH_SLOT_STATE_BIND_IN_PROGRESS)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief auth_slot_fail Closes broken connection and schedules reconnect. Request in flight fails, waiting
+ * requests fail too when no connection of the pool is established.
+ * @param[in] slot        Connection to work with.
+ * @param[in] result_code Result code to report to request in flight.
+ */
+static void auth_slot_fail(auth_slot_t *slot, int result_code)
+{
+    ld_auth_pool_t *pool = slot->pool;
+    auth_request_t *request = slot->request;
+
+    // Idle connection dropped by server is restored at once, failed setup is retried later.
+    bool established = slot->state == AUTH_SLOT_STATE_READY || slot->state == AUTH_SLOT_STATE_BIND_IN_PROGRESS;
+
+    slot->request = NULL;
+    auth_slot_close(slot);
+    auth_slot_set_timer(slot, established ? 0 : AUTH_POOL_RECONNECT_INTERVAL);
+
+    if (request)
+    {
+        request->callback(result_code, request->user_data);
+        talloc_free(request);
+    }
+
+    if (!established && !auth_pool_has_connection(pool))
+    {
+        auth_request_t *waiting = NULL;
+
+        while ((waiting = g_queue_pop_head(pool->waiting)) != NULL)
+        {
+            waiting->callback(LDAP_SERVER_DOWN, waiting->user_data);
+            talloc_free(waiting);
+        }
+    }
+}
+
+static void auth_slot_ready(auth_slot_t *slot)
+{
+    slot->state = AUTH_SLOT_STATE_READY;
+    slot->msgid = -1;
+
+    auth_slot_set_timer(slot, -1);
+    auth_pool_dispatch(slot->pool);
+}
+
+static void auth_slot_on_result(auth_slot_t *slot, int result_code)
+{
+    switch (slot->state)
+    {
+    case AUTH_SLOT_STATE_TLS_NEGOTIATION:
+        if (result_code == LDAP_SUCCESS && !ldap_tls_inplace(slot->ldap))
+        {
+            result_code = ldap_install_tls(slot->ldap);
+        }
+
+        if (result_code != LDAP_SUCCESS)
+        {
+            ld_error("ld_authenticate - unable to establish TLS - code: %d %s\n", result_code,
+                     ldap_err2string(result_code));
+
+            // Next attempt performs full handshake in case server rejected cached session.
+            tls_cache_forget_session(slot->pool->tls_cache);
+            auth_slot_fail(slot, LDAP_CONNECT_ERROR);
+            return;
+        }
+
+        auth_slot_ready(slot);
+        break;
+    case AUTH_SLOT_STATE_RESET:
+        // Server may refuse anonymous bind, connection is established anyway.
+        auth_slot_ready(slot);
+        break;
+    case AUTH_SLOT_STATE_BIND_IN_PROGRESS:
+    {
+        auth_request_t *request = slot->request;
+        slot->request = NULL;
+
+        // Connection stays bound as the user until next check, it is never used for other operations.
+        auth_slot_ready(slot);
+
+        request->callback(result_code, request->user_data);
+        talloc_free(request);
+    }
+        break;
+    default:
+        break;
+    }
+}
+
+static void auth_slot_on_read(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+
+    auth_slot_t *slot = verto_get_private(ev);
+
+    struct timeval timeout = { 0, 0 };
+    LDAPMessage *message = NULL;
+
+    while (slot->ldap)
+    {
+        int rc = ldap_result(slot->ldap, LDAP_RES_ANY, LDAP_MSG_ALL, &timeout, &message);
+
+        if (rc == 0)
+        {
+            return;
+        }
+
+        if (rc < 0)
+        {
+            auth_slot_fail(slot, LDAP_SERVER_DOWN);
+            return;
+        }
+
+        int msgid = ldap_msgid(message);
+        int result_code = LDAP_OTHER;
+
+        if (ldap_parse_result(slot->ldap, message, &result_code, NULL, NULL, NULL, NULL, true) != LDAP_SUCCESS)
+        {
+            result_code = LDAP_OTHER;
+        }
+
+        if (msgid == 0)
+        {
+            // Notice of disconnection.
+            auth_slot_fail(slot, LDAP_SERVER_DOWN);
+            return;
+        }
+
+        if (msgid == slot->msgid)
+        {
+            auth_slot_on_result(slot, result_code);
+        }
+    }
+}
+
+/**
+ * @brief auth_slot_send Sends request over connection, installing read handler once transport is established.
+ * @return
+ *        - LDAP_SUCCESS when request is sent.
+ *        - LDAP_X_CONNECTING when transport is still being established.
+ *        - LDAP result code on failure.
+ */
+static int auth_slot_send(auth_slot_t *slot, const char *dn, struct berval *password)
+{
+    struct berval anonymous = { 0, "" };
+    int rc = LDAP_SUCCESS;
+
+    if (slot->state == AUTH_SLOT_STATE_CONNECTING && slot->pool->config->use_tls)
+    {
+        rc = ldap_start_tls(slot->ldap, NULL, NULL, &slot->msgid);
+    }
+    else
+    {
+        rc = ldap_sasl_bind(slot->ldap, dn ? dn : "", LDAP_SASL_SIMPLE, password ? password : &anonymous,
+                            NULL, NULL, &slot->msgid);
+    }
+
+    if (rc != LDAP_SUCCESS || slot->read_event)
+    {
+        return rc;
+    }
+
+    int fd = -1;
+    if (ldap_get_option(slot->ldap, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS || fd < 0)
+    {
+        ld_error("ld_authenticate - failed to get valid descriptor!\n");
+        return LDAP_LOCAL_ERROR;
+    }
+
+    slot->read_event = verto_add_io(slot->pool->base, VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_READ,
+                                    auth_slot_on_read, fd);
+    if (!slot->read_event)
+    {
+        ld_error("ld_authenticate - unable to create read event!\n");
+        return LDAP_LOCAL_ERROR;
+    }
+
+    verto_set_private(slot->read_event, slot, NULL);
+
+    return LDAP_SUCCESS;
+}
+
+/**
+ * @brief auth_slot_start Sends first request of the connection, StartTLS or anonymous bind, which establishes
+ * transport.
+ */
+static void auth_slot_start(auth_slot_t *slot)
+{
+    int rc = auth_slot_send(slot, NULL, NULL);
+
+    if (rc == LDAP_X_CONNECTING)
+    {
+        auth_slot_set_timer(slot, AUTH_POOL_CONNECT_RETRY_INTERVAL);
+        return;
+    }
+
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_error("ld_authenticate - unable to connect to %s - %s\n", slot->pool->config->host, ldap_err2string(rc));
+        auth_slot_fail(slot, LDAP_CONNECT_ERROR);
+        return;
+    }
+
+    slot->state = slot->pool->config->use_tls ? AUTH_SLOT_STATE_TLS_NEGOTIATION : AUTH_SLOT_STATE_RESET;
+
+    auth_slot_set_timer(slot, slot->pool->config->operation_timeout > 0 ? slot->pool->config->operation_timeout : -1);
+}
+
+static void auth_slot_connect(auth_slot_t *slot)
+{
+    ld_auth_pool_t *pool = slot->pool;
+    ld_config_t *config = pool->config;
+
+    int rc = ldap_initialize(&slot->ldap, config->host);
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_error("ld_authenticate - error initializing LDAP: %s\n", ldap_err2string(rc));
+        slot->ldap = NULL;
+        auth_slot_fail(slot, LDAP_CONNECT_ERROR);
+        return;
+    }
+
+    slot->state = AUTH_SLOT_STATE_CONNECTING;
+
+    int version = config->protocol_version;
+    rc = ldap_set_option(slot->ldap, LDAP_OPT_PROTOCOL_VERSION, &version);
+    rc = rc == LDAP_OPT_SUCCESS ? ldap_set_option(slot->ldap, LDAP_OPT_REFERRALS, LDAP_OPT_OFF) : rc;
+    rc = rc == LDAP_OPT_SUCCESS ? ldap_set_option(slot->ldap, LDAP_OPT_CONNECT_ASYNC, LDAP_OPT_ON) : rc;
+
+    if (rc == LDAP_OPT_SUCCESS && config->use_tls)
+    {
+        if (config->cacertfile)
+        {
+            rc = ldap_set_option(slot->ldap, LDAP_OPT_X_TLS_CACERTFILE, config->cacertfile);
+        }
+        if (rc == LDAP_OPT_SUCCESS && config->certfile)
+        {
+            rc = ldap_set_option(slot->ldap, LDAP_OPT_X_TLS_CERTFILE, config->certfile);
+        }
+        if (rc == LDAP_OPT_SUCCESS && config->keyfile)
+        {
+            rc = ldap_set_option(slot->ldap, LDAP_OPT_X_TLS_KEYFILE, config->keyfile);
+        }
+
+        // Shared context lets handshakes of pooled connections resume cached session.
+        if (rc == LDAP_OPT_SUCCESS && tls_cache_apply(pool->tls_cache, slot->ldap) != RETURN_CODE_SUCCESS)
+        {
+            const int is_server = 0;
+            rc = ldap_set_option(slot->ldap, LDAP_OPT_X_TLS_NEWCTX, &is_server);
+        }
+    }
+
+    if (rc != LDAP_OPT_SUCCESS)
+    {
+        ld_error("ld_authenticate - unable to set ldap option - %s\n", ldap_err2string(rc));
+        auth_slot_fail(slot, LDAP_LOCAL_ERROR);
+        return;
+    }
+
+    auth_slot_start(slot);
+}
+
+static void auth_slot_bind(auth_slot_t *slot, auth_request_t *request)
+{
+    slot->state = AUTH_SLOT_STATE_BIND_IN_PROGRESS;
+    slot->request = request;
+
+    int rc = auth_slot_send(slot, request->dn, &request->password);
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_warning("ld_authenticate - unable to send bind request - %s\n", ldap_err2string(rc));
+
+        // Request waits for another connection while this one is restored.
+        slot->request = NULL;
+        g_queue_push_head(slot->pool->waiting, request);
+        auth_slot_fail(slot, rc);
+        return;
+    }
+
+    auth_slot_set_timer(slot, slot->pool->config->operation_timeout > 0 ? slot->pool->config->operation_timeout : -1);
+}
+
+/**
+ * @brief auth_pool_dispatch Passes waiting requests to idle connections.
+ */
+static void auth_pool_dispatch(ld_auth_pool_t *pool)
+{
+    for (int i = 0; i < pool->size && !g_queue_is_empty(pool->waiting); ++i)
+    {
+        if (pool->slots[i].state == AUTH_SLOT_STATE_READY)
+        {
+            auth_slot_bind(&pool->slots[i], g_queue_pop_head(pool->waiting));
+        }
+    }
+}
+
+/**
+ * @brief ld_auth_pool_new Creates pool of connections which check credentials with simple bind. Connections
+ * are established right away with StartTLS when config requires TLS, or with anonymous bind otherwise, and skip
+ * directory detection and schema loading.
+ * @param[in] ctx    Memory context to allocate pool on, freeing pool closes its connections. Pool must not be
+ *                   freed from authentication callback.
+ * @param[in] config Server, TLS settings and operation timeout, credentials of the config are not used.
+ * @param[in] base   Event loop to serve connections with.
+ * @param[in] size   Number of connections, checks exceeding it wait for idle connection.
+ * @return
+ *        - Pool on success.
+ *        - NULL on failure.
+ */
+ld_auth_pool_t *ld_auth_pool_new(TALLOC_CTX *ctx, const ld_config_t *config, verto_ctx *base, int size)
+{
+    if (!config || !config->host || !base || size <= 0)
+    {
+        ld_error("ld_auth_pool_new - invalid parameters!\n");
+        return NULL;
+    }
+
+    ld_auth_pool_t *pool = talloc_zero(ctx, ld_auth_pool_t);
+    if (!pool)
+    {
+        ld_error("ld_auth_pool_new - out of memory!\n");
+        return NULL;
+    }
+
+    pool->base = base;
+    pool->size = size;
+    pool->config = talloc_memdup(pool, config, sizeof(ld_config_t));
+    pool->slots = talloc_zero_array(pool, auth_slot_t, size);
+    pool->tls_cache = tls_cache_new(pool);
+    pool->waiting = g_queue_new();
+
+    if (!pool->config || !pool->slots || !pool->tls_cache || !pool->waiting)
+    {
+        ld_error("ld_auth_pool_new - out of memory!\n");
+        g_queue_free(pool->waiting);
+        talloc_free(pool);
+        return NULL;
+    }
+
+    pool->config->host = talloc_strdup(pool, config->host);
+    pool->config->cacertfile = config->cacertfile ? talloc_strdup(pool, config->cacertfile) : NULL;
+    pool->config->certfile = config->certfile ? talloc_strdup(pool, config->certfile) : NULL;
+    pool->config->keyfile = config->keyfile ? talloc_strdup(pool, config->keyfile) : NULL;
+
+    // Credentials of the service account are not needed.
+    pool->config->username = NULL;
+    pool->config->password = NULL;
+
+    talloc_set_destructor(pool, auth_pool_destructor);
+
+    for (int i = 0; i < size; ++i)
+    {
+        pool->slots[i].pool = pool;
+        pool->slots[i].msgid = -1;
+        pool->slots[i].state = AUTH_SLOT_STATE_CLOSED;
+
+        // Connections are established from the loop, so caller gets the pool before any callback.
+        auth_slot_set_timer(&pool->slots[i], 0);
+    }
+
+    return pool;
+}
+
+/**
+ * @brief ld_auth_pool_ready Counts connections ready to check credentials.
+ * @param[in] pool Pool to work with.
+ * @return Number of idle established connections.
+ */
+int ld_auth_pool_ready(const ld_auth_pool_t *pool)
+{
+    int result = 0;
+
+    for (int i = 0; pool && i < pool->size; ++i)
+    {
+        if (pool->slots[i].state == AUTH_SLOT_STATE_READY)
+        {
+            ++result;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief ld_authenticate Checks credentials with simple bind over pooled connection.
+ * @param[in] pool      Pool to work with.
+ * @param[in] dn        Dn of the user.
+ * @param[in] password  Password of the user, must not be empty as server treats such bind as anonymous.
+ * @param[in] callback  Callback to report result to, it is never called before function returns.
+ * @param[in] user_data User data to pass to callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS when check is started.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_authenticate(ld_auth_pool_t *pool,
+                                         const char *dn,
+                                         const char *password,
+                                         auth_callback_fn callback,
+                                         void *user_data)
+{
+    if (!pool || !callback)
+    {
+        ld_error("ld_authenticate - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    // Unauthenticated bind (RFC 4513 section 5.1.2) succeeds without checking password.
+    if (!dn || strlen(dn) == 0 || !password || strlen(password) == 0)
+    {
+        ld_error("ld_authenticate - dn and password must not be empty!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    auth_request_t *request = talloc_zero(pool, auth_request_t);
+    if (!request)
+    {
+        ld_error("ld_authenticate - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    talloc_set_destructor(request, auth_request_destructor);
+
+    request->dn = talloc_strdup(request, dn);
+    request->password.bv_val = talloc_strdup(request, password);
+    request->password.bv_len = strlen(password);
+    request->callback = callback;
+    request->user_data = user_data;
+
+    if (!request->dn || !request->password.bv_val)
+    {
+        ld_error("ld_authenticate - out of memory!\n");
+        talloc_free(request);
+        return RETURN_CODE_FAILURE;
+    }
+
+    g_queue_push_tail(pool->waiting, request);
+    auth_pool_dispatch(pool);
+
+    return RETURN_CODE_SUCCESS;
+}
@@ -0,0 +1,48 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_AUTH_POOL_H
+#define LIB_DOMAIN_AUTH_POOL_H
+
+#include "common.h"
+#include "domain.h"
+
+#include <verto.h>
+
+typedef struct ld_auth_pool_s ld_auth_pool_t;
+
+/*!
+ * @brief auth_callback_fn Callback which receives result of credential check.
+ * @param result_code LDAP_SUCCESS if credentials are valid, LDAP_INVALID_CREDENTIALS if they are not,
+ *                    other result code if check could not be performed.
+ * @param user_data   User data passed to ld_authenticate.
+ */
+typedef void (*auth_callback_fn)(int result_code, void *user_data);
+
+ld_auth_pool_t *ld_auth_pool_new(TALLOC_CTX *ctx, const ld_config_t *config, verto_ctx *base, int size);
+int ld_auth_pool_ready(const ld_auth_pool_t *pool);
+
+enum OperationReturnCode ld_authenticate(ld_auth_pool_t *pool,
+                                         const char *dn,
+                                         const char *password,
+                                         auth_callback_fn callback,
+                                         void *user_data);
+
+#endif //LIB_DOMAIN_AUTH_POOL_H
@@ -30,6 +30,7 @@ enum OperationReturnCode
     RETURN_CODE_MISSING_ATTRIBUTE     = 3,          //!< Required attribute for LDAP entry was not provided.
     RETURN_CODE_OPERATION_IN_PROGRESS = 4,          //!< Current operation is in progress.
     RETURN_CODE_REPEAT_LAST_OPERATION = 5,          //!< Last function call must be repeated.
+    RETURN_CODE_WOULD_BLOCK           = 6,          //!< Too many operations are in flight, retry once connection is writable.
 };
 
 /*!
@@ -39,6 +40,8 @@ enum OperationReturnCode
 typedef struct ldap_global_context_t
 {
     LDAP *global_ldap;                              //!< Global ldap context for sharing between connections.
+    struct tls_cache_t *tls_cache;                  //!< TLS context and session shared between connections.
+    struct gss_cache_t *gss_cache;                  //!< Kerberos credential shared between connections.
     TALLOC_CTX *talloc_ctx;                         //!< Pointer to valid TALLOC_CTX. We use this internally
                                                     //!< when we working with ldap entries.
 } ldap_global_context_t;
@@ -21,10 +21,13 @@
 #include "computer.h"
 
 #include "common.h"
+#include "directory.h"
 #include "domain_p.h"
 #include "entry.h"
 #include "helper_p.h"
 
+#include <string.h>
+
 enum ComputerAttributeIndex
 {
     OBJECT_CLASS           = 0,
@@ -147,3 +150,160 @@ enum OperationReturnCode ld_rename_computer(LDHandle *handle, const char *old_na
     error_exit:
     return RETURN_CODE_FAILURE;
 }
+
+#define COMPUTER_LIST_PAGE_SIZE 500
+
+static const char *COMPUTER_ATTRIBUTES_AD[] =
+{
+    "cn", "description", "dNSHostName", NULL
+};
+
+static const char *COMPUTER_ATTRIBUTES_OPENLDAP[] =
+{
+    "cn", "description", NULL
+};
+
+static const char *COMPUTER_FILTER_AD = "(objectClass=computer)";
+static const char *COMPUTER_FILTER_OPENLDAP = "(objectClass=device)";
+
+static void *computer_from_entry(TALLOC_CTX *ctx, int directory_type, ld_entry_t *entry)
+{
+    const char *dn = ld_entry_get_dn(entry);
+
+    // Last message of search result chain carries no entry.
+    if (!dn || strlen(dn) == 0)
+    {
+        return NULL;
+    }
+
+    ld_computer_t *computer = talloc_zero(ctx, ld_computer_t);
+    if (!computer)
+    {
+        return NULL;
+    }
+
+    // Attributes reference values stored in the entry, so computer takes ownership of the entry.
+    talloc_steal(computer, entry);
+    computer->attributes = ld_entry_get_attributes(entry);
+
+    computer->dn = talloc_strdup(computer, dn);
+    computer->name = ld_entry_get_first_value(entry, "cn");
+    computer->description = ld_entry_get_first_value(entry, "description");
+
+    if (directory_type == LDAP_TYPE_ACTIVE_DIRECTORY)
+    {
+        computer->dns_host_name = ld_entry_get_first_value(entry, "dNSHostName");
+    }
+
+    return computer;
+}
+
+static enum OperationReturnCode computer_search(LDHandle *handle,
+                                                const char *base_dn,
+                                                int scope,
+                                                const char **attributes,
+                                                computer_list_callback_fn callback,
+                                                void *user_data)
+{
+    const char *filter = NULL;
+    const char **default_attributes = NULL;
+
+    switch (handle->connection_ctx->directory_type)
+    {
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        filter = COMPUTER_FILTER_AD;
+        default_attributes = COMPUTER_ATTRIBUTES_AD;
+        break;
+    case LDAP_TYPE_OPENLDAP:
+        filter = COMPUTER_FILTER_OPENLDAP;
+        default_attributes = COMPUTER_ATTRIBUTES_OPENLDAP;
+        break;
+    default:
+        ld_error("Listing computers is not implemented for directory type %d!\n",
+                 handle->connection_ctx->directory_type);
+        return RETURN_CODE_FAILURE;
+    }
+
+    char **attrs = (char**)(attributes ? attributes : default_attributes);
+
+    return search_entry_views(handle, base_dn, scope, filter, attrs, COMPUTER_LIST_PAGE_SIZE, computer_from_entry,
+                              (entry_view_callback_fn)callback, user_data);
+}
+
+/**
+ * @brief ld_get_computer Reads single computer and passes it to the callback as a compact ld_computer_t.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] name       Name of the computer.
+ * @param[in] parent     Parent container of the computer. Can be NULL than default parent will be selected.
+ * @param[in] attributes Attributes to request from the server. Can be NULL than attributes needed to fill
+ *                       ld_computer_t will be requested.
+ * @param[in] callback   Callback to receive the computer.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_get_computer(LDHandle *handle,
+                                         const char *name,
+                                         const char *parent,
+                                         const char **attributes,
+                                         computer_list_callback_fn callback,
+                                         void *user_data)
+{
+    check_handle(handle, "ld_get_computer");
+
+    if (!name || !callback)
+    {
+        ld_error("ld_get_computer - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *dn = talloc_asprintf(talloc_ctx, "cn=%s,%s", name,
+                                     parent ? parent : create_computer_parent(talloc_ctx, handle));
+
+    int rc = computer_search(handle, dn, LDAP_SCOPE_BASE, attributes, callback, user_data);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
+
+/**
+ * @brief ld_list_computers Lists computers of the container using paged search and passes them to the callback
+ * as compact ld_computer_t.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] parent     Container to search computers in. Can be NULL than default parent will be selected.
+ * @param[in] attributes Attributes to request from the server. Can be NULL than attributes needed to fill
+ *                       ld_computer_t will be requested.
+ * @param[in] callback   Callback to receive the computers.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_list_computers(LDHandle *handle,
+                                           const char *parent,
+                                           const char **attributes,
+                                           computer_list_callback_fn callback,
+                                           void *user_data)
+{
+    check_handle(handle, "ld_list_computers");
+
+    if (!callback)
+    {
+        ld_error("ld_list_computers - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *base_dn = parent ? parent : create_computer_parent(talloc_ctx, handle);
+
+    int rc = computer_search(handle, base_dn, LDAP_SCOPE_SUBTREE, attributes, callback, user_data);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
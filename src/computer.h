@@ -24,9 +24,42 @@
 #include "common.h"
 #include "domain.h"
 
+/*!
+ * @brief ld_computer_t - Compact view of the computer entry.
+ */
+typedef struct ld_computer_s
+{
+    const char *dn;                  //!< Distinguished name of the computer.
+    const char *name;                //!< Common name of the computer.
+    const char *description;         //!< Description of the computer.
+    const char *dns_host_name;       //!< DNS name of the computer, Active Directory only.
+    LDAPAttribute_t **attributes;    //!< All attributes returned by the server, NULL terminated.
+} ld_computer_t;
+
+/*!
+ * @brief computer_list_callback_fn Callback which receives computers. Computers are released after callback
+ * returns, use talloc_steal to keep them. On failure result_code holds error returned by the server,
+ * LDAP_NO_SUCH_OBJECT if requested computer does not exist, and computers are NULL.
+ */
+typedef enum OperationReturnCode (*computer_list_callback_fn)(LDHandle *handle, int result_code,
+                                                              ld_computer_t **computers, void *user_data);
+
 enum OperationReturnCode ld_add_computer(LDHandle *handle, const char *name, LDAPAttribute_t **attrs, const char *parent);
 enum OperationReturnCode ld_del_computer(LDHandle *handle, const char *name, const char *parent);
 enum OperationReturnCode ld_mod_computer(LDHandle *handle, const char *name, const char *parent, LDAPAttribute_t **computer_attrs);
 enum OperationReturnCode ld_rename_computer(LDHandle *handle, const char *old_name, const char *new_name, const char *parent);
 
+
+enum OperationReturnCode ld_get_computer(LDHandle *handle,
+                                         const char *name,
+                                         const char *parent,
+                                         const char **attributes,
+                                         computer_list_callback_fn callback,
+                                         void *user_data);
+enum OperationReturnCode ld_list_computers(LDHandle *handle,
+                                           const char *parent,
+                                           const char **attributes,
+                                           computer_list_callback_fn callback,
+                                           void *user_data);
+
 #endif//LIB_DOMAIN_COMPUTER_H
@@ -21,12 +21,21 @@
 #include "connection.h"
 #include "connection_state_machine.h"
 #include "directory.h"
+#include "entry_p.h"
+#include "gss_cache.h"
 
 #include "schema.h"
 
 #include "request_queue.h"
+#include "root_dse.h"
+#include "tls_cache.h"
+#include "transport.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
 #include <sasl/sasl.h>
 
 #define container_of(ptr, type, member) ({ \
@@ -104,6 +113,7 @@ static void ldap_requests_init(struct ldap_request_t* requests, int size)
     for (int i = 0; i < size; ++i)
     {
         requests[i].msgid = -1;
+        requests[i].deadline = 0;
         requests[i].on_read_operation = NULL;
         requests[i].on_write_operation = NULL;
         memset(&requests[i].node, 0, sizeof(struct Queue_Node_s));
@@ -142,10 +152,31 @@ struct timeval* connection_microseconds_to_timeval(TALLOC_CTX *talloc_ctx, int m
     return time_interval;
 }
 
+static int connection_sasl_defaults_destructor(ldap_sasl_defaults_t *defaults)
+{
+    if (defaults->authcid)
+    {
+        ldap_memfree(defaults->authcid);
+    }
+
+    if (defaults->authzid)
+    {
+        ldap_memfree(defaults->authzid);
+    }
+
+    if (defaults->realm)
+    {
+        ldap_memfree(defaults->realm);
+    }
+
+    return 0;
+}
+
 /*!
  * \brief connection_configure Configures connection while performing following actions:
  *  1. Creates LDAP handle and sets protocol version, turns on async connection flag.
- *  2. Depending on usage of sasl configures sals flags for connection. Allocates structure to hold sasl parameters.
+ *  2. Depending on usage of sasl configures sals flags for connection. Allocates structure to hold sasl parameters
+ *     once, reconnects reuse it.
  *  3. Depending on usage of TLS configures TLS flags for connection.
  *  4. Creates event base for connection.
  * \param global_ctx [in] global context to use
@@ -188,10 +219,12 @@ enum OperationReturnCode connection_configure(struct ldap_global_context_t *glob
     {
         search_timeout = connection_microseconds_to_timeval(global_ctx->talloc_ctx, config->search_timelimit);
         set_ldap_option(connection->ldap, LDAP_OPT_TIMELIMIT, search_timeout);
+        talloc_free(search_timeout);
     }
 
     network_timeout = connection_microseconds_to_timeval(global_ctx->talloc_ctx, config->network_timeout);
     set_ldap_option(connection->ldap, LDAP_OPT_NETWORK_TIMEOUT, network_timeout);
+    talloc_free(network_timeout);
 
     set_ldap_option(connection->ldap, LDAP_OPT_PROTOCOL_VERSION, &config->protocol_verion);
 
@@ -199,20 +232,40 @@ enum OperationReturnCode connection_configure(struct ldap_global_context_t *glob
 
     set_ldap_option(connection->ldap, LDAP_OPT_CONNECT_ASYNC, LDAP_OPT_ON);
 
-    connection->ldap_defaults = talloc_zero(global_ctx->talloc_ctx, struct ldap_sasl_defaults_t);
-    connection->ldap_defaults->mechanism = LDAP_SASL_SIMPLE;
-
     if (config->use_sasl)
     {
         set_bool_option(connection->ldap, LDAP_OPT_X_SASL_NOCANON, config->sasl_options->sasl_nocanon);
         set_ldap_option(connection->ldap, LDAP_OPT_X_SASL_SECPROPS, config->sasl_options->sasl_secprops);
+    }
+
+    // SASL defaults come from configuration of libldap which does not change, so reconnects reuse them.
+    if (!connection->ldap_defaults)
+    {
+        connection->ldap_defaults = talloc_zero(global_ctx->talloc_ctx, struct ldap_sasl_defaults_t);
+        connection->ldap_defaults->mechanism = LDAP_SASL_SIMPLE;
+        talloc_set_destructor(connection->ldap_defaults, connection_sasl_defaults_destructor);
 
-        get_ldap_option(connection->ldap, LDAP_OPT_X_SASL_REALM, &connection->ldap_defaults->realm);
-        get_ldap_option(connection->ldap, LDAP_OPT_X_SASL_AUTHCID, &connection->ldap_defaults->authcid);
-        get_ldap_option(connection->ldap, LDAP_OPT_X_SASL_AUTHZID, &connection->ldap_defaults->authzid);
+        if (config->use_sasl)
+        {
+            get_ldap_option(connection->ldap, LDAP_OPT_X_SASL_REALM, &connection->ldap_defaults->realm);
+            get_ldap_option(connection->ldap, LDAP_OPT_X_SASL_AUTHCID, &connection->ldap_defaults->authcid);
+            get_ldap_option(connection->ldap, LDAP_OPT_X_SASL_AUTHZID, &connection->ldap_defaults->authzid);
+
+            connection->ldap_defaults->flags = config->sasl_options->sasl_flags;
+            connection->ldap_defaults->mechanism = talloc_strdup(global_ctx->talloc_ctx,
+                                                                 config->sasl_options->mechanism);
+        }
+
+        if (config->use_sasl && connection->ldap_defaults->mechanism
+            && strcasecmp(connection->ldap_defaults->mechanism, "GSSAPI") == 0)
+        {
+            if (!global_ctx->gss_cache)
+            {
+                global_ctx->gss_cache = gss_cache_new(global_ctx->talloc_ctx);
+            }
 
-        connection->ldap_defaults->flags = config->sasl_options->sasl_flags;
-        connection->ldap_defaults->mechanism = talloc_strdup(global_ctx->talloc_ctx, config->sasl_options->mechanism);
+            connection->ldap_defaults->gss_cache = global_ctx->gss_cache;
+        }
     }
 
     if (config->use_start_tls)
@@ -235,12 +288,30 @@ enum OperationReturnCode connection_configure(struct ldap_global_context_t *glob
             set_ldap_option(connection->ldap, LDAP_OPT_X_TLS_KEYFILE, config->tls_key_file);
         }
 
+        // Context built from other certificate files can't be reused, e.g. after configuration was reloaded.
+        if (global_ctx->tls_cache && !tls_cache_matches(global_ctx->tls_cache, connection->ldap))
+        {
+            talloc_free(global_ctx->tls_cache);
+            global_ctx->tls_cache = NULL;
+        }
+
+        if (!global_ctx->tls_cache)
+        {
+            global_ctx->tls_cache = tls_cache_new(global_ctx->talloc_ctx);
+        }
+
         /*
          * We need to initialize new tls context to prevent errors.
          * https://stackoverflow.com/questions/65422215/ldaps-openldap-bind-successful-even-after-deleting-ca-certificate-from-root-dir
+         * Context is created once per handle and shared by reconnects, so handshakes can resume cached session.
          */
-        const bool is_server = 0;
-        set_ldap_option(connection->ldap, LDAP_OPT_X_TLS_NEWCTX, &is_server);
+        connection->tls_cache = global_ctx->tls_cache;
+
+        if (tls_cache_apply(connection->tls_cache, connection->ldap) != RETURN_CODE_SUCCESS)
+        {
+            const bool is_server = 0;
+            set_ldap_option(connection->ldap, LDAP_OPT_X_TLS_NEWCTX, &is_server);
+        }
     }
 
     if (config->bind_type == BIND_TYPE_INTERACTIVE)
@@ -253,11 +324,44 @@ enum OperationReturnCode connection_configure(struct ldap_global_context_t *glob
     }
 
     connection->directory_type = LDAP_TYPE_UNINITIALIZED;
+    connection->directory_requested = false;
+    connection->cancel_supported = false;
 
+    // Reconnects configure connection again, objects of the previous connection are released first.
+    talloc_free(connection->schema);
     connection->schema = ldap_schema_new(global_ctx->talloc_ctx);
 
+    talloc_free(connection->callqueue);
     connection->callqueue = request_queue_new(global_ctx->talloc_ctx, MAX_REQUESTS);
 
+    talloc_free(connection->timers);
+    connection->timers = request_timer_new(global_ctx->talloc_ctx, MAX_REQUESTS);
+    connection->timer_event = NULL;
+    connection->timer_event_deadline = 0;
+    connection->last_msgid = -1;
+
+    connection->transport_event = NULL;
+    connection->buffered_transport = false;
+
+    if (!connection->scheduler)
+    {
+        connection->scheduler = request_scheduler_new(global_ctx->talloc_ctx);
+    }
+    else
+    {
+        // Deferred operations survive reconnect, outstanding ones were lost together with old connection.
+        request_scheduler_reset(connection->scheduler);
+    }
+    connection->dispatching_deferred = false;
+    connection->draining = false;
+
+    connection->request_window = config->request_window > 0 && config->request_window < MAX_REQUESTS
+            ? config->request_window
+            : MAX_REQUESTS;
+    connection->window_successes = 0;
+    connection->write_blocked = false;
+    connection->processing_results = false;
+
     connection->n_read_requests = 0;
     connection->n_write_requests = 0;
 
@@ -270,7 +374,8 @@ enum OperationReturnCode connection_configure(struct ldap_global_context_t *glob
 
     search_requests_init(connection->search_requests, MAX_REQUESTS);
 
-    connection->base = verto_default(NULL, VERTO_EV_TYPE_NONE);
+    connection->owns_base = config->event_base == NULL;
+    connection->base = config->event_base ? config->event_base : verto_default(NULL, VERTO_EV_TYPE_NONE);
     if (!connection->base)
     {
         ld_error("Unable to create event base!");
@@ -307,6 +412,30 @@ enum OperationReturnCode connection_install_handlers(struct ldap_connection_ctx_
             error_exit;
     }
 
+    if (connection->config->use_io_uring && !connection->buffered_transport)
+    {
+        if (transport_install_uring(connection, connection->ldap) == RETURN_CODE_SUCCESS)
+        {
+            connection->buffered_transport = true;
+        }
+        else
+        {
+            ld_warning("Unable to use io_uring transport, falling back to TCP transport.\n");
+        }
+    }
+
+    if (connection->config->coalesce_writes && !connection->buffered_transport)
+    {
+        if (transport_install_coalescing(connection, connection->ldap) == RETURN_CODE_SUCCESS)
+        {
+            connection->buffered_transport = true;
+        }
+        else
+        {
+            ld_warning("Unable to enable write coalescing, requests will be sent immediately.\n");
+        }
+    }
+
     connection->read_event = verto_add_io(connection->base, VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_READ, connection_on_read, fd);
     verto_set_private(connection->read_event, connection, NULL);
     connection->write_event = verto_add_io(connection->base, VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_WRITE, connection_on_write, fd);
@@ -348,11 +477,10 @@ enum OperationReturnCode connection_start_tls(struct ldap_connection_ctx_t *conn
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = connection_start_tls_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
+    if (connection_enqueue_request(connection, msgid, connection_start_tls_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
 
     return RETURN_CODE_SUCCESS;
 }
@@ -400,11 +528,10 @@ enum OperationReturnCode connection_sasl_bind(struct ldap_connection_ctx_t *conn
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = connection_bind_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
+    if (connection_enqueue_request(connection, msgid, connection_bind_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
 
     return RETURN_CODE_SUCCESS;
 }
@@ -431,6 +558,12 @@ int sasl_interact_gssapi(LDAP *ld, unsigned flags, void *indefaults, void *in)
         return LDAP_PARAM_ERROR;
     }
 
+    // GSSAPI mechanism asks for user before it initiates security context, so shared credential is in time.
+    if (defaults && defaults->gss_cache)
+    {
+        gss_cache_apply(defaults->gss_cache, ld);
+    }
+
     while (interact->id != SASL_CB_LIST_END)
     {
         const char *dflt = interact->defresult;
@@ -531,11 +664,10 @@ enum OperationReturnCode connection_ldap_bind(struct ldap_connection_ctx_t *conn
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = connection_bind_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
+    if (connection_enqueue_request(connection, msgid, connection_bind_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
 
     return rc == LDAP_SASL_BIND_IN_PROGRESS ? RETURN_CODE_OPERATION_IN_PROGRESS : RETURN_CODE_SUCCESS;
 }
@@ -549,6 +681,159 @@ void connection_optional_transition_on_error(struct ldap_connection_ctx_t* conne
     }
 }
 
+/**
+ * @brief connection_requests_outstanding Returns number of operations sent to the server and awaiting result.
+ * @param connection [in] connection to use
+ * @return number of operations.
+ */
+static int connection_requests_outstanding(struct ldap_connection_ctx_t *connection)
+{
+    int result = 0;
+
+    for (int priority = 0; priority < REQUEST_PRIORITY_COUNT; ++priority)
+    {
+        result += request_scheduler_outstanding(connection->scheduler, priority);
+    }
+
+    return result;
+}
+
+/**
+ * @brief connection_requests_in_flight Returns number of operations which are either outstanding or deferred.
+ * @param connection [in] connection to use
+ * @return number of operations.
+ */
+int connection_requests_in_flight(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    int result = connection_requests_outstanding(connection);
+
+    for (int priority = 0; priority < REQUEST_PRIORITY_COUNT; ++priority)
+    {
+        result += request_scheduler_pending(connection->scheduler, priority);
+    }
+
+    return result;
+}
+
+/**
+ * @brief connection_adapt_window Adjusts window of operations in flight using result of operation.
+ * Window is halved when server reports that it is busy and grows by one after a window worth of
+ * successful results.
+ * @param connection [in] connection to use
+ * @param message    [in] result of operation
+ */
+static void connection_adapt_window(struct ldap_connection_ctx_t *connection, LDAPMessage *message)
+{
+    int error_code = LDAP_SUCCESS;
+
+    if (!csm_is_in_state(connection->state_machine, LDAP_CONNECTION_STATE_RUN)
+        || ldap_parse_result(connection->ldap, message, &error_code, NULL, NULL, NULL, NULL, false) != LDAP_SUCCESS)
+    {
+        return;
+    }
+
+    int limit = connection->config->request_window > 0 && connection->config->request_window < MAX_REQUESTS
+            ? connection->config->request_window
+            : MAX_REQUESTS;
+
+    if (error_code == LDAP_BUSY || error_code == LDAP_UNWILLING_TO_PERFORM)
+    {
+        connection->request_window = connection->request_window > 1 ? connection->request_window / 2 : 1;
+        connection->window_successes = 0;
+
+        ld_warning("Server is busy, request window reduced to %d\n", connection->request_window);
+    }
+    else if (connection->request_window < limit
+             && ++connection->window_successes >= connection->request_window)
+    {
+        ++connection->request_window;
+        connection->window_successes = 0;
+    }
+}
+
+/**
+ * @brief connection_notify_writable Calls writable callbacks if operation was rejected and window is open again.
+ * Waiting internal operations are notified in turn until one of them fills the window again, writable callback
+ * installed by user is called afterwards in any case.
+ * @param connection [in] connection to use
+ */
+static void connection_notify_writable(struct ldap_connection_ctx_t *connection)
+{
+    if (!connection->write_blocked || connection_requests_in_flight(connection) >= connection->request_window)
+    {
+        return;
+    }
+
+    connection->write_blocked = false;
+
+    // Waiter which blocks again is queued behind the others, so it can't starve them.
+    connection_writable_waiter_t *last = connection->writable_waiters_tail;
+
+    while (connection->writable_waiters && !connection->write_blocked)
+    {
+        connection_writable_waiter_t *waiter = connection->writable_waiters;
+        connection_cancel_wait_writable(connection, waiter);
+
+        waiter->callback(connection, waiter->user_data);
+
+        if (waiter == last)
+        {
+            break;
+        }
+    }
+
+    if (connection->on_writable)
+    {
+        connection->on_writable(connection, connection->on_writable_data);
+    }
+}
+
+/**
+ * @brief connection_on_transport This callback is performed when transport holds unprocessed input.
+ * @param ctx [in] event context
+ * @param ev  [in] event
+ */
+static void connection_on_transport(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    // One-shot event is released by verto after this callback returns.
+    connection->transport_event = NULL;
+
+    connection_process_write(connection);
+
+    if (transport_has_input(connection->ldap))
+    {
+        connection_process_read(connection);
+    }
+}
+
+/**
+ * @brief connection_schedule_transport Arms event for input buffered by transport.
+ * Descriptor does not become readable for data transport has already read from socket, so results
+ * which did not fit into previous read pass are processed on next loop iteration.
+ * @param connection [in] connection to use
+ */
+static void connection_schedule_transport(struct ldap_connection_ctx_t *connection)
+{
+    if (!connection->buffered_transport || connection->transport_event || !transport_has_input(connection->ldap))
+    {
+        return;
+    }
+
+    connection->transport_event = verto_add_timeout(connection->base, VERTO_EV_FLAG_NONE, connection_on_transport, 0);
+    if (!connection->transport_event)
+    {
+        ld_error("Unable to schedule processing of buffered input!\n");
+        return;
+    }
+
+    verto_set_private(connection->transport_event, connection, NULL);
+}
+
 /**
  * @brief connection_on_read This callback is performed on read operation.
  * @param ctx [in] event context
@@ -557,7 +842,17 @@ void connection_optional_transition_on_error(struct ldap_connection_ctx_t* conne
 void connection_on_read(verto_ctx *ctx, verto_ev *ev)
 {
     (void)(ctx);
-    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    connection_process_read(verto_get_private(ev));
+}
+
+/**
+ * @brief connection_process_read Collects results of outstanding requests and calls their callbacks.
+ * @param connection [in] connection to use
+ */
+void connection_process_read(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
 
     int rc = 0;
     LDAPMessage* result_message = NULL;
@@ -567,13 +862,21 @@ void connection_on_read(verto_ctx *ctx, verto_ev *ev)
     char *diagnostic_message = NULL;
     struct Queue_Node_s* top = NULL;
 
-    struct ldap_request_t pending_requests[MAX_REQUESTS];
+    struct ldap_request_t* pending_requests[MAX_REQUESTS];
     int n_pending_requests = 0;
 
+    connection->processing_results = true;
+
     while (!request_queue_empty(connection->callqueue) && (top = request_queue_pop(connection->callqueue)) != NULL)
     {
         struct ldap_request_t* request = container_of(top, struct ldap_request_t, node);
 
+        if (request->msgid < 0)
+        {
+            // Request was abandoned, dropping it here releases its slot.
+            continue;
+        }
+
         ld_info("Processing message #%d\n", request->msgid);
 
         rc = ldap_result(connection->ldap, request->msgid, LDAP_MSG_ALL, &timeout, &result_message);
@@ -591,31 +894,58 @@ void connection_on_read(verto_ctx *ctx, verto_ev *ev)
             ld_warning("Warning - Pending message with id %d!\n", request->msgid);
             ldap_msgfree(result_message);
 
-            pending_requests[n_pending_requests] = *request;
+            pending_requests[n_pending_requests] = request;
             ++n_pending_requests;
 
             break;
         default:
+        {
+            int priority = request->priority;
+
+            if (connection->config->adaptive_window)
+            {
+                connection_adapt_window(connection, result_message);
+            }
+
             connection->msgid = request->msgid;
             error_code = request->on_read_operation ? request->on_read_operation(rc, result_message, connection)
                                                     : RETURN_CODE_FAILURE;
             ldap_msgfree(result_message);
+
+            request_scheduler_on_complete(connection->scheduler, priority);
+        }
             break;
         };
     }
 
+    connection->processing_results = false;
+
     connection->n_read_requests = 0;
 
-    if (n_pending_requests > 0)
+    // Pending requests are stored in ascending slot order, so moving them down never overwrites
+    // a request that is still to be moved. Requests abandoned from a callback are dropped here.
+    for (int i = 0; i < n_pending_requests; ++i)
     {
-        for (int i = 0; i < n_pending_requests; ++i)
+        if (pending_requests[i]->msgid < 0)
+        {
+            continue;
+        }
+
+        struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
+        if (request != pending_requests[i])
         {
-            connection->read_requests[i] = pending_requests[i];
-            request_queue_push(connection->callqueue, &connection->read_requests[i].node);
+            *request = *pending_requests[i];
         }
-        connection->n_read_requests = n_pending_requests;
+        request_queue_push(connection->callqueue, &request->node);
+        ++connection->n_read_requests;
     }
 
+    connection_dispatch_deferred(connection);
+
+    connection_notify_writable(connection);
+
+    connection_schedule_transport(connection);
+
     error_exit:
         return;
 }
@@ -628,65 +958,1018 @@ void connection_on_read(verto_ctx *ctx, verto_ev *ev)
 void connection_on_write(verto_ctx *ctx, verto_ev *ev)
 {
     (void)(ctx);
-    (void)(ev);
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    // Requests submitted during this loop iteration leave in one write.
+    connection_process_write(connection);
 }
 
 /**
- * @brief connection_close Closes connection and frees resources associated with said connection.
+ * @brief connection_process_write Sends requests held by buffered transport.
  * @param connection [in] connection to use
- * @return RETURN_CODE_SUCCESS.
  */
-enum OperationReturnCode connection_close(struct ldap_connection_ctx_t *connection)
+void connection_process_write(struct ldap_connection_ctx_t *connection)
 {
     assert(connection);
 
-    if (connection->ldap_defaults)
+    if (!connection->buffered_transport)
     {
-        if (connection->ldap_defaults->authcid)
-        {
-            ldap_memfree(connection->ldap_defaults->authcid);
-        }
+        return;
+    }
 
-        if (connection->ldap_defaults->authzid)
-        {
-            ldap_memfree(connection->ldap_defaults->authzid);
-        }
+    if (transport_flush(connection->ldap) != RETURN_CODE_SUCCESS)
+    {
+        ld_error("Unable to send requests: %s\n", strerror(errno));
+        connection_optional_transition_on_error(connection);
+    }
+}
+
+/**
+ * @brief connection_find_request Looks up outstanding request by message id.
+ * @param connection [in] connection to use
+ * @param msgid      [in] message id of the request
+ * @return
+ *        - pointer to request on success.
+ *        - NULL if there is no outstanding request with such id.
+ */
+static struct ldap_request_t* connection_find_request(struct ldap_connection_ctx_t *connection, int msgid)
+{
+    if (msgid < 0)
+    {
+        return NULL;
+    }
 
-        if (connection->ldap_defaults->realm)
+    for (int i = connection->n_read_requests - 1; i >= 0; --i)
+    {
+        if (connection->read_requests[i].msgid == msgid)
         {
-            ldap_memfree(connection->ldap_defaults->realm);
+            return &connection->read_requests[i];
         }
     }
 
-    talloc_free(connection->ldap_defaults);
+    return NULL;
+}
 
-    if (connection->read_event)
+/**
+ * @brief connection_request_alive Checks if timer entry still refers to outstanding request.
+ * @param msgid     [in] message id of the timer entry
+ * @param deadline  [in] deadline of the timer entry
+ * @param user_data [in] connection to use
+ * @return true if request is outstanding and its deadline was not changed.
+ */
+static bool connection_request_alive(int msgid, int64_t deadline, void *user_data)
+{
+    struct ldap_request_t* request = connection_find_request(user_data, msgid);
+
+    return request && request->deadline == deadline;
+}
+
+/**
+ * @brief connection_arm_timer Schedules timer event for the earliest request deadline.
+ * @param connection [in] connection to use
+ */
+static void connection_arm_timer(struct ldap_connection_ctx_t *connection)
+{
+    struct Timer_Entry_s next = { 0, -1 };
+
+    if (!connection->base || request_timer_peek(connection->timers, &next) != OPERATION_SUCCESS)
     {
-        verto_del(connection->read_event);
+        return;
     }
 
-    if(connection->write_event) {
-        verto_del(connection->write_event);
+    if (connection->timer_event && connection->timer_event_deadline <= next.deadline)
+    {
+        return;
     }
 
-    if (connection->state_machine->state != LDAP_CONNECTION_STATE_ERROR)
+    if (connection->timer_event)
     {
-        // TODO: Check if there is better way to clean verto context on error.
-        verto_free(connection->base);
+        verto_del(connection->timer_event);
+        connection->timer_event = NULL;
+    }
 
-        ldap_unbind_ext(connection->ldap, NULL, NULL);
+    int64_t interval = next.deadline - request_timer_now();
+
+    connection->timer_event = verto_add_timeout(connection->base, VERTO_EV_FLAG_NONE, connection_on_timer,
+                                                interval > 0 ? interval : 0);
+    if (!connection->timer_event)
+    {
+        ld_error("Unable to create timer event for request deadlines!\n");
+        return;
     }
-    return RETURN_CODE_SUCCESS;
+
+    verto_set_private(connection->timer_event, connection, NULL);
+    connection->timer_event_deadline = next.deadline;
 }
 
 /**
- * @brief connection_bind_on_read This callback is performed during bind operation.
- * @param rc [in] result code of bind operation.
- * @param message [in] message received during operation.
- * @param connection [in] connection used during bind operation.
- * @return
- *        - RETURN_CODE_SUCCESS on success.
- *        - RETURN_CODE_FAILURE on failure.
+ * @brief connection_compact_requests Removes abandoned requests from request table and call queue.
+ * @param connection [in] connection to use
+ */
+static void connection_compact_requests(struct ldap_connection_ctx_t *connection)
+{
+    int n_requests = 0;
+
+    while (!request_queue_empty(connection->callqueue))
+    {
+        request_queue_pop(connection->callqueue);
+    }
+
+    for (int i = 0; i < connection->n_read_requests; ++i)
+    {
+        if (connection->read_requests[i].msgid < 0)
+        {
+            continue;
+        }
+
+        if (n_requests != i)
+        {
+            connection->read_requests[n_requests] = connection->read_requests[i];
+        }
+
+        request_queue_push(connection->callqueue, &connection->read_requests[n_requests].node);
+        ++n_requests;
+    }
+
+    connection->n_read_requests = n_requests;
+}
+
+/**
+ * @brief connection_enqueue_request Registers request which result will be processed in connection_on_read.
+ * If operation timeout is configured request also receives a deadline.
+ * @param connection        [in] connection to use
+ * @param msgid             [in] message id of the request
+ * @param on_read_operation [in] callback to call when result is received
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if request table is full.
+ */
+enum OperationReturnCode connection_enqueue_request(struct ldap_connection_ctx_t *connection,
+                                                    int msgid,
+                                                    operation_callback_fn on_read_operation)
+{
+    assert(connection);
+
+    if (connection->n_read_requests >= MAX_REQUESTS && !connection->processing_results)
+    {
+        // Slots of abandoned requests are reclaimed lazily, try to reclaim them now.
+        connection_compact_requests(connection);
+    }
+
+    if (connection->n_read_requests >= MAX_REQUESTS)
+    {
+        ld_error("Unable to register request #%d - too many outstanding requests!\n", msgid);
+        ldap_abandon_ext(connection->ldap, msgid, NULL, NULL);
+        return RETURN_CODE_FAILURE;
+    }
+
+    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
+    request->msgid = msgid;
+    request->handle = connection->dispatching_deferred ? connection->dispatching_handle : -1;
+    request->deadline = 0;
+    request->priority = connection->priority;
+    request->on_read_operation = on_read_operation;
+    ++connection->n_read_requests;
+    request_queue_push(connection->callqueue, &request->node);
+
+    request_scheduler_on_submit(connection->scheduler, request->priority);
+
+    connection->last_msgid = msgid;
+
+    if (connection->config && connection->config->operation_timeout > 0)
+    {
+        connection_set_request_timeout(connection, msgid, connection->config->operation_timeout);
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief connection_set_request_timeout Sets or replaces deadline of outstanding request.
+ * @param connection [in] connection to use
+ * @param msgid      [in] message id of the request
+ * @param timeout    [in] timeout in milliseconds starting from now, 0 removes deadline
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if there is no such request.
+ */
+enum OperationReturnCode connection_set_request_timeout(struct ldap_connection_ctx_t *connection,
+                                                        int msgid,
+                                                        int timeout)
+{
+    assert(connection);
+
+    struct ldap_request_t* request = connection_find_request(connection, msgid);
+    if (!request)
+    {
+        ld_warning("Unable to set timeout - request #%d is not outstanding!\n", msgid);
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (timeout <= 0)
+    {
+        // Existing timer entry becomes stale and will be skipped.
+        request->deadline = 0;
+        return RETURN_CODE_SUCCESS;
+    }
+
+    if (!connection->timers)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (request_timer_size(connection->timers) > 2 * MAX_REQUESTS)
+    {
+        request_timer_purge(connection->timers, connection_request_alive, connection);
+    }
+
+    request->deadline = request_timer_now() + timeout;
+
+    if (request_timer_push(connection->timers, msgid, request->deadline) != OPERATION_SUCCESS)
+    {
+        request->deadline = 0;
+        return RETURN_CODE_FAILURE;
+    }
+
+    connection_arm_timer(connection);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief connection_forget_search_request Removes search callback registered for the request.
+ * @param connection [in] connection to use
+ * @param msgid      [in] message id of the request
+ * @return copy of removed registration, zeroed if request had none
+ */
+static struct ldap_search_request_t connection_forget_search_request(struct ldap_connection_ctx_t *connection,
+                                                                     int msgid)
+{
+    struct ldap_search_request_t search_request = { 0 };
+
+    for (int i = 0; i < connection->n_search_requests; ++i)
+    {
+        if (connection->search_requests[i].msgid == msgid)
+        {
+            search_request = connection->search_requests[i];
+            connection_remove_search_request(connection, i);
+            break;
+        }
+    }
+
+    return search_request;
+}
+
+/**
+ * @brief connection_discard_on_read This callback drops result of cancelled request.
+ * @param[in] rc         result code of operation.
+ * @param[in] message    message received during operation.
+ * @param[in] connection connection used during operation.
+ * @return RETURN_CODE_SUCCESS.
+ */
+static enum OperationReturnCode connection_discard_on_read(int rc, LDAPMessage *message,
+                                                           struct ldap_connection_ctx_t *connection)
+{
+    (void)(message);
+
+    ld_info("Discarding result of cancelled request #%d - op code: %d\n", connection->msgid, rc);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief connection_cancel_on_read This callback is performed when Cancel extended operation completes.
+ * @param[in] rc         result code of operation.
+ * @param[in] message    message received during operation.
+ * @param[in] connection connection used during operation.
+ * @return
+ *        - RETURN_CODE_SUCCESS if request was cancelled.
+ *        - RETURN_CODE_FAILURE otherwise.
+ */
+static enum OperationReturnCode connection_cancel_on_read(int rc, LDAPMessage *message,
+                                                          struct ldap_connection_ctx_t *connection)
+{
+    int error_code = LDAP_OTHER;
+    char *diagnostic_message = NULL;
+
+    if (rc != LDAP_RES_EXTENDED)
+    {
+        ld_warning("Cancel request #%d failed - op code: %d\n", connection->msgid, rc);
+        return RETURN_CODE_FAILURE;
+    }
+
+    ldap_parse_result(connection->ldap, message, &error_code, NULL, &diagnostic_message, NULL, NULL, false);
+    if (error_code != LDAP_SUCCESS)
+    {
+        // Cancelled request still completes and its result is discarded.
+        ld_info("Cancel request #%d was rejected - code: %d %s %s\n", connection->msgid, error_code,
+                ldap_err2string(error_code), diagnostic_message);
+    }
+    ldap_memfree(diagnostic_message);
+
+    return error_code == LDAP_SUCCESS ? RETURN_CODE_SUCCESS : RETURN_CODE_FAILURE;
+}
+
+/**
+ * @brief connection_resolve_request Finds message id of the request by handle returned to the caller.
+ * @param connection [in] connection to use
+ * @param request    [in] message id or handle of deferred request
+ * @return
+ *        - message id of the request.
+ *        - -1 if deferred request was not sent or is not outstanding anymore.
+ */
+static int connection_resolve_request(struct ldap_connection_ctx_t *connection, int request)
+{
+    if (request >= -1)
+    {
+        return request;
+    }
+
+    for (int i = connection->n_read_requests - 1; i >= 0; --i)
+    {
+        if (connection->read_requests[i].handle == request && connection->read_requests[i].msgid >= 0)
+        {
+            return connection->read_requests[i].msgid;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief connection_abandon_request Abandons outstanding request and releases its slot. Deferred request which
+ * was not sent yet is dropped, its callback is never called.
+ * @param connection  [in] connection to use
+ * @param msgid       [in] message id of the request or handle of deferred request
+ * @param result_code [in] result code to pass to request callback
+ * @param notify      [in] if true request callback is called with result_code and no message
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if there is no such request.
+ */
+enum OperationReturnCode connection_abandon_request(struct ldap_connection_ctx_t *connection,
+                                                    int msgid,
+                                                    int result_code,
+                                                    bool notify)
+{
+    assert(connection);
+
+    if (msgid < -1 && request_scheduler_cancel(connection->scheduler, msgid))
+    {
+        return RETURN_CODE_SUCCESS;
+    }
+
+    msgid = connection_resolve_request(connection, msgid);
+
+    struct ldap_request_t* request = connection_find_request(connection, msgid);
+    if (!request)
+    {
+        ld_warning("Unable to abandon request #%d - request is not outstanding!\n", msgid);
+        return RETURN_CODE_FAILURE;
+    }
+
+    operation_callback_fn on_read_operation = request->on_read_operation;
+
+    request_scheduler_on_complete(connection->scheduler, request->priority);
+
+    request->msgid = -1;
+    request->deadline = 0;
+    request->on_read_operation = NULL;
+
+    int rc = ldap_abandon_ext(connection->ldap, msgid, NULL, NULL);
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_warning("Warning - ldap_abandon_ext failed for request #%d - code: %d %s\n", msgid, rc, ldap_err2string(rc));
+    }
+
+    struct ldap_search_request_t search_request = connection_forget_search_request(connection, msgid);
+
+    if (notify && on_read_operation)
+    {
+        connection->msgid = msgid;
+        on_read_operation(result_code, NULL, connection);
+    }
+
+    if (notify && search_request.on_result_operation)
+    {
+        search_request.on_result_operation(connection, result_code, search_request.user_data);
+    }
+
+    if (notify && search_request.on_extended_operation)
+    {
+        search_request.on_extended_operation(connection, result_code, NULL, search_request.user_data);
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief connection_cancel_request Cancels outstanding request. Callback of the request is never called afterwards.
+ * If server supports Cancel extended operation it is used, otherwise request is abandoned. Deferred request which
+ * was not sent yet is dropped from the queue of its priority class.
+ * @param connection [in] connection to use
+ * @param msgid      [in] message id of the request or handle of deferred request
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if there is no such request.
+ */
+enum OperationReturnCode connection_cancel_request(struct ldap_connection_ctx_t *connection, int msgid)
+{
+    assert(connection);
+
+    if (msgid < -1 && request_scheduler_cancel(connection->scheduler, msgid))
+    {
+        return RETURN_CODE_SUCCESS;
+    }
+
+    msgid = connection_resolve_request(connection, msgid);
+
+    struct ldap_request_t* request = connection_find_request(connection, msgid);
+    if (!request || request->on_read_operation == connection_discard_on_read)
+    {
+        ld_warning("Unable to cancel request #%d - request is not outstanding!\n", msgid);
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (!connection->cancel_supported)
+    {
+        return connection_abandon_request(connection, msgid, LDAP_CANCELLED, false);
+    }
+
+    int cancel_msgid = 0;
+    int rc = ldap_cancel(connection->ldap, msgid, NULL, NULL, &cancel_msgid);
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_warning("Warning - ldap_cancel failed for request #%d - code: %d %s\n", msgid, rc, ldap_err2string(rc));
+        return connection_abandon_request(connection, msgid, LDAP_CANCELLED, false);
+    }
+
+    // Server still replies to cancelled request, so we keep it in flight until reply arrives.
+    request->on_read_operation = connection_discard_on_read;
+    connection_forget_search_request(connection, msgid);
+
+    int last_msgid = connection->last_msgid;
+    enum OperationReturnCode result = connection_enqueue_request(connection, cancel_msgid, connection_cancel_on_read);
+    connection->last_msgid = last_msgid;
+
+    return result;
+}
+
+/**
+ * @brief connection_last_request Returns message id of the most recently registered request. Deferred request
+ * gets handle below -1 instead, which stays valid after request is sent.
+ * @param connection [in] connection to use
+ * @return message id, handle of deferred request or -1 if no request was registered.
+ */
+int connection_last_request(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    return connection->last_msgid;
+}
+
+/**
+ * @brief connection_on_timer This callback is performed when earliest request deadline expires.
+ * @param ctx [in] event context
+ * @param ev  [in] event
+ */
+void connection_on_timer(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ctx);
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    // One-shot event is released by verto after this callback returns.
+    connection->timer_event = NULL;
+
+    connection_process_timers(connection, request_timer_now());
+}
+
+/**
+ * @brief connection_process_timers Abandons requests which deadlines expired.
+ * @param connection [in] connection to use
+ * @param now        [in] current monotonic time in milliseconds, see request_timer_now
+ */
+void connection_process_timers(struct ldap_connection_ctx_t *connection, int64_t now)
+{
+    assert(connection);
+
+    struct Timer_Entry_s entry = { 0, -1 };
+    int n_expired = 0;
+
+    if (connection->buffered_transport && transport_has_input(connection->ldap))
+    {
+        connection_process_read(connection);
+    }
+
+    while (request_timer_peek(connection->timers, &entry) == OPERATION_SUCCESS && entry.deadline <= now)
+    {
+        request_timer_pop(connection->timers, &entry);
+
+        if (!connection_request_alive(entry.msgid, entry.deadline, connection))
+        {
+            continue;
+        }
+
+        ld_warning("Request #%d timed out, abandoning.\n", entry.msgid);
+        connection_abandon_request(connection, entry.msgid, LDAP_TIMEOUT, true);
+        ++n_expired;
+    }
+
+    if (n_expired > 0)
+    {
+        connection_compact_requests(connection);
+        connection_optional_transition_on_error(connection);
+    }
+
+    connection_arm_timer(connection);
+
+    connection_dispatch_deferred(connection);
+
+    connection_notify_writable(connection);
+}
+
+/**
+ * @brief connection_set_priority Sets priority class of subsequent operations.
+ * @param connection [in] connection to use
+ * @param priority   [in] one of RequestPriority values
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if priority is invalid.
+ */
+enum OperationReturnCode connection_set_priority(struct ldap_connection_ctx_t *connection, int priority)
+{
+    assert(connection);
+
+    if (priority < 0 || priority >= REQUEST_PRIORITY_COUNT)
+    {
+        ld_error("Invalid request priority %d!\n", priority);
+        return RETURN_CODE_FAILURE;
+    }
+
+    connection->priority = priority;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/*!
+ * @brief connection_authorized_request_t - Deferred operation with identity it was submitted on behalf of.
+ */
+typedef struct connection_authorized_request_s
+{
+    request_scheduler_dispatch_fn dispatch;  //!< Function to submit operation with.
+    void *operation;                         //!< Arguments of operation.
+    LDAPControl *proxy_authorization;        //!< Proxied Authorization control operation is submitted with.
+} connection_authorized_request_t;
+
+static LDAPControl *connection_proxy_authorization_new(TALLOC_CTX *ctx, const char *authzid)
+{
+    LDAPControl *control = talloc_zero(ctx, LDAPControl);
+    char *value = control ? talloc_strdup(control, authzid) : NULL;
+
+    if (!value)
+    {
+        talloc_free(control);
+        return NULL;
+    }
+
+    // Server must not perform operation as identity of the connection when it does not support the control.
+    control->ldctl_oid = (char*)LDAP_CONTROL_PROXY_AUTHZ;
+    control->ldctl_value.bv_val = value;
+    control->ldctl_value.bv_len = strlen(value);
+    control->ldctl_iscritical = 1;
+
+    return control;
+}
+
+/**
+ * @brief connection_set_proxy_authorization Sets identity subsequent operations are performed on behalf of
+ * using Proxied Authorization control (RFC 4370).
+ * @param connection [in] connection to use
+ * @param authzid    [in] authorization identity in "dn:<dn>" or "u:<user>" form, empty string for anonymous,
+ *                        NULL performs operations as identity connection is bound with
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if identity is invalid or out of memory.
+ */
+enum OperationReturnCode connection_set_proxy_authorization(struct ldap_connection_ctx_t *connection,
+                                                            const char *authzid)
+{
+    assert(connection);
+
+    LDAPControl *control = NULL;
+
+    if (authzid)
+    {
+        if (*authzid && strncmp(authzid, "dn:", 3) != 0 && strncmp(authzid, "u:", 2) != 0)
+        {
+            ld_error("Invalid authorization identity %s!\n", authzid);
+            return RETURN_CODE_FAILURE;
+        }
+
+        if (!(control = connection_proxy_authorization_new(connection, authzid)))
+        {
+            ld_error("Unable to allocate proxied authorization control!\n");
+            return RETURN_CODE_FAILURE;
+        }
+
+        if (connection->root_dse && !root_dse_supports_control(connection->root_dse, LDAP_CONTROL_PROXY_AUTHZ))
+        {
+            ld_warning("Server does not advertise proxied authorization control, operations will be rejected!\n");
+        }
+    }
+
+    talloc_free(connection->proxy_authorization);
+    connection->proxy_authorization = control;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief connection_save_identity Records identity and priority class of subsequent operations.
+ * @param ctx        [in]  memory context to allocate copy of Proxied Authorization control on
+ * @param connection [in]  connection to use
+ * @param identity   [out] recorded identity
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if out of memory.
+ */
+enum OperationReturnCode connection_save_identity(TALLOC_CTX *ctx,
+                                                  struct ldap_connection_ctx_t *connection,
+                                                  connection_identity_t *identity)
+{
+    assert(connection);
+    assert(identity);
+
+    identity->priority = connection->priority;
+    identity->proxy_authorization = NULL;
+
+    if (connection->proxy_authorization
+        && !(identity->proxy_authorization = connection_proxy_authorization_new(ctx,
+                                                 connection->proxy_authorization->ldctl_value.bv_val)))
+    {
+        ld_error("Unable to allocate proxied authorization control!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief connection_apply_identity Makes recorded identity and priority class current until they are applied
+ * again with previous values. Identity must stay valid while it is applied.
+ * @param connection [in]  connection to use
+ * @param identity   [in]  identity to apply
+ * @param previous   [out] identity which was current, can be NULL
+ */
+void connection_apply_identity(struct ldap_connection_ctx_t *connection,
+                               const connection_identity_t *identity,
+                               connection_identity_t *previous)
+{
+    assert(connection);
+    assert(identity);
+
+    if (previous)
+    {
+        previous->proxy_authorization = connection->proxy_authorization;
+        previous->priority = connection->priority;
+    }
+
+    connection->proxy_authorization = identity->proxy_authorization;
+    connection->priority = identity->priority;
+}
+
+/**
+ * @brief connection_request_controls Builds server controls of operation, adding Proxied Authorization control
+ * when subsequent operations are performed on behalf of other identity. Requests of connection setup never
+ * get the control.
+ * @param connection [in]  connection to use
+ * @param controls   [in]  server controls of operation, can be NULL
+ * @param result     [out] array of CONNECTION_MAX_CONTROLS elements, filled with NULL terminated controls
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if operation has too many controls.
+ */
+enum OperationReturnCode connection_request_controls(struct ldap_connection_ctx_t *connection,
+                                                     LDAPControl **controls,
+                                                     LDAPControl **result)
+{
+    assert(connection);
+
+    int count = 0;
+
+    for (; controls && controls[count]; ++count)
+    {
+        if (count >= CONNECTION_MAX_CONTROLS - 2)
+        {
+            ld_error("Too many server controls in request!\n");
+            return RETURN_CODE_FAILURE;
+        }
+
+        result[count] = controls[count];
+    }
+
+    if (connection->proxy_authorization
+        && csm_is_in_state(connection->state_machine, LDAP_CONNECTION_STATE_RUN)
+        && !ldap_control_find(LDAP_CONTROL_PROXY_AUTHZ, controls, NULL))
+    {
+        result[count++] = connection->proxy_authorization;
+    }
+
+    result[count] = NULL;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static enum OperationReturnCode connection_authorized_dispatch(void *connection, void *data)
+{
+    struct ldap_connection_ctx_t *ctx = connection;
+    connection_authorized_request_t *request = data;
+
+    LDAPControl *proxy_authorization = ctx->proxy_authorization;
+    ctx->proxy_authorization = request->proxy_authorization;
+
+    enum OperationReturnCode rc = request->dispatch(connection, request->operation);
+
+    ctx->proxy_authorization = proxy_authorization;
+
+    return rc;
+}
+
+/**
+ * @brief connection_should_defer Checks if operation must wait for its priority class to get a free slot.
+ * @param connection [in] connection to use
+ * @return true if operation must be passed to connection_defer_request instead of being sent.
+ */
+bool connection_should_defer(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    // Requests of connection setup (bind, directory detection, schema) are never deferred.
+    return !connection->dispatching_deferred
+        && csm_is_in_state(connection->state_machine, LDAP_CONNECTION_STATE_RUN)
+        && (connection->draining || !request_scheduler_can_submit(connection->scheduler, connection->priority));
+}
+
+/**
+ * @brief connection_defer_request Stores operation until scheduler allows to submit it. Handle operation may be
+ * cancelled with is returned by connection_last_request.
+ * @param connection [in] connection to use
+ * @param dispatch   [in] function to submit operation with
+ * @param operation  [in] talloc allocated arguments of operation, ownership is transferred to scheduler
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode connection_defer_request(struct ldap_connection_ctx_t *connection,
+                                                  request_scheduler_dispatch_fn dispatch,
+                                                  void *operation)
+{
+    assert(connection);
+
+    // Operation keeps identity it was submitted on behalf of until it is dispatched.
+    if (connection->proxy_authorization)
+    {
+        connection_authorized_request_t *request = talloc_zero(NULL, connection_authorized_request_t);
+        if (!request || !(request->proxy_authorization = connection_proxy_authorization_new(request,
+                                                            connection->proxy_authorization->ldctl_value.bv_val)))
+        {
+            ld_error("Unable to allocate deferred request!\n");
+            talloc_free(request);
+            talloc_free(operation);
+            return RETURN_CODE_FAILURE;
+        }
+
+        request->dispatch = dispatch;
+        request->operation = talloc_steal(request, operation);
+
+        dispatch = connection_authorized_dispatch;
+        operation = request;
+    }
+
+    // Message ids are positive, so handles below -1 never collide with them.
+    if (connection->last_deferred_handle >= -1 || connection->last_deferred_handle == INT_MIN)
+    {
+        connection->last_deferred_handle = -1;
+    }
+    int handle = --connection->last_deferred_handle;
+
+    if (request_scheduler_defer(connection->scheduler, connection->priority, dispatch, operation, handle)
+        != OPERATION_SUCCESS)
+    {
+        ld_error("Unable to defer request of priority class %d!\n", connection->priority);
+        talloc_free(operation);
+        return RETURN_CODE_FAILURE;
+    }
+
+    connection->last_msgid = handle;
+
+    connection_dispatch_deferred(connection);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief connection_dispatch_deferred Submits deferred operations which priority classes have free slots.
+ * @param connection [in] connection to use
+ */
+void connection_dispatch_deferred(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    if (connection->dispatching_deferred
+        || connection->draining
+        || !csm_is_in_state(connection->state_machine, LDAP_CONNECTION_STATE_RUN))
+    {
+        return;
+    }
+
+    int priority = connection->priority;
+    int last_msgid = connection->last_msgid;
+    LDAPControl *proxy_authorization = connection->proxy_authorization;
+    struct Deferred_Request_s* request = NULL;
+
+    connection->dispatching_deferred = true;
+    connection->proxy_authorization = NULL;
+
+    while (connection_requests_outstanding(connection) < connection->request_window
+           && (request = request_scheduler_next(connection->scheduler)) != NULL)
+    {
+        connection->priority = request->priority;
+        connection->dispatching_handle = request->handle;
+
+        if (request->dispatch(connection, request->operation) != RETURN_CODE_SUCCESS)
+        {
+            ld_warning("Unable to submit deferred request of priority class %d!\n", request->priority);
+        }
+
+        talloc_free(request);
+    }
+
+    // Caller keeps handle of the last operation it submitted, requests sent here are found by their handles.
+    connection->priority = priority;
+    connection->last_msgid = last_msgid;
+    connection->proxy_authorization = proxy_authorization;
+    connection->dispatching_deferred = false;
+}
+
+/**
+ * @brief connection_close Closes connection and frees resources associated with said connection.
+ * @param connection [in] connection to use
+ * @return RETURN_CODE_SUCCESS.
+ */
+enum OperationReturnCode connection_close(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    if (connection->read_event)
+    {
+        verto_del(connection->read_event);
+        connection->read_event = NULL;
+    }
+
+    if(connection->write_event) {
+        verto_del(connection->write_event);
+        connection->write_event = NULL;
+    }
+
+    if (connection->timer_event)
+    {
+        verto_del(connection->timer_event);
+        connection->timer_event = NULL;
+    }
+
+    if (connection->transport_event)
+    {
+        verto_del(connection->transport_event);
+        connection->transport_event = NULL;
+    }
+
+    if (connection->state_machine->state != LDAP_CONNECTION_STATE_ERROR)
+    {
+        // TODO: Check if there is better way to clean verto context on error.
+        if (connection->owns_base)
+        {
+            verto_free(connection->base);
+        }
+
+        ldap_unbind_ext(connection->ldap, NULL, NULL);
+    }
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief connection_drain Makes connection restart with its current configuration once operations sent to
+ * the server complete. Operations submitted meanwhile are deferred and sent over the new connection.
+ * Connection which is not running yet restarts right away.
+ * @param global_ctx [in] global context to use
+ * @param connection [in] connection to use
+ */
+void connection_drain(struct ldap_global_context_t *global_ctx, struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    if (!csm_is_in_state(connection->state_machine, LDAP_CONNECTION_STATE_RUN))
+    {
+        connection_restart(global_ctx, connection);
+        return;
+    }
+
+    if (!connection->draining)
+    {
+        ld_info("Draining connection, %d operations outstanding\n", connection_requests_outstanding(connection));
+
+        connection->draining = true;
+        connection->drain_deadline = ld_now() + CONNECTION_DRAIN_TIMEOUT;
+    }
+}
+
+/**
+ * @brief connection_abandon_outstanding Abandons operations sent to the server, their callbacks receive result_code.
+ * @param connection  [in] connection to use
+ * @param result_code [in] result code to pass to callbacks
+ */
+static void connection_abandon_outstanding(struct ldap_connection_ctx_t *connection, int result_code)
+{
+    for (int i = 0; i < connection->n_read_requests; ++i)
+    {
+        if (connection->read_requests[i].msgid >= 0)
+        {
+            connection_abandon_request(connection, connection->read_requests[i].msgid, result_code, true);
+        }
+    }
+
+    connection_compact_requests(connection);
+}
+
+/**
+ * @brief connection_drained Checks if draining connection may be restarted.
+ * @param connection [in] connection to use
+ * @return true if there are no outstanding operations or connection waited for them too long, in which case
+ * outstanding operations are abandoned and fail with LDAP_SERVER_DOWN.
+ */
+bool connection_drained(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    if (!connection->draining)
+    {
+        return false;
+    }
+
+    int outstanding = connection_requests_outstanding(connection);
+
+    if (outstanding > 0 && ld_now() >= connection->drain_deadline)
+    {
+        ld_warning("Connection did not drain in time, abandoning %d outstanding operations\n", outstanding);
+        connection_abandon_outstanding(connection, LDAP_SERVER_DOWN);
+        return true;
+    }
+
+    return outstanding == 0;
+}
+
+/**
+ * @brief connection_restart Closes connection and configures it again using its current configuration.
+ * Deferred operations are kept, SASL defaults are created anew from the configuration.
+ * @param global_ctx [in] global context to use
+ * @param connection [in] connection to restart
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode connection_restart(struct ldap_global_context_t *global_ctx,
+                                            struct ldap_connection_ctx_t *connection)
+{
+    assert(global_ctx);
+    assert(connection);
+
+    ld_info("Restarting connection to %s\n", connection->config->server);
+
+    // Connection in error state keeps event base and LDAP handle, they are released here instead.
+    csm_set_state(connection->state_machine, LDAP_CONNECTION_STATE_ERROR);
+    connection_close(connection);
+    ldap_unbind_ext(connection->ldap, NULL, NULL);
+    connection->ldap = NULL;
+
+    talloc_free(connection->ldap_defaults);
+    connection->ldap_defaults = NULL;
+
+    // TLS context is kept, connection_configure replaces it if certificate files have changed.
+    connection->tls_cache = NULL;
+
+    connection->n_reconnect_attempts = 0;
+
+    return connection_configure(global_ctx, connection, connection->config);
+}
+
+/**
+ * @brief connection_bind_on_read This callback is performed during bind operation.
+ * @param rc [in] result code of bind operation.
+ * @param message [in] message received during operation.
+ * @param connection [in] connection used during bind operation.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
  */
 enum OperationReturnCode connection_bind_on_read(int rc, LDAPMessage * message, struct ldap_connection_ctx_t *connection)
 {
@@ -720,16 +2003,15 @@ enum OperationReturnCode connection_bind_on_read(int rc, LDAPMessage * message,
         if (rc == LDAP_SASL_BIND_IN_PROGRESS)
         {
             ld_info("Bind in progress - request send: %d !\n", connection->msgid);
-            struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-            request->msgid = connection->msgid;
-            request->on_read_operation = connection_bind_on_read;
-            ++connection->n_read_requests;
-            request_queue_push(connection->callqueue, &request->node);
+            connection_enqueue_request(connection, connection->msgid, connection_bind_on_read);
         }
         else if (rc == LDAP_SUCCESS)
         {
             ld_info("Message - connection_bind_on_read - bind success!\n");
             csm_set_state(connection->state_machine, LDAP_CONNECTION_STATE_BOUND);
+
+            // Requests rootDSE without waiting for the next state machine update.
+            csm_next_state(connection->state_machine);
             return RETURN_CODE_SUCCESS;
         }
         else
@@ -738,6 +2020,13 @@ enum OperationReturnCode connection_bind_on_read(int rc, LDAPMessage * message,
             get_ldap_option(connection->ldap, LDAP_OPT_DIAGNOSTIC_MESSAGE, (void*)&diagnostic_message);
             ld_error("Error - ldap_result failed - op code: %d - code: %d %s\n", rc, error_code, diagnostic_message);
             ldap_memfree(diagnostic_message);
+
+            // Tickets of cached credential may have expired, next bind acquires fresh credential.
+            if (connection->bind_type == BIND_TYPE_INTERACTIVE)
+            {
+                gss_cache_forget_credential(connection->ldap_defaults->gss_cache);
+            }
+
             if (error_code != LDAP_SUCCESS)
             {
                 csm_set_state(connection->state_machine, LDAP_CONNECTION_STATE_ERROR);
@@ -792,11 +2081,19 @@ enum OperationReturnCode connection_start_tls_on_read(int rc, LDAPMessage * mess
                   error_code, diagnostic_message);
             ldap_memfree(diagnostic_message);
 
+            // Next attempt performs full handshake in case server rejected cached session.
+            tls_cache_forget_session(connection->tls_cache);
+
             csm_set_state(connection->state_machine, LDAP_CONNECTION_STATE_ERROR);
 
             return RETURN_CODE_FAILURE;
         }
 
+        if (tls_cache_session_resumed(connection->ldap))
+        {
+            ld_info("connection_start_tls_on_read - TLS session was resumed.\n");
+        }
+
         csm_set_state(connection->state_machine, LDAP_CONNECTION_STATE_TRANSPORT_READY);
     default:
         break;
@@ -807,3 +2104,216 @@ enum OperationReturnCode connection_start_tls_on_read(int rc, LDAPMessage * mess
     error_exit:
         return RETURN_CODE_FAILURE;
 }
+
+/**
+ * @brief connection_admit_request Checks if there is room for one more operation in the window.
+ * @param connection [in] connection to use
+ * @return
+ *        - RETURN_CODE_SUCCESS if operation may be submitted.
+ *        - RETURN_CODE_WOULD_BLOCK if window is full. Writable callback is called once window opens again.
+ */
+enum OperationReturnCode connection_admit_request(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    if (connection->dispatching_deferred
+        || !csm_is_in_state(connection->state_machine, LDAP_CONNECTION_STATE_RUN)
+        || connection_requests_in_flight(connection) < connection->request_window)
+    {
+        return RETURN_CODE_SUCCESS;
+    }
+
+    connection->write_blocked = true;
+
+    return RETURN_CODE_WOULD_BLOCK;
+}
+
+/**
+ * @brief connection_set_writable_callback Installs callback which is called when window opens after rejection.
+ * @param connection [in] connection to use
+ * @param callback   [in] callback to call, can be NULL
+ * @param user_data  [in] data to pass to callback
+ */
+void connection_set_writable_callback(struct ldap_connection_ctx_t *connection,
+                                      connection_writable_fn callback,
+                                      void *user_data)
+{
+    assert(connection);
+
+    connection->on_writable = callback;
+    connection->on_writable_data = user_data;
+}
+
+/**
+ * @brief connection_wait_writable Queues internal operation which waits for request window to open. Operations are
+ * notified in the order they started waiting, independently of writable callback installed by user.
+ * @param connection [in] connection to use
+ * @param waiter     [in] entry with callback to call, must stay valid until it is called or wait is canceled
+ */
+void connection_wait_writable(struct ldap_connection_ctx_t *connection, connection_writable_waiter_t *waiter)
+{
+    assert(connection);
+    assert(waiter);
+
+    if (waiter->waiting)
+    {
+        return;
+    }
+
+    waiter->waiting = true;
+    waiter->next = NULL;
+
+    if (connection->writable_waiters_tail)
+    {
+        connection->writable_waiters_tail->next = waiter;
+    }
+    else
+    {
+        connection->writable_waiters = waiter;
+    }
+    connection->writable_waiters_tail = waiter;
+}
+
+/**
+ * @brief connection_cancel_wait_writable Removes entry from the queue of operations waiting for request window.
+ * @param connection [in] connection to use
+ * @param waiter     [in] entry to remove, entry which does not wait is ignored
+ */
+void connection_cancel_wait_writable(struct ldap_connection_ctx_t *connection, connection_writable_waiter_t *waiter)
+{
+    assert(connection);
+    assert(waiter);
+
+    if (!waiter->waiting)
+    {
+        return;
+    }
+
+    connection_writable_waiter_t *previous = NULL;
+    connection_writable_waiter_t *current = connection->writable_waiters;
+
+    while (current && current != waiter)
+    {
+        previous = current;
+        current = current->next;
+    }
+
+    if (current)
+    {
+        if (previous)
+        {
+            previous->next = current->next;
+        }
+        else
+        {
+            connection->writable_waiters = current->next;
+        }
+
+        if (connection->writable_waiters_tail == current)
+        {
+            connection->writable_waiters_tail = previous;
+        }
+    }
+
+    waiter->waiting = false;
+    waiter->next = NULL;
+}
+
+/**
+ * @brief connection_get_descriptor Returns socket descriptor of the connection.
+ * @param connection [in] connection to use
+ * @return
+ *        - socket descriptor.
+ *        - -1 if connection is not established.
+ */
+int connection_get_descriptor(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    int fd = -1;
+
+    if (!connection->ldap || ldap_get_option(connection->ldap, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS)
+    {
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief connection_get_events Returns events connection is interested in.
+ * @param connection [in] connection to use
+ * @return mask of VERTO_EV_FLAG_IO_READ and VERTO_EV_FLAG_IO_WRITE.
+ */
+int connection_get_events(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    if (connection_get_descriptor(connection) < 0)
+    {
+        return 0;
+    }
+
+    if (connection->buffered_transport && transport_has_output(connection->ldap))
+    {
+        return VERTO_EV_FLAG_IO_READ | VERTO_EV_FLAG_IO_WRITE;
+    }
+
+    return VERTO_EV_FLAG_IO_READ;
+}
+
+/**
+ * @brief connection_next_deadline Returns earliest request deadline.
+ * @param connection [in] connection to use
+ * @return
+ *        - monotonic time in milliseconds, see request_timer_now.
+ *        - -1 if there are no deadlines.
+ */
+int64_t connection_next_deadline(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    struct Timer_Entry_s next = { 0, -1 };
+
+    if (connection->buffered_transport && transport_has_input(connection->ldap))
+    {
+        // Buffered results are processed by connection_process_timers.
+        return request_timer_now();
+    }
+
+    if (request_timer_peek(connection->timers, &next) != OPERATION_SUCCESS)
+    {
+        return -1;
+    }
+
+    return next.deadline;
+}
+
+/**
+ * @brief connection_enable_write_coalescing Makes connection send requests submitted during one loop iteration together.
+ * Takes effect immediately if connection is established, otherwise once it is.
+ * @param connection [in] connection to use
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if transport could not be replaced.
+ */
+enum OperationReturnCode connection_enable_write_coalescing(struct ldap_connection_ctx_t *connection)
+{
+    assert(connection);
+
+    connection->config->coalesce_writes = true;
+
+    if (!connection->handlers_installed || connection->buffered_transport)
+    {
+        return RETURN_CODE_SUCCESS;
+    }
+
+    if (transport_install_coalescing(connection, connection->ldap) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    connection->buffered_transport = true;
+
+    return RETURN_CODE_SUCCESS;
+}
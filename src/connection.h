@@ -27,8 +27,12 @@
 #include "common.h"
 
 #include "request_queue.h"
+#include "request_scheduler.h"
+#include "request_timer.h"
 
 #define MAX_REQUESTS 8192
+#define CONNECTION_MAX_CONTROLS 8
+#define CONNECTION_DRAIN_TIMEOUT 30000
 
 enum BindType
 {
@@ -59,6 +63,8 @@ typedef struct ldap_sasl_defaults_t
     char *authzid;                    //!<
 
     char *passwd;                     //!<
+
+    struct gss_cache_t *gss_cache;    //!< Kerberos credential passed to GSSAPI binds, NULL for other mechanisms.
 } ldap_sasl_defaults_t;
 
 typedef struct ldap_sasl_params_t
@@ -96,6 +102,15 @@ typedef struct ldap_connection_config_t
 
     int search_timelimit;                       //!<
     int network_timeout;                        //!<
+    int operation_timeout;                      //!< Default deadline of every operation in milliseconds, 0 disables it.
+
+    struct verto_ctx *event_base;               //!< Event loop provided by application, if NULL connection creates its own.
+
+    int request_window;                         //!< Maximum number of operations in flight, 0 means MAX_REQUESTS.
+    bool adaptive_window;                       //!< Shrink window when server reports it is busy.
+
+    bool use_io_uring;                          //!< Perform socket I/O through io_uring when available.
+    bool coalesce_writes;                       //!< Send requests submitted during one loop iteration together.
 } ldap_connection_config_t;
 
 struct ldap_connection_ctx_t;
@@ -104,19 +119,50 @@ typedef struct ld_entry_s ld_entry_t;
 
 typedef enum OperationReturnCode (*operation_callback_fn)(int, LDAPMessage *, struct ldap_connection_ctx_t *);
 typedef enum OperationReturnCode (*search_callback_fn)(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data);
+typedef void (*connection_writable_fn)(struct ldap_connection_ctx_t *connection, void* user_data);
+typedef void (*result_callback_fn)(struct ldap_connection_ctx_t *connection, int result_code, void* user_data);
+typedef void (*extended_callback_fn)(struct ldap_connection_ctx_t *connection, int result_code, struct berval *data,
+                                     void* user_data);
 
 typedef struct ldhandle LDHandle;
 
+/*!
+ * @brief connection_identity_t - Identity and priority class operations are submitted with. Work which continues
+ * after its first request, e.g. next page of paged search or next step of transaction, records them when it starts.
+ */
+typedef struct connection_identity_s
+{
+    LDAPControl *proxy_authorization;                //!< Proxied Authorization control, NULL for bound identity.
+    int priority;                                    //!< Priority class.
+} connection_identity_t;
+
+/*!
+ * @brief connection_writable_waiter_t - Entry of the queue of internal operations, e.g. pipelines, which wait for
+ * request window to open. Entry is embedded into waiting object, so waiting does not allocate memory.
+ */
+typedef struct connection_writable_waiter_s
+{
+    connection_writable_fn callback;                 //!< Called once window opens, entry is out of queue by then.
+    void *user_data;                                 //!< User data passed to callback.
+    bool waiting;                                    //!< Entry is in the queue.
+    struct connection_writable_waiter_s *next;       //!< Next entry of the queue.
+} connection_writable_waiter_t;
+
 typedef struct ldap_search_request_t
 {
     int msgid;                               //!<
     search_callback_fn on_search_operation;  //!<
+    result_callback_fn on_result_operation;  //!< Callback of tracked update operation, receives LDAP result code.
+    extended_callback_fn on_extended_operation; //!< Callback of tracked extended operation, receives response value.
     void* user_data;                         //!<
 } ldap_search_request_t;
 
 typedef struct ldap_request_t
 {
     int msgid;                                //!<
+    int handle;                               //!< Handle request was deferred with, -1 if it was sent right away.
+    int64_t deadline;                         //!< Monotonic time in milliseconds when request expires, 0 if never.
+    int priority;                             //!< Priority class request was submitted with.
 
     operation_callback_fn on_read_operation;  //!<
     operation_callback_fn on_write_operation; //!<
@@ -141,11 +187,19 @@ typedef struct ldap_connection_ctx_t
 
     struct verto_ev *read_event;                                //!<
     struct verto_ev *write_event;                               //!<
+    struct verto_ev *timer_event;                               //!< One shot event armed for the earliest deadline.
+    bool owns_base;                                             //!< Event base was created by connection and must be freed.
+    struct verto_ev *transport_event;                           //!< One shot event which drains input buffered by transport.
+    bool buffered_transport;                                    //!< Transport buffers data and must be flushed.
 
     operation_callback_fn on_error_operation;                   //!<
 
     int bind_type;                                              //!<
     int directory_type;                                         //!<
+    bool cancel_supported;                                      //!< Server advertises Cancel extended operation (RFC 3909).
+    bool directory_requested;                                   //!< rootDSE request is in flight.
+    struct ld_root_dse_s *root_dse;                             //!< Capabilities advertised by the server, kept across reconnects.
+    struct tls_cache_t *tls_cache;                              //!< TLS context and session shared with other connections.
     int msgid;                                                  //!<
 
     ldap_schema_t* schema;
@@ -153,6 +207,25 @@ typedef struct ldap_connection_ctx_t
     const char *rmech;                                          //!<
 
     struct request_queue* callqueue;                            //!<
+    struct request_timer* timers;                               //!< Deadlines of requests in flight.
+    int64_t timer_event_deadline;                               //!< Deadline the timer_event is armed for.
+    int last_msgid;                                             //!< Message id or handle of the last submitted request.
+    int last_deferred_handle;                                   //!< Handle of the last deferred request, below -1.
+    int dispatching_handle;                                     //!< Handle of deferred request being submitted.
+
+    struct request_scheduler* scheduler;                        //!< Deferred operations of priority classes.
+    int priority;                                               //!< Priority class of subsequent operations.
+    LDAPControl *proxy_authorization;                           //!< Proxied Authorization control of subsequent operations.
+    bool dispatching_deferred;                                  //!< Deferred operations are being submitted.
+
+    int request_window;                                         //!< Current limit of operations in flight.
+    int window_successes;                                       //!< Successful results since window was last changed.
+    bool write_blocked;                                         //!< Operation was rejected because window was full.
+    bool processing_results;                                    //!< Results are being dispatched by connection_on_read.
+    connection_writable_fn on_writable;                         //!< Called when window opens after rejection.
+    void *on_writable_data;                                     //!< User data passed to on_writable.
+    connection_writable_waiter_t *writable_waiters;             //!< Internal operations waiting for window, notified in turn.
+    connection_writable_waiter_t *writable_waiters_tail;        //!< Last entry of writable_waiters.
 
     struct ldap_request_t read_requests[MAX_REQUESTS];          //!<
     struct ldap_request_t write_requests[MAX_REQUESTS];         //!<
@@ -165,6 +238,8 @@ typedef struct ldap_connection_ctx_t
     int n_search_requests;                                      //!<
 
     int n_reconnect_attempts;                                   //!<
+    bool draining;                                              //!< Connection restarts once operations sent to the server complete.
+    int64_t drain_deadline;                                     //!< Time when connection restarts even if operations are outstanding.
 
     struct state_machine_ctx_t *state_machine;                  //!<
 
@@ -181,10 +256,63 @@ enum OperationReturnCode connection_start_tls(struct ldap_connection_ctx_t *conn
 enum OperationReturnCode connection_sasl_bind(struct ldap_connection_ctx_t *connection);
 enum OperationReturnCode connection_ldap_bind(struct ldap_connection_ctx_t *connection);
 enum OperationReturnCode connection_close(struct ldap_connection_ctx_t *connection);
+void connection_drain(struct ldap_global_context_t *global_ctx, struct ldap_connection_ctx_t *connection);
+bool connection_drained(struct ldap_connection_ctx_t *connection);
+enum OperationReturnCode connection_restart(struct ldap_global_context_t *global_ctx,
+                                            struct ldap_connection_ctx_t *connection);
+
+enum OperationReturnCode connection_enqueue_request(struct ldap_connection_ctx_t *connection,
+                                                    int msgid,
+                                                    operation_callback_fn on_read_operation);
+enum OperationReturnCode connection_set_request_timeout(struct ldap_connection_ctx_t *connection,
+                                                        int msgid,
+                                                        int timeout);
+enum OperationReturnCode connection_abandon_request(struct ldap_connection_ctx_t *connection,
+                                                    int msgid,
+                                                    int result_code,
+                                                    bool notify);
+enum OperationReturnCode connection_cancel_request(struct ldap_connection_ctx_t *connection, int msgid);
+int connection_last_request(struct ldap_connection_ctx_t *connection);
+
+enum OperationReturnCode connection_set_priority(struct ldap_connection_ctx_t *connection, int priority);
+enum OperationReturnCode connection_set_proxy_authorization(struct ldap_connection_ctx_t *connection,
+                                                            const char *authzid);
+enum OperationReturnCode connection_save_identity(TALLOC_CTX *ctx,
+                                                  struct ldap_connection_ctx_t *connection,
+                                                  connection_identity_t *identity);
+void connection_apply_identity(struct ldap_connection_ctx_t *connection,
+                               const connection_identity_t *identity,
+                               connection_identity_t *previous);
+enum OperationReturnCode connection_request_controls(struct ldap_connection_ctx_t *connection,
+                                                     LDAPControl **controls,
+                                                     LDAPControl **result);
+bool connection_should_defer(struct ldap_connection_ctx_t *connection);
+enum OperationReturnCode connection_defer_request(struct ldap_connection_ctx_t *connection,
+                                                  request_scheduler_dispatch_fn dispatch,
+                                                  void *operation);
+void connection_dispatch_deferred(struct ldap_connection_ctx_t *connection);
+
+enum OperationReturnCode connection_admit_request(struct ldap_connection_ctx_t *connection);
+int connection_requests_in_flight(struct ldap_connection_ctx_t *connection);
+void connection_set_writable_callback(struct ldap_connection_ctx_t *connection,
+                                      connection_writable_fn callback,
+                                      void *user_data);
+void connection_wait_writable(struct ldap_connection_ctx_t *connection, connection_writable_waiter_t *waiter);
+void connection_cancel_wait_writable(struct ldap_connection_ctx_t *connection, connection_writable_waiter_t *waiter);
 
 // Operation handlers.
 void connection_on_read(verto_ctx *ctx, verto_ev *ev);
 void connection_on_write(verto_ctx *ctx, verto_ev *ev);
+void connection_on_timer(verto_ctx *ctx, verto_ev *ev);
+
+// Event processing without verto.
+void connection_process_read(struct ldap_connection_ctx_t *connection);
+void connection_process_timers(struct ldap_connection_ctx_t *connection, int64_t now);
+void connection_process_write(struct ldap_connection_ctx_t *connection);
+enum OperationReturnCode connection_enable_write_coalescing(struct ldap_connection_ctx_t *connection);
+int connection_get_descriptor(struct ldap_connection_ctx_t *connection);
+int connection_get_events(struct ldap_connection_ctx_t *connection);
+int64_t connection_next_deadline(struct ldap_connection_ctx_t *connection);
 
 enum OperationReturnCode connection_bind_on_read(int, LDAPMessage *, struct ldap_connection_ctx_t *connection);
 enum OperationReturnCode connection_start_tls_on_read(int, LDAPMessage *, struct ldap_connection_ctx_t *connection);
@@ -140,36 +140,34 @@ enum OperationReturnCode csm_next_state(struct state_machine_ctx_t *ctx)
 
     case LDAP_CONNECTION_STATE_BOUND:
         csm_set_state(ctx, LDAP_CONNECTION_STATE_DETECT_DIRECTORY);
-        break;
+        // fallthrough - rootDSE is requested right away.
 
     case LDAP_CONNECTION_STATE_DETECT_DIRECTORY:
         if (ctx->ctx->directory_type == LDAP_TYPE_UNINITIALIZED)
         {
-            rc = directory_get_type(ctx->ctx);
+            if (!ctx->ctx->directory_requested)
+            {
+                rc = directory_get_type(ctx->ctx);
 
-            csm_set_state(ctx, rc == RETURN_CODE_SUCCESS
-                          ? LDAP_CONNECTION_STATE_DETECT_DIRECTORY
-                          : LDAP_CONNECTION_STATE_ERROR);
-        }
-        else
-        {
-            csm_set_state(ctx, LDAP_CONNECTION_STATE_REQUEST_SCHEMA);
+                ctx->ctx->directory_requested = rc == RETURN_CODE_SUCCESS;
+
+                if (rc != RETURN_CODE_SUCCESS)
+                {
+                    csm_set_state(ctx, LDAP_CONNECTION_STATE_ERROR);
+                }
+            }
+            break;
         }
-        break;
+
+        csm_set_state(ctx, LDAP_CONNECTION_STATE_REQUEST_SCHEMA);
+        // fallthrough - schema is requested as soon as directory type is known.
 
     case LDAP_CONNECTION_STATE_REQUEST_SCHEMA:
         rc = ldap_schema_load(ctx->ctx);
 
-        if (rc == RETURN_CODE_SUCCESS)
-        {
-            csm_set_state(ctx, LDAP_CONNECTION_STATE_CHECK_SCHEMA);
-        }
-        else
-        {
-            csm_set_state(ctx, rc == RETURN_CODE_OPERATION_IN_PROGRESS
-                          ? LDAP_CONNECTION_STATE_REQUEST_SCHEMA
-                          : LDAP_CONNECTION_STATE_ERROR);
-        }
+        csm_set_state(ctx, rc == RETURN_CODE_SUCCESS
+                      ? LDAP_CONNECTION_STATE_CHECK_SCHEMA
+                      : LDAP_CONNECTION_STATE_ERROR);
         break;
 
     case LDAP_CONNECTION_STATE_CHECK_SCHEMA:
@@ -182,6 +180,14 @@ enum OperationReturnCode csm_next_state(struct state_machine_ctx_t *ctx)
     case LDAP_CONNECTION_STATE_RUN:
         // TODO: Await signals to either close or transition to error state.
         ctx->ctx->n_reconnect_attempts = 0;
+
+        if (connection_drained(ctx->ctx))
+        {
+            connection_restart(ctx->ctx->handle->global_ctx, ctx->ctx);
+            break;
+        }
+
+        connection_dispatch_deferred(ctx->ctx);
         break;
 
     case LDAP_CONNECTION_STATE_ERROR:
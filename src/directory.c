@@ -19,9 +19,9 @@
 ***********************************************************************************************************************/
 
 #include "directory.h"
+#include "connection_state_machine.h"
 #include "entry.h"
-
-static char* LDAP_DIRECTORY_ATTRS[] = { "*", NULL };
+#include "root_dse.h"
 
 /**
  * @brief directory_get_type Request LDAP type from service.
@@ -37,7 +37,7 @@ enum OperationReturnCode directory_get_type(struct ldap_connection_ctx_t *connec
                     "",
                     LDAP_SCOPE_BASE,
                     "(objectClass=*)",
-                    LDAP_DIRECTORY_ATTRS,
+                    LDAP_ROOT_DSE_ATTRS,
                     0,
                     NULL,
                     NULL,
@@ -50,11 +50,10 @@ enum OperationReturnCode directory_get_type(struct ldap_connection_ctx_t *connec
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = directory_parse_result;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
+    if (connection_enqueue_request(connection, msgid, directory_parse_result) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
 
     return RETURN_CODE_SUCCESS;
 
@@ -93,6 +92,41 @@ bool directory_process_attribute(const char* attribute_name, struct ldap_connect
     return false;
 }
 
+/**
+ * @brief directory_process_root_dse Retains rootDSE of the server. Previously retained rootDSE is kept if server
+ * advertises the same information, so pointers obtained before reconnect stay valid.
+ * @param[in] message    Message received from ldap.
+ * @param[in] connection Connection to work with.
+ */
+static void directory_process_root_dse(LDAPMessage *message, struct ldap_connection_ctx_t *connection)
+{
+    ld_root_dse_t *root_dse = root_dse_parse(connection, connection->ldap, message);
+    if (!root_dse)
+    {
+        return;
+    }
+
+    if (root_dse_equal(connection->root_dse, root_dse))
+    {
+        // Counter is the only value which is expected to change between connections.
+        talloc_free(connection->root_dse->highest_committed_usn);
+        connection->root_dse->highest_committed_usn = talloc_steal(connection->root_dse, root_dse->highest_committed_usn);
+        talloc_free(root_dse);
+    }
+    else
+    {
+        talloc_free(connection->root_dse);
+        connection->root_dse = root_dse;
+    }
+
+    if (root_dse_supports_extension(connection->root_dse, LDAP_EXOP_CANCEL))
+    {
+        connection->cancel_supported = true;
+
+        ld_info("Server supports Cancel extended operation\n");
+    }
+}
+
 /**
  * @brief directory_parse_result Parses results returned by directory_get_type.
  * @param[in] rc                 Return code of ldap_result.
@@ -130,6 +164,11 @@ enum OperationReturnCode directory_parse_result(int rc, LDAPMessage *message, st
             };
             ber_free(ber_element, 0);
 
+            if (ldap_msgtype(message) == LDAP_RES_SEARCH_ENTRY)
+            {
+                directory_process_root_dse(message, connection);
+            }
+
             message = ldap_next_message(connection->ldap, message);
         }
 
@@ -138,6 +177,14 @@ enum OperationReturnCode directory_parse_result(int rc, LDAPMessage *message, st
             connection->directory_type = LDAP_TYPE_UNKNOWN;
         }
 
+        connection->directory_requested = false;
+
+        // Schema request is pipelined right after rootDSE instead of waiting for the next state machine update.
+        if (csm_is_in_state(connection->state_machine, LDAP_CONNECTION_STATE_DETECT_DIRECTORY))
+        {
+            csm_next_state(connection->state_machine);
+        }
+
         return RETURN_CODE_SUCCESS;
     }
         break;
@@ -150,6 +197,9 @@ enum OperationReturnCode directory_parse_result(int rc, LDAPMessage *message, st
         ldap_get_option(connection->ldap, LDAP_OPT_DIAGNOSTIC_MESSAGE, (void*)&diagnostic_message);
         ld_error("ldap_result failed: %s\n", diagnostic_message);
         ldap_memfree(diagnostic_message);
+
+        // Failed or timed out request is sent again by the next state machine update.
+        connection->directory_requested = false;
     }
         break;
     }
@@ -24,7 +24,9 @@
 #include "connection.h"
 #include "connection_state_machine.h"
 #include "entry.h"
+#include "root_dse.h"
 
+#include <ctype.h>
 #include <stdio.h>
 
 #include <talloc.h>
@@ -149,6 +151,30 @@ ld_config_t *ld_load_config(TALLOC_CTX* ctx, const char *filename)
 
     result->timeout = timeout;
 
+    int operation_timeout = 0;
+
+    get_config_optional_int("operation_timeout", operation_timeout);
+
+    result->operation_timeout = operation_timeout;
+
+    int request_window = 0;
+    int adaptive_window = false;
+
+    get_config_optional_int("request_window", request_window);
+    get_config_optional_bool("adaptive_window", adaptive_window);
+
+    result->request_window = request_window;
+    result->adaptive_window = adaptive_window;
+
+    int use_io_uring = false;
+    int coalesce_writes = false;
+
+    get_config_optional_bool("use_io_uring", use_io_uring);
+    get_config_optional_bool("coalesce_writes", coalesce_writes);
+
+    result->use_io_uring = use_io_uring;
+    result->coalesce_writes = coalesce_writes;
+
     const char *cacertfile = NULL;
     const char *certfile = NULL;
     const char *keyfile = NULL;
@@ -259,12 +285,88 @@ ld_config_t *ld_create_config(TALLOC_CTX* talloc_ctx,
     return result;
 }
 
+/**
+ * @brief apply_config Copies configuration into connection configuration and bind parameters of the handle.
+ * Strings describing servers are referenced, the rest is copied.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @param[in] config Configuration of the connections.
+ */
+static void apply_config(LDHandle *handle, const ld_config_t *config)
+{
+    TALLOC_CTX *talloc_ctx = handle->global_ctx->talloc_ctx;
+    struct ldap_connection_config_t *config_ctx = handle->config_ctx;
+
+    config_ctx->server = config->host;
+    config_ctx->protocol_verion = config->protocol_version;
+
+    config_ctx->use_sasl = config->use_sasl;
+    config_ctx->use_start_tls = config->use_tls;
+    config_ctx->operation_timeout = config->operation_timeout;
+    config_ctx->request_window = config->request_window;
+    config_ctx->adaptive_window = config->adaptive_window;
+    config_ctx->use_io_uring = config->use_io_uring;
+    config_ctx->coalesce_writes = config->coalesce_writes;
+
+    config_ctx->bind_type = config->simple_bind ? BIND_TYPE_SIMPLE : BIND_TYPE_INTERACTIVE;
+
+    talloc_free(config_ctx->sasl_options);
+    config_ctx->sasl_options = NULL;
+
+    if (config->use_sasl)
+    {
+        config_ctx->sasl_options = talloc(talloc_ctx, struct ldap_sasl_options_t);
+        config_ctx->sasl_options->mechanism = config->simple_bind ? LDAP_SASL_SIMPLE : "GSSAPI";
+        config_ctx->sasl_options->passwd = talloc_strdup(config_ctx->sasl_options, config->password);
+
+        config_ctx->sasl_options->sasl_nocanon = true;
+        config_ctx->sasl_options->sasl_secprops = "minssf=56";
+        config_ctx->sasl_options->sasl_flags = LDAP_SASL_QUIET;
+    }
+
+    talloc_free((void*)config_ctx->tls_ca_cert_file);
+    talloc_free((void*)config_ctx->tls_cert_file);
+    talloc_free((void*)config_ctx->tls_key_file);
+    config_ctx->tls_ca_cert_file = NULL;
+    config_ctx->tls_cert_file = NULL;
+    config_ctx->tls_key_file = NULL;
+
+    if (config->use_tls)
+    {
+        config_ctx->tls_ca_cert_file = talloc_strdup(talloc_ctx, config->cacertfile);
+        config_ctx->tls_cert_file = talloc_strdup(talloc_ctx, config->certfile);
+        config_ctx->tls_key_file = talloc_strdup(talloc_ctx, config->keyfile);
+    }
+
+    struct ldap_sasl_params_t *ldap_params = talloc(talloc_ctx, struct ldap_sasl_params_t);
+    ldap_params->dn = talloc_asprintf(ldap_params, "cn=%s,%s", config->username, config->base_dn);
+    ldap_params->passwd = talloc(ldap_params, struct berval);
+    ldap_params->passwd->bv_len = config->password ? strlen(config->password) : 0;
+    ldap_params->passwd->bv_val = config->password ? talloc_strdup(ldap_params, config->password) : NULL;
+    ldap_params->clientctrls = NULL;
+    ldap_params->serverctrls = NULL;
+
+    talloc_free(handle->connection_ctx->ldap_params);
+    handle->connection_ctx->ldap_params = ldap_params;
+}
+
 /**
  * @brief ld_init     Initializes the library allowing us to performing various operations.
  * @param[out] handle Pointer to libdomain session handle.
  * @param[in]  config Configuration of the connections.
  */
 void ld_init(LDHandle** handle, const ld_config_t* config)
+{
+    ld_init_with_event_loop(handle, config, NULL);
+}
+
+/**
+ * @brief ld_init_with_event_loop Initializes the library using event loop of the application.
+ * Library never frees provided event loop and application runs it instead of calling ld_exec.
+ * @param[out] handle Pointer to libdomain session handle.
+ * @param[in]  config Configuration of the connections.
+ * @param[in]  base   Event loop to install handlers into. If NULL library creates its own.
+ */
+void ld_init_with_event_loop(LDHandle** handle, const ld_config_t* config, verto_ctx *base)
 {
     *handle = malloc(sizeof(LDHandle));
 
@@ -289,47 +391,16 @@ void ld_init(LDHandle** handle, const ld_config_t* config)
     (*handle)->config_ctx = talloc_zero((*handle)->talloc_ctx, ldap_connection_config_t);
 
     (*handle)->global_ctx->talloc_ctx = (*handle)->talloc_ctx;
+    (*handle)->next_update = 0;
+    (*handle)->update_event = NULL;
 
-    (*handle)->config_ctx->server = config->host;
-    (*handle)->config_ctx->protocol_verion = config->protocol_version;
-
-    (*handle)->config_ctx->use_sasl = config->use_sasl;
-    (*handle)->config_ctx->use_start_tls = config->use_tls;
     (*handle)->config_ctx->chase_referrals = false;
+    (*handle)->config_ctx->event_base = base;
 
     int debug_level = -1;
     ldap_set_option((*handle)->connection_ctx->ldap, LDAP_OPT_DEBUG_LEVEL, &debug_level);
 
-    (*handle)->config_ctx->bind_type = config->simple_bind ? BIND_TYPE_SIMPLE : BIND_TYPE_INTERACTIVE;
-
-    if (config->use_sasl)
-    {
-        (*handle)->config_ctx->sasl_options = talloc((*handle)->global_ctx->talloc_ctx, struct ldap_sasl_options_t);
-        (*handle)->config_ctx->sasl_options->mechanism = config->simple_bind ? LDAP_SASL_SIMPLE : "GSSAPI";
-        (*handle)->config_ctx->sasl_options->passwd = talloc_strdup((*handle)->global_ctx->talloc_ctx, config->password);
-
-        (*handle)->config_ctx->sasl_options->sasl_nocanon = true;
-        (*handle)->config_ctx->sasl_options->sasl_secprops = "minssf=56";
-        (*handle)->config_ctx->sasl_options->sasl_flags = LDAP_SASL_QUIET;
-
-    }
-
-    if (config->use_tls)
-    {
-        (*handle)->config_ctx->tls_ca_cert_file = talloc_strdup((*handle)->global_ctx->talloc_ctx, config->cacertfile);
-        (*handle)->config_ctx->tls_cert_file = talloc_strdup((*handle)->global_ctx->talloc_ctx, config->certfile);
-        (*handle)->config_ctx->tls_key_file = talloc_strdup((*handle)->global_ctx->talloc_ctx, config->keyfile);
-    }
-
-    (*handle)->connection_ctx->ldap_params = talloc((*handle)->global_ctx->talloc_ctx, struct ldap_sasl_params_t);
-    (*handle)->connection_ctx->ldap_params->dn = talloc_asprintf((*handle)->global_ctx->talloc_ctx,
-                                                                 "cn=%s,%s",config->username, config->base_dn);
-    (*handle)->connection_ctx->ldap_params->passwd = talloc((*handle)->global_ctx->talloc_ctx, struct berval);
-    (*handle)->connection_ctx->ldap_params->passwd->bv_len = config->password ? strlen(config->password) : 0;
-    (*handle)->connection_ctx->ldap_params->passwd->bv_val = config->password ? talloc_strdup((*handle)->global_ctx->talloc_ctx,
-                                                                           config->password) : NULL;
-    (*handle)->connection_ctx->ldap_params->clientctrls = NULL;
-    (*handle)->connection_ctx->ldap_params->serverctrls = NULL;
+    apply_config(*handle, config);
 
     int rc = connection_configure((*handle)->global_ctx, (*handle)->connection_ctx, (*handle)->config_ctx);
 
@@ -351,13 +422,34 @@ static void connection_update(verto_ctx *ctx, verto_ev *ev)
     // TODO: Implement error checking.
     csm_next_state(connection->state_machine);
 
-    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN
+    // Draining connection is still driven, it restarts once outstanding operations complete.
+    if ((connection->state_machine->state == LDAP_CONNECTION_STATE_RUN && !connection->draining)
      || connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
     {
+        if (connection->handle && connection->handle->update_event == ev)
+        {
+            connection->handle->update_event = NULL;
+        }
+
         verto_del(ev);
     }
 }
 
+static void install_update_event(LDHandle *handle)
+{
+    if (handle->update_event)
+    {
+        return;
+    }
+
+    handle->update_event = verto_add_timeout(handle->connection_ctx->base, VERTO_EV_FLAG_PERSIST, connection_update,
+                                             CONNECTION_UPDATE_INTERVAL);
+    if (handle->update_event)
+    {
+        verto_set_private(handle->update_event, handle->connection_ctx, NULL);
+    }
+}
+
 /**
  * @brief ld_install_default_handlers Installs default handlers to control connection. This method must be
  * called before performing any operations.
@@ -371,9 +463,7 @@ void ld_install_default_handlers(LDHandle* handle)
         return;
     }
 
-    verto_ev* ev = verto_add_timeout(handle->connection_ctx->base, VERTO_EV_FLAG_PERSIST, connection_update,
-                                     CONNECTION_UPDATE_INTERVAL);
-    verto_set_private(ev, handle->connection_ctx, NULL);
+    install_update_event(handle);
 }
 
 /**
@@ -392,9 +482,122 @@ void ld_install_handler(LDHandle* handle, verto_callback *callback, time_t inter
     verto_set_private(ev, handle->connection_ctx, NULL);
 }
 
+static bool config_string_equal(const char *first, const char *second)
+{
+    return first == second || (first && second && strcmp(first, second) == 0);
+}
+
+static bool config_server_listed(const char *servers, const char *server)
+{
+    size_t length = strlen(server);
+
+    for (const char *position = servers; (position = strstr(position, server)) != NULL; position += length)
+    {
+        if ((position == servers || isspace((unsigned char)position[-1]))
+            && (position[length] == '\0' || isspace((unsigned char)position[length])))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief config_servers_added Checks if every server of previous host list is present in new host list.
+ * @param[in] previous Previous list of servers separated by spaces.
+ * @param[in] current  New list of servers separated by spaces.
+ * @return true if new list only adds servers.
+ */
+static bool config_servers_added(const char *previous, const char *current)
+{
+    char *servers = talloc_strdup(NULL, previous);
+    char *state = NULL;
+    bool result = servers != NULL;
+
+    for (char *server = strtok_r(servers, " \t", &state); result && server; server = strtok_r(NULL, " \t", &state))
+    {
+        result = config_server_listed(current, server);
+    }
+
+    talloc_free(servers);
+
+    return result;
+}
+
+/**
+ * @brief ld_reload_config Applies new configuration to the handle without dropping operations in flight.
+ * Operation timeout, request window and enabling of write coalescing take effect immediately, servers added to
+ * the host list are used on next reconnect. Other changes, e.g. removed servers, credentials, TLS files or transport,
+ * make connection wait for outstanding operations and reconnect with new configuration, operations submitted
+ * meanwhile are sent over the new connection. Same as with ld_init, configuration must outlive the handle.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @param[in] config New configuration of the connections, e.g. returned by ld_load_config.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_reload_config(LDHandle *handle, const ld_config_t *config)
+{
+    check_handle(handle, "ld_reload_config");
+
+    if (!config || !config->host)
+    {
+        ld_error("Invalid config - ld_reload_config\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    const ld_config_t *previous = handle->global_config;
+
+    bool restart = !config_servers_added(previous->host, config->host)
+                || previous->protocol_version != config->protocol_version
+                || !config_string_equal(previous->base_dn, config->base_dn)
+                || !config_string_equal(previous->username, config->username)
+                || !config_string_equal(previous->password, config->password)
+                || previous->simple_bind != config->simple_bind
+                || previous->use_tls != config->use_tls
+                || previous->use_sasl != config->use_sasl
+                || previous->use_anon != config->use_anon
+                || !config_string_equal(previous->cacertfile, config->cacertfile)
+                || !config_string_equal(previous->certfile, config->certfile)
+                || !config_string_equal(previous->keyfile, config->keyfile)
+                || previous->use_io_uring != config->use_io_uring
+                || (previous->coalesce_writes && !config->coalesce_writes);
+    bool window_changed = previous->request_window != config->request_window
+                       || previous->adaptive_window != config->adaptive_window;
+    bool coalescing_enabled = !previous->coalesce_writes && config->coalesce_writes;
+
+    *handle->global_config = *config;
+    apply_config(handle, config);
+
+    if (window_changed)
+    {
+        ld_set_request_window(handle, config->request_window, config->adaptive_window);
+    }
+
+    if (coalescing_enabled && !restart && ld_enable_write_coalescing(handle) != RETURN_CODE_SUCCESS)
+    {
+        ld_warning("Unable to enable write coalescing, it will be used after reconnect - ld_reload_config\n");
+    }
+
+    if (!restart)
+    {
+        ld_info("Configuration reloaded without reconnect\n");
+        return RETURN_CODE_SUCCESS;
+    }
+
+    // Running connection has removed its update event, connection which does not run yet still has one.
+    install_update_event(handle);
+
+    connection_drain(handle->global_ctx, handle->connection_ctx);
+
+    return RETURN_CODE_SUCCESS;
+}
+
 /**
  * @brief ld_exec Start main event cycle. You don't need to call this function if there is already existing
- * event loop e.g. inside of Qt application.
+ * event loop e.g. inside of Qt application. In that case either pass the loop to ld_init_with_event_loop or
+ * drive the library with ld_get_fd, ld_process_io and ld_process_timers.
  * @param[in] handle Pointer to libdomain session handle.
  */
 void ld_exec(LDHandle* handle)
@@ -423,6 +626,121 @@ void ld_exec_once(LDHandle* handle)
     verto_run_once(handle->connection_ctx->base);
 }
 
+/**
+ * @brief ld_get_fd Returns socket descriptor application must watch when it drives events itself.
+ * Descriptor changes when connection is reestablished, so it must be queried before every wait.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @return
+ *        - socket descriptor.
+ *        - -1 if connection is not established yet.
+ */
+int ld_get_fd(LDHandle *handle)
+{
+    if (!handle)
+    {
+        ld_error("Invalid handle was provided - ld_get_fd\n");
+        return -1;
+    }
+
+    return connection_get_descriptor(handle->connection_ctx);
+}
+
+/**
+ * @brief ld_get_events Returns events library waits for on descriptor returned by ld_get_fd.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @return mask of VERTO_EV_FLAG_IO_READ and VERTO_EV_FLAG_IO_WRITE.
+ */
+int ld_get_events(LDHandle *handle)
+{
+    if (!handle)
+    {
+        ld_error("Invalid handle was provided - ld_get_events\n");
+        return 0;
+    }
+
+    return connection_get_events(handle->connection_ctx);
+}
+
+/**
+ * @brief ld_now Returns current time in clock used by ld_get_next_deadline and ld_process_timers.
+ * @return monotonic time in milliseconds.
+ */
+int64_t ld_now(void)
+{
+    return request_timer_now();
+}
+
+/**
+ * @brief ld_get_next_deadline Returns time at which ld_process_timers must be called.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @return
+ *        - monotonic time in milliseconds, see ld_now.
+ *        - -1 on failure.
+ */
+int64_t ld_get_next_deadline(LDHandle *handle)
+{
+    if (!handle)
+    {
+        ld_error("Invalid handle was provided - ld_get_next_deadline\n");
+        return -1;
+    }
+
+    int64_t deadline = connection_next_deadline(handle->connection_ctx);
+
+    return deadline < 0 || handle->next_update < deadline ? handle->next_update : deadline;
+}
+
+/**
+ * @brief ld_process_io Processes events reported for descriptor returned by ld_get_fd.
+ * Use it instead of ld_exec when application drives events itself.
+ * @param[in] handle  Pointer to libdomain session handle.
+ * @param[in] revents Mask of VERTO_EV_FLAG_IO_READ and VERTO_EV_FLAG_IO_WRITE.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_process_io(LDHandle *handle, int revents)
+{
+    check_handle(handle, "ld_process_io");
+
+    if (revents & VERTO_EV_FLAG_IO_WRITE)
+    {
+        connection_process_write(handle->connection_ctx);
+    }
+
+    if (revents & VERTO_EV_FLAG_IO_READ)
+    {
+        connection_process_read(handle->connection_ctx);
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_process_timers Advances connection state and expires request deadlines.
+ * Use it instead of ld_exec and ld_install_default_handlers when application drives events itself.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @param[in] now    Current time, see ld_now.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_process_timers(LDHandle *handle, int64_t now)
+{
+    check_handle(handle, "ld_process_timers");
+
+    if (now >= handle->next_update)
+    {
+        csm_next_state(handle->connection_ctx->state_machine);
+
+        handle->next_update = now + CONNECTION_UPDATE_INTERVAL;
+    }
+
+    connection_process_timers(handle->connection_ctx, now);
+
+    return RETURN_CODE_SUCCESS;
+}
+
 /**
  * @brief ld_free Free library handle and resources associated with it. After freeing the handle you can no longer
  * perform any operations.
@@ -652,6 +970,226 @@ void ld_install_error_handler(LDHandle *handle, error_callback_fn callback)
     handle->connection_ctx->on_error_operation = (operation_callback_fn)callback;
 }
 
+/**
+ * @brief ld_set_operation_timeout Sets deadline for all subsequent operations. Operations which do not complete
+ * in time are abandoned and reported to error handler with LDAP_TIMEOUT.
+ * @param[in] handle  Pointer to libdomain session handle.
+ * @param[in] timeout Timeout in milliseconds, 0 disables deadlines.
+ */
+void ld_set_operation_timeout(LDHandle *handle, int timeout)
+{
+    if (!handle)
+    {
+        ld_error("Invalid handle - ld_set_operation_timeout\n");
+        return;
+    }
+
+    handle->config_ctx->operation_timeout = timeout > 0 ? timeout : 0;
+}
+
+/**
+ * @brief ld_get_last_request Returns handle of the most recently submitted operation.
+ * Call it right after operation function returns to be able to cancel the operation later.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @return
+ *        - request handle on success.
+ *        - -1 if there is no such request.
+ */
+int ld_get_last_request(LDHandle *handle)
+{
+    if (!handle)
+    {
+        ld_error("Invalid handle - ld_get_last_request\n");
+        return -1;
+    }
+
+    return connection_last_request(handle->connection_ctx);
+}
+
+/**
+ * @brief ld_cancel_request Cancels operation in flight. Callbacks of cancelled operation are not called.
+ * Operation which still waits for its priority class is dropped before it is sent.
+ * @param[in] handle  Pointer to libdomain session handle.
+ * @param[in] request Handle of the request returned by ld_get_last_request.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_cancel_request(LDHandle *handle, int request)
+{
+    check_handle(handle, "ld_cancel_request");
+
+    return connection_cancel_request(handle->connection_ctx, request);
+}
+
+/**
+ * @brief ld_get_root_dse Returns capabilities and naming information advertised by the server.
+ * Returned structure is owned by the library and stays valid until ld_free or until server advertises
+ * different information after reconnect.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @return
+ *        - NULL if connection was not established yet.
+ *        - ld_root_dse_t* on success.
+ */
+const ld_root_dse_t *ld_get_root_dse(LDHandle *handle)
+{
+    if (!handle)
+    {
+        ld_error("Invalid handle - ld_get_root_dse\n");
+        return NULL;
+    }
+
+    return handle->connection_ctx->root_dse;
+}
+
+/**
+ * @brief ld_supports_control Checks if server advertises control in rootDSE.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @param[in] oid    OID of the control, e.g. LDAP_CONTROL_PAGEDRESULTS.
+ * @return true if control is supported.
+ */
+bool ld_supports_control(LDHandle *handle, const char *oid)
+{
+    return handle && root_dse_supports_control(handle->connection_ctx->root_dse, oid);
+}
+
+/**
+ * @brief ld_supports_extension Checks if server advertises extended operation in rootDSE.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @param[in] oid    OID of the extended operation, e.g. LDAP_EXOP_CANCEL.
+ * @return true if extended operation is supported.
+ */
+bool ld_supports_extension(LDHandle *handle, const char *oid)
+{
+    return handle && root_dse_supports_extension(handle->connection_ctx->root_dse, oid);
+}
+
+/**
+ * @brief ld_supports_sasl_mechanism Checks if server advertises SASL mechanism in rootDSE.
+ * @param[in] handle    Pointer to libdomain session handle.
+ * @param[in] mechanism Name of the mechanism, e.g. GSSAPI.
+ * @return true if mechanism is supported.
+ */
+bool ld_supports_sasl_mechanism(LDHandle *handle, const char *mechanism)
+{
+    return handle && root_dse_supports_sasl_mechanism(handle->connection_ctx->root_dse, mechanism);
+}
+
+/**
+ * @brief ld_set_priority Sets priority class of subsequent operations.
+ * @param[in] handle   Pointer to libdomain session handle.
+ * @param[in] priority Priority class, one of REQUEST_PRIORITY_INTERACTIVE, REQUEST_PRIORITY_BULK
+ *                     or REQUEST_PRIORITY_BACKGROUND.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_set_priority(LDHandle *handle, int priority)
+{
+    check_handle(handle, "ld_set_priority");
+
+    return connection_set_priority(handle->connection_ctx, priority);
+}
+
+/**
+ * @brief ld_set_proxy_authorization Sets identity subsequent add, modify, delete, rename and search operations
+ * are performed on behalf of using Proxied Authorization control (RFC 4370). Operations keep identity they were
+ * submitted with, so single connection may serve many users by switching identity between operations.
+ * @param[in] handle  Pointer to libdomain session handle.
+ * @param[in] authzid Authorization identity, e.g. "dn:cn=user,dc=domain,dc=alt" or "u:user", empty string
+ *                    for anonymous, NULL to perform operations as identity the handle is bound with.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_set_proxy_authorization(LDHandle *handle, const char *authzid)
+{
+    check_handle(handle, "ld_set_proxy_authorization");
+
+    return connection_set_proxy_authorization(handle->connection_ctx, authzid);
+}
+
+/**
+ * @brief ld_configure_priority Configures share and limit of priority class.
+ * @param[in] handle   Pointer to libdomain session handle.
+ * @param[in] priority Priority class to configure.
+ * @param[in] weight   Number of deferred operations class submits during its turn, must be positive.
+ * @param[in] limit    Maximum number of outstanding operations of the class, 0 if unlimited.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_configure_priority(LDHandle *handle, int priority, unsigned int weight, unsigned int limit)
+{
+    check_handle(handle, "ld_configure_priority");
+
+    if (request_scheduler_set_class(handle->connection_ctx->scheduler, priority, weight, limit) != OPERATION_SUCCESS)
+    {
+        ld_error("Invalid priority class configuration - ld_configure_priority\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    connection_dispatch_deferred(handle->connection_ctx);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_set_request_window Limits number of operations in flight. Operations submitted while window is full
+ * fail with RETURN_CODE_WOULD_BLOCK and writable handler is called once window opens.
+ * @param[in] handle   Pointer to libdomain session handle.
+ * @param[in] window   Maximum number of operations in flight, 0 uses library limit.
+ * @param[in] adaptive If true window is halved every time server responds with LDAP_BUSY or
+ *                     LDAP_UNWILLING_TO_PERFORM and slowly grows back afterwards.
+ */
+void ld_set_request_window(LDHandle *handle, int window, bool adaptive)
+{
+    if (!handle)
+    {
+        ld_error("Invalid handle - ld_set_request_window\n");
+        return;
+    }
+
+    handle->config_ctx->request_window = window > 0 ? window : 0;
+    handle->config_ctx->adaptive_window = adaptive;
+
+    handle->connection_ctx->request_window = window > 0 && window < MAX_REQUESTS ? window : MAX_REQUESTS;
+    handle->connection_ctx->window_successes = 0;
+}
+
+/**
+ * @brief ld_install_writable_handler Installs handler which is called when operations may be submitted again
+ * after one of them failed with RETURN_CODE_WOULD_BLOCK.
+ * @param[in] handle    Pointer to libdomain session handle.
+ * @param[in] callback  Callback to call, receives connection and user data.
+ * @param[in] user_data Data to pass to callback.
+ */
+void ld_install_writable_handler(LDHandle *handle, writable_callback_fn callback, void *user_data)
+{
+    if (!handle)
+    {
+        ld_error("Invalid handle - ld_install_writable_handler\n");
+        return;
+    }
+
+    connection_set_writable_callback(handle->connection_ctx, (connection_writable_fn)callback, user_data);
+}
+
+/**
+ * @brief ld_enable_write_coalescing Makes library send operations submitted during one event loop iteration
+ * in a single write instead of one write per operation. Same as setting "coalesce_writes" in configuration file.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_enable_write_coalescing(LDHandle *handle)
+{
+    check_handle(handle, "ld_enable_write_coalescing");
+
+    return connection_enable_write_coalescing(handle->connection_ctx);
+}
+
 /**
  * @brief ld_mod_entry_attrs Modifies list of attributes using supplied operation.
  * @param[in] handle         Pointer to libdomain session handle.
@@ -23,6 +23,7 @@
 
 #include <talloc.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <verto.h>
 
 /**
@@ -44,9 +45,27 @@ typedef struct LDAPAttribute_s
     char **values;                             //!< NULL terminated array of attribute values.
 } LDAPAttribute_t;
 
+/**
+ * @brief ld_root_dse_t Structure holds capabilities and naming information advertised by the server in rootDSE.
+ * Arrays are NULL terminated, missing attributes are represented by NULL.
+ */
+typedef struct ld_root_dse_s
+{
+    char **supported_controls;                 //!< OIDs of supported controls.
+    char **supported_extensions;               //!< OIDs of supported extended operations.
+    char **supported_sasl_mechanisms;          //!< Names of supported SASL mechanisms.
+    char **naming_contexts;                    //!< DNs of naming contexts held by the server.
+    char *subschema_subentry;                  //!< DN of the subschema entry.
+    char *highest_committed_usn;               //!< Highest update sequence number, Active Directory only.
+    char *dns_host_name;                       //!< DNS name of the server, Active Directory only.
+} ld_root_dse_t;
+
 typedef enum OperationReturnCode (*error_callback_fn)(int, void *, void *);  //!< Type defines error callback.
                                                                              //!< This callback will be fired when connection
                                                                              //!< goes to LDAP_CONNECTION_STATE_ERROR state.
+typedef void (*writable_callback_fn)(void *, void *);                        //!< Type defines writable callback.
+                                                                             //!< This callback will be fired when operations
+                                                                             //!< may be submitted again after RETURN_CODE_WOULD_BLOCK.
 ld_config_t *ld_load_config(TALLOC_CTX *ctx, const char *filename);
 
 ld_config_t *ld_create_config(TALLOC_CTX* talloc_ctx,
@@ -66,11 +85,33 @@ ld_config_t *ld_create_config(TALLOC_CTX* talloc_ctx,
                               char *keyfile);
 
 void ld_init(LDHandle **handle, const ld_config_t *config);
+void ld_init_with_event_loop(LDHandle **handle, const ld_config_t *config, verto_ctx *base);
+enum OperationReturnCode ld_reload_config(LDHandle *handle, const ld_config_t *config);
 void ld_install_default_handlers(LDHandle *handle);
 void ld_install_handler(LDHandle *handle, verto_callback *callback, time_t interval);
 void ld_install_error_handler(LDHandle *handle, error_callback_fn callback);
+void ld_set_operation_timeout(LDHandle *handle, int timeout);
+int ld_get_last_request(LDHandle *handle);
+enum OperationReturnCode ld_cancel_request(LDHandle *handle, int request);
+const ld_root_dse_t *ld_get_root_dse(LDHandle *handle);
+bool ld_supports_control(LDHandle *handle, const char *oid);
+bool ld_supports_extension(LDHandle *handle, const char *oid);
+bool ld_supports_sasl_mechanism(LDHandle *handle, const char *mechanism);
+enum OperationReturnCode ld_set_priority(LDHandle *handle, int priority);
+enum OperationReturnCode ld_set_proxy_authorization(LDHandle *handle, const char *authzid);
+enum OperationReturnCode ld_configure_priority(LDHandle *handle, int priority, unsigned int weight, unsigned int limit);
+void ld_set_request_window(LDHandle *handle, int window, bool adaptive);
+void ld_install_writable_handler(LDHandle *handle, writable_callback_fn callback, void *user_data);
+enum OperationReturnCode ld_enable_write_coalescing(LDHandle *handle);
 void ld_exec(LDHandle *handle);
 void ld_exec_once(LDHandle *handle);
+
+int ld_get_fd(LDHandle *handle);
+int ld_get_events(LDHandle *handle);
+int64_t ld_now(void);
+int64_t ld_get_next_deadline(LDHandle *handle);
+enum OperationReturnCode ld_process_io(LDHandle *handle, int revents);
+enum OperationReturnCode ld_process_timers(LDHandle *handle, int64_t now);
 void ld_free(LDHandle *handle);
 
 #endif //LIB_DOMAIN_H
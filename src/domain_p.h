@@ -22,6 +22,7 @@
 #define LIB_DOMAIN_PRIVATE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "helper_p.h"
 
 typedef struct ld_config_s
@@ -39,6 +40,11 @@ typedef struct ld_config_s
     bool use_anon;                         //!< If we are going to perform "anonymous bind".
 
     int timeout;                           //!< Operation timeout. Once we reach specified limit current operation fails.
+    int operation_timeout;                 //!< Deadline of each request in milliseconds after which request is abandoned. 0 disables it.
+    int request_window;                    //!< Maximum number of operations in flight. 0 uses library limit.
+    bool adaptive_window;                  //!< Shrink request window while server reports it is busy.
+    bool use_io_uring;                     //!< Perform socket I/O through io_uring, requires library built with io_uring.
+    bool coalesce_writes;                  //!< Send operations submitted during one event loop iteration in one write.
 
     char *cacertfile;                      //!< Defines the complete path to a CA certificate, which is utilized for validating the server's presented certificate.
     char *certfile;                        //!< Client certificate file path.
@@ -52,6 +58,8 @@ typedef struct ldhandle
     struct ldap_connection_ctx_t *connection_ctx;      //!< Connection context.
     struct ldap_connection_config_t *config_ctx;       //!< Connection configuration.
     ld_config_t *global_config;                        //!< Global configuration of the library.
+    int64_t next_update;                               //!< Time of next connection update when events are processed by application.
+    struct verto_ev *update_event;                     //!< Persistent event which drives connection until it runs, NULL if none.
 } LDHandle;
 
 #define check_handle(handle, function_name) \
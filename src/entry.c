@@ -24,6 +24,303 @@
 #include "domain.h"
 #include "domain_p.h"
 
+#include <string.h>
+#include <strings.h>
+
+/**
+ * @brief entry_copy_strings Copies NULL terminated array of strings.
+ * @param[in] ctx    Memory context to allocate copy in.
+ * @param[in] values Array to copy. Can be NULL.
+ * @return Copy of the array or NULL.
+ */
+static char **entry_copy_strings(TALLOC_CTX *ctx, char **values)
+{
+    if (!values)
+    {
+        return NULL;
+    }
+
+    int count = 0;
+    while (values[count] != NULL)
+    {
+        ++count;
+    }
+
+    char **result = talloc_array(ctx, char*, count + 1);
+    for (int i = 0; i < count; ++i)
+    {
+        result[i] = talloc_strdup(result, values[i]);
+    }
+    result[count] = NULL;
+
+    return result;
+}
+
+/**
+ * @brief entry_copy_mods Copies NULL terminated array of modifications.
+ * @param[in] ctx  Memory context to allocate copy in.
+ * @param[in] mods Array to copy. Can be NULL.
+ * @return Copy of the array or NULL.
+ */
+LDAPMod **entry_copy_mods(TALLOC_CTX *ctx, LDAPMod **mods)
+{
+    if (!mods)
+    {
+        return NULL;
+    }
+
+    int count = 0;
+    while (mods[count] != NULL)
+    {
+        ++count;
+    }
+
+    LDAPMod **result = talloc_array(ctx, LDAPMod*, count + 1);
+    for (int i = 0; i < count; ++i)
+    {
+        result[i] = talloc_zero(result, LDAPMod);
+        result[i]->mod_op = mods[i]->mod_op;
+        result[i]->mod_type = talloc_strdup(result[i], mods[i]->mod_type);
+
+        if (mods[i]->mod_op & LDAP_MOD_BVALUES)
+        {
+            int n_values = 0;
+            while (mods[i]->mod_bvalues && mods[i]->mod_bvalues[n_values] != NULL)
+            {
+                ++n_values;
+            }
+
+            result[i]->mod_bvalues = talloc_array(result[i], struct berval*, n_values + 1);
+            for (int j = 0; j < n_values; ++j)
+            {
+                result[i]->mod_bvalues[j] = talloc(result[i]->mod_bvalues, struct berval);
+                result[i]->mod_bvalues[j]->bv_len = mods[i]->mod_bvalues[j]->bv_len;
+                result[i]->mod_bvalues[j]->bv_val = talloc_memdup(result[i]->mod_bvalues,
+                                                                  mods[i]->mod_bvalues[j]->bv_val,
+                                                                  mods[i]->mod_bvalues[j]->bv_len);
+            }
+            result[i]->mod_bvalues[n_values] = NULL;
+        }
+        else
+        {
+            result[i]->mod_values = entry_copy_strings(result[i], mods[i]->mod_values);
+        }
+    }
+    result[count] = NULL;
+
+    return result;
+}
+
+/*!
+ * @brief entry_operation_t - Arguments of deferred operation.
+ */
+typedef struct entry_operation_s
+{
+    char *dn;                                //!< Target of the operation.
+    char *new_dn;                            //!< New rdn of the entry for rename operation.
+    char *new_parent;                        //!< New parent of the entry for rename operation.
+    bool delete_original;                    //!< Delete original rdn for rename operation.
+    LDAPMod **mods;                          //!< Modifications for add and modify operations.
+
+    int scope;                               //!< Scope of search operation.
+    char *filter;                            //!< Filter of search operation.
+    char **attrs;                            //!< Attributes to request in search operation.
+    bool attrsonly;                          //!< Request only attribute names in search operation.
+    search_callback_fn search_callback;      //!< Callback of search operation.
+    void *user_data;                         //!< User data of search operation.
+    int page_size;                           //!< Page size of paged search operation.
+    LDAPControl **controls;                  //!< Server controls of tracked operation.
+    result_callback_fn result_callback;      //!< Callback of tracked operation, failure callback of search.
+    char *oid;                               //!< Request name of extended operation.
+    struct berval *data;                     //!< Request value of extended operation, can be NULL.
+    extended_callback_fn extended_callback;  //!< Callback of extended operation.
+} entry_operation_t;
+
+static int entry_operation_destructor(entry_operation_t *operation)
+{
+    if (operation->controls)
+    {
+        ldap_controls_free(operation->controls);
+        operation->controls = NULL;
+    }
+
+    return 0;
+}
+
+static entry_operation_t *entry_operation_new(const char *dn)
+{
+    entry_operation_t *operation = talloc_zero(NULL, entry_operation_t);
+    if (operation && dn)
+    {
+        operation->dn = talloc_strdup(operation, dn);
+    }
+
+    return operation;
+}
+
+/**
+ * @brief entry_operation_set_controls Keeps copy of server controls until deferred operation is dispatched.
+ * @param[in] operation       Operation to store controls in.
+ * @param[in] server_controls Server controls to copy, can be NULL.
+ * @return true on success.
+ */
+static bool entry_operation_set_controls(entry_operation_t *operation, LDAPControl **server_controls)
+{
+    talloc_set_destructor(operation, entry_operation_destructor);
+
+    operation->controls = server_controls ? ldap_controls_dup(server_controls) : NULL;
+
+    return !server_controls || operation->controls;
+}
+
+static enum OperationReturnCode add_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return add(connection, operation->dn, operation->mods);
+}
+
+static enum OperationReturnCode search_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return search_ext(connection, operation->dn, operation->scope, operation->filter, operation->attrs,
+                      operation->attrsonly, operation->search_callback, operation->result_callback,
+                      operation->user_data);
+}
+
+static enum OperationReturnCode search_paged_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return search_paged_ext(connection, operation->dn, operation->scope, operation->filter, operation->attrs,
+                            operation->page_size, operation->search_callback, operation->result_callback,
+                            operation->user_data);
+}
+
+static enum OperationReturnCode modify_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return modify(connection, operation->dn, operation->mods);
+}
+
+static enum OperationReturnCode delete_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return ld_delete(connection, operation->dn);
+}
+
+static enum OperationReturnCode delete_ext_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return delete_ext(connection, operation->dn, operation->controls, operation->result_callback,
+                      operation->user_data);
+}
+
+static enum OperationReturnCode add_ext_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return add_ext(connection, operation->dn, operation->mods, operation->controls, operation->result_callback,
+                   operation->user_data);
+}
+
+static enum OperationReturnCode modify_ext_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return modify_ext(connection, operation->dn, operation->mods, operation->controls, operation->result_callback,
+                      operation->user_data);
+}
+
+static enum OperationReturnCode extended_ext_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return extended_ext(connection, operation->oid, operation->data, operation->extended_callback,
+                        operation->user_data);
+}
+
+static enum OperationReturnCode rename_ext_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return rename_ext(connection, operation->dn, operation->new_dn, operation->new_parent,
+                      operation->delete_original, operation->controls, operation->result_callback,
+                      operation->user_data);
+}
+
+static enum OperationReturnCode whoami_dispatch(void *connection, void *data)
+{
+    (void)(data);
+
+    return whoami(connection);
+}
+
+static enum OperationReturnCode rename_dispatch(void *connection, void *data)
+{
+    entry_operation_t *operation = data;
+
+    return ld_rename(connection, operation->dn, operation->new_dn, operation->new_parent, operation->delete_original);
+}
+
+/*!
+ * @brief entry_request_t - Arguments of request sent to the server.
+ */
+typedef struct entry_request_s
+{
+    int type;                  // LDAP_REQ_ADD, LDAP_REQ_MODIFY, LDAP_REQ_DELETE, LDAP_REQ_MODDN or LDAP_REQ_SEARCH
+    const char *dn;            // target of request, base of search
+    LDAPMod **mods;
+    const char *new_rdn;
+    const char *new_parent;
+    bool delete_original;
+    int scope;
+    const char *filter;
+    char **attrs;
+    bool attrsonly;
+    LDAPControl **controls;    // can be NULL
+} entry_request_t;
+
+/**
+ * @brief entry_send     Sends request to the server with controls of connection, such as Proxied Authorization.
+ * @param[in] connection Connection to work with.
+ * @param[in] request    Request to send.
+ * @param[out] msgid     Message id of request.
+ * @return
+ *        - LDAP_SUCCESS on success.
+ *        - LDAP error code on failure.
+ */
+static int entry_send(struct ldap_connection_ctx_t *connection, const entry_request_t *request, int *msgid)
+{
+    LDAPControl *request_controls[CONNECTION_MAX_CONTROLS];
+    if (connection_request_controls(connection, request->controls, request_controls) != RETURN_CODE_SUCCESS)
+    {
+        return LDAP_PARAM_ERROR;
+    }
+
+    switch (request->type)
+    {
+    case LDAP_REQ_ADD:
+        return ldap_add_ext(connection->ldap, request->dn, request->mods, request_controls, NULL, msgid);
+    case LDAP_REQ_MODIFY:
+        return ldap_modify_ext(connection->ldap, request->dn, request->mods, request_controls, NULL, msgid);
+    case LDAP_REQ_DELETE:
+        return ldap_delete_ext(connection->ldap, request->dn, request_controls, NULL, msgid);
+    case LDAP_REQ_MODDN:
+        return ldap_rename(connection->ldap, request->dn, request->new_rdn, request->new_parent,
+                           request->delete_original, request_controls, NULL, msgid);
+    case LDAP_REQ_SEARCH:
+        return ldap_search_ext(connection->ldap, request->dn, request->scope, request->filter, request->attrs,
+                               request->attrsonly, request_controls, NULL, NULL, LDAP_NO_LIMIT, msgid);
+    default:
+        return LDAP_PARAM_ERROR;
+    }
+}
+
 /**
  * @brief add This function wraps ldap_add_ext function associating it with connection.
  * @param[in] connection Connection to work with.
@@ -36,22 +333,41 @@
  * @return
  *        - RETURN_CODE_SUCCESS on success.
  *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
  */
 enum OperationReturnCode add(struct ldap_connection_ctx_t* connection, const char *dn, LDAPMod **attrs)
 {
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(dn);
+        if (!operation)
+        {
+            return RETURN_CODE_FAILURE;
+        }
+        operation->mods = entry_copy_mods(operation, attrs);
+
+        return connection_defer_request(connection, add_dispatch, operation);
+    }
+
+    entry_request_t request = { .type = LDAP_REQ_ADD, .dn = dn, .mods = attrs };
+
     int msgid = 0;
-    int rc = ldap_add_ext(connection->ldap, dn, attrs, NULL, NULL, &msgid);
+    int rc = entry_send(connection, &request, &msgid);
     if (rc != LDAP_SUCCESS)
     {
         ld_error("Unable to add entry: %s\n", ldap_err2string(rc));
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = add_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
+    if (connection_enqueue_request(connection, msgid, add_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
 
     return RETURN_CODE_SUCCESS;
 }
@@ -189,6 +505,7 @@ static enum OperationReturnCode print_search_callback(struct ldap_connection_ctx
  * @return
  *        - RETURN_CODE_SUCCESS on success.
  *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
  */
 enum OperationReturnCode search(struct ldap_connection_ctx_t *connection,
                                 const char *base_dn,
@@ -199,29 +516,75 @@ enum OperationReturnCode search(struct ldap_connection_ctx_t *connection,
                                 search_callback_fn search_callback,
                                 void* user_data)
 {
+    return search_ext(connection, base_dn, scope, filter, attrs, attrsonly, search_callback, NULL, user_data);
+}
+
+/**
+ * @brief search_ext Performs search like search function. When server returns an error or request is abandoned
+ * because its deadline expired search callback is not called, on_failure receives result code of the server or
+ * LDAP_TIMEOUT instead.
+ * @param[in] connection      Connection to work with.
+ * @param[in] base_dn         The dn of the entry at which to start the search.
+ * @param[in] scope           Scope of the search.
+ * @param[in] filter          Filter of the search.
+ * @param[in] attrs           Attributes to request, NULL terminated.
+ * @param[in] attrsonly       Request only attribute names.
+ * @param[in] search_callback Callback to receive entries.
+ * @param[in] on_failure      Callback to receive result code when search fails or is abandoned, can be NULL.
+ * @param[in] user_data       User data to pass to callbacks.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode search_ext(struct ldap_connection_ctx_t *connection,
+                                    const char *base_dn,
+                                    int scope,
+                                    const char *filter,
+                                    char **attrs,
+                                    bool attrsonly,
+                                    search_callback_fn search_callback,
+                                    result_callback_fn on_failure,
+                                    void* user_data)
+{
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(base_dn);
+        if (!operation)
+        {
+            return RETURN_CODE_FAILURE;
+        }
+        operation->scope = scope;
+        operation->filter = filter ? talloc_strdup(operation, filter) : NULL;
+        operation->attrs = entry_copy_strings(operation, attrs);
+        operation->attrsonly = attrsonly;
+        operation->search_callback = search_callback;
+        operation->result_callback = on_failure;
+        operation->user_data = user_data;
+
+        return connection_defer_request(connection, search_dispatch, operation);
+    }
+
+    entry_request_t request = { .type = LDAP_REQ_SEARCH, .dn = base_dn, .scope = scope, .filter = filter,
+                                .attrs = attrs, .attrsonly = attrsonly };
+
     int msgid = 0;
-    int rc = ldap_search_ext(connection->ldap,
-                    base_dn,
-                    scope,
-                    filter,
-                    attrs,
-                    attrsonly,
-                    NULL,
-                    NULL,
-                    NULL,
-                    LDAP_NO_LIMIT,
-                    &msgid);
+    int rc = entry_send(connection, &request, &msgid);
     if (rc != LDAP_SUCCESS)
     {
         ld_error("Unable to create search request: %s\n", ldap_err2string(rc));
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = search_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
+    if (connection_enqueue_request(connection, msgid, search_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
 
     if (connection->n_search_requests + 1 >= MAX_REQUESTS)
     {
@@ -233,6 +596,7 @@ enum OperationReturnCode search(struct ldap_connection_ctx_t *connection,
     struct ldap_search_request_t* search_request = &connection->search_requests[connection->n_search_requests];
     search_request->msgid = msgid;
     search_request->on_search_operation = search_callback ? search_callback : print_search_callback;
+    search_request->on_result_operation = on_failure;
     search_request->user_data = user_data;
     ++connection->n_search_requests;
 
@@ -263,6 +627,30 @@ void connection_remove_search_request(struct ldap_connection_ctx_t *connection,
     }
 }
 
+/**
+ * @brief search_result_code Returns result code of SearchResultDone message of the chain.
+ */
+static int search_result_code(LDAP *ldap, LDAPMessage *message)
+{
+    while (message && ldap_msgtype(message) != LDAP_RES_SEARCH_RESULT)
+    {
+        message = ldap_next_message(ldap, message);
+    }
+
+    int error_code = LDAP_SUCCESS;
+
+    if (message)
+    {
+        int rc = ldap_parse_result(ldap, message, &error_code, NULL, NULL, NULL, NULL, 0);
+        if (rc != LDAP_SUCCESS)
+        {
+            error_code = rc;
+        }
+    }
+
+    return error_code;
+}
+
 /**
  * @brief search_on_read This callback called upon complition of ldap search operation.
  * @param[in] rc         Return code of ldap_result.
@@ -296,6 +684,22 @@ enum OperationReturnCode search_on_read(int rc, LDAPMessage *message, struct lda
                     return RETURN_CODE_FAILURE;
                 }
 
+                // Searches which handle failures receive result code of the server instead of partial entries.
+                int result_code = search_result_code(connection->ldap, message);
+                if (result_code != LDAP_SUCCESS && connection->search_requests[i].on_result_operation)
+                {
+                    result_callback_fn on_failure = connection->search_requests[i].on_result_operation;
+                    void *user_data = connection->search_requests[i].user_data;
+
+                    ld_error("search_on_read - search failed: %s\n", ldap_err2string(result_code));
+
+                    connection_remove_search_request(connection, i);
+
+                    on_failure(connection, result_code, user_data);
+
+                    return RETURN_CODE_SUCCESS;
+                }
+
                 const int INITIAL_ARRAY_SIZE = 256;
 
                 ld_info("Handle %d\n", connection->handle);
@@ -365,164 +769,1045 @@ enum OperationReturnCode search_on_read(int rc, LDAPMessage *message, struct lda
                     };
                     ber_free(ber_element, 0);
 
-                    message = ldap_next_message(connection->ldap, message);
+                    message = ldap_next_message(connection->ldap, message);
+
+                    entry_index++;
+                }
+
+                entries[entry_index] = NULL;
+
+                int rc = connection->search_requests[i].on_search_operation(connection, entries, connection->search_requests[i].user_data);
+
+                connection_remove_search_request(connection, i);
+
+                return rc;
+            }
+        }
+    }
+        break;
+    case LDAP_RES_SEARCH_REFERENCE:
+        ld_info("Received search referral but not following it!");
+        return RETURN_CODE_SUCCESS;
+    default:
+    {
+        ldap_get_option(connection->ldap, LDAP_OPT_RESULT_CODE, (void*)&error_code);
+        ldap_get_option(connection->ldap, LDAP_OPT_DIAGNOSTIC_MESSAGE, (void*)&diagnostic_message);
+        ld_error("ldap_result failed: %s\n", diagnostic_message);
+        ldap_memfree(diagnostic_message);
+    }
+        break;
+    }
+
+    if (connection->on_error_operation)
+    {
+        connection->on_error_operation(rc, message, connection);
+    }
+
+    return RETURN_CODE_FAILURE;
+}
+
+/*!
+ * @brief paged_search_t - State of paged search carried between pages.
+ */
+typedef struct paged_search_s
+{
+    char *base_dn;                           //!< Base of the search.
+    int scope;                               //!< Scope of the search.
+    char *filter;                            //!< Filter of the search.
+    char **attrs;                            //!< Attributes to request.
+    int page_size;                           //!< Number of entries server returns at once.
+    struct berval *cookie;                   //!< Cookie of the next page, NULL before first page.
+    connection_identity_t identity;          //!< Identity and priority class every page is requested with.
+
+    ld_entry_t **entries;                    //!< Entries of all received pages, NULL terminated.
+    int n_entries;                           //!< Number of received entries.
+
+    search_callback_fn search_callback;      //!< Callback to call once all pages are received.
+    result_callback_fn on_failure;           //!< Callback to receive result code when search fails, can be NULL.
+    void *user_data;                         //!< User data of the search.
+} paged_search_t;
+
+static int paged_search_destructor(paged_search_t *paged)
+{
+    if (paged->cookie)
+    {
+        ber_bvfree(paged->cookie);
+        paged->cookie = NULL;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief search_entry_from_message Converts search entry message into ld_entry_t.
+ * @param[in] ctx        Memory context to allocate entry on.
+ * @param[in] connection Connection message was received on.
+ * @param[in] message    Message of LDAP_RES_SEARCH_ENTRY type.
+ * @return
+ *        - NULL on failure.
+ *        - ld_entry_t* on success.
+ */
+static ld_entry_t *search_entry_from_message(TALLOC_CTX *ctx, struct ldap_connection_ctx_t *connection,
+                                             LDAPMessage *message)
+{
+    BerElement *ber_element = NULL;
+
+    char *dn = ldap_get_dn(connection->ldap, message);
+    ld_entry_t *entry = ld_entry_new(ctx, dn);
+    ldap_memfree(dn);
+
+    if (!entry)
+    {
+        return NULL;
+    }
+
+    for (char *attribute = ldap_first_attribute(connection->ldap, message, &ber_element);
+         attribute != NULL;
+         attribute = ldap_next_attribute(connection->ldap, message, ber_element))
+    {
+        struct berval **values = ldap_get_values_len(connection->ldap, message, attribute);
+        int values_count = ldap_count_values_len(values);
+
+        LDAPAttribute_t *ld_attribute = talloc_zero(entry, LDAPAttribute_t);
+        ld_attribute->name = talloc_strdup(ld_attribute, attribute);
+        ld_attribute->values = talloc_array(ld_attribute, char*, values_count + 1);
+
+        // Value keeps its length as size of the allocation, so binary values with zero bytes are not truncated.
+        for (int i = 0; i < values_count; ++i)
+        {
+            char *value = talloc_size(ld_attribute, values[i]->bv_len + 1);
+            if (value)
+            {
+                memcpy(value, values[i]->bv_val, values[i]->bv_len);
+                value[values[i]->bv_len] = '\0';
+            }
+            ld_attribute->values[i] = value;
+        }
+        ld_attribute->values[values_count] = NULL;
+
+        ldap_value_free_len(values);
+        ldap_memfree(attribute);
+
+        ld_entry_add_attribute(entry, ld_attribute);
+    }
+    ber_free(ber_element, 0);
+
+    return entry;
+}
+
+/**
+ * @brief search_paged_fail Releases state of paged search and passes result code to the caller.
+ * @param[in] connection  Connection to work with.
+ * @param[in] paged       State of the search.
+ * @param[in] result_code Result code to report.
+ */
+static void search_paged_fail(struct ldap_connection_ctx_t *connection, paged_search_t *paged, int result_code)
+{
+    result_callback_fn on_failure = paged->on_failure;
+    void *user_data = paged->user_data;
+
+    talloc_free(paged);
+
+    if (on_failure)
+    {
+        on_failure(connection, result_code, user_data);
+    }
+}
+
+/**
+ * @brief search_paged_on_abandon This callback is called when current page request is abandoned.
+ * @param[in] connection  Connection to work with.
+ * @param[in] result_code Reason of abandon, e.g. LDAP_TIMEOUT.
+ * @param[in] user_data   State of the search.
+ */
+static void search_paged_on_abandon(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    search_paged_fail(connection, talloc_get_type_abort(user_data, paged_search_t), result_code);
+}
+
+/**
+ * @brief search_paged_request Sends request for the next page of paged search.
+ * @param[in] connection Connection to work with.
+ * @param[in] paged      State of the search.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+static enum OperationReturnCode search_paged_request(struct ldap_connection_ctx_t *connection, paged_search_t *paged)
+{
+    LDAPControl *page_control = NULL;
+    int msgid = 0;
+
+    int rc = ldap_create_page_control(connection->ldap, paged->page_size, paged->cookie, 0, &page_control);
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_error("Unable to create paged results control: %s\n", ldap_err2string(rc));
+        return RETURN_CODE_FAILURE;
+    }
+
+    LDAPControl *server_controls[] = { page_control, NULL };
+    entry_request_t request = { .type = LDAP_REQ_SEARCH, .dn = paged->base_dn, .scope = paged->scope,
+                                .filter = paged->filter, .attrs = paged->attrs, .controls = server_controls };
+
+    rc = entry_send(connection, &request, &msgid);
+    ldap_control_free(page_control);
+
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_error("Unable to create paged search request: %s\n", ldap_err2string(rc));
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (connection->n_search_requests + 1 >= MAX_REQUESTS)
+    {
+        ld_error("Maximum amount of search requests exceeded for connection %d.\n", connection);
+        ldap_abandon_ext(connection->ldap, msgid, NULL, NULL);
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (connection_enqueue_request(connection, msgid, search_paged_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    // Search request table maps message id of the current page to the state of the search.
+    struct ldap_search_request_t* search_request = &connection->search_requests[connection->n_search_requests];
+    search_request->msgid = msgid;
+    search_request->on_search_operation = paged->search_callback;
+    search_request->on_result_operation = search_paged_on_abandon;
+    search_request->user_data = paged;
+    ++connection->n_search_requests;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief search_paged Performs search using Simple Paged Results control (RFC 2696). Server returns entries in
+ * pages of page_size, so large result sets do not exceed server size limits. Callback is called once with
+ * entries of all pages.
+ * @param[in] connection        Connection to work with.
+ * @param[in] base_dn           The dn of the entry at which to start the search.
+ * @param[in] scope             The scope of the search.
+ * @param[in] filter            A string representation of the filter to apply in the search.
+ * @param[in] attrs             Attributes to return, pass only attributes you need to reduce size of the result.
+ * @param[in] page_size         Number of entries in one page.
+ * @param[in] search_callback   A callback function on search operation.
+ * @param[in] user_data         An output parameter for returning data after a search.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode search_paged(struct ldap_connection_ctx_t *connection,
+                                      const char *base_dn,
+                                      int scope,
+                                      const char *filter,
+                                      char **attrs,
+                                      int page_size,
+                                      search_callback_fn search_callback,
+                                      void* user_data)
+{
+    return search_paged_ext(connection, base_dn, scope, filter, attrs, page_size, search_callback, NULL, user_data);
+}
+
+/**
+ * @brief search_paged_ext Performs paged search like search_paged function. When server fails the search or request
+ * is abandoned search callback is not called, on_failure receives result code instead and state of the search
+ * is released.
+ * @param[in] connection        Connection to work with.
+ * @param[in] base_dn           The dn of the entry at which to start the search.
+ * @param[in] scope             The scope of the search.
+ * @param[in] filter            A string representation of the filter to apply in the search.
+ * @param[in] attrs             Attributes to return, pass only attributes you need to reduce size of the result.
+ * @param[in] page_size         Number of entries in one page.
+ * @param[in] search_callback   A callback function on search operation.
+ * @param[in] on_failure        Callback to receive result code when search fails, can be NULL.
+ * @param[in] user_data         An output parameter for returning data after a search.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode search_paged_ext(struct ldap_connection_ctx_t *connection,
+                                          const char *base_dn,
+                                          int scope,
+                                          const char *filter,
+                                          char **attrs,
+                                          int page_size,
+                                          search_callback_fn search_callback,
+                                          result_callback_fn on_failure,
+                                          void* user_data)
+{
+    if (!search_callback || page_size <= 0)
+    {
+        ld_error("search_paged - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(base_dn);
+        if (!operation)
+        {
+            return RETURN_CODE_FAILURE;
+        }
+        operation->scope = scope;
+        operation->filter = filter ? talloc_strdup(operation, filter) : NULL;
+        operation->attrs = entry_copy_strings(operation, attrs);
+        operation->page_size = page_size;
+        operation->search_callback = search_callback;
+        operation->result_callback = on_failure;
+        operation->user_data = user_data;
+
+        return connection_defer_request(connection, search_paged_dispatch, operation);
+    }
+
+    paged_search_t *paged = talloc_zero(connection->handle->talloc_ctx, paged_search_t);
+    if (!paged)
+    {
+        ld_error("search_paged - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+    talloc_set_destructor(paged, paged_search_destructor);
+
+    paged->base_dn = talloc_strdup(paged, base_dn ? base_dn : "");
+    paged->scope = scope;
+    paged->filter = filter ? talloc_strdup(paged, filter) : NULL;
+    paged->attrs = entry_copy_strings(paged, attrs);
+    paged->page_size = page_size;
+    paged->search_callback = search_callback;
+    paged->on_failure = on_failure;
+    paged->user_data = user_data;
+    paged->entries = talloc_array(paged, ld_entry_t*, 1);
+    paged->entries[0] = NULL;
+
+    if (connection_save_identity(paged, connection, &paged->identity) != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(paged);
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (search_paged_request(connection, paged) != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(paged);
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief search_paged_on_read This callback is called when page of paged search is received.
+ * @param[in] rc         Return code of ldap_result.
+ * @param[in] message    Message received from ldap.
+ * @param[in] connection Connection to work with.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode search_paged_on_read(int rc, LDAPMessage *message, struct ldap_connection_ctx_t *connection)
+{
+    if (!message)
+    {
+        // Request was abandoned, search is released and its caller notified by search_paged_on_abandon.
+        return RETURN_CODE_FAILURE;
+    }
+
+    int msgid = ldap_msgid(message);
+    int result_code = LDAP_OTHER;
+    paged_search_t *paged = NULL;
+
+    for (int i = 0; i < connection->n_search_requests; ++i)
+    {
+        if (connection->search_requests[i].msgid == msgid)
+        {
+            paged = connection->search_requests[i].user_data;
+            connection_remove_search_request(connection, i);
+            break;
+        }
+    }
+
+    if (!paged)
+    {
+        ld_error("search_paged_on_read - unknown request #%d!\n", msgid);
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (rc != LDAP_RES_SEARCH_ENTRY && rc != LDAP_RES_SEARCH_RESULT && rc != LDAP_RES_SEARCH_REFERENCE)
+    {
+        ld_error("search_paged_on_read - unexpected result type %d!\n", rc);
+        goto error_exit;
+    }
+
+    int n_page_entries = ldap_count_entries(connection->ldap, message);
+    if (n_page_entries > 0)
+    {
+        ld_entry_t **entries = talloc_realloc(paged, paged->entries, ld_entry_t*, paged->n_entries + n_page_entries + 1);
+        if (!entries)
+        {
+            ld_error("search_paged_on_read - out of memory!\n");
+            result_code = LDAP_NO_MEMORY;
+            goto error_exit;
+        }
+        paged->entries = entries;
+
+        for (LDAPMessage *entry = ldap_first_entry(connection->ldap, message);
+             entry != NULL;
+             entry = ldap_next_entry(connection->ldap, entry))
+        {
+            ld_entry_t *ld_entry = search_entry_from_message(paged->entries, connection, entry);
+            if (ld_entry)
+            {
+                paged->entries[paged->n_entries++] = ld_entry;
+            }
+        }
+        paged->entries[paged->n_entries] = NULL;
+    }
+
+    LDAPMessage *result = message;
+    while (result && ldap_msgtype(result) != LDAP_RES_SEARCH_RESULT)
+    {
+        result = ldap_next_message(connection->ldap, result);
+    }
+
+    if (!result)
+    {
+        ld_error("search_paged_on_read - search result is missing!\n");
+        goto error_exit;
+    }
+
+    int error_code = LDAP_SUCCESS;
+    LDAPControl **server_controls = NULL;
+
+    rc = ldap_parse_result(connection->ldap, result, &error_code, NULL, NULL, NULL, &server_controls, 0);
+    if (rc != LDAP_SUCCESS || error_code != LDAP_SUCCESS)
+    {
+        result_code = rc != LDAP_SUCCESS ? rc : error_code;
+        ld_error("search_paged_on_read - search failed: %s\n", ldap_err2string(result_code));
+        ldap_controls_free(server_controls);
+        goto error_exit;
+    }
+
+    struct berval cookie = { 0, NULL };
+    ber_int_t estimate = 0;
+    LDAPControl *page_control = ldap_control_find(LDAP_CONTROL_PAGEDRESULTS, server_controls, NULL);
+
+    if (page_control && ldap_parse_pageresponse_control(connection->ldap, page_control, &estimate, &cookie) == LDAP_SUCCESS)
+    {
+        if (paged->cookie)
+        {
+            ber_bvfree(paged->cookie);
+            paged->cookie = NULL;
+        }
+
+        if (cookie.bv_len > 0)
+        {
+            paged->cookie = ber_bvdup(&cookie);
+        }
+
+        ber_memfree(cookie.bv_val);
+    }
+    else if (paged->cookie)
+    {
+        ber_bvfree(paged->cookie);
+        paged->cookie = NULL;
+    }
+    ldap_controls_free(server_controls);
+
+    if (paged->cookie)
+    {
+        // Identity of the connection may have changed since search was started.
+        connection_identity_t previous_identity;
+        connection_apply_identity(connection, &paged->identity, &previous_identity);
+
+        rc = search_paged_request(connection, paged);
+
+        connection_apply_identity(connection, &previous_identity, NULL);
+
+        if (rc != RETURN_CODE_SUCCESS)
+        {
+            goto error_exit;
+        }
+
+        return RETURN_CODE_SUCCESS;
+    }
+
+    rc = paged->search_callback(connection, paged->entries, paged->user_data);
+
+    talloc_free(paged);
+
+    return rc;
+
+    error_exit:
+        search_paged_fail(connection, paged, result_code);
+
+        if (connection->on_error_operation)
+        {
+            connection->on_error_operation(rc, message, connection);
+        }
+
+        return RETURN_CODE_FAILURE;
+}
+
+/**
+ * @brief ld_entry_get_first_value Returns first value of the attribute, attribute name is case insensitive.
+ * @param[in] entry Entry to use.
+ * @param[in] name  Name of the attribute.
+ * @return
+ *        - NULL if entry has no such attribute.
+ *        - value of the attribute.
+ */
+const char *ld_entry_get_first_value(ld_entry_t *entry, const char *name)
+{
+    if (!entry || !entry->attributes || !name)
+    {
+        return NULL;
+    }
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, entry->attributes);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        LDAPAttribute_t *attribute = value;
+
+        if (strcasecmp(key, name) == 0 && attribute && attribute->values)
+        {
+            return attribute->values[0];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief modify This function wraps ldap_modify_ext.
+ * @param[in] connection Connection to work with.
+ * @param[in] dn         The name of the entry to modify. If NULL, a zero length DN is sent to the server.
+
+ * @param[in] attrs      A NULL-terminated array of modifications to make to the entry.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode modify(struct ldap_connection_ctx_t* connection, const char *dn, LDAPMod **attrs)
+{
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(dn);
+        if (!operation)
+        {
+            return RETURN_CODE_FAILURE;
+        }
+        operation->mods = entry_copy_mods(operation, attrs);
+
+        return connection_defer_request(connection, modify_dispatch, operation);
+    }
+
+    entry_request_t request = { .type = LDAP_REQ_MODIFY, .dn = dn, .mods = attrs };
+
+    int msgid = 0;
+    int rc = entry_send(connection, &request, &msgid);
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_error("Unable to create modify request: %s\n", ldap_err2string(rc));
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (connection_enqueue_request(connection, msgid, modify_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief modify_on_read This callback called upon complition of ldap modify operation.
+ * @param rc             Return code of ldap_result.
+ * @param message        Message received from ldap.
+ * @param connection     Connection to work with.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode modify_on_read(int rc, LDAPMessage *message, struct ldap_connection_ctx_t *connection)
+{
+    int error_code = LDAP_SUCCESS;
+    char *diagnostic_message = NULL;
+
+    switch (rc)
+    {
+    case LDAP_RES_MODIFY:
+    {
+        char *dn = NULL;
+
+        ldap_parse_result(connection->ldap, message, &error_code, &dn, &diagnostic_message, NULL, NULL, false);
+        ld_info("ldap_result: %s %s %d\n", diagnostic_message, ldap_err2string(error_code), error_code);
+        ldap_memfree(diagnostic_message);
+        ldap_memfree(dn);
+
+        switch (error_code)
+        {
+        case LDAP_SUCCESS:
+            return RETURN_CODE_SUCCESS;
+
+        default:
+            if (connection->on_error_operation)
+            {
+                connection->on_error_operation(rc, message, connection);
+            }
+
+            return RETURN_CODE_FAILURE;
+        }
+    }
+        break;
+    default:
+    {
+        ldap_get_option(connection->ldap, LDAP_OPT_RESULT_CODE, (void*)&error_code);
+        ldap_get_option(connection->ldap, LDAP_OPT_DIAGNOSTIC_MESSAGE, (void*)&diagnostic_message);
+        ld_error("ldap_result failed: %s\n", diagnostic_message);
+        ldap_memfree(diagnostic_message);
+    }
+        break;
+    }
+
+    if (connection->on_error_operation)
+    {
+        connection->on_error_operation(rc, message, connection);
+    }
+
+    return RETURN_CODE_FAILURE;
+}
+
+/**
+ * @brief ld_delete Function wraps ldap_delete_ext.
+ * @param[in] connection Connection to work with.
+ * @param[in] dn         The name of the entry to delete.  If NULL, a zero length DN is sent to the server.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode ld_delete(struct ldap_connection_ctx_t* connection, const char *dn)
+{
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(dn);
+        if (!operation)
+        {
+            return RETURN_CODE_FAILURE;
+        }
+
+        return connection_defer_request(connection, delete_dispatch, operation);
+    }
+
+    entry_request_t request = { .type = LDAP_REQ_DELETE, .dn = dn };
+
+    int msgid = 0;
+    int rc = entry_send(connection, &request, &msgid);
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_error("Unable to create modify request: %s\n", ldap_err2string(rc));
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (connection_enqueue_request(connection, msgid, delete_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief entry_track_request Registers callback which receives result code of update operation.
+ * @param[in] connection Connection to work with.
+ * @param[in] msgid      Message id of the operation.
+ * @param[in] on_result   Callback to call with result code.
+ * @param[in] on_extended Callback to call with result code and response value of extended operation.
+ * @param[in] user_data   User data to pass to callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+static enum OperationReturnCode entry_track_request(struct ldap_connection_ctx_t *connection, int msgid,
+                                                    result_callback_fn on_result, extended_callback_fn on_extended,
+                                                    void *user_data)
+{
+    if (connection->n_search_requests + 1 >= MAX_REQUESTS)
+    {
+        ld_error("Maximum amount of tracked requests exceeded for connection %d.\n", connection);
+        ldap_abandon_ext(connection->ldap, msgid, NULL, NULL);
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (connection_enqueue_request(connection, msgid, tracked_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    struct ldap_search_request_t* request = &connection->search_requests[connection->n_search_requests];
+    request->msgid = msgid;
+    request->on_search_operation = NULL;
+    request->on_result_operation = on_result;
+    request->on_extended_operation = on_extended;
+    request->user_data = user_data;
+    ++connection->n_search_requests;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief tracked_on_read This callback passes result code of tracked operation to its callback.
+ * @param[in] rc         Return code of ldap_result.
+ * @param[in] message    Message received from ldap.
+ * @param[in] connection Connection to work with.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode tracked_on_read(int rc, LDAPMessage *message, struct ldap_connection_ctx_t *connection)
+{
+    if (!message)
+    {
+        // Request was abandoned, callback is notified by connection.
+        return RETURN_CODE_FAILURE;
+    }
+
+    int msgid = ldap_msgid(message);
+    struct ldap_search_request_t request = { 0 };
+
+    for (int i = 0; i < connection->n_search_requests; ++i)
+    {
+        if (connection->search_requests[i].msgid == msgid)
+        {
+            request = connection->search_requests[i];
+            connection_remove_search_request(connection, i);
+            break;
+        }
+    }
+
+    int error_code = LDAP_OTHER;
+    char *diagnostic_message = NULL;
+    struct berval *data = NULL;
+
+    switch (rc)
+    {
+    case LDAP_RES_ADD:
+    case LDAP_RES_DELETE:
+    case LDAP_RES_MODIFY:
+    case LDAP_RES_MODDN:
+        ldap_parse_result(connection->ldap, message, &error_code, NULL, &diagnostic_message, NULL, NULL, false);
+        ld_info("ldap_result: %s %s %d\n", diagnostic_message, ldap_err2string(error_code), error_code);
+        ldap_memfree(diagnostic_message);
+        break;
+    case LDAP_RES_EXTENDED:
+        ldap_parse_result(connection->ldap, message, &error_code, NULL, &diagnostic_message, NULL, NULL, false);
+        ldap_parse_extended_result(connection->ldap, message, NULL, &data, false);
+        ld_info("ldap_result: %s %s %d\n", diagnostic_message, ldap_err2string(error_code), error_code);
+        ldap_memfree(diagnostic_message);
+        break;
+    default:
+        ld_error("tracked_on_read - unexpected result type %d!\n", rc);
+        break;
+    }
+
+    if (error_code != LDAP_SUCCESS && connection->on_error_operation)
+    {
+        connection->on_error_operation(rc, message, connection);
+    }
+
+    if (request.on_result_operation)
+    {
+        request.on_result_operation(connection, error_code, request.user_data);
+    }
 
-                    entry_index++;
-                }
+    if (request.on_extended_operation)
+    {
+        request.on_extended_operation(connection, error_code, data, request.user_data);
+    }
 
-                entries[entry_index] = NULL;
+    ber_bvfree(data);
 
-                int rc = connection->search_requests[i].on_search_operation(connection, entries, connection->search_requests[i].user_data);
+    return error_code == LDAP_SUCCESS ? RETURN_CODE_SUCCESS : RETURN_CODE_FAILURE;
+}
 
-                connection_remove_search_request(connection, i);
+/**
+ * @brief delete_ext Deletes entry with server controls and reports result code of the operation to callback.
+ * @param[in] connection      Connection to work with.
+ * @param[in] dn              The name of the entry to delete.
+ * @param[in] server_controls Server controls to send, can be NULL.
+ * @param[in] on_result       Callback to receive result code, called for timed out requests too.
+ * @param[in] user_data       User data to pass to callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode delete_ext(struct ldap_connection_ctx_t* connection, const char *dn,
+                                    LDAPControl **server_controls, result_callback_fn on_result, void *user_data)
+{
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
 
-                return rc;
-            }
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(dn);
+        if (!operation || !entry_operation_set_controls(operation, server_controls))
+        {
+            talloc_free(operation);
+            return RETURN_CODE_FAILURE;
         }
+        operation->result_callback = on_result;
+        operation->user_data = user_data;
+
+        return connection_defer_request(connection, delete_ext_dispatch, operation);
     }
-        break;
-    case LDAP_RES_SEARCH_REFERENCE:
-        ld_info("Received search referral but not following it!");
-        return RETURN_CODE_SUCCESS;
-    default:
+
+    entry_request_t request = { .type = LDAP_REQ_DELETE, .dn = dn, .controls = server_controls };
+
+    int msgid = 0;
+    int rc = entry_send(connection, &request, &msgid);
+    if (rc != LDAP_SUCCESS)
     {
-        ldap_get_option(connection->ldap, LDAP_OPT_RESULT_CODE, (void*)&error_code);
-        ldap_get_option(connection->ldap, LDAP_OPT_DIAGNOSTIC_MESSAGE, (void*)&diagnostic_message);
-        ld_error("ldap_result failed: %s\n", diagnostic_message);
-        ldap_memfree(diagnostic_message);
+        ld_error("Unable to create delete request: %s\n", ldap_err2string(rc));
+        return RETURN_CODE_FAILURE;
     }
-        break;
+
+    return entry_track_request(connection, msgid, on_result, NULL, user_data);
+}
+
+/**
+ * @brief add_ext Adds entry and reports result code of the operation to callback.
+ * @param[in] connection      Connection to work with.
+ * @param[in] dn              Dn of the entry to add.
+ * @param[in] attrs           Attributes of the entry.
+ * @param[in] server_controls Server controls to send, can be NULL.
+ * @param[in] on_result       Callback to receive result code, called for timed out requests too.
+ * @param[in] user_data       User data to pass to callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode add_ext(struct ldap_connection_ctx_t* connection, const char *dn, LDAPMod **attrs,
+                                 LDAPControl **server_controls, result_callback_fn on_result, void *user_data)
+{
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
     }
 
-    if (connection->on_error_operation)
+    if (connection_should_defer(connection))
     {
-        connection->on_error_operation(rc, message, connection);
+        entry_operation_t *operation = entry_operation_new(dn);
+        if (!operation || !entry_operation_set_controls(operation, server_controls))
+        {
+            talloc_free(operation);
+            return RETURN_CODE_FAILURE;
+        }
+        operation->mods = entry_copy_mods(operation, attrs);
+        operation->result_callback = on_result;
+        operation->user_data = user_data;
+
+        return connection_defer_request(connection, add_ext_dispatch, operation);
     }
 
-    return RETURN_CODE_FAILURE;
+    entry_request_t request = { .type = LDAP_REQ_ADD, .dn = dn, .mods = attrs, .controls = server_controls };
+
+    int msgid = 0;
+    int rc = entry_send(connection, &request, &msgid);
+    if (rc != LDAP_SUCCESS)
+    {
+        ld_error("Unable to add entry: %s\n", ldap_err2string(rc));
+        return RETURN_CODE_FAILURE;
+    }
+
+    return entry_track_request(connection, msgid, on_result, NULL, user_data);
 }
 
 /**
- * @brief modify This function wraps ldap_modify_ext.
- * @param[in] connection Connection to work with.
- * @param[in] dn         The name of the entry to modify. If NULL, a zero length DN is sent to the server.
-
- * @param[in] attrs      A NULL-terminated array of modifications to make to the entry.
+ * @brief modify_ext Modifies entry and reports result code of the operation to callback.
+ * @param[in] connection      Connection to work with.
+ * @param[in] dn              Dn of the entry to modify.
+ * @param[in] mods            Modifications to apply.
+ * @param[in] server_controls Server controls to send, can be NULL.
+ * @param[in] on_result       Callback to receive result code, called for timed out requests too.
+ * @param[in] user_data       User data to pass to callback.
  * @return
  *        - RETURN_CODE_SUCCESS on success.
  *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
  */
-enum OperationReturnCode modify(struct ldap_connection_ctx_t* connection, const char *dn, LDAPMod **attrs)
+enum OperationReturnCode modify_ext(struct ldap_connection_ctx_t* connection, const char *dn, LDAPMod **mods,
+                                    LDAPControl **server_controls, result_callback_fn on_result, void *user_data)
 {
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(dn);
+        if (!operation || !entry_operation_set_controls(operation, server_controls))
+        {
+            talloc_free(operation);
+            return RETURN_CODE_FAILURE;
+        }
+        operation->mods = entry_copy_mods(operation, mods);
+        operation->result_callback = on_result;
+        operation->user_data = user_data;
+
+        return connection_defer_request(connection, modify_ext_dispatch, operation);
+    }
+
+    entry_request_t request = { .type = LDAP_REQ_MODIFY, .dn = dn, .mods = mods, .controls = server_controls };
+
     int msgid = 0;
-    int rc = ldap_modify_ext(connection->ldap,
-                             dn,
-                             attrs,
-                             NULL,
-                             NULL,
-                             &msgid);
+    int rc = entry_send(connection, &request, &msgid);
     if (rc != LDAP_SUCCESS)
     {
         ld_error("Unable to create modify request: %s\n", ldap_err2string(rc));
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = modify_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
-
-    return RETURN_CODE_SUCCESS;
+    return entry_track_request(connection, msgid, on_result, NULL, user_data);
 }
 
 /**
- * @brief modify_on_read This callback called upon complition of ldap modify operation.
- * @param rc             Return code of ldap_result.
- * @param message        Message received from ldap.
- * @param connection     Connection to work with.
+ * @brief extended_ext Performs extended operation and reports result code and response value to callback.
+ * @param[in] connection  Connection to work with.
+ * @param[in] oid         Request name of the operation.
+ * @param[in] data        Request value of the operation, can be NULL.
+ * @param[in] on_extended Callback to receive result code and response value, response value is released once
+ *                        callback returns. Called for timed out requests too.
+ * @param[in] user_data   User data to pass to callback.
  * @return
  *        - RETURN_CODE_SUCCESS on success.
  *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
  */
-enum OperationReturnCode modify_on_read(int rc, LDAPMessage *message, struct ldap_connection_ctx_t *connection)
+enum OperationReturnCode extended_ext(struct ldap_connection_ctx_t *connection, const char *oid,
+                                      struct berval *data, extended_callback_fn on_extended, void *user_data)
 {
-    int error_code = LDAP_SUCCESS;
-    char *diagnostic_message = NULL;
-
-    switch (rc)
-    {
-    case LDAP_RES_MODIFY:
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
     {
-        char *dn = NULL;
-
-        ldap_parse_result(connection->ldap, message, &error_code, &dn, &diagnostic_message, NULL, NULL, false);
-        ld_info("ldap_result: %s %s %d\n", diagnostic_message, ldap_err2string(error_code), error_code);
-        ldap_memfree(diagnostic_message);
-        ldap_memfree(dn);
+        return RETURN_CODE_WOULD_BLOCK;
+    }
 
-        switch (error_code)
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(NULL);
+        if (!operation || !(operation->oid = talloc_strdup(operation, oid)))
         {
-        case LDAP_SUCCESS:
-            return RETURN_CODE_SUCCESS;
+            talloc_free(operation);
+            return RETURN_CODE_FAILURE;
+        }
 
-        default:
-            if (connection->on_error_operation)
+        if (data)
+        {
+            operation->data = talloc_zero(operation, struct berval);
+            if (!operation->data
+                || (data->bv_len > 0 && !(operation->data->bv_val = talloc_memdup(operation, data->bv_val,
+                                                                                  data->bv_len))))
             {
-                connection->on_error_operation(rc, message, connection);
+                talloc_free(operation);
+                return RETURN_CODE_FAILURE;
             }
-
-            return RETURN_CODE_FAILURE;
+            operation->data->bv_len = data->bv_len;
         }
-    }
-        break;
-    default:
-    {
-        ldap_get_option(connection->ldap, LDAP_OPT_RESULT_CODE, (void*)&error_code);
-        ldap_get_option(connection->ldap, LDAP_OPT_DIAGNOSTIC_MESSAGE, (void*)&diagnostic_message);
-        ld_error("ldap_result failed: %s\n", diagnostic_message);
-        ldap_memfree(diagnostic_message);
-    }
-        break;
+
+        operation->extended_callback = on_extended;
+        operation->user_data = user_data;
+
+        return connection_defer_request(connection, extended_ext_dispatch, operation);
     }
 
-    if (connection->on_error_operation)
+    int msgid = 0;
+    int rc = ldap_extended_operation(connection->ldap, oid, data, NULL, NULL, &msgid);
+    if (rc != LDAP_SUCCESS)
     {
-        connection->on_error_operation(rc, message, connection);
+        ld_error("Unable to create extended request %s: %s\n", oid, ldap_err2string(rc));
+        return RETURN_CODE_FAILURE;
     }
 
-    return RETURN_CODE_FAILURE;
+    return entry_track_request(connection, msgid, NULL, on_extended, user_data);
 }
 
 /**
- * @brief ld_delete Function wraps ldap_delete_ext.
- * @param[in] connection Connection to work with.
- * @param[in] dn         The name of the entry to delete.  If NULL, a zero length DN is sent to the server.
+ * @brief rename_ext Renames or moves entry and reports result code of the operation to callback.
+ * @param[in] connection      Connection to work with.
+ * @param[in] olddn           Dn of the entry.
+ * @param[in] newrdn          New rdn of the entry.
+ * @param[in] new_parent      New parent of the entry, NULL to keep the entry in place.
+ * @param[in] delete_original Delete old rdn value.
+ * @param[in] server_controls Server controls to send, can be NULL.
+ * @param[in] on_result       Callback to receive result code, called for timed out requests too.
+ * @param[in] user_data       User data to pass to callback.
  * @return
  *        - RETURN_CODE_SUCCESS on success.
  *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
  */
-enum OperationReturnCode ld_delete(struct ldap_connection_ctx_t* connection, const char *dn)
+enum OperationReturnCode rename_ext(struct ldap_connection_ctx_t *connection, const char *olddn, const char *newrdn,
+                                    const char *new_parent, bool delete_original, LDAPControl **server_controls,
+                                    result_callback_fn on_result, void *user_data)
 {
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(olddn);
+        if (!operation || !entry_operation_set_controls(operation, server_controls))
+        {
+            talloc_free(operation);
+            return RETURN_CODE_FAILURE;
+        }
+        operation->new_dn = newrdn ? talloc_strdup(operation, newrdn) : NULL;
+        operation->new_parent = new_parent ? talloc_strdup(operation, new_parent) : NULL;
+        operation->delete_original = delete_original;
+        operation->result_callback = on_result;
+        operation->user_data = user_data;
+
+        return connection_defer_request(connection, rename_ext_dispatch, operation);
+    }
+
+    entry_request_t request = { .type = LDAP_REQ_MODDN, .dn = olddn, .new_rdn = newrdn, .new_parent = new_parent,
+                                .delete_original = delete_original, .controls = server_controls };
+
     int msgid = 0;
-    int rc = ldap_delete_ext(connection->ldap,
-                             dn,
-                             NULL,
-                             NULL,
-                             &msgid);
+    int rc = entry_send(connection, &request, &msgid);
     if (rc != LDAP_SUCCESS)
     {
-        ld_error("Unable to create modify request: %s\n", ldap_err2string(rc));
+        ld_error("Unable to create rename request: %s\n", ldap_err2string(rc));
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = delete_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
-
-    return RETURN_CODE_SUCCESS;
+    return entry_track_request(connection, msgid, on_result, NULL, user_data);
 }
 
 /**
@@ -588,6 +1873,16 @@ enum OperationReturnCode delete_on_read(int rc, LDAPMessage *message, struct lda
  */
 enum OperationReturnCode whoami(struct ldap_connection_ctx_t *connection)
 {
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        return connection_defer_request(connection, whoami_dispatch, NULL);
+    }
+
     int msgid = 0;
     int rc = ldap_whoami(connection->ldap, NULL, NULL, &msgid);
 
@@ -597,11 +1892,10 @@ enum OperationReturnCode whoami(struct ldap_connection_ctx_t *connection)
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = whoami_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
+    if (connection_enqueue_request(connection, msgid, whoami_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
 
     return RETURN_CODE_SUCCESS;
 }
@@ -651,19 +1945,35 @@ enum OperationReturnCode whoami_on_read(int rc, LDAPMessage *message, struct lda
  * @return
  *        - RETURN_CODE_SUCCESS on success.
  *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
  */
 enum OperationReturnCode ld_rename(struct ldap_connection_ctx_t *connection, const char *olddn,
                                    const char *newdn, const char* new_parent, bool delete_original)
 {
+    if (connection_admit_request(connection) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_WOULD_BLOCK;
+    }
+
+    if (connection_should_defer(connection))
+    {
+        entry_operation_t *operation = entry_operation_new(olddn);
+        if (!operation)
+        {
+            return RETURN_CODE_FAILURE;
+        }
+        operation->new_dn = newdn ? talloc_strdup(operation, newdn) : NULL;
+        operation->new_parent = new_parent ? talloc_strdup(operation, new_parent) : NULL;
+        operation->delete_original = delete_original;
+
+        return connection_defer_request(connection, rename_dispatch, operation);
+    }
+
+    entry_request_t request = { .type = LDAP_REQ_MODDN, .dn = olddn, .new_rdn = newdn, .new_parent = new_parent,
+                                .delete_original = delete_original };
+
     int msgid = 0;
-    int rc = ldap_rename(connection->ldap,
-                         olddn,
-                         newdn,
-                         new_parent,
-                         delete_original,
-                         NULL,
-                         NULL,
-                         &msgid);
+    int rc = entry_send(connection, &request, &msgid);
 
     if (rc != LDAP_SUCCESS)
     {
@@ -671,11 +1981,10 @@ enum OperationReturnCode ld_rename(struct ldap_connection_ctx_t *connection, con
         return RETURN_CODE_FAILURE;
     }
 
-    struct ldap_request_t* request = &connection->read_requests[connection->n_read_requests];
-    request->msgid = msgid;
-    request->on_read_operation = rename_on_read;
-    ++connection->n_read_requests;
-    request_queue_push(connection->callqueue, &request->node);
+    if (connection_enqueue_request(connection, msgid, rename_on_read) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
 
     return RETURN_CODE_SUCCESS;
 }
@@ -862,6 +2171,53 @@ LDAPAttribute_t *ld_entry_get_attribute(ld_entry_t* entry, const char *name_or_o
     return (LDAPAttribute_t *)g_hash_table_lookup(entry->attributes, name_or_oid);
 }
 
+/**
+ * @brief ld_entry_get_values_len Get values of the attribute with their lengths, values of entries received
+ *                                by paged search may contain zero bytes.
+ * @param[in] ctx                 Memory context to allocate array on.
+ * @param[in] entry               Entry to get attribute from.
+ * @param[in] name_or_oid         Name or OID of the attribute.
+ * @return
+ *        - NULL if entry has no such attribute.
+ *        - NULL terminated array of bervals referencing values stored in the entry.
+ */
+struct berval **ld_entry_get_values_len(TALLOC_CTX *ctx, ld_entry_t *entry, const char *name_or_oid)
+{
+    LDAPAttribute_t *attribute = ld_entry_get_attribute(entry, name_or_oid);
+    if (!attribute || !attribute->values)
+    {
+        return NULL;
+    }
+
+    int values_count = 0;
+    while (attribute->values[values_count])
+    {
+        ++values_count;
+    }
+
+    struct berval **result = talloc_zero_array(ctx, struct berval*, values_count + 1);
+    if (!result)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < values_count; ++i)
+    {
+        result[i] = talloc_zero(result, struct berval);
+        if (!result[i])
+        {
+            talloc_free(result);
+            return NULL;
+        }
+
+        // Values are allocated with terminating zero which is not part of the value.
+        result[i]->bv_val = attribute->values[i];
+        result[i]->bv_len = talloc_get_size(attribute->values[i]) - 1;
+    }
+
+    return result;
+}
+
 /**
  * @brief ld_entry_get_dn Get entry's dn;
  * @param[in] entry       Entry to use.
@@ -955,3 +2311,128 @@ LDAPAttribute_t **ld_entry_get_attributes(ld_entry_t *entry)
 
     return result;
 }
+
+/*!
+ * @brief entry_view_search_t - State of the search which converts entries into compact views.
+ */
+typedef struct entry_view_search_s
+{
+    LDHandle *handle;                        //!< Handle search was issued on.
+    int scope;                               //!< Scope of the search.
+    entry_view_fn view;                      //!< Converts entry into compact view.
+    entry_view_callback_fn callback;         //!< Callback to receive views.
+    void *user_data;                         //!< User data to pass to callback.
+} entry_view_search_t;
+
+static enum OperationReturnCode search_entry_views_callback(struct ldap_connection_ctx_t *connection,
+                                                            ld_entry_t **entries,
+                                                            void *user_data)
+{
+    entry_view_search_t *state = talloc_get_type_abort(user_data, entry_view_search_t);
+
+    int entries_count = 0;
+    while (entries && entries[entries_count])
+    {
+        ++entries_count;
+    }
+
+    void **views = talloc_array(state, void*, entries_count + 1);
+    if (!views)
+    {
+        ld_error("search_entry_views_callback - out of memory!\n");
+        state->callback(state->handle, LDAP_NO_MEMORY, NULL, state->user_data);
+        talloc_free(state);
+        return RETURN_CODE_FAILURE;
+    }
+
+    int views_count = 0;
+    for (int i = 0; i < entries_count; ++i)
+    {
+        void *view = state->view(views, connection->directory_type, entries[i]);
+        if (view)
+        {
+            views[views_count++] = view;
+        }
+    }
+    views[views_count] = NULL;
+
+    enum OperationReturnCode rc = RETURN_CODE_SUCCESS;
+
+    // Base object which exists but does not match the filter is not found as well.
+    if (views_count == 0 && state->scope == LDAP_SCOPE_BASE)
+    {
+        rc = state->callback(state->handle, LDAP_NO_SUCH_OBJECT, NULL, state->user_data);
+    }
+    else
+    {
+        rc = state->callback(state->handle, LDAP_SUCCESS, views, state->user_data);
+    }
+
+    talloc_free(state);
+
+    return rc;
+}
+
+static void search_entry_views_on_failure(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    entry_view_search_t *state = talloc_get_type_abort(user_data, entry_view_search_t);
+
+    state->callback(state->handle, result_code, NULL, state->user_data);
+
+    talloc_free(state);
+}
+
+/**
+ * @brief search_entry_views Performs paged search and passes found entries to the callback converted into compact
+ * views. Callback is called exactly once: with LDAP_SUCCESS and NULL terminated views, or with result code of
+ * the failure, LDAP_NO_SUCH_OBJECT when base object does not exist or does not match the filter.
+ * @param[in] handle    Pointer to libdomain session handle.
+ * @param[in] base_dn   The dn of the entry at which to start the search.
+ * @param[in] scope     The scope of the search.
+ * @param[in] filter    Filter which selects entries of the type.
+ * @param[in] attrs     Attributes to request from the server.
+ * @param[in] page_size Number of entries in one page.
+ * @param[in] view      Function which converts entry into compact view.
+ * @param[in] callback  Callback to receive views.
+ * @param[in] user_data User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure, callback is not called.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight, callback is not called.
+ */
+enum OperationReturnCode search_entry_views(LDHandle *handle, const char *base_dn, int scope, const char *filter,
+                                            char **attrs, int page_size, entry_view_fn view,
+                                            entry_view_callback_fn callback, void *user_data)
+{
+    if (!handle || !view || !callback || page_size <= 0)
+    {
+        ld_error("search_entry_views - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    entry_view_search_t *state = talloc_zero(handle->talloc_ctx, entry_view_search_t);
+    if (!state)
+    {
+        ld_error("search_entry_views - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    state->handle = handle;
+    state->scope = scope;
+    state->view = view;
+    state->callback = callback;
+    state->user_data = user_data;
+
+    enum OperationReturnCode rc = search_paged_ext(handle->connection_ctx, base_dn, scope, filter, attrs, page_size,
+                                                   search_entry_views_callback, search_entry_views_on_failure,
+                                                   state);
+
+    if (rc != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(state);
+    }
+
+    return rc;
+}
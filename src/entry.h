@@ -37,13 +37,70 @@ enum OperationReturnCode search(struct ldap_connection_ctx_t *connection,
                                 bool attrsonly,
                                 search_callback_fn search_callback,
                                 void *user_data);
+enum OperationReturnCode search_ext(struct ldap_connection_ctx_t *connection,
+                                    const char *base_dn,
+                                    int scope,
+                                    const char *filter,
+                                    char **attrs,
+                                    bool attrsonly,
+                                    search_callback_fn search_callback,
+                                    result_callback_fn on_failure,
+                                    void *user_data);
 enum OperationReturnCode search_on_read(int rc, LDAPMessage *message, struct ldap_connection_ctx_t *connection);
 
+enum OperationReturnCode search_paged(struct ldap_connection_ctx_t *connection,
+                                      const char *base_dn,
+                                      int scope,
+                                      const char *filter,
+                                      char **attrs,
+                                      int page_size,
+                                      search_callback_fn search_callback,
+                                      void *user_data);
+enum OperationReturnCode search_paged_ext(struct ldap_connection_ctx_t *connection,
+                                          const char *base_dn,
+                                          int scope,
+                                          const char *filter,
+                                          char **attrs,
+                                          int page_size,
+                                          search_callback_fn search_callback,
+                                          result_callback_fn on_failure,
+                                          void *user_data);
+enum OperationReturnCode search_paged_on_read(int rc, LDAPMessage *message, struct ldap_connection_ctx_t *connection);
+
 enum OperationReturnCode modify(struct ldap_connection_ctx_t *connection, const char *dn, LDAPMod **attrs);
 enum OperationReturnCode modify_on_read(int rc, LDAPMessage *message, ldap_connection_ctx_t *connection);
 
 enum OperationReturnCode ld_delete(struct ldap_connection_ctx_t* connection, const char *dn);
 enum OperationReturnCode delete_on_read(int rc, LDAPMessage *message, ldap_connection_ctx_t *connection);
+enum OperationReturnCode delete_ext(struct ldap_connection_ctx_t* connection, const char *dn,
+                                    LDAPControl **server_controls, result_callback_fn on_result, void *user_data);
+
+enum OperationReturnCode add_ext(struct ldap_connection_ctx_t* connection, const char *dn, LDAPMod **attrs,
+                                 LDAPControl **server_controls, result_callback_fn on_result, void *user_data);
+enum OperationReturnCode modify_ext(struct ldap_connection_ctx_t* connection, const char *dn, LDAPMod **mods,
+                                    LDAPControl **server_controls, result_callback_fn on_result, void *user_data);
+enum OperationReturnCode rename_ext(struct ldap_connection_ctx_t *connection, const char *olddn, const char *newrdn,
+                                    const char *new_parent, bool delete_original, LDAPControl **server_controls,
+                                    result_callback_fn on_result, void *user_data);
+enum OperationReturnCode extended_ext(struct ldap_connection_ctx_t *connection, const char *oid,
+                                      struct berval *data, extended_callback_fn on_extended, void *user_data);
+enum OperationReturnCode tracked_on_read(int rc, LDAPMessage *message, struct ldap_connection_ctx_t *connection);
+
+/*!
+ * @brief entry_view_fn Converts entry into compact view allocated on ctx. Returns NULL to skip the entry.
+ */
+typedef void *(*entry_view_fn)(TALLOC_CTX *ctx, int directory_type, ld_entry_t *entry);
+
+/*!
+ * @brief entry_view_callback_fn Callback which receives compact views of found entries. On failure result_code
+ * holds error returned by the server and views are NULL.
+ */
+typedef enum OperationReturnCode (*entry_view_callback_fn)(LDHandle *handle, int result_code, void **views,
+                                                           void *user_data);
+
+enum OperationReturnCode search_entry_views(LDHandle *handle, const char *base_dn, int scope, const char *filter,
+                                            char **attrs, int page_size, entry_view_fn view,
+                                            entry_view_callback_fn callback, void *user_data);
 
 enum OperationReturnCode ld_rename(struct ldap_connection_ctx_t *connection, const char *olddn, const char *newdn,
                                    const char *new_parent, bool delete_original);
@@ -52,10 +109,14 @@ enum OperationReturnCode rename_on_read(int rc, LDAPMessage *message, ldap_conne
 enum OperationReturnCode whoami(struct ldap_connection_ctx_t *connection);
 enum OperationReturnCode whoami_on_read(int rc, LDAPMessage *message, struct ldap_connection_ctx_t *connection);
 
+LDAPMod **entry_copy_mods(TALLOC_CTX *ctx, LDAPMod **mods);
+
 ld_entry_t *ld_entry_new(TALLOC_CTX* ctx, const char *dn);
 const char *ld_entry_get_dn(ld_entry_t *entry);
 enum OperationReturnCode ld_entry_add_attribute(ld_entry_t *entry, const LDAPAttribute_t* attr);
 LDAPAttribute_t *ld_entry_get_attribute(ld_entry_t *entry, const char* name_or_oid);
+struct berval **ld_entry_get_values_len(TALLOC_CTX *ctx, ld_entry_t *entry, const char *name_or_oid);
 LDAPAttribute_t **ld_entry_get_attributes(ld_entry_t *entry);
+const char *ld_entry_get_first_value(ld_entry_t *entry, const char *name);
 
 #endif //LIBDOMAIN_ENTRY_H
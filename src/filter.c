@@ -0,0 +1,1068 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "filter.h"
+
+#include <string.h>
+#include <strings.h>
+
+#define FILTER_MAX_DEPTH 64
+
+/*!
+ * @brief ld_filter_template_t - Filter pattern split into literal parts around value placeholders.
+ */
+struct ld_filter_template_s
+{
+    char **literals;                 //!< Literal parts, one more than number of placeholders.
+    size_t *literal_lengths;         //!< Lengths of literal parts.
+    int arity;                       //!< Number of placeholders.
+
+    char *buffer;                    //!< Buffer of ld_filter_template_format, reused between calls.
+    size_t buffer_size;              //!< Size of the buffer.
+};
+
+/*!
+ * @brief filter_parser_t - State of RFC 4515 filter parser.
+ */
+typedef struct filter_parser_s
+{
+    TALLOC_CTX *ctx;                 //!< Memory context to allocate nodes on.
+    const char *position;            //!< Current position in the filter string.
+} filter_parser_t;
+
+static bool filter_needs_escape(char c)
+{
+    return c == '*' || c == '(' || c == ')' || c == '\\';
+}
+
+/**
+ * @brief ld_filter_escape_value Escapes assertion value according to RFC 4515. Works like snprintf: writes at most
+ * size bytes including terminating NUL and returns length of the whole escaped value.
+ * @param[in]  value  Value to escape.
+ * @param[out] buffer Buffer to write escaped value to, can be NULL if size is 0.
+ * @param[in]  size   Size of the buffer.
+ * @return Length of escaped value without terminating NUL.
+ */
+size_t ld_filter_escape_value(const char *value, char *buffer, size_t size)
+{
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+
+    size_t length = 0;
+
+    for (const char *c = value ? value : ""; *c; ++c)
+    {
+        char escaped[3] = { *c, '\0', '\0' };
+        size_t escaped_length = 1;
+
+        if (filter_needs_escape(*c))
+        {
+            escaped[0] = '\\';
+            escaped[1] = HEX_DIGITS[((unsigned char)*c) >> 4];
+            escaped[2] = HEX_DIGITS[((unsigned char)*c) & 0x0f];
+            escaped_length = 3;
+        }
+
+        // Output is truncated the same way snprintf does it, so the buffer always holds a prefix of the result.
+        for (size_t i = 0; i < escaped_length; ++i, ++length)
+        {
+            if (length + 1 < size)
+            {
+                buffer[length] = escaped[i];
+            }
+        }
+    }
+
+    if (size > 0)
+    {
+        buffer[length < size ? length : size - 1] = '\0';
+    }
+
+    return length;
+}
+
+/**
+ * @brief ld_filter_escape Returns escaped copy of assertion value.
+ * @param[in] ctx   Memory context to allocate copy on.
+ * @param[in] value Value to escape.
+ * @return
+ *        - NULL on failure.
+ *        - escaped value.
+ */
+char *ld_filter_escape(TALLOC_CTX *ctx, const char *value)
+{
+    size_t length = ld_filter_escape_value(value, NULL, 0);
+
+    char *result = talloc_array(ctx, char, length + 1);
+    if (!result)
+    {
+        return NULL;
+    }
+
+    ld_filter_escape_value(value, result, length + 1);
+
+    return result;
+}
+
+static bool filter_is_alpha(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool filter_is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static int filter_hex_value(char c)
+{
+    if (filter_is_digit(c))
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief filter_parse_oid Parses descr or numericoid.
+ * @return
+ *        - false if there is no valid descr or numericoid at current position.
+ *        - true otherwise.
+ */
+static bool filter_parse_oid(filter_parser_t *parser)
+{
+    const char *c = parser->position;
+
+    if (filter_is_alpha(*c))
+    {
+        while (filter_is_alpha(*c) || filter_is_digit(*c) || *c == '-')
+        {
+            ++c;
+        }
+    }
+    else if (filter_is_digit(*c))
+    {
+        while (true)
+        {
+            if (!filter_is_digit(*c))
+            {
+                return false;
+            }
+            while (filter_is_digit(*c))
+            {
+                ++c;
+            }
+            if (*c != '.')
+            {
+                break;
+            }
+            ++c;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    parser->position = c;
+
+    return true;
+}
+
+/**
+ * @brief filter_parse_attribute Parses attribute description with options.
+ * @return
+ *        - NULL if there is no valid attribute description at current position.
+ *        - attribute description.
+ */
+static char *filter_parse_attribute(filter_parser_t *parser, TALLOC_CTX *ctx)
+{
+    const char *start = parser->position;
+
+    if (!filter_parse_oid(parser))
+    {
+        return NULL;
+    }
+
+    while (*parser->position == ';')
+    {
+        const char *option = ++parser->position;
+
+        while (filter_is_alpha(*parser->position) || filter_is_digit(*parser->position)
+               || *parser->position == '-')
+        {
+            ++parser->position;
+        }
+
+        if (parser->position == option)
+        {
+            return NULL;
+        }
+    }
+
+    return talloc_strndup(ctx, start, parser->position - start);
+}
+
+/**
+ * @brief filter_parse_value Parses and unescapes assertion value up to ')' or, if stop_at_asterisk is set, '*'.
+ * @return
+ *        - NULL if value contains invalid characters or escapes.
+ *        - unescaped value.
+ */
+static char *filter_parse_value(filter_parser_t *parser, TALLOC_CTX *ctx, bool stop_at_asterisk)
+{
+    const char *c = parser->position;
+    size_t length = 0;
+
+    while (*c && *c != ')' && !(stop_at_asterisk && *c == '*'))
+    {
+        if (*c == '(' || *c == '*')
+        {
+            return NULL;
+        }
+
+        if (*c == '\\')
+        {
+            if (filter_hex_value(c[1]) < 0 || filter_hex_value(c[2]) < 0)
+            {
+                return NULL;
+            }
+            c += 3;
+        }
+        else
+        {
+            ++c;
+        }
+
+        ++length;
+    }
+
+    char *value = talloc_array(ctx, char, length + 1);
+    if (!value)
+    {
+        return NULL;
+    }
+
+    size_t index = 0;
+    for (const char *v = parser->position; v < c; ++index)
+    {
+        if (*v == '\\')
+        {
+            value[index] = (char)(filter_hex_value(v[1]) << 4 | filter_hex_value(v[2]));
+            v += 3;
+        }
+        else
+        {
+            value[index] = *v++;
+        }
+    }
+    value[length] = '\0';
+
+    parser->position = c;
+
+    return value;
+}
+
+static ld_filter_t *filter_parse_filter(filter_parser_t *parser, TALLOC_CTX *ctx, int depth);
+
+/**
+ * @brief filter_parse_list Parses operands of AND and OR filters.
+ */
+static bool filter_parse_list(filter_parser_t *parser, ld_filter_t *node, int depth)
+{
+    int count = 0;
+
+    node->children = talloc_array(node, ld_filter_t*, 1);
+
+    while (node->children && *parser->position == '(')
+    {
+        ld_filter_t *child = filter_parse_filter(parser, node, depth + 1);
+        if (!child)
+        {
+            return false;
+        }
+
+        node->children = talloc_realloc(node, node->children, ld_filter_t*, count + 2);
+        if (!node->children)
+        {
+            return false;
+        }
+        node->children[count++] = child;
+    }
+
+    if (!node->children)
+    {
+        return false;
+    }
+    node->children[count] = NULL;
+
+    return true;
+}
+
+/**
+ * @brief filter_parse_extensible Parses extensible match, attribute is already parsed and can be NULL.
+ */
+static bool filter_parse_extensible(filter_parser_t *parser, ld_filter_t *node)
+{
+    node->type = LD_FILTER_EXTENSIBLE;
+
+    if (strncasecmp(parser->position, ":dn", 3) == 0 && parser->position[3] == ':')
+    {
+        node->dn_attributes = true;
+        parser->position += 3;
+    }
+
+    if (parser->position[0] == ':' && parser->position[1] != '=')
+    {
+        const char *start = ++parser->position;
+
+        if (!filter_parse_oid(parser))
+        {
+            return false;
+        }
+
+        node->matching_rule = talloc_strndup(node, start, parser->position - start);
+    }
+
+    if (parser->position[0] != ':' || parser->position[1] != '=')
+    {
+        return false;
+    }
+    parser->position += 2;
+
+    if (!node->attribute && !node->matching_rule)
+    {
+        return false;
+    }
+
+    node->value = filter_parse_value(parser, node, false);
+
+    return node->value != NULL;
+}
+
+/**
+ * @brief filter_parse_equality Parses equality, presence and substrings filters after '='.
+ */
+static bool filter_parse_equality(filter_parser_t *parser, ld_filter_t *node)
+{
+    char **parts = talloc_array(node, char*, 1);
+    int count = 0;
+
+    while (parts)
+    {
+        char *part = filter_parse_value(parser, parts, true);
+        if (!part)
+        {
+            return false;
+        }
+
+        parts = talloc_realloc(node, parts, char*, count + 2);
+        if (!parts)
+        {
+            return false;
+        }
+        parts[count++] = part;
+        parts[count] = NULL;
+
+        if (*parser->position != '*')
+        {
+            break;
+        }
+        ++parser->position;
+    }
+
+    if (!parts)
+    {
+        return false;
+    }
+
+    if (count == 1)
+    {
+        node->type = LD_FILTER_EQUALITY;
+        node->value = talloc_steal(node, parts[0]);
+    }
+    else if (count == 2 && parts[0][0] == '\0' && parts[1][0] == '\0')
+    {
+        node->type = LD_FILTER_PRESENT;
+    }
+    else
+    {
+        node->type = LD_FILTER_SUBSTRINGS;
+        node->initial = parts[0][0] ? talloc_steal(node, parts[0]) : NULL;
+        node->final = parts[count - 1][0] ? talloc_steal(node, parts[count - 1]) : NULL;
+
+        if (count > 2)
+        {
+            node->any = talloc_array(node, char*, count - 1);
+            if (!node->any)
+            {
+                return false;
+            }
+
+            for (int i = 1; i < count - 1; ++i)
+            {
+                // Middle parts must not be empty, "**" is not valid.
+                if (parts[i][0] == '\0')
+                {
+                    return false;
+                }
+                node->any[i - 1] = talloc_steal(node, parts[i]);
+            }
+            node->any[count - 2] = NULL;
+        }
+    }
+
+    talloc_free(parts);
+
+    return true;
+}
+
+/**
+ * @brief filter_parse_item Parses simple, presence, substrings and extensible filters.
+ */
+static bool filter_parse_item(filter_parser_t *parser, ld_filter_t *node)
+{
+    if (*parser->position == ':')
+    {
+        return filter_parse_extensible(parser, node);
+    }
+
+    node->attribute = filter_parse_attribute(parser, node);
+    if (!node->attribute)
+    {
+        return false;
+    }
+
+    const char *c = parser->position;
+
+    if (c[0] == '~' && c[1] == '=')
+    {
+        node->type = LD_FILTER_APPROX;
+    }
+    else if (c[0] == '>' && c[1] == '=')
+    {
+        node->type = LD_FILTER_GREATER_OR_EQUAL;
+    }
+    else if (c[0] == '<' && c[1] == '=')
+    {
+        node->type = LD_FILTER_LESS_OR_EQUAL;
+    }
+    else if (c[0] == ':')
+    {
+        return filter_parse_extensible(parser, node);
+    }
+    else if (c[0] == '=')
+    {
+        ++parser->position;
+        return filter_parse_equality(parser, node);
+    }
+    else
+    {
+        return false;
+    }
+
+    parser->position += 2;
+    node->value = filter_parse_value(parser, node, false);
+
+    return node->value != NULL;
+}
+
+/**
+ * @brief filter_parse_filter Parses parenthesized filter.
+ */
+static ld_filter_t *filter_parse_filter(filter_parser_t *parser, TALLOC_CTX *ctx, int depth)
+{
+    if (depth > FILTER_MAX_DEPTH || *parser->position != '(')
+    {
+        return NULL;
+    }
+    ++parser->position;
+
+    ld_filter_t *node = talloc_zero(ctx, ld_filter_t);
+    if (!node)
+    {
+        return NULL;
+    }
+
+    bool parsed = false;
+
+    switch (*parser->position)
+    {
+    case '&':
+    case '|':
+        node->type = *parser->position == '&' ? LD_FILTER_AND : LD_FILTER_OR;
+        ++parser->position;
+        parsed = filter_parse_list(parser, node, depth);
+        break;
+    case '!':
+        node->type = LD_FILTER_NOT;
+        ++parser->position;
+        node->children = talloc_zero_array(node, ld_filter_t*, 2);
+        parsed = node->children && (node->children[0] = filter_parse_filter(parser, node, depth + 1)) != NULL;
+        break;
+    default:
+        parsed = filter_parse_item(parser, node);
+        break;
+    }
+
+    if (!parsed || *parser->position != ')')
+    {
+        talloc_free(node);
+        return NULL;
+    }
+    ++parser->position;
+
+    return node;
+}
+
+/**
+ * @brief ld_filter_parse Parses RFC 4515 search filter.
+ * @param[in] ctx    Memory context to allocate filter on.
+ * @param[in] filter String representation of the filter.
+ * @return
+ *        - NULL if filter is not valid.
+ *        - parsed filter.
+ */
+ld_filter_t *ld_filter_parse(TALLOC_CTX *ctx, const char *filter)
+{
+    if (!filter)
+    {
+        return NULL;
+    }
+
+    filter_parser_t parser = { .ctx = ctx, .position = filter };
+
+    ld_filter_t *result = filter_parse_filter(&parser, ctx, 0);
+
+    if (result && *parser.position != '\0')
+    {
+        talloc_free(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+/**
+ * @brief ld_filter_validate Checks that string is a valid RFC 4515 search filter.
+ * @param[in] filter Filter to check.
+ * @return
+ *        - false if filter is not valid.
+ *        - true otherwise.
+ */
+bool ld_filter_validate(const char *filter)
+{
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    bool result = ld_filter_parse(talloc_ctx, filter) != NULL;
+
+    talloc_free(talloc_ctx);
+
+    return result;
+}
+
+static char *filter_append_escaped(char *string, const char *value)
+{
+    size_t length = strlen(string);
+    size_t escaped_length = ld_filter_escape_value(value, NULL, 0);
+
+    string = talloc_realloc(NULL, string, char, length + escaped_length + 1);
+    if (!string)
+    {
+        return NULL;
+    }
+
+    ld_filter_escape_value(value, string + length, escaped_length + 1);
+
+    return string;
+}
+
+static char *filter_append(char *string, const ld_filter_t *filter)
+{
+    static const char *OPERATORS[] = { "&", "|", "!", "=", "=", ">=", "<=", "=*", "~=", ":=" };
+
+    if (!string || !filter || filter->type > LD_FILTER_EXTENSIBLE)
+    {
+        talloc_free(string);
+        return NULL;
+    }
+
+    string = talloc_strdup_append_buffer(string, "(");
+
+    switch (filter->type)
+    {
+    case LD_FILTER_AND:
+    case LD_FILTER_OR:
+    case LD_FILTER_NOT:
+        string = talloc_strdup_append_buffer(string, OPERATORS[filter->type]);
+        for (int i = 0; string && filter->children && filter->children[i]; ++i)
+        {
+            string = filter_append(string, filter->children[i]);
+        }
+        break;
+    case LD_FILTER_SUBSTRINGS:
+        string = talloc_asprintf_append_buffer(string, "%s=", filter->attribute);
+        if (string && filter->initial)
+        {
+            string = filter_append_escaped(string, filter->initial);
+        }
+        for (int i = 0; string && filter->any && filter->any[i]; ++i)
+        {
+            string = talloc_strdup_append_buffer(string, "*");
+            string = string ? filter_append_escaped(string, filter->any[i]) : NULL;
+        }
+        string = string ? talloc_strdup_append_buffer(string, "*") : NULL;
+        if (string && filter->final)
+        {
+            string = filter_append_escaped(string, filter->final);
+        }
+        break;
+    case LD_FILTER_PRESENT:
+        string = talloc_asprintf_append_buffer(string, "%s=*", filter->attribute);
+        break;
+    case LD_FILTER_EXTENSIBLE:
+        string = talloc_asprintf_append_buffer(string, "%s%s%s%s:=",
+                                               filter->attribute ? filter->attribute : "",
+                                               filter->dn_attributes ? ":dn" : "",
+                                               filter->matching_rule ? ":" : "",
+                                               filter->matching_rule ? filter->matching_rule : "");
+        string = string ? filter_append_escaped(string, filter->value) : NULL;
+        break;
+    default:
+        string = talloc_asprintf_append_buffer(string, "%s%s", filter->attribute, OPERATORS[filter->type]);
+        string = string ? filter_append_escaped(string, filter->value) : NULL;
+        break;
+    }
+
+    return string ? talloc_strdup_append_buffer(string, ")") : NULL;
+}
+
+/**
+ * @brief ld_filter_to_string Returns string representation of the filter with escaped values.
+ * @param[in] ctx    Memory context to allocate string on.
+ * @param[in] filter Filter to convert.
+ * @return
+ *        - NULL on failure.
+ *        - string representation of the filter.
+ */
+char *ld_filter_to_string(TALLOC_CTX *ctx, const ld_filter_t *filter)
+{
+    char *result = filter_append(talloc_strdup(NULL, ""), filter);
+
+    return result ? talloc_steal(ctx, result) : NULL;
+}
+
+static ld_filter_t *filter_new_list(TALLOC_CTX *ctx, enum LdapFilterType type, ld_filter_t **children)
+{
+    ld_filter_t *node = talloc_zero(ctx, ld_filter_t);
+    if (!node)
+    {
+        return NULL;
+    }
+
+    node->type = type;
+
+    int count = 0;
+    while (children && children[count])
+    {
+        ++count;
+    }
+
+    node->children = talloc_array(node, ld_filter_t*, count + 1);
+    if (!node->children)
+    {
+        talloc_free(node);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        node->children[i] = talloc_steal(node, children[i]);
+    }
+    node->children[count] = NULL;
+
+    return node;
+}
+
+static ld_filter_t *filter_new_item(TALLOC_CTX *ctx, enum LdapFilterType type, const char *attribute,
+                                    const char *value)
+{
+    if (!attribute)
+    {
+        return NULL;
+    }
+
+    ld_filter_t *node = talloc_zero(ctx, ld_filter_t);
+    if (!node)
+    {
+        return NULL;
+    }
+
+    node->type = type;
+    node->attribute = talloc_strdup(node, attribute);
+    node->value = value ? talloc_strdup(node, value) : NULL;
+
+    return node;
+}
+
+/**
+ * @brief ld_filter_and Creates AND filter, children are moved into the new node.
+ * @param[in] ctx      Memory context to allocate filter on.
+ * @param[in] children Operands, NULL terminated.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+ld_filter_t *ld_filter_and(TALLOC_CTX *ctx, ld_filter_t **children)
+{
+    return filter_new_list(ctx, LD_FILTER_AND, children);
+}
+
+/**
+ * @brief ld_filter_or Creates OR filter, children are moved into the new node.
+ * @param[in] ctx      Memory context to allocate filter on.
+ * @param[in] children Operands, NULL terminated.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+ld_filter_t *ld_filter_or(TALLOC_CTX *ctx, ld_filter_t **children)
+{
+    return filter_new_list(ctx, LD_FILTER_OR, children);
+}
+
+/**
+ * @brief ld_filter_not Creates NOT filter, child is moved into the new node.
+ * @param[in] ctx   Memory context to allocate filter on.
+ * @param[in] child Operand.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+ld_filter_t *ld_filter_not(TALLOC_CTX *ctx, ld_filter_t *child)
+{
+    if (!child)
+    {
+        return NULL;
+    }
+
+    ld_filter_t *children[] = { child, NULL };
+
+    return filter_new_list(ctx, LD_FILTER_NOT, children);
+}
+
+/**
+ * @brief ld_filter_equal Creates equality filter, value is escaped when filter is converted to string.
+ * @param[in] ctx       Memory context to allocate filter on.
+ * @param[in] attribute Attribute description.
+ * @param[in] value     Unescaped assertion value.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+ld_filter_t *ld_filter_equal(TALLOC_CTX *ctx, const char *attribute, const char *value)
+{
+    return value ? filter_new_item(ctx, LD_FILTER_EQUALITY, attribute, value) : NULL;
+}
+
+/**
+ * @brief ld_filter_present Creates presence filter.
+ * @param[in] ctx       Memory context to allocate filter on.
+ * @param[in] attribute Attribute description.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+ld_filter_t *ld_filter_present(TALLOC_CTX *ctx, const char *attribute)
+{
+    return filter_new_item(ctx, LD_FILTER_PRESENT, attribute, NULL);
+}
+
+/**
+ * @brief ld_filter_greater_or_equal Creates greater or equal filter.
+ * @param[in] ctx       Memory context to allocate filter on.
+ * @param[in] attribute Attribute description.
+ * @param[in] value     Unescaped assertion value.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+ld_filter_t *ld_filter_greater_or_equal(TALLOC_CTX *ctx, const char *attribute, const char *value)
+{
+    return value ? filter_new_item(ctx, LD_FILTER_GREATER_OR_EQUAL, attribute, value) : NULL;
+}
+
+/**
+ * @brief ld_filter_less_or_equal Creates less or equal filter.
+ * @param[in] ctx       Memory context to allocate filter on.
+ * @param[in] attribute Attribute description.
+ * @param[in] value     Unescaped assertion value.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+ld_filter_t *ld_filter_less_or_equal(TALLOC_CTX *ctx, const char *attribute, const char *value)
+{
+    return value ? filter_new_item(ctx, LD_FILTER_LESS_OR_EQUAL, attribute, value) : NULL;
+}
+
+/**
+ * @brief ld_filter_substrings Creates substrings filter.
+ * @param[in] ctx       Memory context to allocate filter on.
+ * @param[in] attribute Attribute description.
+ * @param[in] initial   Unescaped initial part, can be NULL.
+ * @param[in] any       Unescaped middle parts, NULL terminated, can be NULL.
+ * @param[in] final     Unescaped final part, can be NULL.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+ld_filter_t *ld_filter_substrings(TALLOC_CTX *ctx, const char *attribute, const char *initial, const char **any,
+                                  const char *final)
+{
+    ld_filter_t *node = filter_new_item(ctx, LD_FILTER_SUBSTRINGS, attribute, NULL);
+    if (!node)
+    {
+        return NULL;
+    }
+
+    node->initial = initial && initial[0] ? talloc_strdup(node, initial) : NULL;
+    node->final = final && final[0] ? talloc_strdup(node, final) : NULL;
+
+    int count = 0;
+    while (any && any[count])
+    {
+        ++count;
+    }
+
+    if (count > 0)
+    {
+        node->any = talloc_array(node, char*, count + 1);
+        if (!node->any)
+        {
+            talloc_free(node);
+            return NULL;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            node->any[i] = talloc_strdup(node->any, any[i]);
+        }
+        node->any[count] = NULL;
+    }
+
+    return node;
+}
+
+/**
+ * @brief ld_filter_template_new Compiles filter pattern where every "%s" is a placeholder for assertion value
+ * and "%%" stands for '%'. Pattern is validated once, values are escaped when template is rendered.
+ * @param[in] ctx     Memory context to allocate template on.
+ * @param[in] pattern Filter pattern, e.g. "(&(objectClass=user)(sAMAccountName=%s))".
+ * @return
+ *        - NULL if pattern is not a valid filter.
+ *        - compiled template.
+ */
+ld_filter_template_t *ld_filter_template_new(TALLOC_CTX *ctx, const char *pattern)
+{
+    if (!pattern)
+    {
+        return NULL;
+    }
+
+    ld_filter_template_t *filter_template = talloc_zero(ctx, ld_filter_template_t);
+    if (!filter_template)
+    {
+        return NULL;
+    }
+
+    int arity = 0;
+    for (const char *c = pattern; *c; ++c)
+    {
+        if (c[0] == '%' && c[1] == 's')
+        {
+            ++arity;
+            ++c;
+        }
+        else if (c[0] == '%' && c[1] == '%')
+        {
+            ++c;
+        }
+        else if (c[0] == '%')
+        {
+            ld_error("ld_filter_template_new - unsupported conversion in pattern %s\n", pattern);
+            talloc_free(filter_template);
+            return NULL;
+        }
+    }
+
+    filter_template->arity = arity;
+    filter_template->literals = talloc_array(filter_template, char*, arity + 1);
+    filter_template->literal_lengths = talloc_array(filter_template, size_t, arity + 1);
+    char *literal = talloc_array(filter_template, char, strlen(pattern) + 1);
+
+    if (!filter_template->literals || !filter_template->literal_lengths || !literal)
+    {
+        talloc_free(filter_template);
+        return NULL;
+    }
+
+    int index = 0;
+    size_t length = 0;
+
+    for (const char *c = pattern; ; ++c)
+    {
+        if (*c == '\0' || (c[0] == '%' && c[1] == 's'))
+        {
+            filter_template->literals[index] = talloc_strndup(filter_template->literals, literal, length);
+            filter_template->literal_lengths[index] = length;
+            ++index;
+            length = 0;
+
+            if (*c == '\0')
+            {
+                break;
+            }
+            ++c;
+        }
+        else
+        {
+            literal[length++] = *c;
+            if (c[0] == '%')
+            {
+                ++c;
+            }
+        }
+    }
+    talloc_free(literal);
+
+    const char **values = talloc_array(filter_template, const char*, arity + 1);
+    for (int i = 0; values && i < arity; ++i)
+    {
+        values[i] = "x";
+    }
+
+    const char *sample = values ? ld_filter_template_format(filter_template, values) : NULL;
+    talloc_free(values);
+
+    if (!sample || !ld_filter_validate(sample))
+    {
+        ld_error("ld_filter_template_new - pattern %s is not a valid filter!\n", pattern);
+        talloc_free(filter_template);
+        return NULL;
+    }
+
+    return filter_template;
+}
+
+/**
+ * @brief ld_filter_template_arity Returns number of values template expects.
+ * @param[in] filter_template Template to use.
+ * @return Number of placeholders.
+ */
+int ld_filter_template_arity(const ld_filter_template_t *filter_template)
+{
+    return filter_template ? filter_template->arity : 0;
+}
+
+/**
+ * @brief ld_filter_template_render Substitutes escaped values into template. Works like snprintf: writes at most
+ * size bytes including terminating NUL and returns length of the whole filter, no memory is allocated.
+ * @param[in]  filter_template Template to use.
+ * @param[in]  values          Unescaped values, one per placeholder.
+ * @param[out] buffer          Buffer to write filter to, can be NULL if size is 0.
+ * @param[in]  size            Size of the buffer.
+ * @return Length of the filter without terminating NUL.
+ */
+size_t ld_filter_template_render(const ld_filter_template_t *filter_template, const char **values,
+                                 char *buffer, size_t size)
+{
+    size_t length = 0;
+
+    for (int i = 0; i <= filter_template->arity; ++i)
+    {
+        size_t literal_length = filter_template->literal_lengths[i];
+
+        if (length < size)
+        {
+            size_t available = size - length - 1;
+            memcpy(buffer + length, filter_template->literals[i],
+                   literal_length < available ? literal_length : available);
+        }
+        length += literal_length;
+
+        if (i < filter_template->arity)
+        {
+            length += ld_filter_escape_value(values[i], length < size ? buffer + length : NULL,
+                                             length < size ? size - length : 0);
+        }
+    }
+
+    if (size > 0)
+    {
+        buffer[length < size ? length : size - 1] = '\0';
+    }
+
+    return length;
+}
+
+/**
+ * @brief ld_filter_template_format Substitutes escaped values into template using buffer owned by template.
+ * Buffer only grows, so repeated formatting does not allocate. Result is valid until next call.
+ * @param[in] filter_template Template to use.
+ * @param[in] values          Unescaped values, one per placeholder.
+ * @return
+ *        - NULL on failure.
+ *        - filter.
+ */
+const char *ld_filter_template_format(ld_filter_template_t *filter_template, const char **values)
+{
+    if (!filter_template || (filter_template->arity > 0 && !values))
+    {
+        return NULL;
+    }
+
+    size_t length = ld_filter_template_render(filter_template, values, filter_template->buffer,
+                                              filter_template->buffer_size);
+
+    if (length + 1 > filter_template->buffer_size)
+    {
+        char *buffer = talloc_realloc(filter_template, filter_template->buffer, char, length + 1);
+        if (!buffer)
+        {
+            return NULL;
+        }
+
+        filter_template->buffer = buffer;
+        filter_template->buffer_size = length + 1;
+
+        ld_filter_template_render(filter_template, values, filter_template->buffer, filter_template->buffer_size);
+    }
+
+    return filter_template->buffer;
+}
@@ -0,0 +1,92 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_FILTER_H
+#define LIB_DOMAIN_FILTER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*!
+ * @brief LdapFilterType - Type of the node of RFC 4515 search filter.
+ */
+enum LdapFilterType
+{
+    LD_FILTER_AND              = 0,
+    LD_FILTER_OR               = 1,
+    LD_FILTER_NOT              = 2,
+    LD_FILTER_EQUALITY         = 3,
+    LD_FILTER_SUBSTRINGS       = 4,
+    LD_FILTER_GREATER_OR_EQUAL = 5,
+    LD_FILTER_LESS_OR_EQUAL    = 6,
+    LD_FILTER_PRESENT          = 7,
+    LD_FILTER_APPROX           = 8,
+    LD_FILTER_EXTENSIBLE       = 9,
+};
+
+typedef struct ld_filter_s ld_filter_t;
+
+/*!
+ * @brief ld_filter_t - Node of parsed search filter. Values are stored unescaped.
+ */
+struct ld_filter_s
+{
+    enum LdapFilterType type;        //!< Type of the node.
+    ld_filter_t **children;          //!< Operands of AND, OR and NOT, NULL terminated.
+
+    char *attribute;                 //!< Attribute description, can be NULL for extensible match.
+    char *value;                     //!< Assertion value.
+
+    char *initial;                   //!< Initial part of substrings filter, can be NULL.
+    char **any;                      //!< Middle parts of substrings filter, NULL terminated, can be NULL.
+    char *final;                     //!< Final part of substrings filter, can be NULL.
+
+    char *matching_rule;             //!< Matching rule of extensible match, can be NULL.
+    bool dn_attributes;              //!< Extensible match applies to dn attributes too.
+};
+
+typedef struct ld_filter_template_s ld_filter_template_t;
+
+size_t ld_filter_escape_value(const char *value, char *buffer, size_t size);
+char *ld_filter_escape(TALLOC_CTX *ctx, const char *value);
+
+ld_filter_t *ld_filter_parse(TALLOC_CTX *ctx, const char *filter);
+bool ld_filter_validate(const char *filter);
+char *ld_filter_to_string(TALLOC_CTX *ctx, const ld_filter_t *filter);
+
+ld_filter_t *ld_filter_and(TALLOC_CTX *ctx, ld_filter_t **children);
+ld_filter_t *ld_filter_or(TALLOC_CTX *ctx, ld_filter_t **children);
+ld_filter_t *ld_filter_not(TALLOC_CTX *ctx, ld_filter_t *child);
+ld_filter_t *ld_filter_equal(TALLOC_CTX *ctx, const char *attribute, const char *value);
+ld_filter_t *ld_filter_present(TALLOC_CTX *ctx, const char *attribute);
+ld_filter_t *ld_filter_greater_or_equal(TALLOC_CTX *ctx, const char *attribute, const char *value);
+ld_filter_t *ld_filter_less_or_equal(TALLOC_CTX *ctx, const char *attribute, const char *value);
+ld_filter_t *ld_filter_substrings(TALLOC_CTX *ctx, const char *attribute, const char *initial, const char **any,
+                                  const char *final);
+
+ld_filter_template_t *ld_filter_template_new(TALLOC_CTX *ctx, const char *pattern);
+int ld_filter_template_arity(const ld_filter_template_t *filter_template);
+size_t ld_filter_template_render(const ld_filter_template_t *filter_template, const char **values,
+                                 char *buffer, size_t size);
+const char *ld_filter_template_format(ld_filter_template_t *filter_template, const char **values);
+
+#endif //LIB_DOMAIN_FILTER_H
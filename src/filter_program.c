@@ -0,0 +1,818 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "filter_program.h"
+
+#include "domain.h"
+#include "entry_p.h"
+#include "matching_rule.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define FILTER_PROGRAM_MAX_STACK 256
+#define FILTER_PROGRAM_MAX_DEPTH 64
+#define FILTER_VALUE_BUFFER_SIZE 512
+
+
+/*!
+ * @brief FilterOpcode - Instruction of compiled filter. Program is stored in postfix order.
+ */
+enum FilterOpcode
+{
+    FILTER_OP_TEST     = 0,          //!< Evaluate filter item, operand is index of the test.
+    FILTER_OP_CONSTANT = 1,          //!< Push constant, operand is FilterResult.
+    FILTER_OP_AND      = 2,          //!< Combine operand number of results with AND.
+    FILTER_OP_OR       = 3,          //!< Combine operand number of results with OR.
+    FILTER_OP_NOT      = 4,          //!< Negate result on top of the stack.
+};
+
+/*!
+ * @brief FilterResult - Three-valued result of filter evaluation as defined in RFC 4511 section 4.5.1.7.
+ */
+enum FilterResult
+{
+    FILTER_FALSE     = 0,
+    FILTER_TRUE      = 1,
+    FILTER_UNDEFINED = 2,
+};
+
+/*!
+ * @brief filter_instruction_t - Single instruction of compiled filter.
+ */
+typedef struct filter_instruction_s
+{
+    enum FilterOpcode opcode;        //!< Instruction.
+    int operand;                     //!< Argument of the instruction.
+} filter_instruction_t;
+
+/*!
+ * @brief filter_test_t - Filter item with assertion values normalized by the matching rule of the attribute.
+ */
+typedef struct filter_test_s
+{
+    enum LdapFilterType type;        //!< Type of the filter item.
+    enum MatchingRule rule;    //!< Matching rule to compare values with.
+
+    const char **names;              //!< Names of the attribute, NULL terminated, NULL matches every attribute.
+
+    char *value;                     //!< Normalized assertion value.
+    long long integer;               //!< Assertion value of integer rule.
+    bool integer_valid;              //!< Assertion value is a valid integer.
+
+    char *initial;                   //!< Normalized initial part of substrings filter.
+    char **any;                      //!< Normalized middle parts of substrings filter, NULL terminated.
+    char *final;                     //!< Normalized final part of substrings filter.
+
+    bool dn_attributes;              //!< Values of entry dn are tested too.
+} filter_test_t;
+
+/*!
+ * @brief ld_filter_program_t - Compiled search filter.
+ */
+struct ld_filter_program_s
+{
+    filter_instruction_t *instructions; //!< Instructions in postfix order.
+    int n_instructions;              //!< Number of instructions.
+
+    filter_test_t *tests;            //!< Filter items referenced by instructions.
+    int n_tests;                     //!< Number of filter items.
+};
+
+/*!
+ * @brief filter_compiler_t - State of filter compilation.
+ */
+typedef struct filter_compiler_s
+{
+    ld_filter_program_t *program;    //!< Program being compiled.
+    const ldap_schema_t *schema;     //!< Schema to look up matching rules in, can be NULL.
+    int stack_size;                  //!< Stack size at current instruction.
+} filter_compiler_t;
+
+
+/**
+ * @brief filter_attribute_names Returns names the attribute can appear under in the entry.
+ */
+static const char **filter_attribute_names(TALLOC_CTX *ctx, const ldap_schema_t *schema, const char *attribute)
+{
+    LDAPAttributeType *type = strchr(attribute, ';') ? NULL : matching_rule_attribute_type(schema, attribute);
+
+    int count = 1;
+    while (type && type->at_names && type->at_names[count - 1])
+    {
+        ++count;
+    }
+
+    const char **names = talloc_array(ctx, const char*, count + 2);
+    if (!names)
+    {
+        return NULL;
+    }
+
+    int index = 0;
+    names[index++] = talloc_strdup(names, attribute);
+    for (int i = 0; type && type->at_names && type->at_names[i]; ++i)
+    {
+        names[index++] = talloc_strdup(names, type->at_names[i]);
+    }
+    if (type && type->at_oid)
+    {
+        names[index++] = talloc_strdup(names, type->at_oid);
+    }
+    names[index] = NULL;
+
+    return names;
+}
+
+
+/**
+ * @brief filter_normalized Normalizes value into local buffer, allocates if value does not fit.
+ * @param[out] allocated Allocated buffer to free, NULL if local buffer was used.
+ */
+static const char *filter_normalized(enum MatchingRule rule, const char *value, char *local, size_t size,
+                                     char **allocated)
+{
+    size_t length = matching_rule_normalize(rule, value, local, size);
+
+    *allocated = NULL;
+
+    if (length < size)
+    {
+        return local;
+    }
+
+    *allocated = talloc_array(NULL, char, length + 1);
+    if (!*allocated)
+    {
+        return NULL;
+    }
+
+    matching_rule_normalize(rule, value, *allocated, length + 1);
+
+    return *allocated;
+}
+
+static char *filter_normalize_copy(TALLOC_CTX *ctx, enum MatchingRule rule, const char *value)
+{
+    if (!value)
+    {
+        return NULL;
+    }
+
+    size_t length = matching_rule_normalize(rule, value, NULL, 0);
+
+    char *result = talloc_array(ctx, char, length + 1);
+    if (result)
+    {
+        matching_rule_normalize(rule, value, result, length + 1);
+    }
+
+    return result;
+}
+
+static bool filter_parse_integer(const char *value, long long *number)
+{
+    if (!value || !*value)
+    {
+        return false;
+    }
+
+    char *end = NULL;
+    errno = 0;
+    *number = strtoll(value, &end, 10);
+
+    return errno == 0 && end && *end == '\0';
+}
+
+static bool filter_match_substrings(const filter_test_t *test, const char *value)
+{
+    const char *position = value;
+    const char *end = value + strlen(value);
+
+    if (test->initial)
+    {
+        size_t length = strlen(test->initial);
+        if (strncmp(position, test->initial, length) != 0)
+        {
+            return false;
+        }
+        position += length;
+    }
+
+    for (int i = 0; test->any && test->any[i]; ++i)
+    {
+        const char *found = strstr(position, test->any[i]);
+        if (!found)
+        {
+            return false;
+        }
+        position = found + strlen(test->any[i]);
+    }
+
+    if (test->final)
+    {
+        size_t length = strlen(test->final);
+        return (size_t)(end - position) >= length && strcmp(end - length, test->final) == 0;
+    }
+
+    return true;
+}
+
+static enum FilterResult filter_or(enum FilterResult left, enum FilterResult right)
+{
+    if (left == FILTER_TRUE || right == FILTER_TRUE)
+    {
+        return FILTER_TRUE;
+    }
+
+    return left == FILTER_UNDEFINED || right == FILTER_UNDEFINED ? FILTER_UNDEFINED : FILTER_FALSE;
+}
+
+/**
+ * @brief filter_test_value Compares single attribute value with assertion.
+ */
+static enum FilterResult filter_test_value(const filter_test_t *test, const char *value)
+{
+    if (test->type == LD_FILTER_PRESENT)
+    {
+        return FILTER_TRUE;
+    }
+
+    if (test->rule == MATCHING_RULE_INTEGER)
+    {
+        long long number = 0;
+        if (!test->integer_valid || !filter_parse_integer(value, &number))
+        {
+            return FILTER_UNDEFINED;
+        }
+
+        switch (test->type)
+        {
+        case LD_FILTER_GREATER_OR_EQUAL:
+            return number >= test->integer ? FILTER_TRUE : FILTER_FALSE;
+        case LD_FILTER_LESS_OR_EQUAL:
+            return number <= test->integer ? FILTER_TRUE : FILTER_FALSE;
+        default:
+            return number == test->integer ? FILTER_TRUE : FILTER_FALSE;
+        }
+    }
+
+    char local[FILTER_VALUE_BUFFER_SIZE];
+    char *allocated = NULL;
+
+    const char *normalized = filter_normalized(test->rule, value, local, sizeof(local), &allocated);
+    if (!normalized)
+    {
+        return FILTER_UNDEFINED;
+    }
+
+    bool matched = false;
+
+    switch (test->type)
+    {
+    case LD_FILTER_SUBSTRINGS:
+        matched = filter_match_substrings(test, normalized);
+        break;
+    case LD_FILTER_GREATER_OR_EQUAL:
+        matched = strcmp(normalized, test->value) >= 0;
+        break;
+    case LD_FILTER_LESS_OR_EQUAL:
+        matched = strcmp(normalized, test->value) <= 0;
+        break;
+    default:
+        matched = strcmp(normalized, test->value) == 0;
+        break;
+    }
+
+    talloc_free(allocated);
+
+    return matched ? FILTER_TRUE : FILTER_FALSE;
+}
+
+static enum FilterResult filter_test_attribute(const filter_test_t *test, const LDAPAttribute_t *attribute)
+{
+    enum FilterResult result = FILTER_FALSE;
+
+    for (int i = 0; attribute && attribute->values && attribute->values[i] && result != FILTER_TRUE; ++i)
+    {
+        result = filter_or(result, filter_test_value(test, attribute->values[i]));
+    }
+
+    return result;
+}
+
+static bool filter_name_matches(const filter_test_t *test, const char *name)
+{
+    for (int i = 0; test->names && test->names[i]; ++i)
+    {
+        if (strcasecmp(test->names[i], name) == 0)
+        {
+            return true;
+        }
+    }
+
+    return !test->names;
+}
+
+/**
+ * @brief filter_find_attribute Looks up attribute by exact names first, then case insensitively.
+ */
+static LDAPAttribute_t *filter_find_attribute(const filter_test_t *test, ld_entry_t *entry)
+{
+    for (int i = 0; test->names[i]; ++i)
+    {
+        LDAPAttribute_t *attribute = g_hash_table_lookup(entry->attributes, test->names[i]);
+        if (attribute)
+        {
+            return attribute;
+        }
+    }
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, entry->attributes);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        if (filter_name_matches(test, key))
+        {
+            return value;
+        }
+    }
+
+    return NULL;
+}
+
+static void filter_put(char *buffer, size_t size, size_t *length, char c)
+{
+    if (*length + 1 < size)
+    {
+        buffer[*length] = c;
+    }
+    ++*length;
+}
+
+static int filter_hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief filter_test_dn Tests attribute values of every RDN of the dn, used by extensible match with :dn.
+ */
+static enum FilterResult filter_test_dn(const filter_test_t *test, const char *dn)
+{
+    enum FilterResult result = FILTER_FALSE;
+
+    const char *c = dn;
+
+    while (c && *c && result != FILTER_TRUE)
+    {
+        char type[FILTER_VALUE_BUFFER_SIZE];
+        char value[FILTER_VALUE_BUFFER_SIZE];
+        size_t type_length = 0;
+        size_t value_length = 0;
+
+        while (*c == ' ')
+        {
+            ++c;
+        }
+        while (*c && *c != '=')
+        {
+            if (*c != ' ')
+            {
+                filter_put(type, sizeof(type), &type_length, *c);
+            }
+            ++c;
+        }
+        if (*c != '=')
+        {
+            break;
+        }
+        ++c;
+
+        while (*c && *c != ',' && *c != '+' && *c != ';')
+        {
+            if (c[0] == '\\' && filter_hex_value(c[1]) >= 0 && filter_hex_value(c[2]) >= 0)
+            {
+                filter_put(value, sizeof(value), &value_length,
+                           (char)(filter_hex_value(c[1]) << 4 | filter_hex_value(c[2])));
+                c += 3;
+            }
+            else if (c[0] == '\\' && c[1])
+            {
+                filter_put(value, sizeof(value), &value_length, c[1]);
+                c += 2;
+            }
+            else
+            {
+                filter_put(value, sizeof(value), &value_length, *c++);
+            }
+        }
+        if (*c)
+        {
+            ++c;
+        }
+
+        if (type_length >= sizeof(type) || value_length >= sizeof(value))
+        {
+            result = filter_or(result, FILTER_UNDEFINED);
+            continue;
+        }
+        type[type_length] = '\0';
+        value[value_length] = '\0';
+
+        if (filter_name_matches(test, type))
+        {
+            result = filter_or(result, filter_test_value(test, value));
+        }
+    }
+
+    return result;
+}
+
+static enum FilterResult filter_evaluate_test(const filter_test_t *test, ld_entry_t *entry)
+{
+    enum FilterResult result = FILTER_FALSE;
+
+    if (test->names)
+    {
+        result = filter_test_attribute(test, filter_find_attribute(test, entry));
+    }
+    else
+    {
+        GHashTableIter iter;
+        gpointer key = NULL, value = NULL;
+
+        g_hash_table_iter_init(&iter, entry->attributes);
+        while (result != FILTER_TRUE && g_hash_table_iter_next(&iter, &key, &value))
+        {
+            result = filter_or(result, filter_test_attribute(test, value));
+        }
+    }
+
+    if (result != FILTER_TRUE && test->dn_attributes)
+    {
+        result = filter_or(result, filter_test_dn(test, entry->dn));
+    }
+
+    return result;
+}
+
+static bool filter_emit(filter_compiler_t *compiler, enum FilterOpcode opcode, int operand)
+{
+    ld_filter_program_t *program = compiler->program;
+
+    filter_instruction_t *instructions = talloc_realloc(program, program->instructions, filter_instruction_t,
+                                                        program->n_instructions + 1);
+    if (!instructions)
+    {
+        return false;
+    }
+
+    program->instructions = instructions;
+    program->instructions[program->n_instructions].opcode = opcode;
+    program->instructions[program->n_instructions].operand = operand;
+    program->n_instructions++;
+
+    switch (opcode)
+    {
+    case FILTER_OP_TEST:
+    case FILTER_OP_CONSTANT:
+        compiler->stack_size++;
+        break;
+    case FILTER_OP_AND:
+    case FILTER_OP_OR:
+        compiler->stack_size += 1 - operand;
+        break;
+    default:
+        break;
+    }
+
+    if (compiler->stack_size > FILTER_PROGRAM_MAX_STACK)
+    {
+        ld_error("ld_filter_compile - filter is too large!\n");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief filter_compile_test Resolves matching rule of the filter item and normalizes its assertion values.
+ */
+static bool filter_compile_test(filter_compiler_t *compiler, const ld_filter_t *node)
+{
+    ld_filter_program_t *program = compiler->program;
+
+    enum MatchingRule rule = node->attribute ? matching_rule_for_attribute(compiler->schema, node->attribute)
+                                                   : MATCHING_RULE_CASE_IGNORE;
+
+    if (node->matching_rule
+        && !matching_rule_find_by_name(node->matching_rule, &rule))
+    {
+        // Unknown matching rule makes filter item undefined.
+        return filter_emit(compiler, FILTER_OP_CONSTANT, FILTER_UNDEFINED);
+    }
+
+    if (node->type == LD_FILTER_PRESENT && node->attribute && strcasecmp(node->attribute, "objectClass") == 0)
+    {
+        // Every entry has object class, even if it was not requested.
+        return filter_emit(compiler, FILTER_OP_CONSTANT, FILTER_TRUE);
+    }
+
+    if (node->type == LD_FILTER_SUBSTRINGS && rule == MATCHING_RULE_INTEGER)
+    {
+        rule = MATCHING_RULE_CASE_EXACT;
+    }
+    else if (node->type == LD_FILTER_SUBSTRINGS && rule == MATCHING_RULE_DN)
+    {
+        rule = MATCHING_RULE_CASE_IGNORE;
+    }
+
+    bool ordering = node->type == LD_FILTER_GREATER_OR_EQUAL || node->type == LD_FILTER_LESS_OR_EQUAL;
+
+    // Dns have no ordering, octet strings are ordered only when schema says so (octetStringOrderingMatch).
+    if (ordering && (rule == MATCHING_RULE_DN
+                     || (rule == MATCHING_RULE_OCTET_STRING
+                         && !matching_rule_has_ordering(compiler->schema, node->attribute))))
+    {
+        return filter_emit(compiler, FILTER_OP_CONSTANT, FILTER_UNDEFINED);
+    }
+
+    filter_test_t *tests = talloc_realloc(program, program->tests, filter_test_t, program->n_tests + 1);
+    if (!tests)
+    {
+        return false;
+    }
+    program->tests = tests;
+
+    filter_test_t *test = &program->tests[program->n_tests];
+    memset(test, 0, sizeof(filter_test_t));
+
+    test->type = node->type;
+    test->rule = rule;
+    test->dn_attributes = node->dn_attributes;
+
+    if (node->attribute)
+    {
+        test->names = filter_attribute_names(program, compiler->schema, node->attribute);
+        if (!test->names)
+        {
+            return false;
+        }
+    }
+
+    if (node->type == LD_FILTER_SUBSTRINGS)
+    {
+        test->initial = filter_normalize_copy(program, rule, node->initial);
+        test->final = filter_normalize_copy(program, rule, node->final);
+
+        int count = 0;
+        while (node->any && node->any[count])
+        {
+            ++count;
+        }
+
+        test->any = talloc_zero_array(program, char*, count + 1);
+        for (int i = 0; test->any && i < count; ++i)
+        {
+            test->any[i] = filter_normalize_copy(test->any, rule, node->any[i]);
+        }
+    }
+    else if (node->value)
+    {
+        test->value = filter_normalize_copy(program, rule, node->value);
+        test->integer_valid = filter_parse_integer(node->value, &test->integer);
+    }
+
+    return filter_emit(compiler, FILTER_OP_TEST, program->n_tests++);
+}
+
+static bool filter_compile_node(filter_compiler_t *compiler, const ld_filter_t *node, int depth)
+{
+    if (!node || depth > FILTER_PROGRAM_MAX_DEPTH)
+    {
+        return false;
+    }
+
+    int count = 0;
+
+    switch (node->type)
+    {
+    case LD_FILTER_AND:
+    case LD_FILTER_OR:
+    case LD_FILTER_NOT:
+        for (; node->children && node->children[count]; ++count)
+        {
+            if (!filter_compile_node(compiler, node->children[count], depth + 1))
+            {
+                return false;
+            }
+        }
+
+        if (node->type == LD_FILTER_NOT)
+        {
+            return count == 1 && filter_emit(compiler, FILTER_OP_NOT, 1);
+        }
+
+        return filter_emit(compiler, node->type == LD_FILTER_AND ? FILTER_OP_AND : FILTER_OP_OR, count);
+    default:
+        return filter_compile_test(compiler, node);
+    }
+}
+
+/**
+ * @brief ld_filter_compile Compiles filter into program which can be evaluated against entries without a server.
+ * Assertion values are normalized once using equality matching rules from the schema. If schema is NULL or has
+ * no information about the attribute, case ignore matching is used.
+ * @param[in] ctx    Memory context to allocate program on.
+ * @param[in] filter Filter to compile.
+ * @param[in] schema Schema to look up matching rules in, can be NULL.
+ * @return
+ *        - NULL on failure.
+ *        - compiled filter.
+ */
+ld_filter_program_t *ld_filter_compile(TALLOC_CTX *ctx, const ld_filter_t *filter, const ldap_schema_t *schema)
+{
+    ld_filter_program_t *program = talloc_zero(ctx, ld_filter_program_t);
+    if (!program)
+    {
+        ld_error("ld_filter_compile - out of memory!\n");
+        return NULL;
+    }
+
+    filter_compiler_t compiler = { .program = program, .schema = schema, .stack_size = 0 };
+
+    if (!filter_compile_node(&compiler, filter, 0))
+    {
+        ld_error("ld_filter_compile - unable to compile filter!\n");
+        talloc_free(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+/**
+ * @brief ld_filter_compile_string Parses and compiles RFC 4515 filter.
+ * @param[in] ctx    Memory context to allocate program on.
+ * @param[in] filter Filter to compile.
+ * @param[in] schema Schema to look up matching rules in, can be NULL.
+ * @return
+ *        - NULL if filter is not valid.
+ *        - compiled filter.
+ */
+ld_filter_program_t *ld_filter_compile_string(TALLOC_CTX *ctx, const char *filter, const ldap_schema_t *schema)
+{
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    ld_filter_t *parsed = ld_filter_parse(talloc_ctx, filter);
+
+    ld_filter_program_t *program = parsed ? ld_filter_compile(ctx, parsed, schema) : NULL;
+
+    if (!parsed)
+    {
+        ld_error("ld_filter_compile_string - filter %s is not valid!\n", filter ? filter : "(null)");
+    }
+
+    talloc_free(talloc_ctx);
+
+    return program;
+}
+
+/**
+ * @brief ld_filter_match Evaluates compiled filter against the entry.
+ * @param[in] program Compiled filter.
+ * @param[in] entry   Entry to test.
+ * @return
+ *        - true if filter evaluates to TRUE.
+ *        - false if filter evaluates to FALSE or Undefined.
+ */
+bool ld_filter_match(const ld_filter_program_t *program, ld_entry_t *entry)
+{
+    if (!program || !entry || !entry->attributes)
+    {
+        return false;
+    }
+
+    uint8_t stack[FILTER_PROGRAM_MAX_STACK];
+    int top = 0;
+
+    for (int i = 0; i < program->n_instructions; ++i)
+    {
+        const filter_instruction_t *instruction = &program->instructions[i];
+
+        switch (instruction->opcode)
+        {
+        case FILTER_OP_TEST:
+            stack[top++] = filter_evaluate_test(&program->tests[instruction->operand], entry);
+            break;
+        case FILTER_OP_CONSTANT:
+            stack[top++] = instruction->operand;
+            break;
+        case FILTER_OP_AND:
+        case FILTER_OP_OR:
+        {
+            bool is_and = instruction->opcode == FILTER_OP_AND;
+            enum FilterResult deciding = is_and ? FILTER_FALSE : FILTER_TRUE;
+            enum FilterResult result = is_and ? FILTER_TRUE : FILTER_FALSE;
+
+            for (int j = top - instruction->operand; j < top; ++j)
+            {
+                if (stack[j] == deciding)
+                {
+                    result = deciding;
+                    break;
+                }
+                if (stack[j] == FILTER_UNDEFINED)
+                {
+                    result = FILTER_UNDEFINED;
+                }
+            }
+
+            top -= instruction->operand;
+            stack[top++] = result;
+            break;
+        }
+        case FILTER_OP_NOT:
+            if (stack[top - 1] != FILTER_UNDEFINED)
+            {
+                stack[top - 1] = stack[top - 1] == FILTER_TRUE ? FILTER_FALSE : FILTER_TRUE;
+            }
+            break;
+        }
+    }
+
+    return top == 1 && stack[0] == FILTER_TRUE;
+}
+
+/**
+ * @brief ld_filter_select Returns entries matching compiled filter.
+ * @param[in] ctx     Memory context to allocate result on.
+ * @param[in] program Compiled filter.
+ * @param[in] entries Entries to test, NULL terminated.
+ * @return
+ *        - NULL on failure.
+ *        - NULL terminated array of matching entries, entries are not copied.
+ */
+ld_entry_t **ld_filter_select(TALLOC_CTX *ctx, const ld_filter_program_t *program, ld_entry_t **entries)
+{
+    int count = 0;
+    while (entries && entries[count])
+    {
+        ++count;
+    }
+
+    ld_entry_t **result = talloc_array(ctx, ld_entry_t*, count + 1);
+    if (!result)
+    {
+        ld_error("ld_filter_select - out of memory!\n");
+        return NULL;
+    }
+
+    int matched = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (ld_filter_match(program, entries[i]))
+        {
+            result[matched++] = entries[i];
+        }
+    }
+    result[matched] = NULL;
+
+    return result;
+}
@@ -0,0 +1,39 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_FILTER_PROGRAM_H
+#define LIB_DOMAIN_FILTER_PROGRAM_H
+
+#include "common.h"
+#include "entry.h"
+#include "filter.h"
+#include "schema.h"
+
+#include <stdbool.h>
+
+typedef struct ld_filter_program_s ld_filter_program_t;
+
+ld_filter_program_t *ld_filter_compile(TALLOC_CTX *ctx, const ld_filter_t *filter, const ldap_schema_t *schema);
+ld_filter_program_t *ld_filter_compile_string(TALLOC_CTX *ctx, const char *filter, const ldap_schema_t *schema);
+
+bool ld_filter_match(const ld_filter_program_t *program, ld_entry_t *entry);
+ld_entry_t **ld_filter_select(TALLOC_CTX *ctx, const ld_filter_program_t *program, ld_entry_t **entries);
+
+#endif //LIB_DOMAIN_FILTER_PROGRAM_H
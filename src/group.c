@@ -25,6 +25,7 @@
 #include "entry.h"
 
 #include <string.h>
+#include <strings.h>
 
 enum GroupAttributeIndex
 {
@@ -181,3 +182,158 @@ enum OperationReturnCode ld_group_remove_user(LDHandle *handle, const char *grou
     return group_member_modify(handle, group_name, user_name, LDAP_MOD_DELETE);
 }
 
+#define GROUP_LIST_PAGE_SIZE 500
+
+static const char *GROUP_ATTRIBUTES_AD[] =
+{
+    "cn", "description", "member", NULL
+};
+
+static const char *GROUP_ATTRIBUTES_OPENLDAP[] =
+{
+    "cn", "description", "memberUid", NULL
+};
+
+static const char *GROUP_FILTER_AD = "(objectClass=group)";
+static const char *GROUP_FILTER_OPENLDAP = "(objectClass=posixGroup)";
+
+static void *group_from_entry(TALLOC_CTX *ctx, int directory_type, ld_entry_t *entry)
+{
+    const char *dn = ld_entry_get_dn(entry);
+
+    // Last message of search result chain carries no entry.
+    if (!dn || strlen(dn) == 0)
+    {
+        return NULL;
+    }
+
+    ld_group_t *group = talloc_zero(ctx, ld_group_t);
+    if (!group)
+    {
+        return NULL;
+    }
+
+    // Attributes reference values stored in the entry, so group takes ownership of the entry.
+    talloc_steal(group, entry);
+    group->attributes = ld_entry_get_attributes(entry);
+
+    group->dn = talloc_strdup(group, dn);
+    group->name = ld_entry_get_first_value(entry, "cn");
+    group->description = ld_entry_get_first_value(entry, "description");
+
+    const char *member_attribute = directory_type == LDAP_TYPE_ACTIVE_DIRECTORY ? "member" : "memberUid";
+    for (int i = 0; group->attributes && group->attributes[i]; ++i)
+    {
+        if (strcasecmp(group->attributes[i]->name, member_attribute) == 0)
+        {
+            group->members = group->attributes[i]->values;
+            break;
+        }
+    }
+
+    return group;
+}
+
+static enum OperationReturnCode group_search(LDHandle *handle,
+                                             const char *base_dn,
+                                             int scope,
+                                             const char **attributes,
+                                             group_list_callback_fn callback,
+                                             void *user_data)
+{
+    const char *filter = NULL;
+    const char **default_attributes = NULL;
+
+    switch (handle->connection_ctx->directory_type)
+    {
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        filter = GROUP_FILTER_AD;
+        default_attributes = GROUP_ATTRIBUTES_AD;
+        break;
+    case LDAP_TYPE_OPENLDAP:
+        filter = GROUP_FILTER_OPENLDAP;
+        default_attributes = GROUP_ATTRIBUTES_OPENLDAP;
+        break;
+    default:
+        ld_error("Listing groups is not implemented for directory type %d!\n",
+                 handle->connection_ctx->directory_type);
+        return RETURN_CODE_FAILURE;
+    }
+
+    char **attrs = (char**)(attributes ? attributes : default_attributes);
+
+    return search_entry_views(handle, base_dn, scope, filter, attrs, GROUP_LIST_PAGE_SIZE, group_from_entry,
+                              (entry_view_callback_fn)callback, user_data);
+}
+
+/**
+ * @brief ld_get_group Reads single group and passes it to the callback as a compact ld_group_t.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] name       Name of the group.
+ * @param[in] parent     Parent container of the group. Can be NULL than base dn will be used.
+ * @param[in] attributes Attributes to request from the server. Can be NULL than attributes needed to fill
+ *                       ld_group_t will be requested.
+ * @param[in] callback   Callback to receive the group.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_get_group(LDHandle *handle,
+                                      const char *name,
+                                      const char *parent,
+                                      const char **attributes,
+                                      group_list_callback_fn callback,
+                                      void *user_data)
+{
+    check_handle(handle, "ld_get_group");
+
+    if (!name || !callback)
+    {
+        ld_error("ld_get_group - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *dn = talloc_asprintf(talloc_ctx, "cn=%s,%s", name,
+                                     parent && strlen(parent) > 0 ? parent : handle->global_config->base_dn);
+
+    int rc = group_search(handle, dn, LDAP_SCOPE_BASE, attributes, callback, user_data);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
+
+/**
+ * @brief ld_list_groups Lists groups of the container using paged search and passes them to the callback
+ * as compact ld_group_t.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] parent     Container to search groups in. Can be NULL than base dn will be used.
+ * @param[in] attributes Attributes to request from the server. Can be NULL than attributes needed to fill
+ *                       ld_group_t will be requested.
+ * @param[in] callback   Callback to receive the groups.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_list_groups(LDHandle *handle,
+                                        const char *parent,
+                                        const char **attributes,
+                                        group_list_callback_fn callback,
+                                        void *user_data)
+{
+    check_handle(handle, "ld_list_groups");
+
+    if (!callback)
+    {
+        ld_error("ld_list_groups - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    const char *base_dn = parent && strlen(parent) > 0 ? parent : handle->global_config->base_dn;
+
+    return group_search(handle, base_dn, LDAP_SCOPE_SUBTREE, attributes, callback, user_data);
+}
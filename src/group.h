@@ -37,6 +37,26 @@ enum GroupCategory
     GROUP_CATEGORY_SECURITY     = 1
 };
 
+/*!
+ * @brief ld_group_t - Compact view of the group entry.
+ */
+typedef struct ld_group_s
+{
+    const char *dn;                  //!< Distinguished name of the group.
+    const char *name;                //!< Common name of the group.
+    const char *description;         //!< Description of the group.
+    char **members;                  //!< Members of the group, NULL terminated, NULL if group is empty.
+    LDAPAttribute_t **attributes;    //!< All attributes returned by the server, NULL terminated.
+} ld_group_t;
+
+/*!
+ * @brief group_list_callback_fn Callback which receives groups. Groups are released after callback returns,
+ * use talloc_steal to keep them. On failure result_code holds error returned by the server, LDAP_NO_SUCH_OBJECT
+ * if requested group does not exist, and groups are NULL.
+ */
+typedef enum OperationReturnCode (*group_list_callback_fn)(LDHandle *handle, int result_code, ld_group_t **groups,
+                                                           void *user_data);
+
 enum OperationReturnCode ld_add_group(LDHandle *handle, const char *name, LDAPAttribute_t **attributes, const char *parent);
 enum OperationReturnCode ld_del_group(LDHandle *handle, const char *name, const char *parent);
 enum OperationReturnCode ld_mod_group(LDHandle *handle,
@@ -51,4 +71,16 @@ enum OperationReturnCode ld_rename_group(LDHandle *handle,
 enum OperationReturnCode ld_group_add_user(LDHandle *handle, const char *group_name, const char *user_name);
 enum OperationReturnCode ld_group_remove_user(LDHandle *handle, const char *group_name, const char *user_name);
 
+enum OperationReturnCode ld_get_group(LDHandle *handle,
+                                      const char *name,
+                                      const char *parent,
+                                      const char **attributes,
+                                      group_list_callback_fn callback,
+                                      void *user_data);
+enum OperationReturnCode ld_list_groups(LDHandle *handle,
+                                        const char *parent,
+                                        const char **attributes,
+                                        group_list_callback_fn callback,
+                                        void *user_data);
+
 #endif //LIB_DOMAIN_GROUP_H
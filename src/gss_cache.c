@@ -0,0 +1,243 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "gss_cache.h"
+
+#ifdef LIBDOMAIN_HAVE_GSSAPI
+#include <glib.h>
+#include <gssapi/gssapi.h>
+#endif
+
+#ifdef LIBDOMAIN_HAVE_GSSAPI
+
+/*!
+ * @brief gss_credential_t - Initiator credential acquired from default credential cache or client keytab.
+ */
+typedef struct gss_credential_t
+{
+    gss_cred_id_t id;           //!< GSSAPI credential.
+    unsigned int references;    //!< Number of caches which hold the credential, it is released by the last one.
+} gss_credential_t;
+
+/*!
+ * Credential handed out to every cache of the process, NULL until first bind or after it was forgotten.
+ * Acquiring credential without a name always yields identity of the default credential cache, so handles
+ * of a pool may share single credential and its service tickets.
+ */
+static gss_credential_t *shared_credential = NULL;
+
+G_LOCK_DEFINE_STATIC(shared_credential);
+
+#endif
+
+/*!
+ * @brief gss_cache_t - Kerberos credential used by connections of one handle.
+ *
+ * Credential is acquired when first GSSAPI bind of the process starts and is passed to every following bind of
+ * all handles. Ticket granting ticket and service tickets obtained through it are kept by the credential, so
+ * reconnects and pooled connections do not repeat exchanges with KDC while tickets are valid. Cache holds
+ * reference to credential it passed to the last bind, so credential which is replaced after failed bind of
+ * another handle stays valid until bind in progress completes.
+ */
+struct gss_cache_t
+{
+#ifdef LIBDOMAIN_HAVE_GSSAPI
+    gss_credential_t *credential;   //!< Credential of the last bind, NULL until first bind.
+#else
+    int unused;                     //!< Credential caching requires GSSAPI.
+#endif
+};
+
+#ifdef LIBDOMAIN_HAVE_GSSAPI
+
+static void gss_credential_release(gss_credential_t *credential)
+{
+    if (--credential->references > 0)
+    {
+        return;
+    }
+
+    if (shared_credential == credential)
+    {
+        shared_credential = NULL;
+    }
+
+    OM_uint32 minor = 0;
+    gss_release_cred(&minor, &credential->id);
+    talloc_free(credential);
+}
+
+static gss_credential_t *gss_credential_acquire(void)
+{
+    gss_credential_t *credential = talloc_zero(NULL, gss_credential_t);
+    if (!credential)
+    {
+        ld_error("Unable to allocate GSSAPI credential.\n");
+        return NULL;
+    }
+
+    OM_uint32 minor = 0;
+    OM_uint32 major = gss_acquire_cred(&minor, GSS_C_NO_NAME, GSS_C_INDEFINITE, GSS_C_NO_OID_SET,
+                                       GSS_C_INITIATE, &credential->id, NULL, NULL);
+    if (GSS_ERROR(major))
+    {
+        ld_warning("Unable to acquire GSSAPI credential - major: %u minor: %u.\n", major, minor);
+        talloc_free(credential);
+        return NULL;
+    }
+
+    return credential;
+}
+
+static int gss_cache_destructor(gss_cache_t *cache)
+{
+    if (cache->credential)
+    {
+        G_LOCK(shared_credential);
+        gss_credential_release(cache->credential);
+        G_UNLOCK(shared_credential);
+    }
+
+    return 0;
+}
+
+#endif
+
+/**
+ * @brief gss_cache_new Creates empty GSSAPI credential cache.
+ * @param[in] ctx Memory context to allocate cache on.
+ * @return
+ *        - NULL on failure.
+ *        - gss_cache_t* on success.
+ */
+gss_cache_t *gss_cache_new(TALLOC_CTX *ctx)
+{
+    gss_cache_t *cache = talloc_zero(ctx, gss_cache_t);
+    if (!cache)
+    {
+        ld_error("Unable to allocate GSSAPI credential cache.\n");
+        return NULL;
+    }
+
+#ifdef LIBDOMAIN_HAVE_GSSAPI
+    talloc_set_destructor(cache, gss_cache_destructor);
+#endif
+
+    return cache;
+}
+
+/**
+ * @brief gss_cache_credential Returns credential shared by GSSAPI binds, acquiring it on first call in process.
+ * @param[in] cache Cache to use.
+ * @return
+ *        - NULL if credential can't be acquired or GSSAPI support is disabled.
+ *        - gss_cred_id_t of the credential on success.
+ */
+void *gss_cache_credential(gss_cache_t *cache)
+{
+#ifdef LIBDOMAIN_HAVE_GSSAPI
+    if (!cache)
+    {
+        return NULL;
+    }
+
+    G_LOCK(shared_credential);
+
+    if (!shared_credential)
+    {
+        shared_credential = gss_credential_acquire();
+    }
+
+    if (cache->credential != shared_credential)
+    {
+        if (cache->credential)
+        {
+            gss_credential_release(cache->credential);
+        }
+
+        if ((cache->credential = shared_credential))
+        {
+            ++cache->credential->references;
+        }
+    }
+
+    gss_cred_id_t id = cache->credential ? cache->credential->id : GSS_C_NO_CREDENTIAL;
+
+    G_UNLOCK(shared_credential);
+
+    return id;
+#else
+    (void)(cache);
+
+    return NULL;
+#endif
+}
+
+/**
+ * @brief gss_cache_apply Makes SASL bind in progress use shared credential, acquiring it on first call.
+ * SASL context of the connection exists only while bind is in progress, so function is called from SASL
+ * interaction callback.
+ * @param[in] cache Cache to use.
+ * @param[in] ldap  LDAP handle of connection which performs GSSAPI bind.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if credential can't be shared, bind acquires its own credential.
+ */
+enum OperationReturnCode gss_cache_apply(gss_cache_t *cache, LDAP *ldap)
+{
+    void *credential = gss_cache_credential(cache);
+
+    if (!credential || !ldap || ldap_set_option(ldap, LDAP_OPT_X_SASL_GSS_CREDS, credential) != LDAP_OPT_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief gss_cache_forget_credential Drops credential, e.g. after bind with it failed because tickets expired.
+ * Next bind of any handle acquires credential again, binds of other handles which are in progress keep using
+ * the old one.
+ * @param[in] cache Cache to use.
+ */
+void gss_cache_forget_credential(gss_cache_t *cache)
+{
+#ifdef LIBDOMAIN_HAVE_GSSAPI
+    if (!cache || !cache->credential)
+    {
+        return;
+    }
+
+    G_LOCK(shared_credential);
+
+    if (shared_credential == cache->credential)
+    {
+        shared_credential = NULL;
+    }
+
+    gss_credential_release(cache->credential);
+    cache->credential = NULL;
+
+    G_UNLOCK(shared_credential);
+#else
+    (void)(cache);
+#endif
+}
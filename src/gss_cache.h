@@ -0,0 +1,35 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_GSS_CACHE_H
+#define LIB_DOMAIN_GSS_CACHE_H
+
+#include "common.h"
+
+typedef struct gss_cache_t gss_cache_t;
+
+gss_cache_t *gss_cache_new(TALLOC_CTX *ctx);
+
+void *gss_cache_credential(gss_cache_t *cache);
+enum OperationReturnCode gss_cache_apply(gss_cache_t *cache, LDAP *ldap);
+
+void gss_cache_forget_credential(gss_cache_t *cache);
+
+#endif//LIB_DOMAIN_GSS_CACHE_H
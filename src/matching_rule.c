@@ -0,0 +1,388 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "matching_rule.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+
+#define MATCHING_RULE_NAME_BUFFER_SIZE 512
+#define MATCHING_RULE_SUPERIOR_TYPE_LIMIT 16
+
+typedef struct matching_rule_s
+{
+    const char *name;
+    const char *oid;
+    enum MatchingRule rule;
+} matching_rule_t;
+
+static const matching_rule_t MATCHING_RULES[] =
+{
+    { "objectIdentifierMatch",        "2.5.13.0",                   MATCHING_RULE_CASE_IGNORE },
+    { "distinguishedNameMatch",       "2.5.13.1",                   MATCHING_RULE_DN },
+    { "caseIgnoreMatch",              "2.5.13.2",                   MATCHING_RULE_CASE_IGNORE },
+    { "caseIgnoreOrderingMatch",      "2.5.13.3",                   MATCHING_RULE_CASE_IGNORE },
+    { "caseIgnoreSubstringsMatch",    "2.5.13.4",                   MATCHING_RULE_CASE_IGNORE },
+    { "caseExactMatch",               "2.5.13.5",                   MATCHING_RULE_CASE_EXACT },
+    { "caseExactOrderingMatch",       "2.5.13.6",                   MATCHING_RULE_CASE_EXACT },
+    { "caseExactSubstringsMatch",     "2.5.13.7",                   MATCHING_RULE_CASE_EXACT },
+    { "numericStringMatch",           "2.5.13.8",                   MATCHING_RULE_NUMERIC_STRING },
+    { "numericStringOrderingMatch",   "2.5.13.9",                   MATCHING_RULE_NUMERIC_STRING },
+    { "numericStringSubstringsMatch", "2.5.13.10",                  MATCHING_RULE_NUMERIC_STRING },
+    { "booleanMatch",                 "2.5.13.13",                  MATCHING_RULE_CASE_IGNORE },
+    { "integerMatch",                 "2.5.13.14",                  MATCHING_RULE_INTEGER },
+    { "integerOrderingMatch",         "2.5.13.15",                  MATCHING_RULE_INTEGER },
+    { "octetStringMatch",             "2.5.13.17",                  MATCHING_RULE_OCTET_STRING },
+    { "octetStringOrderingMatch",     "2.5.13.18",                  MATCHING_RULE_OCTET_STRING },
+    { "uniqueMemberMatch",            "2.5.13.23",                  MATCHING_RULE_DN },
+    { "generalizedTimeMatch",         "2.5.13.27",                  MATCHING_RULE_CASE_EXACT },
+    { "generalizedTimeOrderingMatch", "2.5.13.28",                  MATCHING_RULE_CASE_EXACT },
+    { "caseExactIA5Match",            "1.3.6.1.4.1.1466.109.114.1", MATCHING_RULE_CASE_EXACT },
+    { "caseIgnoreIA5Match",           "1.3.6.1.4.1.1466.109.114.2", MATCHING_RULE_CASE_IGNORE },
+    { "caseIgnoreIA5SubstringsMatch", "1.3.6.1.4.1.1466.109.114.3", MATCHING_RULE_CASE_IGNORE },
+};
+
+// Active Directory does not publish matching rules, so they are derived from attribute syntax.
+static const matching_rule_t SYNTAX_RULES[] =
+{
+    { "Binary",                 "1.3.6.1.4.1.1466.115.121.1.5",  MATCHING_RULE_OCTET_STRING },
+    { "DN",                     "1.3.6.1.4.1.1466.115.121.1.12", MATCHING_RULE_DN },
+    { "Generalized Time",       "1.3.6.1.4.1.1466.115.121.1.24", MATCHING_RULE_CASE_EXACT },
+    { "INTEGER",                "1.3.6.1.4.1.1466.115.121.1.27", MATCHING_RULE_INTEGER },
+    { "Numeric String",         "1.3.6.1.4.1.1466.115.121.1.36", MATCHING_RULE_NUMERIC_STRING },
+    { "Octet String",           "1.3.6.1.4.1.1466.115.121.1.40", MATCHING_RULE_OCTET_STRING },
+    { "Large Integer",          "1.2.840.113556.1.4.906",        MATCHING_RULE_INTEGER },
+    { "Security Descriptor",    "1.2.840.113556.1.4.907",        MATCHING_RULE_OCTET_STRING },
+};
+
+#define number_of_elements(x)  (sizeof(x) / sizeof((x)[0]))
+
+static bool matching_rule_find(const matching_rule_t *rules, size_t n_rules, const char *name_or_oid,
+                             enum MatchingRule *rule)
+{
+    for (size_t i = 0; name_or_oid && i < n_rules; ++i)
+    {
+        if (strcasecmp(rules[i].name, name_or_oid) == 0 || strcmp(rules[i].oid, name_or_oid) == 0)
+        {
+            *rule = rules[i].rule;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief matching_rule_find_by_name Looks up matching rule by name or oid.
+ * @return
+ *        - false if rule is unknown.
+ *        - true otherwise.
+ */
+bool matching_rule_find_by_name(const char *name_or_oid, enum MatchingRule *rule)
+{
+    return matching_rule_find(MATCHING_RULES, number_of_elements(MATCHING_RULES), name_or_oid, rule);
+}
+
+/**
+ * @brief matching_rule_attribute_type Looks up type of attribute description, options are ignored.
+ */
+LDAPAttributeType *matching_rule_attribute_type(const ldap_schema_t *schema, const char *attribute)
+{
+    char name[MATCHING_RULE_NAME_BUFFER_SIZE];
+
+    size_t length = strcspn(attribute, ";");
+    if (!schema || length >= sizeof(name))
+    {
+        return NULL;
+    }
+
+    memcpy(name, attribute, length);
+    name[length] = '\0';
+
+    LDAPAttributeType *type = ldap_schema_find_attributetype(schema, name);
+
+    return type ? type : ldap_schema_get_attributetype_by_oid(schema, name);
+}
+
+/**
+ * @brief matching_rule_for_attribute Finds equality matching rule of the attribute following superior types.
+ */
+enum MatchingRule matching_rule_for_attribute(const ldap_schema_t *schema, const char *attribute)
+{
+    enum MatchingRule rule = MATCHING_RULE_CASE_IGNORE;
+
+    LDAPAttributeType *type = matching_rule_attribute_type(schema, attribute);
+
+    for (int i = 0; type && i < MATCHING_RULE_SUPERIOR_TYPE_LIMIT; ++i)
+    {
+        if (type->at_equality_oid)
+        {
+            matching_rule_find(MATCHING_RULES, number_of_elements(MATCHING_RULES), type->at_equality_oid, &rule);
+            return rule;
+        }
+
+        if (type->at_syntax_oid)
+        {
+            matching_rule_find(SYNTAX_RULES, number_of_elements(SYNTAX_RULES), type->at_syntax_oid, &rule);
+            return rule;
+        }
+
+        type = type->at_sup_oid ? matching_rule_attribute_type(schema, type->at_sup_oid) : NULL;
+    }
+
+    return rule;
+}
+
+/**
+ * @brief matching_rule_has_ordering Checks if attribute or its superior types declare ordering matching rule.
+ */
+bool matching_rule_has_ordering(const ldap_schema_t *schema, const char *attribute)
+{
+    LDAPAttributeType *type = matching_rule_attribute_type(schema, attribute);
+
+    for (int i = 0; type && i < MATCHING_RULE_SUPERIOR_TYPE_LIMIT; ++i)
+    {
+        if (type->at_ordering_oid)
+        {
+            return true;
+        }
+
+        type = type->at_sup_oid ? matching_rule_attribute_type(schema, type->at_sup_oid) : NULL;
+    }
+
+    return false;
+}
+
+static void matching_rule_put(char *buffer, size_t size, size_t *length, char c)
+{
+    if (*length + 1 < size)
+    {
+        buffer[*length] = c;
+    }
+    ++*length;
+}
+
+static char matching_rule_to_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+static bool matching_rule_is_dn_separator(char c)
+{
+    return c == ',' || c == '+' || c == '=' || c == ';';
+}
+
+/**
+ * @brief matching_rule_normalize_dn Folds case and removes insignificant spaces around separators of the DN.
+ */
+static size_t matching_rule_normalize_dn(const char *value, char *buffer, size_t size)
+{
+    size_t length = 0;
+    bool after_separator = true;
+
+    for (const char *c = value; *c; ++c)
+    {
+        if (*c == ' ')
+        {
+            const char *next = c;
+            while (*next == ' ')
+            {
+                ++next;
+            }
+
+            if (!after_separator && *next && !matching_rule_is_dn_separator(*next))
+            {
+                matching_rule_put(buffer, size, &length, ' ');
+            }
+
+            c = next - 1;
+            continue;
+        }
+
+        if (*c == '\\' && c[1])
+        {
+            matching_rule_put(buffer, size, &length, '\\');
+            matching_rule_put(buffer, size, &length, matching_rule_to_lower(*++c));
+            after_separator = false;
+            continue;
+        }
+
+        after_separator = matching_rule_is_dn_separator(*c);
+        matching_rule_put(buffer, size, &length, after_separator && *c == ';' ? ',' : matching_rule_to_lower(*c));
+    }
+
+    return length;
+}
+
+/**
+ * @brief matching_rule_normalize_integer Removes spaces, plus sign and leading zeros of the integer, so integers
+ * can be ordered by sign, length and digits. Values which are not integers are copied as is.
+ */
+static size_t matching_rule_normalize_integer(const char *value, char *buffer, size_t size)
+{
+    size_t length = 0;
+
+    const char *c = value;
+    while (*c == ' ')
+    {
+        ++c;
+    }
+
+    bool negative = *c == '-';
+    if (*c == '-' || *c == '+')
+    {
+        ++c;
+    }
+
+    const char *digits = c;
+    while (*digits == '0' && digits[1] >= '0' && digits[1] <= '9')
+    {
+        ++digits;
+    }
+
+    const char *end = digits;
+    while (*end >= '0' && *end <= '9')
+    {
+        ++end;
+    }
+
+    const char *tail = end;
+    while (*tail == ' ')
+    {
+        ++tail;
+    }
+
+    if (end == digits || *tail != '\0')
+    {
+        for (c = value; *c; ++c)
+        {
+            matching_rule_put(buffer, size, &length, *c);
+        }
+        return length;
+    }
+
+    if (negative && !(digits[0] == '0' && end == digits + 1))
+    {
+        matching_rule_put(buffer, size, &length, '-');
+    }
+    for (c = digits; c < end; ++c)
+    {
+        matching_rule_put(buffer, size, &length, *c);
+    }
+
+    return length;
+}
+
+/**
+ * @brief matching_rule_normalize Prepares value for comparison according to the matching rule. Works like snprintf.
+ * String rules remove leading and trailing spaces and collapse inner spaces, case ignore rule folds ASCII case.
+ */
+size_t matching_rule_normalize(enum MatchingRule rule, const char *value, char *buffer, size_t size)
+{
+    size_t length = 0;
+
+    switch (rule)
+    {
+    case MATCHING_RULE_DN:
+        length = matching_rule_normalize_dn(value, buffer, size);
+        break;
+    case MATCHING_RULE_OCTET_STRING:
+        for (const char *c = value; *c; ++c)
+        {
+            matching_rule_put(buffer, size, &length, *c);
+        }
+        break;
+    case MATCHING_RULE_INTEGER:
+        length = matching_rule_normalize_integer(value, buffer, size);
+        break;
+    case MATCHING_RULE_NUMERIC_STRING:
+        for (const char *c = value; *c; ++c)
+        {
+            if (*c != ' ')
+            {
+                matching_rule_put(buffer, size, &length, *c);
+            }
+        }
+        break;
+    default:
+        for (const char *c = value; *c; ++c)
+        {
+            if (*c == ' ')
+            {
+                const char *next = c;
+                while (*next == ' ')
+                {
+                    ++next;
+                }
+
+                if (length > 0 && *next)
+                {
+                    matching_rule_put(buffer, size, &length, ' ');
+                }
+
+                c = next - 1;
+                continue;
+            }
+
+            matching_rule_put(buffer, size, &length,
+                              rule == MATCHING_RULE_CASE_IGNORE ? matching_rule_to_lower(*c) : *c);
+        }
+        break;
+    }
+
+    if (size > 0)
+    {
+        buffer[length < size ? length : size - 1] = '\0';
+    }
+
+    return length;
+}
+
+
+/**
+ * @brief matching_rule_compare Orders two values normalized with the same rule.
+ * @return
+ *        - negative if left is less than right.
+ *        - zero if values are equal.
+ *        - positive if left is greater than right.
+ */
+int matching_rule_compare(enum MatchingRule rule, const char *left, const char *right)
+{
+    if (rule != MATCHING_RULE_INTEGER)
+    {
+        return strcmp(left, right);
+    }
+
+    bool left_negative = left[0] == '-';
+    bool right_negative = right[0] == '-';
+
+    if (left_negative != right_negative)
+    {
+        return left_negative ? -1 : 1;
+    }
+
+    size_t left_length = strlen(left);
+    size_t right_length = strlen(right);
+
+    int result = left_length != right_length ? (left_length < right_length ? -1 : 1) : strcmp(left, right);
+
+    return left_negative ? -result : result;
+}
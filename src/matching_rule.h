@@ -0,0 +1,49 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_MATCHING_RULE_H
+#define LIB_DOMAIN_MATCHING_RULE_H
+
+#include "schema.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+/*!
+ * @brief MatchingRule - Comparison derived from schema matching rules, used by filters and indexes.
+ */
+enum MatchingRule
+{
+    MATCHING_RULE_CASE_IGNORE    = 0,  //!< caseIgnoreMatch and friends, also the default.
+    MATCHING_RULE_CASE_EXACT     = 1,  //!< caseExactMatch, caseExactIA5Match, generalizedTimeMatch.
+    MATCHING_RULE_NUMERIC_STRING = 2,  //!< numericStringMatch, spaces are insignificant.
+    MATCHING_RULE_INTEGER        = 3,  //!< integerMatch, values are compared as numbers.
+    MATCHING_RULE_DN             = 4,  //!< distinguishedNameMatch.
+    MATCHING_RULE_OCTET_STRING   = 5,  //!< octetStringMatch, values are compared byte by byte.
+};
+
+bool matching_rule_find_by_name(const char *name_or_oid, enum MatchingRule *rule);
+LDAPAttributeType *matching_rule_attribute_type(const ldap_schema_t *schema, const char *attribute);
+enum MatchingRule matching_rule_for_attribute(const ldap_schema_t *schema, const char *attribute);
+bool matching_rule_has_ordering(const ldap_schema_t *schema, const char *attribute);
+
+size_t matching_rule_normalize(enum MatchingRule rule, const char *value, char *buffer, size_t size);
+int matching_rule_compare(enum MatchingRule rule, const char *left, const char *right);
+
+#endif //LIB_DOMAIN_MATCHING_RULE_H
@@ -30,86 +30,22 @@
 #include <ldap.h>
 #include <ldap_schema.h>
 
-char* LDAP_ATTRIBUTE_TYPES[] = { "attributetypes", NULL };
-char* LDAP_OBJECT_CLASSES[] = { "objectclasses", NULL };
+#include <strings.h>
 
-typedef enum OperationReturnCode (*op_fn)(char *attribute_value, void* user_data);
+static char* LDAP_SCHEMA_ATTRIBUTES[] = { "attributetypes", "objectclasses", NULL };
 
-/**
- * @brief ldap_schema_read_entry   Reads attribute values of entry and writes to output parameter.
- * @param[in] entry                Entry to work with.
- * @param[in] callback             Callback for processing attribute values.
- * @param[in] user_data            An output parameter for returning data from callback.
- * @return
- *        - RETURN_CODE_SUCCESS on success.
- *        - RETURN_CODE_FAILURE on failure.
- */
-static enum OperationReturnCode
-ldap_schema_read_entry(ld_entry_t* entry, op_fn callback, void* user_data)
+static int attribute_type_destructor(LDAPAttributeType **attribute_type)
 {
-    LDAPAttribute_t** attributes = ld_entry_get_attributes(entry); // TODO: Check memory leak
-
-    if (attributes == NULL)
-    {
-        return RETURN_CODE_SUCCESS;
-    }
-
-    int index = 0;
-    LDAPAttribute_t* current_attribute = attributes[index];
-    while (current_attribute != NULL)
-    {
-        if (current_attribute->values == NULL)
-        {
-            continue;
-        }
-
-        int value_index = 0;
-        char* current_value = current_attribute->values[value_index];
-        while (current_value != NULL)
-        {
-            if (callback(current_value, user_data) == RETURN_CODE_FAILURE)
-            {
-                return RETURN_CODE_FAILURE;
-            }
-
-            current_value = current_attribute->values[++value_index];
-        }
-        current_attribute = attributes[++index];
-    }
+    ldap_attributetype_free(*attribute_type);
 
-    return RETURN_CODE_SUCCESS;
+    return 0;
 }
 
-/**
- * @brief ldap_schema_callback_common   This callback processes LDAP attributes from entries with a callback parameter.
- * @param[in] connection                Connection to work with.
- * @param[in] entries                   Entries to work with.
- * @param[in] callback                  Callback for processing attribute values.
- * @param[in] user_data                 An output parameter for returning data from callback.
- * @return
- *        - RETURN_CODE_SUCCESS on success.
- *        - RETURN_CODE_FAILURE on failure.
- */
-static enum OperationReturnCode
-ldap_schema_callback_common(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, op_fn callback, void* user_data)
+static int object_class_destructor(LDAPObjectClass **object_class)
 {
-    if (entries != NULL && entries[0] != NULL)
-    {
-        int index = 0;
-        ld_entry_t* current_entry = entries[index];
-
-        while (current_entry != NULL)
-        {
-            if (ldap_schema_read_entry(current_entry, callback, user_data) == RETURN_CODE_FAILURE)
-            {
-                return RETURN_CODE_FAILURE;
-            }
+    ldap_objectclass_free(*object_class);
 
-            current_entry = entries[++index];
-        }
-    }
-
-    return RETURN_CODE_SUCCESS;
+    return 0;
 }
 
 /**
@@ -132,13 +68,21 @@ static enum OperationReturnCode attribute_type_callback(char *attribute_value, v
         ld_error("Error: %d %s\n", error_code, error_message);
         return RETURN_CODE_FAILURE;
     }
-    else
+
+    // Attribute type is allocated by libldap, it is released together with the schema.
+    LDAPAttributeType **owner = talloc(schema, LDAPAttributeType*);
+    if (!owner)
     {
-        if (!ldap_schema_append_attributetype(schema, attribute_type))
-        {
-            ld_error("Error: unable to add attribute type to the schema!\n");
-            return RETURN_CODE_FAILURE;
-        }
+        ldap_attributetype_free(attribute_type);
+        return RETURN_CODE_FAILURE;
+    }
+    *owner = attribute_type;
+    talloc_set_destructor(owner, attribute_type_destructor);
+
+    if (!ldap_schema_append_attributetype(schema, attribute_type))
+    {
+        ld_error("Error: unable to add attribute type to the schema!\n");
+        return RETURN_CODE_FAILURE;
     }
 
     return RETURN_CODE_SUCCESS;
@@ -165,50 +109,45 @@ static enum OperationReturnCode object_class_callback(char *attribute_value, voi
         ld_error("Error: %d %s\n", error_code, error_message);
         return RETURN_CODE_FAILURE;
     }
-    else
+
+    // Object class is allocated by libldap, it is released together with the schema.
+    LDAPObjectClass **owner = talloc(schema, LDAPObjectClass*);
+    if (!owner)
     {
-        if (!ldap_schema_append_objectclass(schema, object_class))
-        {
-            ld_error("Error: unable to add class to the schema!\n");
-            return RETURN_CODE_FAILURE;
-        }
+        ldap_objectclass_free(object_class);
+        return RETURN_CODE_FAILURE;
     }
+    *owner = object_class;
+    talloc_set_destructor(owner, object_class_destructor);
 
-    return RETURN_CODE_SUCCESS;
-}
+    if (!ldap_schema_append_objectclass(schema, object_class))
+    {
+        ld_error("Error: unable to add class to the schema!\n");
+        return RETURN_CODE_FAILURE;
+    }
 
-/**
- * @brief ldap_schema_attribute_types_search_callback   This callback wraps ldap_schema_callback_common for attribute type appending to schema.
- * @param[in] connection                                Connection to work with.
- * @param[in] entries                                   Entries to work with.
- * @param[in] user_data                                 An output parameter for returning data (schema in this case) from callback.
- * @return
- *        - RETURN_CODE_SUCCESS on success.
- *        - RETURN_CODE_FAILURE on failure.
- */
-static enum OperationReturnCode
-ldap_schema_attribute_types_search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
-{
-    return ldap_schema_callback_common(connection, entries, &attribute_type_callback, user_data);
+    return RETURN_CODE_SUCCESS;
 }
 
 /**
- * @brief ldap_schema_object_classes_search_callback    This callback wraps ldap_schema_callback_common for object class appending to schema.
- * @param[in] connection                                Connection to work with.
- * @param[in] entries                                   Entries to work with.
- * @param[in] user_data                                 An output parameter for returning data (schema in this case) from callback.
+ * @brief ldap_schema_subschema_search_callback This callback appends attribute types and object classes
+ *                                              of subschema entry to schema.
+ * @param[in] connection                        Connection to work with.
+ * @param[in] entries                           Entries to work with.
+ * @param[in] user_data                         An output parameter for returning data (schema in this case) from callback.
  * @return
  *        - RETURN_CODE_SUCCESS on success.
  *        - RETURN_CODE_FAILURE on failure.
  */
 static enum OperationReturnCode
-ldap_schema_object_classes_search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
+ldap_schema_subschema_search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
 {
-    return ldap_schema_callback_common(connection, entries, &object_class_callback, user_data);
+    return ldap_schema_read_subschema(connection, entries, attribute_type_callback, object_class_callback, user_data);
 }
 
 /**
  * @brief schema_load_openldap  Loads the schema of OpenLDAP directory type from the connection.
+ * Attribute types and object classes are requested with a single search.
  * @param[in] connection        Connection to work with.
  * @param[in] schema            Schema for loading data from connection.
  * @return
@@ -218,37 +157,25 @@ ldap_schema_object_classes_search_callback(struct ldap_connection_ctx_t *connect
 enum OperationReturnCode
 schema_load_openldap(struct ldap_connection_ctx_t* connection, struct ldap_schema_t* schema)
 {
-    int rc = RETURN_CODE_SUCCESS;
     const char* search_base = "cn=subschema";
 
-    rc = search(connection,
-                search_base,
-                LDAP_SCOPE_BASE,
-                "(objectclass=subschema)",
-                LDAP_ATTRIBUTE_TYPES,
-                false,
-                &ldap_schema_attribute_types_search_callback,
-                schema);
-
-    if (rc != RETURN_CODE_SUCCESS)
+    if (connection->root_dse && connection->root_dse->subschema_subentry)
     {
-        ld_error("schema_load_openldap - unable to search attribute types.\n");
-
-        return RETURN_CODE_FAILURE;
+        search_base = connection->root_dse->subschema_subentry;
     }
 
-    rc = search(connection,
-                search_base,
-                LDAP_SCOPE_BASE,
-                "(objectclass=subschema)",
-                LDAP_OBJECT_CLASSES,
-                false,
-                &ldap_schema_object_classes_search_callback,
-                schema);
+    int rc = search(connection,
+                    search_base,
+                    LDAP_SCOPE_BASE,
+                    "(objectclass=subschema)",
+                    LDAP_SCHEMA_ATTRIBUTES,
+                    false,
+                    &ldap_schema_subschema_search_callback,
+                    schema);
 
     if (rc != RETURN_CODE_SUCCESS)
     {
-        ld_error("schema_load_openldap - unable to search object classes.\n");
+        ld_error("schema_load_openldap - unable to search schema.\n");
 
         return RETURN_CODE_FAILURE;
     }
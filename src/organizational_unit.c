@@ -23,6 +23,8 @@
 #include "domain_p.h"
 #include "entry.h"
 
+#include <string.h>
+
 enum OUAttributeIndex
 {
     OBJECT_CLASS = 0,
@@ -71,6 +73,39 @@ enum OperationReturnCode ld_del_ou(LDHandle *handle, const char *name, const cha
     return ld_del_entry(handle, name, parent ? parent : handle ? handle->global_config->base_dn : NULL, "ou");
 }
 
+/**
+ * @brief ld_del_ou_tree Deletes the OU with everything it contains.
+ * @param[in] handle      Pointer to libdomain session handle.
+ * @param[in] name        Name of the OU.
+ * @param[in] parent      Parent container that holds the OU.
+ * @param[in] callback    Callback to call once OU is deleted. Can be NULL.
+ * @param[in] user_data   User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_del_ou_tree(LDHandle *handle, const char *name, const char *parent,
+                                        subtree_callback_fn callback, void *user_data)
+{
+    check_handle(handle, "ld_del_ou_tree");
+
+    if (!name || strlen(name) == 0)
+    {
+        ld_error("ld_del_ou_tree - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *dn = talloc_asprintf(talloc_ctx, "ou=%s,%s", name, parent ? parent : handle->global_config->base_dn);
+
+    enum OperationReturnCode rc = ld_del_tree(handle, dn, callback, user_data);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
+
 /**
  * @brief ld_mod_ou    Modifies the OU.
  * @param[in] handle       Pointer to libdomain session handle.
@@ -100,3 +135,117 @@ enum OperationReturnCode ld_rename_ou(LDHandle *handle, const char *old_name, co
 {
     return ld_rename_entry(handle, old_name, new_name, parent ? parent : handle ? handle->global_config->base_dn : NULL, "ou");
 }
+
+#define OU_LIST_PAGE_SIZE 500
+
+static const char *OU_ATTRIBUTES[] =
+{
+    "ou", "description", NULL
+};
+
+static const char *OU_FILTER = "(objectClass=organizationalUnit)";
+
+static void *ou_from_entry(TALLOC_CTX *ctx, int directory_type, ld_entry_t *entry)
+{
+    (void)(directory_type);
+
+    const char *dn = ld_entry_get_dn(entry);
+
+    // Last message of search result chain carries no entry.
+    if (!dn || strlen(dn) == 0)
+    {
+        return NULL;
+    }
+
+    ld_ou_t *ou = talloc_zero(ctx, ld_ou_t);
+    if (!ou)
+    {
+        return NULL;
+    }
+
+    // Attributes reference values stored in the entry, so OU takes ownership of the entry.
+    talloc_steal(ou, entry);
+    ou->attributes = ld_entry_get_attributes(entry);
+
+    ou->dn = talloc_strdup(ou, dn);
+    ou->name = ld_entry_get_first_value(entry, "ou");
+    ou->description = ld_entry_get_first_value(entry, "description");
+
+    return ou;
+}
+
+/**
+ * @brief ld_get_ou Reads single OU and passes it to the callback as a compact ld_ou_t.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] name       Name of the OU.
+ * @param[in] parent     Parent container that holds the OU. Can be NULL than base dn will be used.
+ * @param[in] attributes Attributes to request from the server. Can be NULL than attributes needed to fill
+ *                       ld_ou_t will be requested.
+ * @param[in] callback   Callback to receive the OU.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_get_ou(LDHandle *handle,
+                                   const char *name,
+                                   const char *parent,
+                                   const char **attributes,
+                                   ou_list_callback_fn callback,
+                                   void *user_data)
+{
+    check_handle(handle, "ld_get_ou");
+
+    if (!name || !callback)
+    {
+        ld_error("ld_get_ou - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *dn = talloc_asprintf(talloc_ctx, "ou=%s,%s", name,
+                                     parent && strlen(parent) > 0 ? parent : handle->global_config->base_dn);
+
+    int rc = search_entry_views(handle, dn, LDAP_SCOPE_BASE, OU_FILTER,
+                                (char**)(attributes ? attributes : OU_ATTRIBUTES), OU_LIST_PAGE_SIZE,
+                                ou_from_entry, (entry_view_callback_fn)callback, user_data);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
+
+/**
+ * @brief ld_list_ous Lists OUs of the container using paged search and passes them to the callback
+ * as compact ld_ou_t.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] parent     Container to search OUs in. Can be NULL than base dn will be used.
+ * @param[in] attributes Attributes to request from the server. Can be NULL than attributes needed to fill
+ *                       ld_ou_t will be requested.
+ * @param[in] callback   Callback to receive the OUs.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_list_ous(LDHandle *handle,
+                                     const char *parent,
+                                     const char **attributes,
+                                     ou_list_callback_fn callback,
+                                     void *user_data)
+{
+    check_handle(handle, "ld_list_ous");
+
+    if (!callback)
+    {
+        ld_error("ld_list_ous - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    const char *base_dn = parent && strlen(parent) > 0 ? parent : handle->global_config->base_dn;
+
+    return search_entry_views(handle, base_dn, LDAP_SCOPE_SUBTREE, OU_FILTER,
+                              (char**)(attributes ? attributes : OU_ATTRIBUTES), OU_LIST_PAGE_SIZE,
+                              ou_from_entry, (entry_view_callback_fn)callback, user_data);
+}
@@ -23,9 +23,43 @@
 
 #include "common.h"
 #include "domain.h"
+#include "subtree.h"
+
+/*!
+ * @brief ld_ou_t - Compact view of the organizational unit entry.
+ */
+typedef struct ld_ou_s
+{
+    const char *dn;                  //!< Distinguished name of the OU.
+    const char *name;                //!< Name of the OU.
+    const char *description;         //!< Description of the OU.
+    LDAPAttribute_t **attributes;    //!< All attributes returned by the server, NULL terminated.
+} ld_ou_t;
+
+/*!
+ * @brief ou_list_callback_fn Callback which receives OUs. OUs are released after callback returns,
+ * use talloc_steal to keep them. On failure result_code holds error returned by the server,
+ * LDAP_NO_SUCH_OBJECT if requested OU does not exist, and OUs are NULL.
+ */
+typedef enum OperationReturnCode (*ou_list_callback_fn)(LDHandle *handle, int result_code, ld_ou_t **ous,
+                                                        void *user_data);
 
 enum OperationReturnCode ld_add_ou(LDHandle *handle, const char *name, LDAPAttribute_t **ou_attrs, const char *parent);
 enum OperationReturnCode ld_del_ou(LDHandle *handle, const char *name, const char *parent);
+enum OperationReturnCode ld_del_ou_tree(LDHandle *handle, const char *name, const char *parent,
+                                        subtree_callback_fn callback, void *user_data);
 enum OperationReturnCode ld_mod_ou(LDHandle *handle, const char *name, const char *parent, LDAPAttribute_t **ou_attrs);
 enum OperationReturnCode ld_rename_ou(LDHandle *handle, const char *old_name, const char *new_name, const char *parent);
+
+enum OperationReturnCode ld_get_ou(LDHandle *handle,
+                                   const char *name,
+                                   const char *parent,
+                                   const char **attributes,
+                                   ou_list_callback_fn callback,
+                                   void *user_data);
+enum OperationReturnCode ld_list_ous(LDHandle *handle,
+                                     const char *parent,
+                                     const char **attributes,
+                                     ou_list_callback_fn callback,
+                                     void *user_data);
 #endif //LIB_DOMAIN_ORGANIZATIONAL_UNIT_H
@@ -0,0 +1,174 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "pipeline.h"
+
+/*!
+ * @brief pipeline_t - State of operations submitted through the request window.
+ */
+typedef struct pipeline_s
+{
+    struct ldap_connection_ctx_t *connection;    //!< Connection operations are submitted to.
+    int count;                                   //!< Number of operations.
+    int index;                                   //!< Next operation to submit.
+    int submitted;                               //!< Number of submitted operations.
+    int failed;                                  //!< Number of operations which were not submitted.
+
+    pipeline_submit_fn submit;                   //!< Callback to submit operation.
+    pipeline_complete_fn complete;               //!< Callback to call once every operation was submitted.
+    void *user_data;                             //!< User data to pass to callbacks.
+
+    connection_writable_waiter_t waiter;         //!< Entry of the queue of operations waiting for request window.
+
+    const connection_identity_t *identity;       //!< Identity and priority class operations are submitted with.
+    connection_identity_t started_identity;      //!< Identity current when pipeline was started.
+} pipeline_t;
+
+static void pipeline_on_writable(struct ldap_connection_ctx_t *connection, void *user_data);
+
+/**
+ * @brief pipeline_pump Submits operations until window of the connection is full or every operation is submitted.
+ * @param[in] pipeline Pipeline to work with.
+ */
+static void pipeline_pump(pipeline_t *pipeline)
+{
+    struct ldap_connection_ctx_t *connection = pipeline->connection;
+
+    while (pipeline->index < pipeline->count)
+    {
+        // Identity of the connection may have changed while pipeline waited for the window.
+        connection_identity_t previous_identity;
+        connection_apply_identity(connection, pipeline->identity, &previous_identity);
+
+        enum OperationReturnCode rc = pipeline->submit(connection, pipeline->index, pipeline->user_data);
+
+        connection_apply_identity(connection, &previous_identity, NULL);
+
+        if (rc == RETURN_CODE_WOULD_BLOCK)
+        {
+            connection_wait_writable(connection, &pipeline->waiter);
+            return;
+        }
+
+        if (rc == RETURN_CODE_SUCCESS)
+        {
+            ++pipeline->submitted;
+        }
+        else
+        {
+            ++pipeline->failed;
+        }
+
+        ++pipeline->index;
+    }
+
+    // Completion callback may release memory pipeline was allocated on.
+    pipeline_complete_fn complete = pipeline->complete;
+    int submitted = pipeline->submitted;
+    int failed = pipeline->failed;
+    void *user_data = pipeline->user_data;
+
+    talloc_free(pipeline);
+
+    if (complete)
+    {
+        complete(connection, submitted, failed, user_data);
+    }
+}
+
+static void pipeline_on_writable(struct ldap_connection_ctx_t *connection, void *user_data)
+{
+    (void)(connection);
+
+    pipeline_pump(talloc_get_type_abort(user_data, pipeline_t));
+}
+
+static int pipeline_destructor(pipeline_t *pipeline)
+{
+    // Pipeline freed together with its memory context stops waiting for the window.
+    connection_cancel_wait_writable(pipeline->connection, &pipeline->waiter);
+
+    return 0;
+}
+
+/**
+ * @brief pipeline_start Submits count operations keeping as many of them in flight as request window allows.
+ * Submission stops when window is full and continues once window opens, pipelines which wait for the window are
+ * resumed in turn. Every operation is submitted on behalf of the same identity and with the same priority class.
+ * Completion callback may be called before function returns.
+ * @param[in] ctx        Memory context to allocate pipeline on.
+ * @param[in] connection Connection to submit operations to.
+ * @param[in] identity   Identity to submit operations with, must outlive the pipeline. When NULL identity current
+ *                       at the start is used.
+ * @param[in] count      Number of operations.
+ * @param[in] submit     Callback to submit single operation.
+ * @param[in] complete   Callback to call once every operation was submitted. Can be NULL.
+ * @param[in] user_data  User data to pass to callbacks.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode pipeline_start(TALLOC_CTX *ctx,
+                                        struct ldap_connection_ctx_t *connection,
+                                        const connection_identity_t *identity,
+                                        int count,
+                                        pipeline_submit_fn submit,
+                                        pipeline_complete_fn complete,
+                                        void *user_data)
+{
+    if (!connection || !submit || count < 0)
+    {
+        ld_error("pipeline_start - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    pipeline_t *pipeline = talloc_zero(ctx, pipeline_t);
+    if (!pipeline)
+    {
+        ld_error("pipeline_start - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    pipeline->connection = connection;
+    pipeline->count = count;
+    pipeline->submit = submit;
+    pipeline->complete = complete;
+    pipeline->user_data = user_data;
+    pipeline->waiter.callback = pipeline_on_writable;
+    pipeline->waiter.user_data = pipeline;
+    pipeline->identity = identity;
+
+    if (!identity)
+    {
+        if (connection_save_identity(pipeline, connection, &pipeline->started_identity) != RETURN_CODE_SUCCESS)
+        {
+            talloc_free(pipeline);
+            return RETURN_CODE_FAILURE;
+        }
+
+        pipeline->identity = &pipeline->started_identity;
+    }
+
+    talloc_set_destructor(pipeline, pipeline_destructor);
+
+    pipeline_pump(pipeline);
+
+    return RETURN_CODE_SUCCESS;
+}
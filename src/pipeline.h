@@ -0,0 +1,51 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_PIPELINE_H
+#define LIB_DOMAIN_PIPELINE_H
+
+#include "common.h"
+#include "connection.h"
+
+/*!
+ * @brief pipeline_submit_fn Submits operation with given index.
+ * Returns RETURN_CODE_WOULD_BLOCK to be called again with the same index once window opens.
+ */
+typedef enum OperationReturnCode (*pipeline_submit_fn)(struct ldap_connection_ctx_t *connection,
+                                                       int index,
+                                                       void *user_data);
+
+/*!
+ * @brief pipeline_complete_fn Called once every operation was submitted.
+ */
+typedef void (*pipeline_complete_fn)(struct ldap_connection_ctx_t *connection,
+                                     int submitted,
+                                     int failed,
+                                     void *user_data);
+
+enum OperationReturnCode pipeline_start(TALLOC_CTX *ctx,
+                                        struct ldap_connection_ctx_t *connection,
+                                        const connection_identity_t *identity,
+                                        int count,
+                                        pipeline_submit_fn submit,
+                                        pipeline_complete_fn complete,
+                                        void *user_data);
+
+#endif //LIB_DOMAIN_PIPELINE_H
@@ -0,0 +1,347 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "request_scheduler.h"
+
+/*!
+ * @brief request_class - Queue of deferred operations of one priority class.
+ */
+struct request_class
+{
+    struct Deferred_Request_s* head;
+    struct Deferred_Request_s* tail;
+
+    unsigned int weight;                       //!< Number of operations class may submit during its turn.
+    unsigned int limit;                        //!< Maximum number of outstanding operations, 0 if unlimited.
+    unsigned int outstanding;                  //!< Number of submitted operations awaiting result.
+    unsigned int pending;                      //!< Number of deferred operations.
+    unsigned int credit;                       //!< Operations left to submit during current turn.
+};
+
+/*!
+ * @brief request_scheduler - Weighted round robin over priority classes.
+ *
+ * Operation is submitted immediately when its class has no deferred operations and is below its limit.
+ * Otherwise operation is deferred and later released by request_scheduler_next(), which visits classes
+ * in turn and lets each class submit up to its weight of operations per turn.
+ */
+struct request_scheduler
+{
+    struct request_class classes[REQUEST_PRIORITY_COUNT];
+    int current;
+};
+
+static const unsigned int DEFAULT_WEIGHTS[REQUEST_PRIORITY_COUNT] = { 8, 2, 1 };
+static const unsigned int DEFAULT_LIMITS[REQUEST_PRIORITY_COUNT]  = { 0, 64, 8 };
+
+static bool request_scheduler_valid_priority(int priority)
+{
+    return priority >= 0 && priority < REQUEST_PRIORITY_COUNT;
+}
+
+static bool request_class_has_room(struct request_class* cls)
+{
+    return cls->limit == 0 || cls->outstanding < cls->limit;
+}
+
+/*!
+ * \brief request_scheduler_new Creates new request_scheduler with default classes.
+ * \param[in] ctx               Memory context to operate upon.
+ * \return
+ *        - NULL on error.
+ *        - Pointer to scheduler on success.
+ */
+request_scheduler *request_scheduler_new(TALLOC_CTX *ctx)
+{
+    request_scheduler* result = talloc_zero(ctx, struct request_scheduler);
+    if (!result)
+    {
+        ld_error("Unable to allocate request_scheduler.\n");
+
+        return NULL;
+    }
+
+    for (int i = 0; i < REQUEST_PRIORITY_COUNT; ++i)
+    {
+        result->classes[i].weight = DEFAULT_WEIGHTS[i];
+        result->classes[i].limit = DEFAULT_LIMITS[i];
+    }
+
+    result->current = REQUEST_PRIORITY_INTERACTIVE;
+    result->classes[result->current].credit = result->classes[result->current].weight;
+
+    return result;
+}
+
+/*!
+ * \brief request_scheduler_set_class Configures priority class.
+ * \param[in] scheduler              Scheduler to operate upon.
+ * \param[in] priority               Priority class to configure.
+ * \param[in] weight                 Share of submissions class receives relatively to other classes.
+ * \param[in] limit                  Maximum number of outstanding operations, 0 if unlimited.
+ * \return
+ *        - OPERATION_ERROR_INVALID_PARAMETER if @var{scheduler} is NULL or arguments are invalid.
+ *        - OPERATION_SUCCESS on success.
+ */
+enum RequestQueueErrorCode request_scheduler_set_class(request_scheduler *scheduler, int priority,
+                                                       unsigned int weight, unsigned int limit)
+{
+    if (!scheduler || !request_scheduler_valid_priority(priority) || weight == 0)
+    {
+        return OPERATION_ERROR_INVALID_PARAMETER;
+    }
+
+    scheduler->classes[priority].weight = weight;
+    scheduler->classes[priority].limit = limit;
+
+    return OPERATION_SUCCESS;
+}
+
+/*!
+ * \brief request_scheduler_can_submit Checks if operation of given class may be submitted right away.
+ * \param[in] scheduler                Scheduler to operate upon.
+ * \param[in] priority                 Priority class of operation.
+ * \return
+ *        - true if operation may be submitted.
+ *        - false if operation must be deferred.
+ */
+bool request_scheduler_can_submit(request_scheduler *scheduler, int priority)
+{
+    if (!scheduler || !request_scheduler_valid_priority(priority))
+    {
+        return true;
+    }
+
+    struct request_class* cls = &scheduler->classes[priority];
+
+    return cls->head == NULL && request_class_has_room(cls);
+}
+
+/*!
+ * \brief request_scheduler_defer Stores operation until its class is allowed to submit it.
+ * \param[in] scheduler           Scheduler to operate upon.
+ * \param[in] priority            Priority class of operation.
+ * \param[in] dispatch            Function to submit operation with.
+ * \param[in] operation           Talloc allocated arguments of operation, scheduler takes ownership.
+ * \param[in] handle              Handle to cancel operation with.
+ * \return
+ *        - OPERATION_ERROR_INVALID_PARAMETER if arguments are invalid.
+ *        - OPERATION_ERROR_FULL if we were unable to allocate node.
+ *        - OPERATION_SUCCESS on success.
+ */
+enum RequestQueueErrorCode request_scheduler_defer(request_scheduler *scheduler, int priority,
+                                                   request_scheduler_dispatch_fn dispatch, void *operation,
+                                                   int handle)
+{
+    if (!scheduler || !dispatch || !request_scheduler_valid_priority(priority))
+    {
+        return OPERATION_ERROR_INVALID_PARAMETER;
+    }
+
+    struct Deferred_Request_s* request = talloc_zero(scheduler, struct Deferred_Request_s);
+    if (!request)
+    {
+        ld_error("Unable to allocate deferred request.\n");
+
+        return OPERATION_ERROR_FULL;
+    }
+
+    request->dispatch = dispatch;
+    request->operation = operation ? talloc_steal(request, operation) : NULL;
+    request->priority = priority;
+    request->handle = handle;
+
+    struct request_class* cls = &scheduler->classes[priority];
+
+    if (cls->tail)
+    {
+        cls->tail->next = request;
+    }
+    else
+    {
+        cls->head = request;
+    }
+    cls->tail = request;
+    ++cls->pending;
+
+    return OPERATION_SUCCESS;
+}
+
+/*!
+ * \brief request_scheduler_cancel Drops deferred operation, operation is released without being submitted.
+ * \param[in] scheduler            Scheduler to operate upon.
+ * \param[in] handle               Handle operation was deferred with.
+ * \return
+ *        - true if operation was dropped.
+ *        - false if there is no deferred operation with such handle.
+ */
+bool request_scheduler_cancel(request_scheduler *scheduler, int handle)
+{
+    if (!scheduler)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < REQUEST_PRIORITY_COUNT; ++i)
+    {
+        struct request_class* cls = &scheduler->classes[i];
+        struct Deferred_Request_s* previous = NULL;
+
+        for (struct Deferred_Request_s* request = cls->head; request; previous = request, request = request->next)
+        {
+            if (request->handle != handle)
+            {
+                continue;
+            }
+
+            if (previous)
+            {
+                previous->next = request->next;
+            }
+            else
+            {
+                cls->head = request->next;
+            }
+
+            if (cls->tail == request)
+            {
+                cls->tail = previous;
+            }
+            --cls->pending;
+
+            talloc_free(request);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * \brief request_scheduler_next Picks next deferred operation which may be submitted.
+ * \param[in] scheduler          Scheduler to operate upon.
+ * \return
+ *        - NULL if no operation may be submitted now.
+ *        - Deferred operation, caller must dispatch it and free it with talloc_free.
+ */
+struct Deferred_Request_s *request_scheduler_next(request_scheduler *scheduler)
+{
+    if (!scheduler)
+    {
+        return NULL;
+    }
+
+    // Every class receives a fresh turn before we give up.
+    for (int visited = 0; visited <= REQUEST_PRIORITY_COUNT; ++visited)
+    {
+        struct request_class* cls = &scheduler->classes[scheduler->current];
+
+        if (cls->head && cls->credit > 0 && request_class_has_room(cls))
+        {
+            struct Deferred_Request_s* result = cls->head;
+
+            cls->head = result->next;
+            if (!cls->head)
+            {
+                cls->tail = NULL;
+            }
+            --cls->pending;
+            --cls->credit;
+
+            result->next = NULL;
+
+            return result;
+        }
+
+        cls->credit = 0;
+
+        scheduler->current = (scheduler->current + 1) % REQUEST_PRIORITY_COUNT;
+        scheduler->classes[scheduler->current].credit = scheduler->classes[scheduler->current].weight;
+    }
+
+    return NULL;
+}
+
+/*!
+ * \brief request_scheduler_on_submit Accounts operation which was sent to the server.
+ * \param[in] scheduler               Scheduler to operate upon.
+ * \param[in] priority                Priority class of operation.
+ */
+void request_scheduler_on_submit(request_scheduler *scheduler, int priority)
+{
+    if (scheduler && request_scheduler_valid_priority(priority))
+    {
+        ++scheduler->classes[priority].outstanding;
+    }
+}
+
+/*!
+ * \brief request_scheduler_on_complete Accounts operation which result was received or which was abandoned.
+ * \param[in] scheduler                 Scheduler to operate upon.
+ * \param[in] priority                  Priority class of operation.
+ */
+void request_scheduler_on_complete(request_scheduler *scheduler, int priority)
+{
+    if (scheduler && request_scheduler_valid_priority(priority) && scheduler->classes[priority].outstanding > 0)
+    {
+        --scheduler->classes[priority].outstanding;
+    }
+}
+
+/*!
+ * \brief request_scheduler_reset Forgets outstanding operations, e.g. after connection was reestablished.
+ * Deferred operations are kept.
+ * \param[in] scheduler           Scheduler to operate upon.
+ */
+void request_scheduler_reset(request_scheduler *scheduler)
+{
+    if (!scheduler)
+    {
+        return;
+    }
+
+    for (int i = 0; i < REQUEST_PRIORITY_COUNT; ++i)
+    {
+        scheduler->classes[i].outstanding = 0;
+    }
+}
+
+/*!
+ * \brief request_scheduler_outstanding Returns number of outstanding operations of the class.
+ * \param[in] scheduler                 Scheduler to operate upon.
+ * \param[in] priority                  Priority class.
+ * \return Number of operations.
+ */
+unsigned int request_scheduler_outstanding(request_scheduler *scheduler, int priority)
+{
+    return scheduler && request_scheduler_valid_priority(priority) ? scheduler->classes[priority].outstanding : 0;
+}
+
+/*!
+ * \brief request_scheduler_pending Returns number of deferred operations of the class.
+ * \param[in] scheduler             Scheduler to operate upon.
+ * \param[in] priority              Priority class.
+ * \return Number of operations.
+ */
+unsigned int request_scheduler_pending(request_scheduler *scheduler, int priority)
+{
+    return scheduler && request_scheduler_valid_priority(priority) ? scheduler->classes[priority].pending : 0;
+}
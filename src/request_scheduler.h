@@ -0,0 +1,84 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_REQUEST_SCHEDULER_H
+#define LIB_DOMAIN_REQUEST_SCHEDULER_H
+
+#include "common.h"
+#include "request_queue.h"
+
+#include <stdbool.h>
+
+typedef struct request_scheduler request_scheduler;
+
+/*!
+ * @brief RequestPriority - Priority classes of outgoing operations.
+ */
+enum RequestPriority
+{
+    REQUEST_PRIORITY_INTERACTIVE = 0,          //!< Short lookups issued on behalf of the user.
+    REQUEST_PRIORITY_BULK        = 1,          //!< Large exports and mass modifications.
+    REQUEST_PRIORITY_BACKGROUND  = 2,          //!< Maintenance work that may wait indefinitely.
+
+    REQUEST_PRIORITY_COUNT       = 3           //!< Number of priority classes.
+};
+
+typedef enum OperationReturnCode (*request_scheduler_dispatch_fn)(void *connection, void *operation);
+
+/*!
+ * @brief Deferred_Request_s - Operation that waits for its priority class to get a free slot.
+ */
+struct Deferred_Request_s
+{
+    struct Deferred_Request_s* next;           //!< Next operation of the same class.
+    request_scheduler_dispatch_fn dispatch;    //!< Function that submits operation.
+    void *operation;                           //!< Arguments of operation, owned by this node.
+    int priority;                              //!< Priority class of operation.
+    int handle;                                //!< Handle caller may cancel operation with before it is submitted.
+};
+
+request_scheduler*
+request_scheduler_new(TALLOC_CTX* ctx);
+
+enum RequestQueueErrorCode
+request_scheduler_set_class(request_scheduler* scheduler, int priority, unsigned int weight, unsigned int limit);
+
+bool request_scheduler_can_submit(request_scheduler* scheduler, int priority);
+
+enum RequestQueueErrorCode
+request_scheduler_defer(request_scheduler* scheduler, int priority, request_scheduler_dispatch_fn dispatch,
+                        void *operation, int handle);
+
+bool request_scheduler_cancel(request_scheduler* scheduler, int handle);
+
+struct Deferred_Request_s*
+request_scheduler_next(request_scheduler* scheduler);
+
+void request_scheduler_on_submit(request_scheduler* scheduler, int priority);
+
+void request_scheduler_on_complete(request_scheduler* scheduler, int priority);
+
+void request_scheduler_reset(request_scheduler* scheduler);
+
+unsigned int request_scheduler_outstanding(request_scheduler* scheduler, int priority);
+
+unsigned int request_scheduler_pending(request_scheduler* scheduler, int priority);
+
+#endif//LIB_DOMAIN_REQUEST_SCHEDULER_H
@@ -0,0 +1,279 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "request_timer.h"
+
+#include <time.h>
+
+/*!
+ * @brief request_timer - Binary min-heap of request deadlines.
+ *
+ * Entries are never removed when request completes. Instead stale entries are skipped by the owner when they
+ * reach the top of the heap, or dropped in bulk by request_timer_purge(). Storage grows on demand, so every entry
+ * is pushed and popped exactly once.
+ */
+struct request_timer
+{
+    struct Timer_Entry_s* entries;
+    unsigned int size;
+    unsigned int capacity;
+};
+
+static void request_timer_swap(struct Timer_Entry_s* entries, unsigned int a, unsigned int b)
+{
+    struct Timer_Entry_s tmp = entries[a];
+    entries[a] = entries[b];
+    entries[b] = tmp;
+}
+
+static void request_timer_sift_up(request_timer *timer, unsigned int index)
+{
+    while (index > 0)
+    {
+        unsigned int parent = (index - 1) / 2;
+
+        if (timer->entries[parent].deadline <= timer->entries[index].deadline)
+        {
+            break;
+        }
+
+        request_timer_swap(timer->entries, parent, index);
+        index = parent;
+    }
+}
+
+static void request_timer_sift_down(request_timer *timer, unsigned int index)
+{
+    while (true)
+    {
+        unsigned int left = index * 2 + 1;
+        unsigned int right = left + 1;
+        unsigned int smallest = index;
+
+        if (left < timer->size && timer->entries[left].deadline < timer->entries[smallest].deadline)
+        {
+            smallest = left;
+        }
+
+        if (right < timer->size && timer->entries[right].deadline < timer->entries[smallest].deadline)
+        {
+            smallest = right;
+        }
+
+        if (smallest == index)
+        {
+            break;
+        }
+
+        request_timer_swap(timer->entries, smallest, index);
+        index = smallest;
+    }
+}
+
+/*!
+ * \brief request_timer_new Creates new request_timer.
+ * \param[in] ctx           Memory context to operate upon.
+ * \param[in] capacity      Initial capacity of the timer, storage grows when it is exceeded.
+ * \return
+ *        - NULL on error.
+ *        - Pointer to timer on success.
+ */
+request_timer *request_timer_new(TALLOC_CTX *ctx, unsigned int capacity)
+{
+    request_timer* result = talloc_zero(ctx, struct request_timer);
+    if (!result)
+    {
+        ld_error("Unable to allocate request_timer.\n");
+
+        return NULL;
+    }
+
+    result->capacity = capacity > 0 ? capacity : 1;
+    result->entries = talloc_array(result, struct Timer_Entry_s, result->capacity);
+    if (!result->entries)
+    {
+        ld_error("Unable to allocate request_timer entries.\n");
+
+        talloc_free(result);
+
+        return NULL;
+    }
+
+    return result;
+}
+
+/*!
+ * \brief request_timer_push Schedules deadline for request.
+ * \param[in] timer          Timer to push to.
+ * \param[in] msgid          Message id of the request.
+ * \param[in] deadline       Monotonic time in milliseconds.
+ * \return
+ *        - OPERATION_ERROR_INVALID_PARAMETER if @var{timer} is NULL.
+ *        - OPERATION_ERROR_FULL if we were unable to grow storage.
+ *        - OPERATION_SUCCESS if push successful.
+ */
+enum RequestQueueErrorCode request_timer_push(request_timer *timer, int msgid, int64_t deadline)
+{
+    if (!timer)
+    {
+        ld_error("Attempt to push request %d into NULL timer\n", msgid);
+
+        return OPERATION_ERROR_INVALID_PARAMETER;
+    }
+
+    if (timer->size >= timer->capacity)
+    {
+        struct Timer_Entry_s* entries = talloc_realloc(timer, timer->entries, struct Timer_Entry_s,
+                                                       timer->capacity * 2);
+        if (!entries)
+        {
+            ld_error("Timer overflow - unable to grow capacity %d\n", timer->capacity);
+
+            return OPERATION_ERROR_FULL;
+        }
+
+        timer->entries = entries;
+        timer->capacity *= 2;
+    }
+
+    timer->entries[timer->size].deadline = deadline;
+    timer->entries[timer->size].msgid = msgid;
+
+    request_timer_sift_up(timer, timer->size++);
+
+    return OPERATION_SUCCESS;
+}
+
+/*!
+ * \brief request_timer_pop Removes entry with the earliest deadline.
+ * \param[in] timer         Timer to remove entry from.
+ * \param[out] entry        Removed entry. Can be NULL.
+ * \return
+ *        - OPERATION_ERROR_INVALID_PARAMETER if @var{timer} is NULL or empty.
+ *        - OPERATION_SUCCESS on success.
+ */
+enum RequestQueueErrorCode request_timer_pop(request_timer *timer, struct Timer_Entry_s *entry)
+{
+    if (!timer || timer->size == 0)
+    {
+        return OPERATION_ERROR_INVALID_PARAMETER;
+    }
+
+    if (entry)
+    {
+        *entry = timer->entries[0];
+    }
+
+    timer->entries[0] = timer->entries[--timer->size];
+
+    request_timer_sift_down(timer, 0);
+
+    return OPERATION_SUCCESS;
+}
+
+/*!
+ * \brief request_timer_peek Returns entry with the earliest deadline without removing it.
+ * \param[in] timer          Timer to operate upon.
+ * \param[out] entry         Entry with the earliest deadline.
+ * \return
+ *        - OPERATION_ERROR_INVALID_PARAMETER if @var{timer} or @var{entry} is NULL or timer is empty.
+ *        - OPERATION_SUCCESS on success.
+ */
+enum RequestQueueErrorCode request_timer_peek(request_timer *timer, struct Timer_Entry_s *entry)
+{
+    if (!timer || !entry || timer->size == 0)
+    {
+        return OPERATION_ERROR_INVALID_PARAMETER;
+    }
+
+    *entry = timer->entries[0];
+
+    return OPERATION_SUCCESS;
+}
+
+/*!
+ * \brief request_timer_empty Returns true if there are no scheduled deadlines.
+ * \param[in] timer           Timer to operate upon.
+ * \return
+ *        - true if empty.
+ *        - false if there are entries in timer.
+ */
+bool request_timer_empty(request_timer *timer)
+{
+    return !timer || timer->size == 0;
+}
+
+/*!
+ * \brief request_timer_size Returns number of scheduled deadlines including stale ones.
+ * \param[in] timer          Timer to operate upon.
+ * \return Number of entries.
+ */
+unsigned int request_timer_size(request_timer *timer)
+{
+    return timer ? timer->size : 0;
+}
+
+/*!
+ * \brief request_timer_purge Drops entries of requests that are already completed.
+ * \param[in] timer           Timer to operate upon.
+ * \param[in] alive           Predicate that returns true if request is still waiting for its deadline.
+ * \param[in] user_data       Data to pass to predicate.
+ * \return Number of removed entries.
+ */
+unsigned int request_timer_purge(request_timer *timer, request_timer_alive_fn alive, void *user_data)
+{
+    if (!timer || !alive)
+    {
+        return 0;
+    }
+
+    unsigned int kept = 0;
+
+    for (unsigned int i = 0; i < timer->size; ++i)
+    {
+        if (alive(timer->entries[i].msgid, timer->entries[i].deadline, user_data))
+        {
+            timer->entries[kept++] = timer->entries[i];
+        }
+    }
+
+    unsigned int removed = timer->size - kept;
+
+    timer->size = kept;
+
+    for (int i = (int)kept / 2 - 1; i >= 0; --i)
+    {
+        request_timer_sift_down(timer, i);
+    }
+
+    return removed;
+}
+
+/*!
+ * \brief request_timer_now Returns current monotonic time in milliseconds.
+ */
+int64_t request_timer_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
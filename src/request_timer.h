@@ -0,0 +1,63 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_REQUEST_TIMER_H
+#define LIB_DOMAIN_REQUEST_TIMER_H
+
+#include "common.h"
+#include "request_queue.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct request_timer request_timer;
+
+/*!
+ * @brief Timer_Entry_s - Deadline of a single request.
+ */
+struct Timer_Entry_s
+{
+    int64_t deadline;                          //!< Monotonic time in milliseconds when request expires.
+    int msgid;                                 //!< Message id of the request.
+};
+
+typedef bool (*request_timer_alive_fn)(int msgid, int64_t deadline, void *user_data);
+
+request_timer*
+request_timer_new(TALLOC_CTX* ctx, unsigned int capacity);
+
+enum RequestQueueErrorCode
+request_timer_push(request_timer* timer, int msgid, int64_t deadline);
+
+enum RequestQueueErrorCode
+request_timer_pop(request_timer* timer, struct Timer_Entry_s *entry);
+
+enum RequestQueueErrorCode
+request_timer_peek(request_timer* timer, struct Timer_Entry_s *entry);
+
+bool request_timer_empty(request_timer* timer);
+
+unsigned int request_timer_size(request_timer* timer);
+
+unsigned int request_timer_purge(request_timer* timer, request_timer_alive_fn alive, void *user_data);
+
+int64_t request_timer_now(void);
+
+#endif//LIB_DOMAIN_REQUEST_TIMER_H
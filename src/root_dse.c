@@ -0,0 +1,219 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "root_dse.h"
+
+#include <string.h>
+#include <strings.h>
+
+/*
+ * Operational attributes are not returned for "*", so the ones we are interested in are requested explicitly.
+ * "*" is still needed to recognize directory type, see directory_process_attribute.
+ */
+char* LDAP_ROOT_DSE_ATTRS[] =
+{
+    "*",
+    "supportedControl",
+    "supportedExtension",
+    "supportedSASLMechanisms",
+    "namingContexts",
+    "subschemaSubentry",
+    "highestCommittedUSN",
+    "dnsHostName",
+    NULL
+};
+
+static char **root_dse_get_values(TALLOC_CTX *ctx, LDAP *ldap, LDAPMessage *entry, const char *name)
+{
+    struct berval **values = ldap_get_values_len(ldap, entry, name);
+    if (!values)
+    {
+        return NULL;
+    }
+
+    int count = ldap_count_values_len(values);
+
+    char **result = talloc_array(ctx, char*, count + 1);
+    if (!result)
+    {
+        ldap_value_free_len(values);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        result[i] = talloc_strndup(result, values[i]->bv_val, values[i]->bv_len);
+    }
+    result[count] = NULL;
+
+    ldap_value_free_len(values);
+
+    return result;
+}
+
+static char *root_dse_get_value(TALLOC_CTX *ctx, LDAP *ldap, LDAPMessage *entry, const char *name)
+{
+    struct berval **values = ldap_get_values_len(ldap, entry, name);
+    if (!values)
+    {
+        return NULL;
+    }
+
+    char *result = values[0] ? talloc_strndup(ctx, values[0]->bv_val, values[0]->bv_len) : NULL;
+
+    ldap_value_free_len(values);
+
+    return result;
+}
+
+static bool root_dse_contains(char **values, const char *value, bool ignore_case)
+{
+    if (!values || !value)
+    {
+        return false;
+    }
+
+    for (int i = 0; values[i] != NULL; ++i)
+    {
+        if ((ignore_case ? strcasecmp(values[i], value) : strcmp(values[i], value)) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool root_dse_values_equal(char **first, char **second)
+{
+    if (!first || !second)
+    {
+        return first == second;
+    }
+
+    int i = 0;
+    for (; first[i] != NULL && second[i] != NULL; ++i)
+    {
+        if (strcmp(first[i], second[i]) != 0)
+        {
+            return false;
+        }
+    }
+
+    return first[i] == second[i];
+}
+
+static bool root_dse_value_equal(const char *first, const char *second)
+{
+    if (!first || !second)
+    {
+        return first == second;
+    }
+
+    return strcmp(first, second) == 0;
+}
+
+/**
+ * @brief root_dse_parse Parses rootDSE entry.
+ * @param[in] ctx   Memory context to allocate result on.
+ * @param[in] ldap  LDAP handle message belongs to.
+ * @param[in] entry Search entry returned for rootDSE request, see LDAP_ROOT_DSE_ATTRS.
+ * @return
+ *        - NULL on failure.
+ *        - ld_root_dse_t* on success.
+ */
+ld_root_dse_t *root_dse_parse(TALLOC_CTX *ctx, LDAP *ldap, LDAPMessage *entry)
+{
+    if (!ldap || !entry)
+    {
+        return NULL;
+    }
+
+    ld_root_dse_t *result = talloc_zero(ctx, ld_root_dse_t);
+    if (!result)
+    {
+        ld_error("Unable to allocate memory for rootDSE.\n");
+        return NULL;
+    }
+
+    result->supported_controls = root_dse_get_values(result, ldap, entry, "supportedControl");
+    result->supported_extensions = root_dse_get_values(result, ldap, entry, "supportedExtension");
+    result->supported_sasl_mechanisms = root_dse_get_values(result, ldap, entry, "supportedSASLMechanisms");
+    result->naming_contexts = root_dse_get_values(result, ldap, entry, "namingContexts");
+    result->subschema_subentry = root_dse_get_value(result, ldap, entry, "subschemaSubentry");
+    result->highest_committed_usn = root_dse_get_value(result, ldap, entry, "highestCommittedUSN");
+    result->dns_host_name = root_dse_get_value(result, ldap, entry, "dnsHostName");
+
+    return result;
+}
+
+/**
+ * @brief root_dse_equal Compares two rootDSE. highestCommittedUSN is ignored as it changes on every update.
+ * @param[in] first  First rootDSE.
+ * @param[in] second Second rootDSE.
+ * @return true if server advertises same capabilities and naming information.
+ */
+bool root_dse_equal(const ld_root_dse_t *first, const ld_root_dse_t *second)
+{
+    if (!first || !second)
+    {
+        return first == second;
+    }
+
+    return root_dse_values_equal(first->supported_controls, second->supported_controls)
+        && root_dse_values_equal(first->supported_extensions, second->supported_extensions)
+        && root_dse_values_equal(first->supported_sasl_mechanisms, second->supported_sasl_mechanisms)
+        && root_dse_values_equal(first->naming_contexts, second->naming_contexts)
+        && root_dse_value_equal(first->subschema_subentry, second->subschema_subentry)
+        && root_dse_value_equal(first->dns_host_name, second->dns_host_name);
+}
+
+/**
+ * @brief root_dse_supports_control Checks if server supports control.
+ * @param[in] root_dse rootDSE of the server, may be NULL.
+ * @param[in] oid      OID of the control.
+ * @return true if control is advertised.
+ */
+bool root_dse_supports_control(const ld_root_dse_t *root_dse, const char *oid)
+{
+    return root_dse && root_dse_contains(root_dse->supported_controls, oid, false);
+}
+
+/**
+ * @brief root_dse_supports_extension Checks if server supports extended operation.
+ * @param[in] root_dse rootDSE of the server, may be NULL.
+ * @param[in] oid      OID of the extended operation.
+ * @return true if extended operation is advertised.
+ */
+bool root_dse_supports_extension(const ld_root_dse_t *root_dse, const char *oid)
+{
+    return root_dse && root_dse_contains(root_dse->supported_extensions, oid, false);
+}
+
+/**
+ * @brief root_dse_supports_sasl_mechanism Checks if server supports SASL mechanism.
+ * @param[in] root_dse  rootDSE of the server, may be NULL.
+ * @param[in] mechanism Name of the mechanism, e.g. GSSAPI.
+ * @return true if mechanism is advertised.
+ */
+bool root_dse_supports_sasl_mechanism(const ld_root_dse_t *root_dse, const char *mechanism)
+{
+    return root_dse && root_dse_contains(root_dse->supported_sasl_mechanisms, mechanism, true);
+}
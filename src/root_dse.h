@@ -0,0 +1,38 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_ROOT_DSE_H
+#define LIB_DOMAIN_ROOT_DSE_H
+
+#include "common.h"
+#include "domain.h"
+
+#include <stdbool.h>
+
+extern char* LDAP_ROOT_DSE_ATTRS[];
+
+ld_root_dse_t *root_dse_parse(TALLOC_CTX *ctx, LDAP *ldap, LDAPMessage *entry);
+bool root_dse_equal(const ld_root_dse_t *first, const ld_root_dse_t *second);
+
+bool root_dse_supports_control(const ld_root_dse_t *root_dse, const char *oid);
+bool root_dse_supports_extension(const ld_root_dse_t *root_dse, const char *oid);
+bool root_dse_supports_sasl_mechanism(const ld_root_dse_t *root_dse, const char *mechanism);
+
+#endif//LIB_DOMAIN_ROOT_DSE_H
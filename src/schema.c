@@ -23,9 +23,14 @@
 #include "common.h"
 
 #include "directory.h"
+#include "domain.h"
+#include "entry.h"
+#include "connection_state_machine.h"
 
 #include <talloc.h>
 
+#include <strings.h>
+
 #include <ldap.h>
 #include <ldap_schema.h>
 
@@ -36,6 +41,22 @@
         return NULL; \
     }
 
+static int ldap_schema_destructor(ldap_schema_t *schema)
+{
+    GHashTable *tables[] = { schema->attribute_types_by_oid, schema->attribute_types_by_name,
+                             schema->object_classes_by_oid, schema->object_classes_by_name };
+
+    for (size_t i = 0; i < sizeof(tables) / sizeof(*tables); ++i)
+    {
+        if (tables[i])
+        {
+            g_hash_table_destroy(tables[i]);
+        }
+    }
+
+    return 0;
+}
+
 /*!
  * \brief ldap_schema_new Allocates ldap_schema_t and checks it for validity.
  * \param[in] ctx         TALLOC_CTX to use.
@@ -51,6 +72,8 @@ ldap_schema_new(TALLOC_CTX *ctx)
     ldap_schema_t* result = talloc_zero(ctx, struct ldap_schema_t);
     return_null_if_null(result, "Unable to allocate ldap_schema_t.\n")
 
+    talloc_set_destructor(result, ldap_schema_destructor);
+
     result->attribute_types_by_oid = g_hash_table_new(g_str_hash, g_str_equal);
     result->attribute_types_by_name = g_hash_table_new(g_str_hash, g_str_equal);
 
@@ -216,6 +239,38 @@ LDAPAttributeType *ldap_schema_get_attributetype_by_name(const ldap_schema_t* sc
     return (LDAPAttributeType *)g_hash_table_lookup(schema->attribute_types_by_name, name);
 }
 
+/*!
+ * \brief ldap_schema_find_attributetype Returns attribute type by name ignoring case of the name.
+ * \param[in] schema                     Schema to work with.
+ * \param[in] name                       One of the attribute names.
+ * \return
+ *        - NULL if schema is NULL or has no such attribute.
+ *        - Attribute type from schema.
+ */
+LDAPAttributeType *ldap_schema_find_attributetype(const ldap_schema_t* schema, const char *name)
+{
+    LDAPAttributeType *result = ldap_schema_get_attributetype_by_name(schema, name);
+
+    if (result || !schema || !schema->attribute_types_by_name || !name)
+    {
+        return result;
+    }
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, schema->attribute_types_by_name);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        if (strcasecmp(key, name) == 0)
+        {
+            return value;
+        }
+    }
+
+    return NULL;
+}
+
 /*!
  * \brief ldap_schema_append_attributetype Appends attribute type to the list of schema's attribute types.
  * \param[in] schema                       Schema to work with.
@@ -323,3 +378,68 @@ ldap_schema_ready(struct ldap_connection_ctx_t* connection)
         return true;
     }
 }
+
+/*!
+ * @brief ldap_schema_on_loaded Makes connection ready for use as soon as schema is received instead of waiting
+ *                             for the next state machine update.
+ * @param[in] connection    Connection to work with.
+ */
+void
+ldap_schema_on_loaded(struct ldap_connection_ctx_t* connection)
+{
+    if (csm_is_in_state(connection->state_machine, LDAP_CONNECTION_STATE_CHECK_SCHEMA)
+        && ldap_schema_ready(connection))
+    {
+        csm_set_state(connection->state_machine, LDAP_CONNECTION_STATE_RUN);
+
+        connection_dispatch_deferred(connection);
+    }
+}
+
+/*!
+ * @brief ldap_schema_read_subschema Passes attribute types and object classes of subschema entries to callbacks
+ *                                   which parse them in dialect of the directory, then makes connection ready.
+ * @param[in] connection              Connection to work with.
+ * @param[in] entries                 Entries returned by subschema search.
+ * @param[in] attribute_type_callback Callback to append attribute type to schema.
+ * @param[in] object_class_callback   Callback to append object class to schema.
+ * @param[in] user_data               Data to pass to callbacks, schema.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode
+ldap_schema_read_subschema(struct ldap_connection_ctx_t *connection, ld_entry_t **entries,
+                           op_fn attribute_type_callback, op_fn object_class_callback, void *user_data)
+{
+    for (int i = 0; entries != NULL && entries[i] != NULL; ++i)
+    {
+        LDAPAttribute_t** attributes = ld_entry_get_attributes(entries[i]);
+
+        for (int j = 0; attributes != NULL && attributes[j] != NULL; ++j)
+        {
+            op_fn callback = NULL;
+
+            if (strcasecmp(attributes[j]->name, "attributeTypes") == 0)
+            {
+                callback = attribute_type_callback;
+            }
+            else if (strcasecmp(attributes[j]->name, "objectClasses") == 0)
+            {
+                callback = object_class_callback;
+            }
+
+            for (int k = 0; callback != NULL && attributes[j]->values != NULL && attributes[j]->values[k] != NULL; ++k)
+            {
+                if (callback(attributes[j]->values[k], user_data) == RETURN_CODE_FAILURE)
+                {
+                    return RETURN_CODE_FAILURE;
+                }
+            }
+        }
+    }
+
+    ldap_schema_on_loaded(connection);
+
+    return RETURN_CODE_SUCCESS;
+}
@@ -46,6 +46,9 @@ bool ldap_schema_append_objectclass(ldap_schema_t* schema, LDAPObjectClass *obje
 LDAPAttributeType*
 ldap_schema_get_attributetype_by_name(const ldap_schema_t* schema, const char *name);
 
+LDAPAttributeType*
+ldap_schema_find_attributetype(const ldap_schema_t* schema, const char *name);
+
 LDAPAttributeType*
 ldap_schema_get_attributetype_by_oid(const ldap_schema_t* schema, const char *oid);
 
@@ -48,4 +48,14 @@ enum OperationReturnCode schema_load_openldap(struct ldap_connection_ctx_t* conn
 enum OperationReturnCode schema_load_active_directory(struct ldap_connection_ctx_t* connection,
                                                       struct ldap_schema_t* schema);
 
+typedef enum OperationReturnCode (*op_fn)(char *attribute_value, void* user_data);
+
+enum OperationReturnCode ldap_schema_read_subschema(struct ldap_connection_ctx_t *connection,
+                                                    struct ld_entry_s **entries,
+                                                    op_fn attribute_type_callback,
+                                                    op_fn object_class_callback,
+                                                    void *user_data);
+
+void ldap_schema_on_loaded(struct ldap_connection_ctx_t* connection);
+
 #endif//LIB_DOMAIN_SCHEMA_PRIVATE_H
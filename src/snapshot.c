@@ -0,0 +1,1569 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "snapshot.h"
+
+#include "domain_p.h"
+#include "entry_p.h"
+#include "matching_rule.h"
+#include "snapshot_file.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#define SNAPSHOT_PAGE_SIZE 500
+#define SNAPSHOT_DEFAULT_FILTER "(objectClass=*)"
+
+/*!
+ * @brief snapshot_index_item_t - Element of sorted index.
+ */
+typedef struct snapshot_index_item_s
+{
+    char *key;                       //!< Normalized value.
+    ld_entry_t *entry;               //!< Entry having the value.
+    bool erased;                     //!< Entry was removed during bulk load, item is dropped once index is sorted.
+} snapshot_index_item_t;
+
+/*!
+ * @brief snapshot_index_t - Index over values of single attribute.
+ */
+typedef struct snapshot_index_s
+{
+    char *attribute;                 //!< Name of the indexed attribute.
+    LDAPAttributeType *type;         //!< Type of the attribute, can be NULL if schema has no such attribute.
+    enum MatchingRule rule;          //!< Matching rule to normalize and order values with.
+    int types;                       //!< Combination of LdapSnapshotIndexType.
+
+    GHashTable *values;              //!< Hash index, normalized value to set of entries.
+
+    snapshot_index_item_t *items;    //!< Sorted index, ordered by value and entry address.
+    size_t n_items;                  //!< Number of elements in sorted index.
+    size_t capacity;                 //!< Capacity of sorted index.
+    size_t n_sorted;                 //!< Number of leading elements which are ordered, rest was appended in bulk.
+    bool unsorted;                   //!< Index was changed during bulk load and has to be sorted.
+} snapshot_index_t;
+
+/*!
+ * @brief ld_snapshot_t - Local copy of directory entries with secondary indexes.
+ */
+struct ld_snapshot_s
+{
+    const ldap_schema_t *schema;     //!< Schema to look up matching rules in, can be NULL.
+    GHashTable *entries;             //!< Normalized dn to entry.
+    snapshot_index_t **indexes;      //!< Attribute indexes.
+    int n_indexes;                   //!< Number of attribute indexes.
+    bool bulk;                       //!< Sorted indexes are appended to and ordered once bulk load completes.
+};
+
+/*!
+ * @brief snapshot_load_t - State of snapshot loading.
+ */
+typedef struct snapshot_load_s
+{
+    LDHandle *handle;                //!< Handle to pass to the callback.
+    ld_snapshot_t *snapshot;         //!< Snapshot to fill.
+    snapshot_callback_fn callback;   //!< Callback to call once snapshot is loaded.
+    void *user_data;                 //!< User data to pass to the callback.
+} snapshot_load_t;
+
+/*!
+ * @brief snapshot_collector_t - Accumulates unique entries found by lookup.
+ */
+typedef struct snapshot_collector_s
+{
+    TALLOC_CTX *ctx;                 //!< Memory context to allocate result on.
+    ld_entry_t **entries;            //!< Found entries.
+    int count;                       //!< Number of found entries.
+    int capacity;                    //!< Capacity of entries array without terminating NULL.
+    GHashTable *seen;                //!< Set of found entries.
+} snapshot_collector_t;
+
+static char *snapshot_normalize(TALLOC_CTX *ctx, enum MatchingRule rule, const char *value)
+{
+    size_t length = matching_rule_normalize(rule, value, NULL, 0);
+
+    char *result = talloc_array(ctx, char, length + 1);
+    if (result)
+    {
+        matching_rule_normalize(rule, value, result, length + 1);
+    }
+
+    return result;
+}
+
+static int snapshot_destructor(TALLOC_CTX *ctx)
+{
+    ld_snapshot_t *snapshot = talloc_get_type_abort(ctx, ld_snapshot_t);
+
+    for (int i = 0; i < snapshot->n_indexes; ++i)
+    {
+        snapshot_index_t *index = snapshot->indexes[i];
+
+        if (index->values)
+        {
+            g_hash_table_destroy(index->values);
+        }
+
+        for (size_t j = 0; j < index->n_items; ++j)
+        {
+            g_free(index->items[j].key);
+        }
+    }
+
+    if (snapshot->entries)
+    {
+        g_hash_table_destroy(snapshot->entries);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief ld_snapshot_new Creates empty snapshot store.
+ * @param[in] ctx    Memory context to allocate snapshot on.
+ * @param[in] schema Schema to look up matching rules of indexed attributes in, can be NULL.
+ * @return
+ *        - NULL on failure.
+ *        - snapshot.
+ */
+ld_snapshot_t *ld_snapshot_new(TALLOC_CTX *ctx, const ldap_schema_t *schema)
+{
+    ld_snapshot_t *snapshot = talloc_zero(ctx, ld_snapshot_t);
+    if (!snapshot)
+    {
+        ld_error("ld_snapshot_new - out of memory!\n");
+        return NULL;
+    }
+
+    snapshot->schema = schema;
+    snapshot->entries = g_hash_table_new(g_str_hash, g_str_equal);
+
+    talloc_set_destructor((void*)snapshot, snapshot_destructor);
+
+    if (!snapshot->entries)
+    {
+        ld_error("ld_snapshot_new - out of memory!\n");
+        talloc_free(snapshot);
+        return NULL;
+    }
+
+    return snapshot;
+}
+
+static bool snapshot_index_matches(const ld_snapshot_t *snapshot, const snapshot_index_t *index, const char *name)
+{
+    if (strcasecmp(index->attribute, name) == 0)
+    {
+        return true;
+    }
+
+    return index->type && !strchr(name, ';') && matching_rule_attribute_type(snapshot->schema, name) == index->type;
+}
+
+static snapshot_index_t *snapshot_find_index(const ld_snapshot_t *snapshot, const char *attribute)
+{
+    for (int i = 0; i < snapshot->n_indexes; ++i)
+    {
+        if (snapshot_index_matches(snapshot, snapshot->indexes[i], attribute))
+        {
+            return snapshot->indexes[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int snapshot_item_compare(const snapshot_index_t *index, const char *key, const ld_entry_t *entry,
+                                 const snapshot_index_item_t *item)
+{
+    int result = matching_rule_compare(index->rule, key, item->key);
+    if (result != 0 || !entry)
+    {
+        return result;
+    }
+
+    return (uintptr_t)entry < (uintptr_t)item->entry ? -1 : ((uintptr_t)entry > (uintptr_t)item->entry ? 1 : 0);
+}
+
+/**
+ * @brief snapshot_lower_bound Returns position of the first item not less than key and entry.
+ * If entry is NULL only keys are compared.
+ */
+static size_t snapshot_lower_bound(const snapshot_index_t *index, const char *key, const ld_entry_t *entry)
+{
+    size_t first = 0;
+    size_t last = index->n_sorted;
+
+    while (first < last)
+    {
+        size_t middle = first + (last - first) / 2;
+
+        if (snapshot_item_compare(index, key, entry, &index->items[middle]) > 0)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+static int snapshot_index_item_compare(gconstpointer left, gconstpointer right, gpointer user_data)
+{
+    const snapshot_index_item_t *item = left;
+
+    return snapshot_item_compare(user_data, item->key, item->entry, right);
+}
+
+/**
+ * @brief snapshot_index_sort Orders items changed during bulk load, erased and duplicate items are dropped.
+ */
+static void snapshot_index_sort(snapshot_index_t *index)
+{
+    if (!index->unsorted)
+    {
+        return;
+    }
+
+    size_t count = 0;
+
+    for (size_t i = 0; i < index->n_items; ++i)
+    {
+        if (index->items[i].erased)
+        {
+            g_free(index->items[i].key);
+            continue;
+        }
+
+        index->items[count++] = index->items[i];
+    }
+
+    g_qsort_with_data(index->items, count, sizeof(snapshot_index_item_t), snapshot_index_item_compare, index);
+
+    index->n_items = count;
+    count = 0;
+
+    for (size_t i = 0; i < index->n_items; ++i)
+    {
+        if (count > 0 && snapshot_index_item_compare(&index->items[i], &index->items[count - 1], index) == 0)
+        {
+            g_free(index->items[i].key);
+            continue;
+        }
+
+        index->items[count++] = index->items[i];
+    }
+
+    index->n_items = count;
+    index->n_sorted = count;
+    index->unsorted = false;
+}
+
+/**
+ * @brief snapshot_index_insert Adds value of the entry to the index. During bulk load sorted index is appended to
+ * and is ordered by snapshot_index_sort once load completes.
+ */
+static bool snapshot_index_insert(snapshot_index_t *index, const char *key, ld_entry_t *entry, bool bulk)
+{
+    if (index->types & LD_SNAPSHOT_INDEX_HASH)
+    {
+        GHashTable *entries = g_hash_table_lookup(index->values, key);
+        if (!entries)
+        {
+            entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+            g_hash_table_insert(index->values, g_strdup(key), entries);
+        }
+
+        g_hash_table_insert(entries, entry, entry);
+    }
+
+    if (index->types & LD_SNAPSHOT_INDEX_SORTED)
+    {
+        size_t position = index->n_items;
+
+        if (!bulk)
+        {
+            snapshot_index_sort(index);
+
+            position = snapshot_lower_bound(index, key, entry);
+            if (position < index->n_items
+                && snapshot_item_compare(index, key, entry, &index->items[position]) == 0)
+            {
+                return true;
+            }
+        }
+
+        if (index->n_items == index->capacity)
+        {
+            size_t capacity = index->capacity ? index->capacity * 2 : 64;
+
+            snapshot_index_item_t *items = talloc_realloc(index, index->items, snapshot_index_item_t, capacity);
+            if (!items)
+            {
+                ld_error("snapshot_index_insert - out of memory!\n");
+                return false;
+            }
+
+            index->items = items;
+            index->capacity = capacity;
+        }
+
+        memmove(&index->items[position + 1], &index->items[position],
+                (index->n_items - position) * sizeof(snapshot_index_item_t));
+
+        index->items[position].key = g_strdup(key);
+        index->items[position].entry = entry;
+        index->items[position].erased = false;
+        index->n_items++;
+
+        if (bulk)
+        {
+            index->unsorted = true;
+        }
+        else
+        {
+            index->n_sorted++;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief snapshot_index_erase Removes value of the entry from the index. During bulk load items of ordered part
+ * are only marked as erased, so removal does not move the rest of the index.
+ */
+static void snapshot_index_erase(snapshot_index_t *index, const char *key, ld_entry_t *entry, bool bulk)
+{
+    if (index->types & LD_SNAPSHOT_INDEX_HASH)
+    {
+        GHashTable *entries = g_hash_table_lookup(index->values, key);
+        if (entries)
+        {
+            g_hash_table_remove(entries, entry);
+
+            if (g_hash_table_size(entries) == 0)
+            {
+                g_hash_table_remove(index->values, key);
+            }
+        }
+    }
+
+    if (!(index->types & LD_SNAPSHOT_INDEX_SORTED))
+    {
+        return;
+    }
+
+    if (!bulk)
+    {
+        snapshot_index_sort(index);
+    }
+
+    size_t position = snapshot_lower_bound(index, key, entry);
+    for (; position < index->n_sorted
+         && snapshot_item_compare(index, key, entry, &index->items[position]) == 0; ++position)
+    {
+        if (index->items[position].erased)
+        {
+            continue;
+        }
+
+        if (bulk)
+        {
+            index->items[position].erased = true;
+            index->unsorted = true;
+            return;
+        }
+
+        g_free(index->items[position].key);
+
+        memmove(&index->items[position], &index->items[position + 1],
+                (index->n_items - position - 1) * sizeof(snapshot_index_item_t));
+        index->n_items--;
+        index->n_sorted--;
+        return;
+    }
+
+    // Items appended during bulk load are not ordered.
+    for (position = index->n_sorted; position < index->n_items; ++position)
+    {
+        if (!index->items[position].erased
+            && snapshot_item_compare(index, key, entry, &index->items[position]) == 0)
+        {
+            index->items[position].erased = true;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief snapshot_index_entry Adds or removes values of the entry to or from single index.
+ */
+static bool snapshot_index_entry(const ld_snapshot_t *snapshot, snapshot_index_t *index, ld_entry_t *entry,
+                                 bool insert)
+{
+    bool result = true;
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, entry->attributes);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        LDAPAttribute_t *attribute = value;
+
+        if (!attribute->values || !snapshot_index_matches(snapshot, index, key))
+        {
+            continue;
+        }
+
+        for (int i = 0; attribute->values[i]; ++i)
+        {
+            char *normalized = snapshot_normalize(NULL, index->rule, attribute->values[i]);
+            if (!normalized)
+            {
+                return false;
+            }
+
+            if (insert)
+            {
+                result = snapshot_index_insert(index, normalized, entry, snapshot->bulk) && result;
+            }
+            else
+            {
+                snapshot_index_erase(index, normalized, entry, snapshot->bulk);
+            }
+
+            talloc_free(normalized);
+        }
+    }
+
+    return result;
+}
+
+static bool snapshot_index_all(const ld_snapshot_t *snapshot, ld_entry_t *entry, bool insert)
+{
+    bool result = true;
+
+    for (int i = 0; i < snapshot->n_indexes; ++i)
+    {
+        result = snapshot_index_entry(snapshot, snapshot->indexes[i], entry, insert) && result;
+    }
+
+    return result;
+}
+
+/**
+ * @brief snapshot_bulk_begin Starts adding many entries at once, sorted indexes are ordered once in
+ * snapshot_bulk_end instead of on every insertion.
+ */
+static void snapshot_bulk_begin(ld_snapshot_t *snapshot)
+{
+    snapshot->bulk = true;
+}
+
+static void snapshot_bulk_end(ld_snapshot_t *snapshot)
+{
+    snapshot->bulk = false;
+
+    for (int i = 0; i < snapshot->n_indexes; ++i)
+    {
+        snapshot_index_sort(snapshot->indexes[i]);
+    }
+}
+
+/**
+ * @brief ld_snapshot_add_index Builds index over values of the attribute. Entries already in the snapshot are
+ * indexed immediately, later changes keep the index up to date.
+ * @param[in] snapshot    Snapshot to index.
+ * @param[in] attribute   Attribute to index.
+ * @param[in] index_types Combination of LdapSnapshotIndexType.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_snapshot_add_index(ld_snapshot_t *snapshot, const char *attribute, int index_types)
+{
+    if (!snapshot || !attribute
+        || !(index_types & (LD_SNAPSHOT_INDEX_HASH | LD_SNAPSHOT_INDEX_SORTED)))
+    {
+        ld_error("ld_snapshot_add_index - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (snapshot_find_index(snapshot, attribute))
+    {
+        ld_error("ld_snapshot_add_index - attribute %s is already indexed!\n", attribute);
+        return RETURN_CODE_FAILURE;
+    }
+
+    snapshot_index_t **indexes = talloc_realloc(snapshot, snapshot->indexes, snapshot_index_t*,
+                                                snapshot->n_indexes + 1);
+    if (!indexes)
+    {
+        ld_error("ld_snapshot_add_index - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+    snapshot->indexes = indexes;
+
+    snapshot_index_t *index = talloc_zero(snapshot->indexes, snapshot_index_t);
+    if (!index)
+    {
+        ld_error("ld_snapshot_add_index - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    index->attribute = talloc_strdup(index, attribute);
+    index->type = matching_rule_attribute_type(snapshot->schema, attribute);
+    index->rule = matching_rule_for_attribute(snapshot->schema, attribute);
+    index->types = index_types;
+
+    if (index_types & LD_SNAPSHOT_INDEX_HASH)
+    {
+        index->values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify)g_hash_table_destroy);
+    }
+
+    snapshot->indexes[snapshot->n_indexes++] = index;
+
+    enum OperationReturnCode rc = RETURN_CODE_SUCCESS;
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    snapshot_bulk_begin(snapshot);
+
+    g_hash_table_iter_init(&iter, snapshot->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        if (!snapshot_index_entry(snapshot, index, value, true))
+        {
+            ld_error("ld_snapshot_add_index - unable to index attribute %s!\n", attribute);
+            rc = RETURN_CODE_FAILURE;
+            break;
+        }
+    }
+
+    snapshot_bulk_end(snapshot);
+
+    return rc;
+}
+
+static LDAPAttribute_t *snapshot_copy_attribute(TALLOC_CTX *ctx, const char *name, char **values, int count)
+{
+    LDAPAttribute_t *attribute = talloc_zero(ctx, LDAPAttribute_t);
+    if (!attribute)
+    {
+        return NULL;
+    }
+
+    attribute->name = talloc_strdup(attribute, name);
+    attribute->values = talloc_array(attribute, char*, count + 1);
+    if (!attribute->name || !attribute->values)
+    {
+        talloc_free(attribute);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        attribute->values[i] = talloc_strdup(attribute->values, values[i]);
+    }
+    attribute->values[count] = NULL;
+
+    return attribute;
+}
+
+static int snapshot_count_values(char **values)
+{
+    int count = 0;
+    while (values && values[count])
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+static ld_entry_t *snapshot_copy_entry(ld_snapshot_t *snapshot, ld_entry_t *source)
+{
+    ld_entry_t *entry = ld_entry_new(snapshot, source->dn);
+    if (!entry)
+    {
+        return NULL;
+    }
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, source->attributes);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        LDAPAttribute_t *attribute = value;
+
+        LDAPAttribute_t *copy = snapshot_copy_attribute(entry, attribute->name, attribute->values,
+                                                        snapshot_count_values(attribute->values));
+        if (!copy || ld_entry_add_attribute(entry, copy) != RETURN_CODE_SUCCESS)
+        {
+            talloc_free(entry);
+            return NULL;
+        }
+    }
+
+    return entry;
+}
+
+static ld_entry_t *snapshot_lookup(const ld_snapshot_t *snapshot, const char *dn, char **key)
+{
+    char *normalized = snapshot_normalize(NULL, MATCHING_RULE_DN, dn);
+    if (!normalized)
+    {
+        return NULL;
+    }
+
+    gpointer original_key = NULL, value = NULL;
+    bool found = g_hash_table_lookup_extended(snapshot->entries, normalized, &original_key, &value);
+
+    talloc_free(normalized);
+
+    if (key)
+    {
+        *key = found ? original_key : NULL;
+    }
+
+    return found ? value : NULL;
+}
+
+static void snapshot_detach(ld_snapshot_t *snapshot, ld_entry_t *entry, char *key)
+{
+    snapshot_index_all(snapshot, entry, false);
+    g_hash_table_remove(snapshot->entries, key);
+}
+
+/**
+ * @brief snapshot_adopt Stores entry allocated on the snapshot, entry with the same dn is replaced.
+ * @param[in]  snapshot Snapshot to update.
+ * @param[in]  entry    Entry to store, on failure entry is not stored and stays owned by the caller.
+ * @param[out] replaced Receives replaced entry which is removed from the snapshot but not released,
+ *                      can be NULL than replaced entry is released.
+ */
+static enum OperationReturnCode snapshot_adopt(ld_snapshot_t *snapshot, ld_entry_t *entry, ld_entry_t **replaced)
+{
+    if (replaced)
+    {
+        *replaced = NULL;
+    }
+
+    char *key = snapshot_normalize(entry, MATCHING_RULE_DN, entry->dn);
+    if (!key)
+    {
+        ld_error("snapshot_adopt - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    char *previous_key = NULL;
+    ld_entry_t *previous = snapshot_lookup(snapshot, entry->dn, &previous_key);
+    if (previous)
+    {
+        snapshot_detach(snapshot, previous, previous_key);
+
+        if (replaced)
+        {
+            *replaced = previous;
+        }
+        else
+        {
+            talloc_free(previous);
+        }
+    }
+
+    g_hash_table_insert(snapshot->entries, key, entry);
+
+    if (!snapshot_index_all(snapshot, entry, true))
+    {
+        ld_error("snapshot_adopt - unable to index entry %s!\n", entry->dn);
+        snapshot_detach(snapshot, entry, key);
+        talloc_free(key);
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_snapshot_put Adds entry to the snapshot or replaces entry with the same dn. Entry is copied.
+ * @param[in] snapshot Snapshot to update.
+ * @param[in] entry    Entry to store.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_snapshot_put(ld_snapshot_t *snapshot, ld_entry_t *entry)
+{
+    if (!snapshot || !entry || !entry->dn || !entry->attributes)
+    {
+        ld_error("ld_snapshot_put - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    ld_entry_t *copy = snapshot_copy_entry(snapshot, entry);
+    if (!copy)
+    {
+        ld_error("ld_snapshot_put - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (snapshot_adopt(snapshot, copy, NULL) != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(copy);
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief snapshot_find_attribute Looks up attribute of the entry ignoring case of the name.
+ */
+static LDAPAttribute_t *snapshot_find_attribute(ld_entry_t *entry, const char *name)
+{
+    LDAPAttribute_t *attribute = g_hash_table_lookup(entry->attributes, name);
+    if (attribute)
+    {
+        return attribute;
+    }
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, entry->attributes);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        if (strcasecmp(key, name) == 0)
+        {
+            return value;
+        }
+    }
+
+    return NULL;
+}
+
+static bool snapshot_contains_value(enum MatchingRule rule, char **values, int count, const char *value)
+{
+    char *normalized = snapshot_normalize(NULL, rule, value);
+    bool found = false;
+
+    for (int i = 0; normalized && !found && i < count; ++i)
+    {
+        char *candidate = snapshot_normalize(NULL, rule, values[i]);
+        found = candidate && matching_rule_compare(rule, normalized, candidate) == 0;
+        talloc_free(candidate);
+    }
+
+    talloc_free(normalized);
+
+    return found;
+}
+
+/**
+ * @brief snapshot_apply_modification Applies single LDAPMod to the entry.
+ */
+static bool snapshot_apply_modification(const ld_snapshot_t *snapshot, ld_entry_t *entry, LDAPMod *modification)
+{
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    bool binary = modification->mod_op & LDAP_MOD_BVALUES;
+    int operation = modification->mod_op & ~LDAP_MOD_BVALUES;
+
+    int n_changes = 0;
+    while (binary ? (modification->mod_bvalues && modification->mod_bvalues[n_changes])
+                  : (modification->mod_values && modification->mod_values[n_changes]))
+    {
+        ++n_changes;
+    }
+
+    char **changes = talloc_array(talloc_ctx, char*, n_changes + 1);
+    for (int i = 0; changes && i < n_changes; ++i)
+    {
+        changes[i] = binary ? talloc_strndup(changes, modification->mod_bvalues[i]->bv_val,
+                                             modification->mod_bvalues[i]->bv_len)
+                            : modification->mod_values[i];
+    }
+
+    LDAPAttribute_t *current = snapshot_find_attribute(entry, modification->mod_type);
+    int n_current = current ? snapshot_count_values(current->values) : 0;
+
+    char **values = talloc_array(talloc_ctx, char*, n_current + n_changes + 1);
+    if (!changes || !values)
+    {
+        talloc_free(talloc_ctx);
+        return false;
+    }
+
+    enum MatchingRule rule = matching_rule_for_attribute(snapshot->schema, modification->mod_type);
+    int count = 0;
+
+    switch (operation)
+    {
+    case LDAP_MOD_ADD:
+        for (int i = 0; i < n_current; ++i)
+        {
+            values[count++] = current->values[i];
+        }
+        for (int i = 0; i < n_changes; ++i)
+        {
+            if (!snapshot_contains_value(rule, values, count, changes[i]))
+            {
+                values[count++] = changes[i];
+            }
+        }
+        break;
+    case LDAP_MOD_DELETE:
+        for (int i = 0; n_changes > 0 && i < n_current; ++i)
+        {
+            if (!snapshot_contains_value(rule, changes, n_changes, current->values[i]))
+            {
+                values[count++] = current->values[i];
+            }
+        }
+        break;
+    case LDAP_MOD_REPLACE:
+        for (int i = 0; i < n_changes; ++i)
+        {
+            values[count++] = changes[i];
+        }
+        break;
+    default:
+        ld_error("snapshot_apply_modification - unsupported operation %d!\n", operation);
+        talloc_free(talloc_ctx);
+        return false;
+    }
+
+    LDAPAttribute_t *replacement = count > 0
+            ? snapshot_copy_attribute(entry, current ? current->name : modification->mod_type, values, count)
+            : NULL;
+
+    if (count > 0 && !replacement)
+    {
+        talloc_free(talloc_ctx);
+        return false;
+    }
+
+    if (current)
+    {
+        g_hash_table_remove(entry->attributes, current->name);
+        talloc_free(current);
+    }
+
+    if (replacement)
+    {
+        ld_entry_add_attribute(entry, replacement);
+    }
+
+    talloc_free(talloc_ctx);
+
+    return true;
+}
+
+/**
+ * @brief ld_snapshot_modify Applies modifications of the change event to the stored entry.
+ * @param[in] snapshot      Snapshot to update.
+ * @param[in] dn            Dn of the modified entry.
+ * @param[in] modifications Modifications, NULL terminated.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if entry is not in the snapshot or modification failed.
+ */
+enum OperationReturnCode ld_snapshot_modify(ld_snapshot_t *snapshot, const char *dn, LDAPMod **modifications)
+{
+    if (!snapshot || !dn || !modifications)
+    {
+        ld_error("ld_snapshot_modify - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    ld_entry_t *entry = snapshot_lookup(snapshot, dn, NULL);
+    if (!entry)
+    {
+        ld_error("ld_snapshot_modify - entry %s is not in the snapshot!\n", dn);
+        return RETURN_CODE_FAILURE;
+    }
+
+    snapshot_index_all(snapshot, entry, false);
+
+    bool result = true;
+    for (int i = 0; modifications[i] && result; ++i)
+    {
+        result = snapshot_apply_modification(snapshot, entry, modifications[i]);
+    }
+
+    result = snapshot_index_all(snapshot, entry, true) && result;
+
+    if (!result)
+    {
+        ld_error("ld_snapshot_modify - unable to modify entry %s!\n", dn);
+    }
+
+    return result ? RETURN_CODE_SUCCESS : RETURN_CODE_FAILURE;
+}
+
+/**
+ * @brief ld_snapshot_rename Moves stored entry to the new dn. Entry at the new dn is replaced.
+ * @param[in] snapshot Snapshot to update.
+ * @param[in] dn       Current dn of the entry.
+ * @param[in] new_dn   New dn of the entry.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if entry is not in the snapshot.
+ */
+enum OperationReturnCode ld_snapshot_rename(ld_snapshot_t *snapshot, const char *dn, const char *new_dn)
+{
+    if (!snapshot || !dn || !new_dn)
+    {
+        ld_error("ld_snapshot_rename - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    char *key = NULL;
+    ld_entry_t *entry = snapshot_lookup(snapshot, dn, &key);
+    if (!entry)
+    {
+        ld_error("ld_snapshot_rename - entry %s is not in the snapshot!\n", dn);
+        return RETURN_CODE_FAILURE;
+    }
+
+    char *new_key = snapshot_normalize(entry, MATCHING_RULE_DN, new_dn);
+    char *new_entry_dn = talloc_strdup(entry, new_dn);
+    if (!new_key || !new_entry_dn)
+    {
+        ld_error("ld_snapshot_rename - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    g_hash_table_remove(snapshot->entries, key);
+    talloc_free(key);
+
+    char *previous_key = NULL;
+    ld_entry_t *previous = snapshot_lookup(snapshot, new_dn, &previous_key);
+    if (previous)
+    {
+        snapshot_detach(snapshot, previous, previous_key);
+        talloc_free(previous);
+    }
+
+    talloc_free(entry->dn);
+    entry->dn = new_entry_dn;
+
+    g_hash_table_insert(snapshot->entries, new_key, entry);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_snapshot_remove Removes entry from the snapshot.
+ * @param[in] snapshot Snapshot to update.
+ * @param[in] dn       Dn of the entry.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if entry is not in the snapshot.
+ */
+enum OperationReturnCode ld_snapshot_remove(ld_snapshot_t *snapshot, const char *dn)
+{
+    if (!snapshot || !dn)
+    {
+        ld_error("ld_snapshot_remove - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    char *key = NULL;
+    ld_entry_t *entry = snapshot_lookup(snapshot, dn, &key);
+    if (!entry)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    snapshot_detach(snapshot, entry, key);
+    talloc_free(entry);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_snapshot_count Returns number of entries in the snapshot.
+ * @param[in] snapshot Snapshot to use.
+ * @return Number of entries.
+ */
+int ld_snapshot_count(const ld_snapshot_t *snapshot)
+{
+    return snapshot ? (int)g_hash_table_size(snapshot->entries) : 0;
+}
+
+/**
+ * @brief ld_snapshot_get Returns stored entry by dn.
+ * @param[in] snapshot Snapshot to use.
+ * @param[in] dn       Dn of the entry.
+ * @return
+ *        - NULL if entry is not in the snapshot.
+ *        - entry owned by the snapshot.
+ */
+ld_entry_t *ld_snapshot_get(const ld_snapshot_t *snapshot, const char *dn)
+{
+    return snapshot && dn ? snapshot_lookup(snapshot, dn, NULL) : NULL;
+}
+
+#define SNAPSHOT_COLLECTOR_INITIAL_CAPACITY 16
+
+static bool snapshot_collector_init(TALLOC_CTX *ctx, snapshot_collector_t *collector)
+{
+    collector->ctx = ctx;
+    collector->count = 0;
+    collector->capacity = SNAPSHOT_COLLECTOR_INITIAL_CAPACITY;
+    collector->entries = talloc_array(ctx, ld_entry_t*, collector->capacity + 1);
+    collector->seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    return collector->entries && collector->seen;
+}
+
+static bool snapshot_collect(snapshot_collector_t *collector, ld_entry_t *entry)
+{
+    if (!collector->entries || g_hash_table_lookup(collector->seen, entry))
+    {
+        return collector->entries != NULL;
+    }
+
+    if (collector->count == collector->capacity)
+    {
+        ld_entry_t **entries = talloc_realloc(collector->ctx, collector->entries, ld_entry_t*,
+                                              collector->capacity * 2 + 1);
+        if (!entries)
+        {
+            ld_error("snapshot_collect - out of memory!\n");
+            talloc_free(collector->entries);
+            collector->entries = NULL;
+            return false;
+        }
+
+        collector->entries = entries;
+        collector->capacity *= 2;
+    }
+
+    g_hash_table_insert(collector->seen, entry, entry);
+    collector->entries[collector->count++] = entry;
+
+    return true;
+}
+
+static ld_entry_t **snapshot_collector_finish(snapshot_collector_t *collector)
+{
+    if (collector->seen)
+    {
+        g_hash_table_destroy(collector->seen);
+    }
+
+    if (collector->entries)
+    {
+        collector->entries[collector->count] = NULL;
+    }
+
+    return collector->entries;
+}
+
+/*!
+ * @brief SnapshotLookup - Kind of lookup over attribute values.
+ */
+enum SnapshotLookup
+{
+    SNAPSHOT_LOOKUP_EQUAL,
+    SNAPSHOT_LOOKUP_PREFIX,
+    SNAPSHOT_LOOKUP_RANGE,
+};
+
+static bool snapshot_value_matches(enum MatchingRule rule, enum SnapshotLookup lookup, const char *value,
+                                   const char *first, const char *last)
+{
+    switch (lookup)
+    {
+    case SNAPSHOT_LOOKUP_EQUAL:
+        return matching_rule_compare(rule, value, first) == 0;
+    case SNAPSHOT_LOOKUP_PREFIX:
+        return strncmp(value, first, strlen(first)) == 0;
+    default:
+        return (!first || matching_rule_compare(rule, value, first) >= 0)
+                && (!last || matching_rule_compare(rule, value, last) <= 0);
+    }
+}
+
+/**
+ * @brief snapshot_scan Answers lookup without index by checking every stored entry.
+ */
+static void snapshot_scan(const ld_snapshot_t *snapshot, snapshot_collector_t *collector, const char *attribute,
+                          enum MatchingRule rule, enum SnapshotLookup lookup, const char *first, const char *last)
+{
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, snapshot->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        LDAPAttribute_t *found = snapshot_find_attribute(value, attribute);
+
+        for (int i = 0; found && found->values && found->values[i]; ++i)
+        {
+            char *normalized = snapshot_normalize(NULL, rule, found->values[i]);
+            bool matched = normalized && snapshot_value_matches(rule, lookup, normalized, first, last);
+            talloc_free(normalized);
+
+            if (matched)
+            {
+                snapshot_collect(collector, value);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief snapshot_find Probes index of the attribute, falls back to scan if there is no suitable index.
+ */
+static ld_entry_t **snapshot_find(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot, const char *attribute,
+                                  enum SnapshotLookup lookup, const char *first, const char *last)
+{
+    snapshot_index_t *index = snapshot_find_index(snapshot, attribute);
+    enum MatchingRule rule = index ? index->rule : matching_rule_for_attribute(snapshot->schema, attribute);
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    char *normalized_first = first ? snapshot_normalize(talloc_ctx, rule, first) : NULL;
+    char *normalized_last = last ? snapshot_normalize(talloc_ctx, rule, last) : NULL;
+
+    snapshot_collector_t collector;
+
+    if (!snapshot_collector_init(ctx, &collector)
+        || (first && !normalized_first) || (last && !normalized_last))
+    {
+        ld_error("snapshot_find - out of memory!\n");
+        talloc_free(talloc_ctx);
+        talloc_free(snapshot_collector_finish(&collector));
+        return NULL;
+    }
+
+    bool has_hash = index && (index->types & LD_SNAPSHOT_INDEX_HASH);
+    bool has_sorted = index && (index->types & LD_SNAPSHOT_INDEX_SORTED);
+
+    // Integers are ordered by value, so their prefixes are not contiguous in sorted index.
+    if (lookup == SNAPSHOT_LOOKUP_PREFIX && rule == MATCHING_RULE_INTEGER)
+    {
+        has_sorted = false;
+    }
+
+    if (lookup == SNAPSHOT_LOOKUP_EQUAL && has_hash)
+    {
+        GHashTable *entries = g_hash_table_lookup(index->values, normalized_first);
+
+        GHashTableIter iter;
+        gpointer key = NULL, value = NULL;
+
+        if (entries)
+        {
+            g_hash_table_iter_init(&iter, entries);
+            while (g_hash_table_iter_next(&iter, &key, &value))
+            {
+                snapshot_collect(&collector, value);
+            }
+        }
+    }
+    else if (has_sorted)
+    {
+        size_t position = normalized_first ? snapshot_lower_bound(index, normalized_first, NULL) : 0;
+
+        for (; position < index->n_items; ++position)
+        {
+            const snapshot_index_item_t *item = &index->items[position];
+
+            if (!snapshot_value_matches(rule, lookup, item->key, normalized_first, normalized_last))
+            {
+                break;
+            }
+
+            snapshot_collect(&collector, item->entry);
+        }
+    }
+    else
+    {
+        snapshot_scan(snapshot, &collector, attribute, rule, lookup, normalized_first, normalized_last);
+    }
+
+    talloc_free(talloc_ctx);
+
+    return snapshot_collector_finish(&collector);
+}
+
+/**
+ * @brief ld_snapshot_find_equal Returns entries having attribute value equal to the given one.
+ * @param[in] ctx       Memory context to allocate result on.
+ * @param[in] snapshot  Snapshot to search.
+ * @param[in] attribute Attribute to test.
+ * @param[in] value     Value to look for.
+ * @return
+ *        - NULL on failure.
+ *        - NULL terminated array of entries owned by the snapshot.
+ */
+ld_entry_t **ld_snapshot_find_equal(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot, const char *attribute,
+                                    const char *value)
+{
+    if (!snapshot || !attribute || !value)
+    {
+        ld_error("ld_snapshot_find_equal - invalid parameters!\n");
+        return NULL;
+    }
+
+    return snapshot_find(ctx, snapshot, attribute, SNAPSHOT_LOOKUP_EQUAL, value, NULL);
+}
+
+/**
+ * @brief ld_snapshot_find_prefix Returns entries having attribute value starting with the given prefix.
+ * @param[in] ctx       Memory context to allocate result on.
+ * @param[in] snapshot  Snapshot to search.
+ * @param[in] attribute Attribute to test.
+ * @param[in] prefix    Prefix to look for.
+ * @return
+ *        - NULL on failure.
+ *        - NULL terminated array of entries owned by the snapshot.
+ */
+ld_entry_t **ld_snapshot_find_prefix(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot, const char *attribute,
+                                     const char *prefix)
+{
+    if (!snapshot || !attribute || !prefix)
+    {
+        ld_error("ld_snapshot_find_prefix - invalid parameters!\n");
+        return NULL;
+    }
+
+    return snapshot_find(ctx, snapshot, attribute, SNAPSHOT_LOOKUP_PREFIX, prefix, NULL);
+}
+
+/**
+ * @brief ld_snapshot_find_range Returns entries having attribute value within inclusive range.
+ * @param[in] ctx       Memory context to allocate result on.
+ * @param[in] snapshot  Snapshot to search.
+ * @param[in] attribute Attribute to test.
+ * @param[in] lower     Lower bound, NULL if range is not bounded from below.
+ * @param[in] upper     Upper bound, NULL if range is not bounded from above.
+ * @return
+ *        - NULL on failure.
+ *        - NULL terminated array of entries owned by the snapshot.
+ */
+ld_entry_t **ld_snapshot_find_range(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot, const char *attribute,
+                                    const char *lower, const char *upper)
+{
+    if (!snapshot || !attribute)
+    {
+        ld_error("ld_snapshot_find_range - invalid parameters!\n");
+        return NULL;
+    }
+
+    return snapshot_find(ctx, snapshot, attribute, SNAPSHOT_LOOKUP_RANGE, lower, upper);
+}
+
+/**
+ * @brief ld_snapshot_select Returns entries matching compiled filter.
+ * @param[in] ctx      Memory context to allocate result on.
+ * @param[in] snapshot Snapshot to search.
+ * @param[in] program  Compiled filter.
+ * @return
+ *        - NULL on failure.
+ *        - NULL terminated array of entries owned by the snapshot.
+ */
+ld_entry_t **ld_snapshot_select(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot, const ld_filter_program_t *program)
+{
+    if (!snapshot || !program)
+    {
+        ld_error("ld_snapshot_select - invalid parameters!\n");
+        return NULL;
+    }
+
+    ld_entry_t **result = talloc_array(ctx, ld_entry_t*, ld_snapshot_count(snapshot) + 1);
+    if (!result)
+    {
+        ld_error("ld_snapshot_select - out of memory!\n");
+        return NULL;
+    }
+
+    int count = 0;
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, snapshot->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        if (ld_filter_match(program, value))
+        {
+            result[count++] = value;
+        }
+    }
+    result[count] = NULL;
+
+    return result;
+}
+
+static enum OperationReturnCode snapshot_load_callback(struct ldap_connection_ctx_t *connection,
+                                                       ld_entry_t **entries,
+                                                       void *user_data)
+{
+    (void)(connection);
+
+    snapshot_load_t *state = talloc_get_type_abort(user_data, snapshot_load_t);
+
+    int loaded = 0;
+    enum OperationReturnCode rc = RETURN_CODE_SUCCESS;
+
+    snapshot_bulk_begin(state->snapshot);
+
+    for (int i = 0; entries && entries[i]; ++i)
+    {
+        if (!entries[i]->dn || entries[i]->dn[0] == '\0')
+        {
+            continue;
+        }
+
+        if (ld_snapshot_put(state->snapshot, entries[i]) == RETURN_CODE_SUCCESS)
+        {
+            ++loaded;
+        }
+        else
+        {
+            rc = RETURN_CODE_FAILURE;
+        }
+    }
+
+    snapshot_bulk_end(state->snapshot);
+
+    if (state->callback)
+    {
+        state->callback(state->handle, state->snapshot, loaded, state->user_data);
+    }
+
+    talloc_free(state);
+
+    return rc;
+}
+
+/**
+ * @brief ld_snapshot_load Fills snapshot with entries of the subtree using paged search.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] snapshot   Snapshot to fill.
+ * @param[in] base_dn    Base of the subtree.
+ * @param[in] filter     Filter of entries to load. Can be NULL than every entry is loaded.
+ * @param[in] attributes Attributes to load, NULL terminated. Can be NULL than all user attributes are loaded.
+ * @param[in] callback   Callback to call once entries are loaded. Can be NULL.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_snapshot_load(LDHandle *handle,
+                                          ld_snapshot_t *snapshot,
+                                          const char *base_dn,
+                                          const char *filter,
+                                          const char **attributes,
+                                          snapshot_callback_fn callback,
+                                          void *user_data)
+{
+    check_handle(handle, "ld_snapshot_load");
+
+    if (!snapshot || !base_dn)
+    {
+        ld_error("ld_snapshot_load - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    snapshot_load_t *state = talloc_zero(handle->talloc_ctx, snapshot_load_t);
+    if (!state)
+    {
+        ld_error("ld_snapshot_load - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    state->handle = handle;
+    state->snapshot = snapshot;
+    state->callback = callback;
+    state->user_data = user_data;
+
+    enum OperationReturnCode rc = search_paged(handle->connection_ctx, base_dn, LDAP_SCOPE_SUBTREE,
+                                               filter ? filter : SNAPSHOT_DEFAULT_FILTER, (char**)attributes,
+                                               SNAPSHOT_PAGE_SIZE, snapshot_load_callback, state);
+    if (rc != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(state);
+    }
+
+    return rc;
+}
+
+/**
+ * @brief ld_snapshot_save Writes every entry of the snapshot to the snapshot file.
+ * @param[in] snapshot Snapshot to save.
+ * @param[in] path     Path of the file, existing file is replaced.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_snapshot_save(const ld_snapshot_t *snapshot, const char *path)
+{
+    if (!snapshot || !path)
+    {
+        ld_error("ld_snapshot_save - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    ld_snapshot_writer_t *writer = ld_snapshot_writer_open(NULL, path);
+    if (!writer)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+
+    g_hash_table_iter_init(&iter, snapshot->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        if (ld_snapshot_writer_add(writer, value) != RETURN_CODE_SUCCESS)
+        {
+            talloc_free(writer);
+            return RETURN_CODE_FAILURE;
+        }
+    }
+
+    return ld_snapshot_writer_close(writer);
+}
+
+/**
+ * @brief snapshot_import_rollback Restores snapshot after import failed, entries are restored in reverse order
+ * so entries replaced twice by the same file end up replaced by the original.
+ * @param[in] snapshot Snapshot to restore.
+ * @param[in] entries  Imported entries, NULL terminated.
+ * @param[in] replaced Entries replaced by imported entries.
+ * @param[in] adopted  Number of imported entries stored in the snapshot.
+ * @param[in] count    Number of imported entries for which replaced entry is known.
+ */
+static void snapshot_import_rollback(ld_snapshot_t *snapshot, ld_entry_t **entries, ld_entry_t **replaced,
+                                     int adopted, int count)
+{
+    for (int i = count - 1; i >= 0; --i)
+    {
+        if (i < adopted)
+        {
+            char *key = NULL;
+            if (snapshot_lookup(snapshot, entries[i]->dn, &key) == entries[i])
+            {
+                snapshot_detach(snapshot, entries[i], key);
+            }
+        }
+
+        if (replaced[i] && snapshot_adopt(snapshot, replaced[i], NULL) != RETURN_CODE_SUCCESS)
+        {
+            ld_error("ld_snapshot_import_file - unable to restore entry %s!\n", replaced[i]->dn);
+            talloc_free(replaced[i]);
+        }
+    }
+}
+
+/**
+ * @brief ld_snapshot_import_file Fills snapshot with entries of the snapshot file. File stays mapped for the
+ * lifetime of the snapshot, values of imported entries are not copied. Import is all or nothing, on failure
+ * snapshot is left as it was.
+ * @param[in] snapshot Snapshot to fill.
+ * @param[in] path     Path of the snapshot file.
+ * @return
+ *        - Number of imported entries.
+ *        - -1 on failure.
+ */
+int ld_snapshot_import_file(ld_snapshot_t *snapshot, const char *path)
+{
+    if (!snapshot || !path)
+    {
+        ld_error("ld_snapshot_import_file - invalid parameters!\n");
+        return -1;
+    }
+
+    ld_snapshot_file_t *file = ld_snapshot_file_open(snapshot, path);
+    if (!file)
+    {
+        return -1;
+    }
+
+    int count = ld_snapshot_file_count(file);
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ld_entry_t **entries = talloc_zero_array(talloc_ctx, ld_entry_t*, count + 1);
+    ld_entry_t **replaced = talloc_zero_array(talloc_ctx, ld_entry_t*, count + 1);
+    if (!entries || !replaced)
+    {
+        ld_error("ld_snapshot_import_file - out of memory!\n");
+        talloc_free(talloc_ctx);
+        talloc_free(file);
+        return -1;
+    }
+
+    // Every entry is decoded before snapshot is changed, so malformed file leaves snapshot intact.
+    for (int i = 0; i < count; ++i)
+    {
+        entries[i] = ld_snapshot_file_entry(file, file, i);
+        if (!entries[i])
+        {
+            talloc_free(talloc_ctx);
+            talloc_free(file);
+            return -1;
+        }
+    }
+
+    snapshot_bulk_begin(snapshot);
+
+    int adopted = 0;
+    while (adopted < count && snapshot_adopt(snapshot, entries[adopted], &replaced[adopted]) == RETURN_CODE_SUCCESS)
+    {
+        ++adopted;
+    }
+
+    snapshot_bulk_end(snapshot);
+
+    if (adopted < count)
+    {
+        snapshot_import_rollback(snapshot, entries, replaced, adopted, adopted + 1);
+
+        talloc_free(talloc_ctx);
+        talloc_free(file);
+        return -1;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        talloc_free(replaced[i]);
+    }
+
+    talloc_free(talloc_ctx);
+
+    return count;
+}
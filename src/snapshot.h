@@ -0,0 +1,79 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_SNAPSHOT_H
+#define LIB_DOMAIN_SNAPSHOT_H
+
+#include "common.h"
+#include "domain.h"
+#include "entry.h"
+#include "filter_program.h"
+#include "schema.h"
+
+#include <stdbool.h>
+
+/*!
+ * @brief LdapSnapshotIndexType - Kinds of index which can be built over attribute values, can be combined.
+ */
+enum LdapSnapshotIndexType
+{
+    LD_SNAPSHOT_INDEX_HASH   = 1 << 0,  //!< Hash index, answers equality lookups.
+    LD_SNAPSHOT_INDEX_SORTED = 1 << 1,  //!< Sorted index, answers equality, prefix and range lookups.
+};
+
+typedef struct ld_snapshot_s ld_snapshot_t;
+
+/*!
+ * @brief snapshot_callback_fn Callback which is called once snapshot is loaded from the server.
+ */
+typedef void (*snapshot_callback_fn)(LDHandle *handle, ld_snapshot_t *snapshot, int loaded, void *user_data);
+
+ld_snapshot_t *ld_snapshot_new(TALLOC_CTX *ctx, const ldap_schema_t *schema);
+enum OperationReturnCode ld_snapshot_add_index(ld_snapshot_t *snapshot, const char *attribute, int index_types);
+
+enum OperationReturnCode ld_snapshot_load(LDHandle *handle,
+                                          ld_snapshot_t *snapshot,
+                                          const char *base_dn,
+                                          const char *filter,
+                                          const char **attributes,
+                                          snapshot_callback_fn callback,
+                                          void *user_data);
+
+enum OperationReturnCode ld_snapshot_put(ld_snapshot_t *snapshot, ld_entry_t *entry);
+enum OperationReturnCode ld_snapshot_modify(ld_snapshot_t *snapshot, const char *dn, LDAPMod **modifications);
+enum OperationReturnCode ld_snapshot_rename(ld_snapshot_t *snapshot, const char *dn, const char *new_dn);
+enum OperationReturnCode ld_snapshot_remove(ld_snapshot_t *snapshot, const char *dn);
+
+enum OperationReturnCode ld_snapshot_save(const ld_snapshot_t *snapshot, const char *path);
+int ld_snapshot_import_file(ld_snapshot_t *snapshot, const char *path);
+
+int ld_snapshot_count(const ld_snapshot_t *snapshot);
+ld_entry_t *ld_snapshot_get(const ld_snapshot_t *snapshot, const char *dn);
+
+ld_entry_t **ld_snapshot_find_equal(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot, const char *attribute,
+                                    const char *value);
+ld_entry_t **ld_snapshot_find_prefix(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot, const char *attribute,
+                                     const char *prefix);
+ld_entry_t **ld_snapshot_find_range(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot, const char *attribute,
+                                    const char *lower, const char *upper);
+ld_entry_t **ld_snapshot_select(TALLOC_CTX *ctx, const ld_snapshot_t *snapshot,
+                                const ld_filter_program_t *program);
+
+#endif //LIB_DOMAIN_SNAPSHOT_H
@@ -0,0 +1,1186 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+/*
+ * Snapshot file layout, all integers are little-endian:
+ *
+ *   header   "LDSNAP" 0x00 0x01
+ *   entries  per entry: u32 dn length, dn, NUL, u32 number of attributes,
+ *            per attribute: u32 name index, u32 number of values,
+ *            per value: u32 length, value, NUL
+ *   names    per interned attribute name: u32 length, name, NUL
+ *   offsets  u64 offset of every entry
+ *   footer   u64 offset of names, u64 offset of offsets, u32 number of names, u32 number of entries, "LDSNAPFT"
+ *
+ * Entries are written sequentially, tables go after them, so file can be produced in a single pass.
+ * Strings are NUL terminated in the file, so loaded entries point straight into the mapping.
+ */
+
+#include "snapshot_file.h"
+
+#include "domain.h"
+#include "entry_p.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_FILE_MAGIC "LDSNAP\0\1"
+#define SNAPSHOT_FILE_FOOTER_MAGIC "LDSNAPFT"
+#define SNAPSHOT_FILE_MAGIC_SIZE 8
+#define SNAPSHOT_FILE_FOOTER_SIZE (8 + 8 + 4 + 4 + SNAPSHOT_FILE_MAGIC_SIZE)
+#define SNAPSHOT_FILE_MAX_NAMES (1 << 20)
+#define SNAPSHOT_FILE_INITIAL_CAPACITY 1024
+
+#define LDIF_LINE_WIDTH 76
+
+/*!
+ * @brief snapshot_value_t - Value with explicit length, can hold binary data.
+ */
+typedef struct snapshot_value_s
+{
+    const char *data;                //!< Value.
+    uint32_t length;                 //!< Length of the value.
+} snapshot_value_t;
+
+/*!
+ * @brief snapshot_attribute_t - Attribute of the record being written.
+ */
+typedef struct snapshot_attribute_s
+{
+    const char *name;                //!< Name of the attribute.
+    snapshot_value_t *values;        //!< Values of the attribute.
+    uint32_t n_values;               //!< Number of values.
+} snapshot_attribute_t;
+
+/*!
+ * @brief ld_snapshot_writer_t - Sequential writer of snapshot file.
+ */
+struct ld_snapshot_writer_s
+{
+    char *path;                      //!< Path of the snapshot file.
+    char *temporary_path;            //!< Path of the file being written, renamed to path once complete.
+    FILE *stream;                    //!< Output file.
+    uint64_t position;               //!< Number of bytes written.
+    bool failed;                     //!< Write error occurred.
+
+    GHashTable *names;               //!< Interned attribute names, name to index.
+    char **name_list;                //!< Interned attribute names in order of appearance.
+    uint32_t n_names;                //!< Number of interned names.
+
+    uint64_t *offsets;               //!< Offsets of written entries.
+    uint32_t n_entries;              //!< Number of written entries.
+    uint32_t capacity;               //!< Capacity of offsets array.
+};
+
+/*!
+ * @brief ld_snapshot_file_t - Memory mapped snapshot file.
+ */
+struct ld_snapshot_file_s
+{
+    const uint8_t *data;             //!< Mapped file.
+    size_t size;                     //!< Size of the file.
+
+    const char **names;              //!< Attribute names, point into the mapping.
+    uint32_t n_names;                //!< Number of attribute names.
+
+    uint64_t offsets;                //!< Offset of entry offsets table.
+    uint32_t n_entries;              //!< Number of entries.
+};
+
+/*!
+ * @brief snapshot_cursor_t - Bounds checked reader over the mapping.
+ */
+typedef struct snapshot_cursor_s
+{
+    const uint8_t *data;             //!< Mapped file.
+    size_t size;                     //!< Size of the file.
+    size_t position;                 //!< Current position.
+    bool failed;                     //!< Read went out of bounds or data is malformed.
+} snapshot_cursor_t;
+
+/*!
+ * @brief ldif_record_t - LDIF record being parsed.
+ */
+typedef struct ldif_record_s
+{
+    snapshot_value_t dn;             //!< Dn of the record.
+    snapshot_attribute_t *attributes; //!< Attributes of the record.
+    uint32_t n_attributes;           //!< Number of attributes.
+} ldif_record_t;
+
+static uint32_t snapshot_read_u32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+static uint64_t snapshot_read_u64(const uint8_t *data)
+{
+    return (uint64_t)snapshot_read_u32(data) | (uint64_t)snapshot_read_u32(data + 4) << 32;
+}
+
+static uint32_t snapshot_cursor_u32(snapshot_cursor_t *cursor)
+{
+    if (cursor->failed || cursor->position > cursor->size || cursor->size - cursor->position < 4)
+    {
+        cursor->failed = true;
+        return 0;
+    }
+
+    uint32_t value = snapshot_read_u32(cursor->data + cursor->position);
+    cursor->position += 4;
+
+    return value;
+}
+
+static const char *snapshot_cursor_string(snapshot_cursor_t *cursor, uint32_t *length)
+{
+    *length = snapshot_cursor_u32(cursor);
+
+    if (cursor->failed || cursor->size - cursor->position <= *length
+        || cursor->data[cursor->position + *length] != '\0')
+    {
+        cursor->failed = true;
+        return NULL;
+    }
+
+    const char *result = (const char *)cursor->data + cursor->position;
+    cursor->position += (size_t)*length + 1;
+
+    return result;
+}
+
+static void snapshot_writer_write(ld_snapshot_writer_t *writer, const void *data, size_t size)
+{
+    if (!writer->failed && size > 0 && fwrite(data, 1, size, writer->stream) != size)
+    {
+        writer->failed = true;
+    }
+
+    writer->position += size;
+}
+
+static void snapshot_writer_write_u32(ld_snapshot_writer_t *writer, uint32_t value)
+{
+    uint8_t bytes[4] = { value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, (value >> 24) & 0xff };
+
+    snapshot_writer_write(writer, bytes, sizeof(bytes));
+}
+
+static void snapshot_writer_write_u64(ld_snapshot_writer_t *writer, uint64_t value)
+{
+    snapshot_writer_write_u32(writer, (uint32_t)(value & 0xffffffff));
+    snapshot_writer_write_u32(writer, (uint32_t)(value >> 32));
+}
+
+static void snapshot_writer_write_string(ld_snapshot_writer_t *writer, const char *value, uint32_t length)
+{
+    snapshot_writer_write_u32(writer, length);
+    snapshot_writer_write(writer, value, length);
+    snapshot_writer_write(writer, "", 1);
+}
+
+static int snapshot_writer_destructor(TALLOC_CTX *ctx)
+{
+    ld_snapshot_writer_t *writer = talloc_get_type_abort(ctx, ld_snapshot_writer_t);
+
+    // Incomplete file never replaces the snapshot.
+    if (writer->stream)
+    {
+        fclose(writer->stream);
+        unlink(writer->temporary_path);
+    }
+
+    if (writer->names)
+    {
+        g_hash_table_destroy(writer->names);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief ld_snapshot_writer_open Creates snapshot file and prepares it for sequential writing. Entries are written
+ * to temporary file in the same directory, which replaces the snapshot file only when writer is closed, so readers
+ * never see partially written file.
+ * @param[in] ctx  Memory context to allocate writer on.
+ * @param[in] path Path of the file, existing file is replaced.
+ * @return
+ *        - NULL on failure.
+ *        - writer.
+ */
+ld_snapshot_writer_t *ld_snapshot_writer_open(TALLOC_CTX *ctx, const char *path)
+{
+    if (!path)
+    {
+        ld_error("ld_snapshot_writer_open - invalid parameters!\n");
+        return NULL;
+    }
+
+    ld_snapshot_writer_t *writer = talloc_zero(ctx, ld_snapshot_writer_t);
+    if (!writer)
+    {
+        ld_error("ld_snapshot_writer_open - out of memory!\n");
+        return NULL;
+    }
+
+    talloc_set_destructor((void*)writer, snapshot_writer_destructor);
+
+    writer->path = talloc_strdup(writer, path);
+    writer->temporary_path = talloc_asprintf(writer, "%s.XXXXXX", path);
+    writer->names = g_hash_table_new(g_str_hash, g_str_equal);
+
+    if (!writer->path || !writer->temporary_path || !writer->names)
+    {
+        ld_error("ld_snapshot_writer_open - out of memory!\n");
+        talloc_free(writer);
+        return NULL;
+    }
+
+    int fd = mkstemp(writer->temporary_path);
+    writer->stream = fd >= 0 ? fdopen(fd, "wb") : NULL;
+
+    if (!writer->stream)
+    {
+        ld_error("ld_snapshot_writer_open - unable to create %s: %s\n", path, strerror(errno));
+
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(writer->temporary_path);
+        }
+
+        talloc_free(writer);
+        return NULL;
+    }
+
+    snapshot_writer_write(writer, SNAPSHOT_FILE_MAGIC, SNAPSHOT_FILE_MAGIC_SIZE);
+
+    return writer;
+}
+
+static bool snapshot_writer_intern(ld_snapshot_writer_t *writer, const char *name, uint32_t *index)
+{
+    gpointer key = NULL, value = NULL;
+
+    if (g_hash_table_lookup_extended(writer->names, name, &key, &value))
+    {
+        *index = (uint32_t)(uintptr_t)value;
+        return true;
+    }
+
+    char **name_list = talloc_realloc(writer, writer->name_list, char*, writer->n_names + 1);
+    if (!name_list)
+    {
+        return false;
+    }
+    writer->name_list = name_list;
+
+    char *copy = talloc_strdup(writer->name_list, name);
+    if (!copy)
+    {
+        return false;
+    }
+
+    writer->name_list[writer->n_names] = copy;
+    g_hash_table_insert(writer->names, copy, (gpointer)(uintptr_t)writer->n_names);
+
+    *index = writer->n_names++;
+
+    return true;
+}
+
+/**
+ * @brief snapshot_writer_add_record Appends single entry to the file.
+ */
+static enum OperationReturnCode snapshot_writer_add_record(ld_snapshot_writer_t *writer,
+                                                           const snapshot_value_t *dn,
+                                                           const snapshot_attribute_t *attributes,
+                                                           uint32_t n_attributes)
+{
+    if (writer->n_entries == writer->capacity)
+    {
+        uint32_t capacity = writer->capacity ? writer->capacity * 2 : SNAPSHOT_FILE_INITIAL_CAPACITY;
+
+        uint64_t *offsets = talloc_realloc(writer, writer->offsets, uint64_t, capacity);
+        if (!offsets)
+        {
+            ld_error("snapshot_writer_add_record - out of memory!\n");
+            return RETURN_CODE_FAILURE;
+        }
+
+        writer->offsets = offsets;
+        writer->capacity = capacity;
+    }
+
+    writer->offsets[writer->n_entries++] = writer->position;
+
+    snapshot_writer_write_string(writer, dn->data, dn->length);
+    snapshot_writer_write_u32(writer, n_attributes);
+
+    for (uint32_t i = 0; i < n_attributes; ++i)
+    {
+        uint32_t name_index = 0;
+        if (!snapshot_writer_intern(writer, attributes[i].name, &name_index))
+        {
+            ld_error("snapshot_writer_add_record - out of memory!\n");
+            return RETURN_CODE_FAILURE;
+        }
+
+        snapshot_writer_write_u32(writer, name_index);
+        snapshot_writer_write_u32(writer, attributes[i].n_values);
+
+        for (uint32_t j = 0; j < attributes[i].n_values; ++j)
+        {
+            snapshot_writer_write_string(writer, attributes[i].values[j].data, attributes[i].values[j].length);
+        }
+    }
+
+    return writer->failed ? RETURN_CODE_FAILURE : RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_snapshot_writer_add Appends entry to the snapshot file.
+ * @param[in] writer Writer to use.
+ * @param[in] entry  Entry to write.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_snapshot_writer_add(ld_snapshot_writer_t *writer, ld_entry_t *entry)
+{
+    if (!writer || !entry || !entry->dn || !entry->attributes)
+    {
+        ld_error("ld_snapshot_writer_add - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    uint32_t n_attributes = g_hash_table_size(entry->attributes);
+    snapshot_attribute_t *attributes = talloc_zero_array(talloc_ctx, snapshot_attribute_t, n_attributes + 1);
+    if (!attributes)
+    {
+        ld_error("ld_snapshot_writer_add - out of memory!\n");
+        talloc_free(talloc_ctx);
+        return RETURN_CODE_FAILURE;
+    }
+
+    GHashTableIter iter;
+    gpointer key = NULL, value = NULL;
+    uint32_t index = 0;
+
+    g_hash_table_iter_init(&iter, entry->attributes);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        LDAPAttribute_t *attribute = value;
+
+        uint32_t n_values = 0;
+        while (attribute->values && attribute->values[n_values])
+        {
+            ++n_values;
+        }
+
+        attributes[index].name = attribute->name;
+        attributes[index].n_values = n_values;
+        attributes[index].values = talloc_array(attributes, snapshot_value_t, n_values + 1);
+        if (!attributes[index].values)
+        {
+            ld_error("ld_snapshot_writer_add - out of memory!\n");
+            talloc_free(talloc_ctx);
+            return RETURN_CODE_FAILURE;
+        }
+
+        for (uint32_t i = 0; i < n_values; ++i)
+        {
+            attributes[index].values[i].data = attribute->values[i];
+            attributes[index].values[i].length = strlen(attribute->values[i]);
+        }
+
+        ++index;
+    }
+
+    snapshot_value_t dn = { entry->dn, strlen(entry->dn) };
+
+    enum OperationReturnCode rc = snapshot_writer_add_record(writer, &dn, attributes, index);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
+
+/**
+ * @brief snapshot_writer_sync_directory Flushes directory of the file, so rename survives crash.
+ */
+static void snapshot_writer_sync_directory(const char *path)
+{
+    char *directory_path = talloc_strdup(NULL, path);
+    if (!directory_path)
+    {
+        return;
+    }
+
+    int fd = open(dirname(directory_path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+
+    talloc_free(directory_path);
+}
+
+/**
+ * @brief ld_snapshot_writer_close Writes attribute names, entry offsets and footer, flushes the file to disk and
+ * renames it over the snapshot file. Writer is freed.
+ * @param[in] writer Writer to close.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if any write failed.
+ */
+enum OperationReturnCode ld_snapshot_writer_close(ld_snapshot_writer_t *writer)
+{
+    if (!writer)
+    {
+        ld_error("ld_snapshot_writer_close - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    uint64_t names_offset = writer->position;
+    for (uint32_t i = 0; i < writer->n_names; ++i)
+    {
+        snapshot_writer_write_string(writer, writer->name_list[i], strlen(writer->name_list[i]));
+    }
+
+    uint64_t offsets_offset = writer->position;
+    for (uint32_t i = 0; i < writer->n_entries; ++i)
+    {
+        snapshot_writer_write_u64(writer, writer->offsets[i]);
+    }
+
+    snapshot_writer_write_u64(writer, names_offset);
+    snapshot_writer_write_u64(writer, offsets_offset);
+    snapshot_writer_write_u32(writer, writer->n_names);
+    snapshot_writer_write_u32(writer, writer->n_entries);
+    snapshot_writer_write(writer, SNAPSHOT_FILE_FOOTER_MAGIC, SNAPSHOT_FILE_MAGIC_SIZE);
+
+    if (writer->failed || fflush(writer->stream) != 0 || fsync(fileno(writer->stream)) != 0)
+    {
+        ld_error("ld_snapshot_writer_close - unable to write snapshot file %s!\n", writer->path);
+        talloc_free(writer);
+        return RETURN_CODE_FAILURE;
+    }
+
+    bool failed = fclose(writer->stream) != 0;
+    writer->stream = NULL;
+
+    if (failed || rename(writer->temporary_path, writer->path) != 0)
+    {
+        ld_error("ld_snapshot_writer_close - unable to replace snapshot file %s: %s\n", writer->path,
+                 strerror(errno));
+        unlink(writer->temporary_path);
+        talloc_free(writer);
+        return RETURN_CODE_FAILURE;
+    }
+
+    snapshot_writer_sync_directory(writer->path);
+
+    talloc_free(writer);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static int snapshot_file_destructor(TALLOC_CTX *ctx)
+{
+    ld_snapshot_file_t *file = talloc_get_type_abort(ctx, ld_snapshot_file_t);
+
+    if (file->data)
+    {
+        munmap((void*)file->data, file->size);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief snapshot_file_validate Checks header and footer and reads table of attribute names.
+ */
+static bool snapshot_file_validate(ld_snapshot_file_t *file)
+{
+    if (file->size < SNAPSHOT_FILE_MAGIC_SIZE + SNAPSHOT_FILE_FOOTER_SIZE
+        || memcmp(file->data, SNAPSHOT_FILE_MAGIC, SNAPSHOT_FILE_MAGIC_SIZE) != 0)
+    {
+        return false;
+    }
+
+    size_t footer = file->size - SNAPSHOT_FILE_FOOTER_SIZE;
+
+    if (memcmp(file->data + footer + 24, SNAPSHOT_FILE_FOOTER_MAGIC, SNAPSHOT_FILE_MAGIC_SIZE) != 0)
+    {
+        return false;
+    }
+
+    uint64_t names_offset = snapshot_read_u64(file->data + footer);
+    file->offsets = snapshot_read_u64(file->data + footer + 8);
+    file->n_names = snapshot_read_u32(file->data + footer + 16);
+    file->n_entries = snapshot_read_u32(file->data + footer + 20);
+
+    if (names_offset > file->offsets || file->offsets > footer
+        || (footer - file->offsets) / 8 < file->n_entries || file->n_names > SNAPSHOT_FILE_MAX_NAMES)
+    {
+        return false;
+    }
+
+    file->names = talloc_array(file, const char*, file->n_names + 1);
+    if (!file->names)
+    {
+        return false;
+    }
+
+    snapshot_cursor_t cursor = { file->data, file->offsets, names_offset, false };
+
+    for (uint32_t i = 0; i < file->n_names; ++i)
+    {
+        uint32_t length = 0;
+        file->names[i] = snapshot_cursor_string(&cursor, &length);
+    }
+    file->names[file->n_names] = NULL;
+
+    return !cursor.failed;
+}
+
+/**
+ * @brief ld_snapshot_file_open Maps snapshot file into memory and validates its tables.
+ * @param[in] ctx  Memory context to allocate file on, file is unmapped when it is freed.
+ * @param[in] path Path of the file.
+ * @return
+ *        - NULL on failure.
+ *        - mapped file.
+ */
+ld_snapshot_file_t *ld_snapshot_file_open(TALLOC_CTX *ctx, const char *path)
+{
+    if (!path)
+    {
+        ld_error("ld_snapshot_file_open - invalid parameters!\n");
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        ld_error("ld_snapshot_file_open - unable to open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+    {
+        ld_error("ld_snapshot_file_open - unable to read %s!\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        ld_error("ld_snapshot_file_open - unable to map %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    ld_snapshot_file_t *file = talloc_zero(ctx, ld_snapshot_file_t);
+    if (!file)
+    {
+        ld_error("ld_snapshot_file_open - out of memory!\n");
+        munmap(data, file_stat.st_size);
+        return NULL;
+    }
+
+    file->data = data;
+    file->size = file_stat.st_size;
+
+    talloc_set_destructor((void*)file, snapshot_file_destructor);
+
+    if (!snapshot_file_validate(file))
+    {
+        ld_error("ld_snapshot_file_open - %s is not a valid snapshot file!\n", path);
+        talloc_free(file);
+        return NULL;
+    }
+
+#ifdef MADV_WILLNEED
+    madvise(data, file->size, MADV_WILLNEED);
+#endif
+
+    return file;
+}
+
+/**
+ * @brief ld_snapshot_file_count Returns number of entries in the file.
+ * @param[in] file File to use.
+ * @return Number of entries.
+ */
+int ld_snapshot_file_count(const ld_snapshot_file_t *file)
+{
+    return file ? (int)file->n_entries : 0;
+}
+
+static bool snapshot_file_seek(const ld_snapshot_file_t *file, int index, snapshot_cursor_t *cursor)
+{
+    if (!file || index < 0 || (uint32_t)index >= file->n_entries)
+    {
+        return false;
+    }
+
+    cursor->data = file->data;
+    cursor->size = file->offsets;
+    cursor->position = snapshot_read_u64(file->data + file->offsets + (uint64_t)index * 8);
+    cursor->failed = cursor->position >= file->offsets;
+
+    return !cursor->failed;
+}
+
+/**
+ * @brief ld_snapshot_file_entry Builds entry from the file. Dn is copied, attribute names and values point into
+ * the mapping, so entry must not outlive the file.
+ * @param[in] ctx   Memory context to allocate entry on.
+ * @param[in] file  File to read.
+ * @param[in] index Index of the entry.
+ * @return
+ *        - NULL if index is out of range or entry is malformed.
+ *        - entry.
+ */
+ld_entry_t *ld_snapshot_file_entry(TALLOC_CTX *ctx, const ld_snapshot_file_t *file, int index)
+{
+    snapshot_cursor_t cursor;
+    if (!snapshot_file_seek(file, index, &cursor))
+    {
+        ld_error("ld_snapshot_file_entry - invalid index %d!\n", index);
+        return NULL;
+    }
+
+    uint32_t length = 0;
+    const char *dn = snapshot_cursor_string(&cursor, &length);
+    uint32_t n_attributes = snapshot_cursor_u32(&cursor);
+
+    ld_entry_t *entry = cursor.failed ? NULL : ld_entry_new(ctx, dn);
+
+    for (uint32_t i = 0; entry && !cursor.failed && i < n_attributes; ++i)
+    {
+        uint32_t name_index = snapshot_cursor_u32(&cursor);
+        uint32_t n_values = snapshot_cursor_u32(&cursor);
+
+        // Every value takes at least five bytes, this bounds the allocation below.
+        if (cursor.failed || name_index >= file->n_names || n_values > (cursor.size - cursor.position) / 5)
+        {
+            cursor.failed = true;
+            break;
+        }
+
+        // Attribute and its values array share one allocation, values themselves stay in the mapping.
+        LDAPAttribute_t *attribute = talloc_size(entry, sizeof(LDAPAttribute_t) + (n_values + 1) * sizeof(char*));
+        if (!attribute)
+        {
+            cursor.failed = true;
+            break;
+        }
+        talloc_set_name_const(attribute, "LDAPAttribute_t");
+
+        attribute->name = (char *)file->names[name_index];
+        attribute->values = (char **)(attribute + 1);
+
+        for (uint32_t j = 0; j < n_values; ++j)
+        {
+            attribute->values[j] = (char *)snapshot_cursor_string(&cursor, &length);
+        }
+        attribute->values[n_values] = NULL;
+
+        if (cursor.failed || ld_entry_add_attribute(entry, attribute) != RETURN_CODE_SUCCESS)
+        {
+            cursor.failed = true;
+        }
+    }
+
+    if (!entry || cursor.failed)
+    {
+        ld_error("ld_snapshot_file_entry - entry %d is malformed!\n", index);
+        talloc_free(entry);
+        return NULL;
+    }
+
+    return entry;
+}
+
+/**
+ * @brief ldif_is_safe Checks whether value can be written as SAFE-STRING of RFC 2849.
+ */
+static bool ldif_is_safe(const char *value, size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+
+    if (value[0] == ' ' || value[0] == ':' || value[0] == '<' || value[length - 1] == ' ')
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        unsigned char c = value[i];
+
+        if (c == '\0' || c == '\n' || c == '\r' || c > 127)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool ldif_write_folded(FILE *stream, const char *line, size_t length)
+{
+    size_t width = LDIF_LINE_WIDTH;
+
+    while (length > width)
+    {
+        if (fwrite(line, 1, width, stream) != width || fputs("\n ", stream) == EOF)
+        {
+            return false;
+        }
+
+        line += width;
+        length -= width;
+        width = LDIF_LINE_WIDTH - 1;
+    }
+
+    return fwrite(line, 1, length, stream) == length && fputc('\n', stream) != EOF;
+}
+
+static bool ldif_write_value(FILE *stream, const char *name, const char *value, size_t length)
+{
+    bool safe = ldif_is_safe(value, length);
+
+    char *encoded = safe ? NULL : g_base64_encode((const guchar *)value, length);
+    char *line = safe ? talloc_asprintf(NULL, "%s: %.*s", name, (int)length, value)
+                      : talloc_asprintf(NULL, "%s:: %s", name, encoded ? encoded : "");
+
+    bool result = line && (safe || encoded) && ldif_write_folded(stream, line, strlen(line));
+
+    g_free(encoded);
+    talloc_free(line);
+
+    return result;
+}
+
+/**
+ * @brief snapshot_file_entry_to_ldif Writes entry as LDIF content record, binary values are base64 encoded.
+ */
+static bool snapshot_file_entry_to_ldif(const ld_snapshot_file_t *file, int index, FILE *stream)
+{
+    snapshot_cursor_t cursor;
+    if (!snapshot_file_seek(file, index, &cursor))
+    {
+        return false;
+    }
+
+    uint32_t length = 0;
+    const char *dn = snapshot_cursor_string(&cursor, &length);
+    uint32_t n_attributes = snapshot_cursor_u32(&cursor);
+
+    bool result = !cursor.failed && fputc('\n', stream) != EOF && ldif_write_value(stream, "dn", dn, length);
+
+    for (uint32_t i = 0; result && i < n_attributes; ++i)
+    {
+        uint32_t name_index = snapshot_cursor_u32(&cursor);
+        uint32_t n_values = snapshot_cursor_u32(&cursor);
+
+        if (cursor.failed || name_index >= file->n_names)
+        {
+            return false;
+        }
+
+        for (uint32_t j = 0; result && j < n_values; ++j)
+        {
+            const char *value = snapshot_cursor_string(&cursor, &length);
+
+            result = !cursor.failed && ldif_write_value(stream, file->names[name_index], value, length);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief ld_snapshot_file_to_ldif Converts snapshot file to LDIF.
+ * @param[in] path      Path of the snapshot file.
+ * @param[in] ldif_path Path of the LDIF file to create.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_snapshot_file_to_ldif(const char *path, const char *ldif_path)
+{
+    if (!path || !ldif_path)
+    {
+        ld_error("ld_snapshot_file_to_ldif - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    ld_snapshot_file_t *file = ld_snapshot_file_open(talloc_ctx, path);
+    if (!file)
+    {
+        talloc_free(talloc_ctx);
+        return RETURN_CODE_FAILURE;
+    }
+
+    FILE *stream = fopen(ldif_path, "w");
+    if (!stream)
+    {
+        ld_error("ld_snapshot_file_to_ldif - unable to create %s: %s\n", ldif_path, strerror(errno));
+        talloc_free(talloc_ctx);
+        return RETURN_CODE_FAILURE;
+    }
+
+    bool result = fputs("version: 1\n", stream) != EOF;
+
+    for (uint32_t i = 0; result && i < file->n_entries; ++i)
+    {
+        result = snapshot_file_entry_to_ldif(file, i, stream);
+    }
+
+    result = fclose(stream) == 0 && result;
+
+    talloc_free(talloc_ctx);
+
+    if (!result)
+    {
+        ld_error("ld_snapshot_file_to_ldif - unable to write %s!\n", ldif_path);
+    }
+
+    return result ? RETURN_CODE_SUCCESS : RETURN_CODE_FAILURE;
+}
+
+/**
+ * @brief ldif_add_value Appends value to the record, values of the same attribute are grouped.
+ */
+static bool ldif_add_value(ldif_record_t *record, const char *name, char *value, uint32_t length)
+{
+    snapshot_attribute_t *attribute = NULL;
+
+    for (uint32_t i = 0; i < record->n_attributes; ++i)
+    {
+        if (strcasecmp(record->attributes[i].name, name) == 0)
+        {
+            attribute = &record->attributes[i];
+            break;
+        }
+    }
+
+    if (!attribute)
+    {
+        snapshot_attribute_t *attributes = talloc_realloc(record, record->attributes, snapshot_attribute_t,
+                                                          record->n_attributes + 1);
+        if (!attributes)
+        {
+            return false;
+        }
+
+        record->attributes = attributes;
+        attribute = &record->attributes[record->n_attributes++];
+        memset(attribute, 0, sizeof(snapshot_attribute_t));
+
+        attribute->name = talloc_strdup(record, name);
+        if (!attribute->name)
+        {
+            return false;
+        }
+    }
+
+    snapshot_value_t *values = talloc_realloc(record, attribute->values, snapshot_value_t, attribute->n_values + 1);
+    if (!values)
+    {
+        return false;
+    }
+
+    attribute->values = values;
+    attribute->values[attribute->n_values].data = talloc_steal(record, value);
+    attribute->values[attribute->n_values].length = length;
+    attribute->n_values++;
+
+    return true;
+}
+
+/**
+ * @brief ldif_parse_value Splits logical LDIF line into attribute description and decoded value.
+ * @return
+ *        - NULL if line is malformed.
+ *        - decoded value allocated on ctx.
+ */
+static char *ldif_parse_value(TALLOC_CTX *ctx, char *line, const char **name, uint32_t *length)
+{
+    char *separator = strchr(line, ':');
+    if (!separator || separator == line)
+    {
+        return NULL;
+    }
+
+    *separator = '\0';
+    *name = line;
+
+    char *value = separator + 1;
+    bool encoded = *value == ':';
+
+    if (*value == ':' || *value == '<')
+    {
+        if (*value == '<')
+        {
+            // URL values would make conversion depend on external files.
+            return NULL;
+        }
+        ++value;
+    }
+
+    while (*value == ' ')
+    {
+        ++value;
+    }
+
+    if (!encoded)
+    {
+        *length = strlen(value);
+        return talloc_strdup(ctx, value);
+    }
+
+    gsize decoded_length = 0;
+    guchar *decoded = g_base64_decode(value, &decoded_length);
+
+    char *result = talloc_array(ctx, char, decoded_length + 1);
+    if (result)
+    {
+        if (decoded_length > 0)
+        {
+            memcpy(result, decoded, decoded_length);
+        }
+        result[decoded_length] = '\0';
+        *length = decoded_length;
+    }
+
+    g_free(decoded);
+
+    return result;
+}
+
+/**
+ * @brief ldif_process_line Applies logical LDIF line to the record being parsed.
+ */
+static bool ldif_process_line(TALLOC_CTX *ctx, ldif_record_t **record, bool *first, char *line)
+{
+    const char *name = NULL;
+    uint32_t length = 0;
+
+    char *value = ldif_parse_value(ctx, line, &name, &length);
+    if (!value)
+    {
+        return false;
+    }
+
+    if (*first && !*record && strcasecmp(name, "version") == 0)
+    {
+        *first = false;
+        talloc_free(value);
+        return true;
+    }
+    *first = false;
+
+    if (strcasecmp(name, "dn") == 0)
+    {
+        if (*record)
+        {
+            return false;
+        }
+
+        *record = talloc_zero(ctx, ldif_record_t);
+        if (!*record)
+        {
+            return false;
+        }
+
+        (*record)->dn.data = talloc_steal(*record, value);
+        (*record)->dn.length = length;
+
+        return true;
+    }
+
+    if (!*record)
+    {
+        return false;
+    }
+
+    if (strcasecmp(name, "changetype") == 0)
+    {
+        // Only content records and add change records describe complete entries.
+        bool add = strcasecmp(value, "add") == 0;
+        talloc_free(value);
+        return add;
+    }
+
+    return ldif_add_value(*record, name, value, length);
+}
+
+static bool ldif_flush_record(ld_snapshot_writer_t *writer, ldif_record_t **record)
+{
+    if (!*record)
+    {
+        return true;
+    }
+
+    bool result = snapshot_writer_add_record(writer, &(*record)->dn, (*record)->attributes,
+                                             (*record)->n_attributes) == RETURN_CODE_SUCCESS;
+
+    talloc_free(*record);
+    *record = NULL;
+
+    return result;
+}
+
+/**
+ * @brief ld_snapshot_file_from_ldif Converts LDIF content records to snapshot file.
+ * @param[in] ldif_path Path of the LDIF file.
+ * @param[in] path      Path of the snapshot file to create.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_snapshot_file_from_ldif(const char *ldif_path, const char *path)
+{
+    if (!ldif_path || !path)
+    {
+        ld_error("ld_snapshot_file_from_ldif - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    FILE *stream = fopen(ldif_path, "r");
+    if (!stream)
+    {
+        ld_error("ld_snapshot_file_from_ldif - unable to open %s: %s\n", ldif_path, strerror(errno));
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    ld_snapshot_writer_t *writer = ld_snapshot_writer_open(talloc_ctx, path);
+    if (!writer)
+    {
+        fclose(stream);
+        talloc_free(talloc_ctx);
+        return RETURN_CODE_FAILURE;
+    }
+
+    ldif_record_t *record = NULL;
+    char *logical = NULL;
+    bool comment = false;
+    bool first = true;
+    bool result = true;
+    int line_number = 0;
+
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t line_length = 0;
+
+    while (result && (line_length = getline(&line, &line_size, stream)) >= 0)
+    {
+        ++line_number;
+
+        while (line_length > 0 && (line[line_length - 1] == '\n' || line[line_length - 1] == '\r'))
+        {
+            line[--line_length] = '\0';
+        }
+
+        if (line[0] == ' ')
+        {
+            if (!comment)
+            {
+                result = logical && (logical = talloc_strdup_append_buffer(logical, line + 1)) != NULL;
+            }
+            continue;
+        }
+
+        if (logical)
+        {
+            result = ldif_process_line(talloc_ctx, &record, &first, logical);
+            talloc_free(logical);
+            logical = NULL;
+        }
+
+        comment = line[0] == '#';
+
+        if (!result || comment)
+        {
+            continue;
+        }
+
+        if (line[0] == '\0')
+        {
+            result = ldif_flush_record(writer, &record);
+        }
+        else
+        {
+            logical = talloc_strdup(talloc_ctx, line);
+            result = logical != NULL;
+        }
+    }
+
+    if (result && logical)
+    {
+        result = ldif_process_line(talloc_ctx, &record, &first, logical);
+    }
+
+    result = result && ldif_flush_record(writer, &record);
+
+    free(line);
+    fclose(stream);
+
+    if (!result)
+    {
+        ld_error("ld_snapshot_file_from_ldif - unable to convert %s, error at line %d!\n", ldif_path, line_number);
+        talloc_free(talloc_ctx);
+        unlink(path);
+        return RETURN_CODE_FAILURE;
+    }
+
+    enum OperationReturnCode rc = ld_snapshot_writer_close(writer);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
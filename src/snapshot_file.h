@@ -0,0 +1,41 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_SNAPSHOT_FILE_H
+#define LIB_DOMAIN_SNAPSHOT_FILE_H
+
+#include "common.h"
+#include "entry.h"
+
+typedef struct ld_snapshot_writer_s ld_snapshot_writer_t;
+typedef struct ld_snapshot_file_s ld_snapshot_file_t;
+
+ld_snapshot_writer_t *ld_snapshot_writer_open(TALLOC_CTX *ctx, const char *path);
+enum OperationReturnCode ld_snapshot_writer_add(ld_snapshot_writer_t *writer, ld_entry_t *entry);
+enum OperationReturnCode ld_snapshot_writer_close(ld_snapshot_writer_t *writer);
+
+ld_snapshot_file_t *ld_snapshot_file_open(TALLOC_CTX *ctx, const char *path);
+int ld_snapshot_file_count(const ld_snapshot_file_t *file);
+ld_entry_t *ld_snapshot_file_entry(TALLOC_CTX *ctx, const ld_snapshot_file_t *file, int index);
+
+enum OperationReturnCode ld_snapshot_file_from_ldif(const char *ldif_path, const char *path);
+enum OperationReturnCode ld_snapshot_file_to_ldif(const char *path, const char *ldif_path);
+
+#endif //LIB_DOMAIN_SNAPSHOT_FILE_H
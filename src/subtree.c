@@ -0,0 +1,749 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "subtree.h"
+
+#include "connection.h"
+#include "domain_p.h"
+#include "entry.h"
+#include "pipeline.h"
+#include "root_dse.h"
+#include "schema.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define LDAP_CONTROL_TREE_DELETE_OID "1.2.840.113556.1.4.805"
+#define SUBTREE_PAGE_SIZE 500
+
+/*!
+ * @brief subtree_node_t - Entry of the subtree with its depth below the root.
+ */
+typedef struct subtree_node_s
+{
+    char *dn;                        //!< Distinguished name of the entry.
+    int depth;                       //!< Number of RDNs in the dn.
+    ld_entry_t *entry;               //!< Attributes of the entry, only read when subtree is copied.
+} subtree_node_t;
+
+struct subtree_operation_s;
+
+typedef enum OperationReturnCode (*subtree_submit_fn)(struct subtree_operation_s *operation, subtree_node_t *node);
+typedef void (*subtree_done_fn)(struct subtree_operation_s *operation);
+
+/*!
+ * @brief subtree_operation_t - State of operation applied to every entry of the subtree. Entries are processed level
+ * by level, every level is pipelined and next level starts once all results of the current one were received.
+ */
+typedef struct subtree_operation_s
+{
+    LDHandle *handle;                //!< Handle operation is performed with.
+    connection_identity_t identity;  //!< Identity and priority class requests of every level are submitted with.
+    char *dn;                        //!< Root of the subtree.
+    char *rdn;                       //!< RDN of the root, move only.
+    char *new_parent;                //!< New parent of the root, move only.
+    char *new_dn;                    //!< New dn of the root, move only.
+    char *root_dn;                   //!< Dn of the root as returned by the server, copy only.
+
+    subtree_node_t *nodes;           //!< Entries of the subtree in processing order.
+    int count;                       //!< Number of entries.
+    int level_start;                 //!< First entry of the current level.
+    int level_end;                   //!< Entry after the last one of the current level.
+    int outstanding;                 //!< Operations of the current level which result was not received yet.
+    bool level_submitted;            //!< Every operation of the current level was submitted.
+    int tolerated_result;            //!< Result code besides LDAP_SUCCESS which counts as success.
+
+    int processed;                   //!< Number of processed entries.
+    int failed;                      //!< Number of entries which were not processed.
+
+    subtree_submit_fn submit_node;   //!< Submits operation for one entry.
+    subtree_done_fn on_levels_done;  //!< Called once every level is processed.
+
+    subtree_callback_fn callback;    //!< Callback to call once operation is over.
+    void *user_data;                 //!< User data to pass to callback.
+} subtree_operation_t;
+
+/**
+ * @brief subtree_dn_depth Counts RDNs of the dn, escaped commas are not separators.
+ * @param[in] dn Dn to use.
+ * @return Number of RDNs.
+ */
+static int subtree_dn_depth(const char *dn)
+{
+    int depth = 1;
+
+    for (const char *c = dn; *c; ++c)
+    {
+        if (*c == '\\' && c[1])
+        {
+            ++c;
+        }
+        else if (*c == ',')
+        {
+            ++depth;
+        }
+    }
+
+    return depth;
+}
+
+/**
+ * @brief subtree_dn_rdn Returns first RDN of the dn.
+ * @param[in] ctx Memory context to allocate RDN on.
+ * @param[in] dn  Dn to use.
+ * @return RDN of the dn.
+ */
+static char *subtree_dn_rdn(TALLOC_CTX *ctx, const char *dn)
+{
+    const char *c = dn;
+
+    for (; *c; ++c)
+    {
+        if (*c == '\\' && c[1])
+        {
+            ++c;
+        }
+        else if (*c == ',')
+        {
+            break;
+        }
+    }
+
+    return talloc_strndup(ctx, dn, c - dn);
+}
+
+/**
+ * @brief subtree_dn_is_below Checks if dn equals to the suffix or belongs to the subtree of the suffix.
+ * @param[in] dn     Dn to check.
+ * @param[in] suffix Dn of the subtree.
+ * @return
+ *        - true if dn ends with the suffix on rdn boundary, comparison is case insensitive.
+ *        - false otherwise.
+ */
+static bool subtree_dn_is_below(const char *dn, const char *suffix)
+{
+    size_t dn_length = strlen(dn);
+    size_t suffix_length = strlen(suffix);
+
+    if (suffix_length > dn_length || strcasecmp(dn + dn_length - suffix_length, suffix) != 0)
+    {
+        return false;
+    }
+
+    return suffix_length == dn_length || dn[dn_length - suffix_length - 1] == ',';
+}
+
+/**
+ * @brief subtree_naming_context Finds naming context which holds the dn.
+ * @param[in] root_dse Root DSE of the server, can be NULL.
+ * @param[in] dn       Dn to use.
+ * @return
+ *        - NULL if naming context is unknown.
+ *        - The longest naming context dn ends with.
+ */
+static const char *subtree_naming_context(const ld_root_dse_t *root_dse, const char *dn)
+{
+    const char *result = NULL;
+
+    for (int i = 0; root_dse && root_dse->naming_contexts && root_dse->naming_contexts[i]; ++i)
+    {
+        const char *context = root_dse->naming_contexts[i];
+
+        if (!subtree_dn_is_below(dn, context))
+        {
+            continue;
+        }
+
+        if (!result || strlen(result) < strlen(context))
+        {
+            result = context;
+        }
+    }
+
+    return result;
+}
+
+static int subtree_node_compare_deepest_first(const void *left, const void *right)
+{
+    return ((const subtree_node_t*)right)->depth - ((const subtree_node_t*)left)->depth;
+}
+
+static int subtree_node_compare_shallowest_first(const void *left, const void *right)
+{
+    return ((const subtree_node_t*)left)->depth - ((const subtree_node_t*)right)->depth;
+}
+
+static void subtree_finish(subtree_operation_t *operation)
+{
+    if (operation->callback)
+    {
+        operation->callback(operation->handle, operation->processed, operation->failed, operation->user_data);
+    }
+
+    talloc_free(operation);
+}
+
+static void subtree_process_level(subtree_operation_t *operation);
+
+static void subtree_next_level(subtree_operation_t *operation)
+{
+    if (!operation->level_submitted || operation->outstanding > 0)
+    {
+        return;
+    }
+
+    operation->level_start = operation->level_end;
+
+    subtree_process_level(operation);
+}
+
+static void subtree_on_node_result(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    subtree_operation_t *operation = talloc_get_type_abort(user_data, subtree_operation_t);
+
+    --operation->outstanding;
+
+    if (result_code == LDAP_SUCCESS || result_code == operation->tolerated_result)
+    {
+        ++operation->processed;
+    }
+    else
+    {
+        ++operation->failed;
+    }
+
+    subtree_next_level(operation);
+}
+
+static enum OperationReturnCode subtree_submit(struct ldap_connection_ctx_t *connection, int index,
+                                               void *user_data)
+{
+    (void)(connection);
+
+    subtree_operation_t *operation = user_data;
+
+    enum OperationReturnCode rc = operation->submit_node(operation, &operation->nodes[operation->level_start + index]);
+    if (rc == RETURN_CODE_SUCCESS)
+    {
+        ++operation->outstanding;
+    }
+
+    return rc;
+}
+
+static void subtree_on_level_submitted(struct ldap_connection_ctx_t *connection, int submitted, int failed,
+                                       void *user_data)
+{
+    (void)(connection);
+    (void)(submitted);
+
+    subtree_operation_t *operation = user_data;
+
+    operation->failed += failed;
+    operation->level_submitted = true;
+
+    subtree_next_level(operation);
+}
+
+/**
+ * @brief subtree_process_level Submits operations for every entry on the current level.
+ * @param[in] operation State of the operation.
+ */
+static void subtree_process_level(subtree_operation_t *operation)
+{
+    if (operation->level_start >= operation->count)
+    {
+        operation->on_levels_done(operation);
+        return;
+    }
+
+    int depth = operation->nodes[operation->level_start].depth;
+
+    operation->level_end = operation->level_start;
+    while (operation->level_end < operation->count && operation->nodes[operation->level_end].depth == depth)
+    {
+        ++operation->level_end;
+    }
+
+    operation->level_submitted = false;
+
+    if (pipeline_start(operation, operation->handle->connection_ctx, &operation->identity,
+                       operation->level_end - operation->level_start, subtree_submit, subtree_on_level_submitted,
+                       operation) != RETURN_CODE_SUCCESS)
+    {
+        operation->failed += operation->count - operation->level_start;
+        subtree_finish(operation);
+    }
+}
+
+/**
+ * @brief subtree_on_enumerated Builds processing plan of the subtree and starts processing.
+ * Entries are kept when operation copies them.
+ */
+static enum OperationReturnCode subtree_on_enumerated(struct ldap_connection_ctx_t *connection,
+                                                      ld_entry_t **entries,
+                                                      void *user_data)
+{
+    (void)(connection);
+
+    subtree_operation_t *operation = talloc_get_type_abort(user_data, subtree_operation_t);
+
+    bool keep_entries = operation->new_dn != NULL;
+
+    int entries_count = 0;
+    while (entries && entries[entries_count])
+    {
+        ++entries_count;
+    }
+
+    operation->nodes = talloc_array(operation, subtree_node_t, entries_count + 1);
+    if (!operation->nodes)
+    {
+        ld_error("subtree_on_enumerated - out of memory!\n");
+        operation->failed = 1;
+        subtree_finish(operation);
+        return RETURN_CODE_FAILURE;
+    }
+
+    for (int i = 0; i < entries_count; ++i)
+    {
+        const char *dn = ld_entry_get_dn(entries[i]);
+        if (!dn || strlen(dn) == 0)
+        {
+            continue;
+        }
+
+        subtree_node_t *node = &operation->nodes[operation->count++];
+        node->dn = talloc_strdup(operation->nodes, dn);
+        node->depth = subtree_dn_depth(dn);
+        node->entry = keep_entries ? talloc_steal(operation->nodes, entries[i]) : NULL;
+    }
+
+    qsort(operation->nodes, operation->count, sizeof(subtree_node_t),
+          keep_entries ? subtree_node_compare_shallowest_first : subtree_node_compare_deepest_first);
+
+    // Server may spell dn of the root differently from the caller, dns of copies are built from its spelling.
+    if (keep_entries && operation->count > 0)
+    {
+        operation->root_dn = operation->nodes[0].dn;
+    }
+
+    ld_info("Processing %d entries of %s\n", operation->count, operation->dn);
+
+    subtree_process_level(operation);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static subtree_operation_t *subtree_operation_new(LDHandle *handle, const char *dn,
+                                                  subtree_callback_fn callback, void *user_data)
+{
+    subtree_operation_t *operation = talloc_zero(handle->talloc_ctx, subtree_operation_t);
+    if (!operation)
+    {
+        return NULL;
+    }
+
+    operation->handle = handle;
+    operation->dn = talloc_strdup(operation, dn);
+    operation->callback = callback;
+    operation->user_data = user_data;
+
+    if (connection_save_identity(operation, handle->connection_ctx, &operation->identity) != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(operation);
+        return NULL;
+    }
+
+    return operation;
+}
+
+/**
+ * @brief subtree_on_enumeration_failed Finishes operation when subtree can't be enumerated, e.g. root is missing,
+ * access is denied or deadline expired. Nothing was processed, root counts as failed entry.
+ */
+static void subtree_on_enumeration_failed(struct ldap_connection_ctx_t *connection, int result_code,
+                                          void *user_data)
+{
+    (void)(connection);
+
+    subtree_operation_t *operation = talloc_get_type_abort(user_data, subtree_operation_t);
+
+    ld_error("Unable to enumerate subtree of %s: %s\n", operation->dn, ldap_err2string(result_code));
+
+    operation->failed = 1;
+
+    subtree_finish(operation);
+}
+
+static enum OperationReturnCode subtree_enumerate(subtree_operation_t *operation, char **attributes)
+{
+    return search_paged_ext(operation->handle->connection_ctx, operation->dn, LDAP_SCOPE_SUBTREE, "(objectClass=*)",
+                            attributes, SUBTREE_PAGE_SIZE, subtree_on_enumerated, subtree_on_enumeration_failed,
+                            operation);
+}
+
+static enum OperationReturnCode subtree_delete_node(subtree_operation_t *operation, subtree_node_t *node)
+{
+    return delete_ext(operation->handle->connection_ctx, node->dn, NULL, subtree_on_node_result, operation);
+}
+
+static void subtree_on_tree_delete(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    subtree_operation_t *operation = talloc_get_type_abort(user_data, subtree_operation_t);
+
+    if (result_code == LDAP_SUCCESS)
+    {
+        operation->processed = 1;
+    }
+    else
+    {
+        operation->failed = 1;
+    }
+
+    subtree_finish(operation);
+}
+
+/**
+ * @brief ld_del_tree Deletes entry with all its descendants. When server advertises Tree Delete control
+ * subtree is deleted with single request. Otherwise subtree is enumerated with paged search and entries are
+ * deleted level by level starting with leaves, deletes of one level are pipelined through the request window.
+ * @param[in] handle    Pointer to libdomain session handle.
+ * @param[in] dn        Root of the subtree to delete.
+ * @param[in] callback  Callback to receive number of deleted and failed entries, when Tree Delete control is used
+ *                      whole subtree counts as one entry. Can be NULL.
+ * @param[in] user_data User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode ld_del_tree(LDHandle *handle,
+                                     const char *dn,
+                                     subtree_callback_fn callback,
+                                     void *user_data)
+{
+    check_handle(handle, "ld_del_tree");
+
+    if (!dn || strlen(dn) == 0)
+    {
+        ld_error("ld_del_tree - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    struct ldap_connection_ctx_t *connection = handle->connection_ctx;
+
+    subtree_operation_t *operation = subtree_operation_new(handle, dn, callback, user_data);
+    if (!operation)
+    {
+        ld_error("ld_del_tree - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    operation->tolerated_result = LDAP_NO_SUCH_OBJECT;
+    operation->submit_node = subtree_delete_node;
+    operation->on_levels_done = subtree_finish;
+
+    enum OperationReturnCode rc = RETURN_CODE_FAILURE;
+
+    if (connection->root_dse && root_dse_supports_control(connection->root_dse, LDAP_CONTROL_TREE_DELETE_OID))
+    {
+        LDAPControl tree_delete = { LDAP_CONTROL_TREE_DELETE_OID, { 0, NULL }, 1 };
+        LDAPControl *server_controls[] = { &tree_delete, NULL };
+
+        rc = delete_ext(connection, operation->dn, server_controls, subtree_on_tree_delete, operation);
+    }
+    else
+    {
+        char *attributes[] = { LDAP_NO_ATTRS, NULL };
+
+        rc = subtree_enumerate(operation, attributes);
+    }
+
+    if (rc != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(operation);
+    }
+
+    return rc;
+}
+
+/*!
+ * @brief SUBTREE_COPY_SKIPPED_ATTRIBUTES - Attributes server assigns to new entry itself.
+ */
+static const char *SUBTREE_COPY_SKIPPED_ATTRIBUTES[] =
+{
+    "distinguishedName", "objectGUID", "objectSid", NULL
+};
+
+/**
+ * @brief subtree_copy_attribute Checks if attribute may be supplied when entry is added.
+ * @param[in] schema Schema of the directory, can be NULL.
+ * @param[in] name   Name of the attribute.
+ * @return
+ *        - false if attribute is NO-USER-MODIFICATION or assigned by server.
+ *        - true otherwise.
+ */
+static bool subtree_copy_attribute(const ldap_schema_t *schema, const char *name)
+{
+    for (int i = 0; SUBTREE_COPY_SKIPPED_ATTRIBUTES[i]; ++i)
+    {
+        if (strcasecmp(SUBTREE_COPY_SKIPPED_ATTRIBUTES[i], name) == 0)
+        {
+            return false;
+        }
+    }
+
+    LDAPAttributeType *attribute_type = schema ? ldap_schema_find_attributetype(schema, name) : NULL;
+
+    return !attribute_type || !attribute_type->at_no_user_mod;
+}
+
+/**
+ * @brief subtree_copy_dn Builds dn of the copy, entry keeps its position below the root.
+ * @param[in] ctx       Memory context to allocate dn on.
+ * @param[in] operation State of the operation.
+ * @param[in] dn        Dn of the entry as returned by the server.
+ * @return
+ *        - NULL if entry does not belong to the subtree.
+ *        - Dn of the copy.
+ */
+static char *subtree_copy_dn(TALLOC_CTX *ctx, subtree_operation_t *operation, const char *dn)
+{
+    if (!operation->root_dn || !subtree_dn_is_below(dn, operation->root_dn))
+    {
+        return NULL;
+    }
+
+    int prefix_length = (int)(strlen(dn) - strlen(operation->root_dn));
+
+    return talloc_asprintf(ctx, "%.*s%s", prefix_length, dn, operation->new_dn);
+}
+
+static enum OperationReturnCode subtree_copy_node(subtree_operation_t *operation, subtree_node_t *node)
+{
+    struct ldap_connection_ctx_t *connection = operation->handle->connection_ctx;
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    char *new_dn = subtree_copy_dn(talloc_ctx, operation, node->dn);
+    if (!new_dn)
+    {
+        ld_error("ld_move_tree - %s is not below %s!\n", node->dn, operation->root_dn);
+        talloc_free(talloc_ctx);
+        return RETURN_CODE_FAILURE;
+    }
+
+    LDAPAttribute_t **attributes = ld_entry_get_attributes(node->entry);
+
+    int attributes_count = 0;
+    while (attributes && attributes[attributes_count])
+    {
+        ++attributes_count;
+    }
+
+    LDAPMod **mods = talloc_zero_array(talloc_ctx, LDAPMod*, attributes_count + 1);
+    int mods_count = 0;
+
+    for (int i = 0; i < attributes_count; ++i)
+    {
+        if (!attributes[i]->values || !subtree_copy_attribute(connection->schema, attributes[i]->name))
+        {
+            continue;
+        }
+
+        // Values are copied with their lengths, so binary values are copied intact.
+        struct berval **values = ld_entry_get_values_len(mods, node->entry, attributes[i]->name);
+        if (!values)
+        {
+            ld_error("ld_move_tree - unable to copy %s of %s!\n", attributes[i]->name, node->dn);
+            talloc_free(attributes);
+            talloc_free(talloc_ctx);
+            return RETURN_CODE_FAILURE;
+        }
+
+        LDAPMod *mod = talloc_zero(mods, LDAPMod);
+        mod->mod_op = LDAP_MOD_ADD | LDAP_MOD_BVALUES;
+        mod->mod_type = attributes[i]->name;
+        mod->mod_bvalues = values;
+        mods[mods_count++] = mod;
+    }
+
+    enum OperationReturnCode rc = add_ext(connection, new_dn, mods, NULL, subtree_on_node_result, operation);
+
+    talloc_free(attributes);
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
+
+static void subtree_move_on_originals_deleted(LDHandle *handle, int processed, int failed, void *user_data)
+{
+    (void)(handle);
+    (void)(processed);
+
+    subtree_operation_t *operation = talloc_get_type_abort(user_data, subtree_operation_t);
+
+    operation->failed += failed;
+
+    subtree_finish(operation);
+}
+
+/**
+ * @brief subtree_move_on_copied Deletes original subtree once every entry was copied. When copy is incomplete
+ * original subtree is left intact.
+ */
+static void subtree_move_on_copied(subtree_operation_t *operation)
+{
+    if (operation->failed > 0)
+    {
+        ld_error("ld_move_tree - %d entries of %s were not copied, original subtree is kept!\n",
+                 operation->failed, operation->dn);
+        subtree_finish(operation);
+        return;
+    }
+
+    // Original subtree is deleted on behalf of identity move was started with.
+    connection_identity_t previous_identity;
+    connection_apply_identity(operation->handle->connection_ctx, &operation->identity, &previous_identity);
+
+    enum OperationReturnCode rc = ld_del_tree(operation->handle, operation->dn, subtree_move_on_originals_deleted,
+                                              operation);
+
+    connection_apply_identity(operation->handle->connection_ctx, &previous_identity, NULL);
+
+    if (rc != RETURN_CODE_SUCCESS)
+    {
+        ++operation->failed;
+        subtree_finish(operation);
+    }
+}
+
+static enum OperationReturnCode subtree_move_copy(subtree_operation_t *operation)
+{
+    operation->tolerated_result = LDAP_SUCCESS;
+    operation->submit_node = subtree_copy_node;
+    operation->on_levels_done = subtree_move_on_copied;
+
+    char *attributes[] = { LDAP_ALL_USER_ATTRIBUTES, NULL };
+
+    return subtree_enumerate(operation, attributes);
+}
+
+static void subtree_move_on_renamed(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    subtree_operation_t *operation = talloc_get_type_abort(user_data, subtree_operation_t);
+
+    switch (result_code)
+    {
+    case LDAP_SUCCESS:
+        operation->processed = 1;
+        break;
+    case LDAP_AFFECTS_MULTIPLE_DSAS:
+    case LDAP_NOT_ALLOWED_ON_NONLEAF:
+    case LDAP_UNWILLING_TO_PERFORM:
+        ld_info("ld_move_tree - server refused to move %s, copying subtree\n", operation->dn);
+        if (subtree_move_copy(operation) == RETURN_CODE_SUCCESS)
+        {
+            return;
+        }
+        operation->failed = 1;
+        break;
+    default:
+        operation->failed = 1;
+        break;
+    }
+
+    subtree_finish(operation);
+}
+
+/**
+ * @brief ld_move_tree Moves entry with all its descendants under new parent. Subtree is moved with single ModDN
+ * request when both parents belong to the same naming context. When they do not or server refuses to move
+ * the subtree, entries are copied level by level starting with the root, attributes which can not be supplied
+ * by client (NO-USER-MODIFICATION in the loaded schema) are skipped, and original subtree is deleted once every
+ * entry was copied.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] dn         Root of the subtree to move.
+ * @param[in] new_parent New parent of the subtree.
+ * @param[in] callback   Callback to receive number of moved and failed entries, when subtree is moved with ModDN
+ *                       whole subtree counts as one entry. Can be NULL.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if too many operations are in flight.
+ */
+enum OperationReturnCode ld_move_tree(LDHandle *handle,
+                                      const char *dn,
+                                      const char *new_parent,
+                                      subtree_callback_fn callback,
+                                      void *user_data)
+{
+    check_handle(handle, "ld_move_tree");
+
+    if (!dn || strlen(dn) == 0 || !new_parent || strlen(new_parent) == 0)
+    {
+        ld_error("ld_move_tree - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    struct ldap_connection_ctx_t *connection = handle->connection_ctx;
+
+    subtree_operation_t *operation = subtree_operation_new(handle, dn, callback, user_data);
+    if (!operation)
+    {
+        ld_error("ld_move_tree - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    operation->rdn = subtree_dn_rdn(operation, dn);
+    operation->new_parent = talloc_strdup(operation, new_parent);
+    operation->new_dn = talloc_asprintf(operation, "%s,%s", operation->rdn, new_parent);
+
+    const char *source_context = subtree_naming_context(connection->root_dse, dn);
+    const char *target_context = subtree_naming_context(connection->root_dse, new_parent);
+
+    enum OperationReturnCode rc = RETURN_CODE_FAILURE;
+
+    if (source_context == target_context)
+    {
+        rc = rename_ext(connection, operation->dn, operation->rdn, operation->new_parent, true, NULL,
+                        subtree_move_on_renamed, operation);
+    }
+    else
+    {
+        rc = subtree_move_copy(operation);
+    }
+
+    if (rc != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(operation);
+    }
+
+    return rc;
+}
@@ -0,0 +1,42 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_SUBTREE_H
+#define LIB_DOMAIN_SUBTREE_H
+
+#include "common.h"
+#include "domain.h"
+
+/*!
+ * @brief subtree_callback_fn Callback which is called once subtree operation is over.
+ */
+typedef void (*subtree_callback_fn)(LDHandle *handle, int processed, int failed, void *user_data);
+
+enum OperationReturnCode ld_del_tree(LDHandle *handle,
+                                     const char *dn,
+                                     subtree_callback_fn callback,
+                                     void *user_data);
+enum OperationReturnCode ld_move_tree(LDHandle *handle,
+                                      const char *dn,
+                                      const char *new_parent,
+                                      subtree_callback_fn callback,
+                                      void *user_data);
+
+#endif //LIB_DOMAIN_SUBTREE_H
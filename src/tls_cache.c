@@ -0,0 +1,294 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "tls_cache.h"
+
+#include <stdbool.h>
+
+#ifdef LIBDOMAIN_HAVE_OPENSSL
+#include <openssl/ssl.h>
+#include <string.h>
+#endif
+
+/*!
+ * @brief tls_cache_t - TLS state shared by all connections of one handle.
+ *
+ * TLS context holds CA store, client certificate and key, they are loaded when first connection is configured
+ * and reused by every reconnect of connections with the same TLS settings. Client session cache keeps the last session issued by the server, so the next
+ * handshake resumes it instead of performing full key exchange and certificate chain verification.
+ */
+struct tls_cache_t
+{
+    void *tls_ctx;              //!< Shared libldap TLS context, SSL_CTX when libldap is built with OpenSSL.
+
+    char *ca_cert_file;         //!< CA certificate file the context was built with.
+    char *cert_file;            //!< Client certificate file the context was built with.
+    char *key_file;             //!< Private key file the context was built with.
+
+#ifdef LIBDOMAIN_HAVE_OPENSSL
+    SSL_SESSION *session;       //!< Session to resume on next handshake.
+#endif
+};
+
+#ifdef LIBDOMAIN_HAVE_OPENSSL
+
+static int tls_cache_new_session(SSL *ssl, SSL_SESSION *session)
+{
+    tls_cache_t *cache = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    if (!cache)
+    {
+        return 0;
+    }
+
+    if (cache->session)
+    {
+        SSL_SESSION_free(cache->session);
+    }
+
+    // Returning 1 passes our reference to the session to the cache.
+    cache->session = session;
+
+    return 1;
+}
+
+static int tls_cache_on_connect(LDAP *ldap, void *ssl, void *ctx, void *arg)
+{
+    (void)(ldap);
+    (void)(ctx);
+
+    tls_cache_t *cache = arg;
+
+    if (ssl && cache->session && SSL_set_session(ssl, cache->session) != 1)
+    {
+        ld_warning("Unable to resume TLS session, performing full handshake.\n");
+    }
+
+    return 0;
+}
+
+static bool tls_cache_backend_supported(void)
+{
+    char *package = NULL;
+    bool supported = false;
+
+    // Context and session objects are only understood if libldap uses the same TLS library as we do.
+    if (ldap_get_option(NULL, LDAP_OPT_X_TLS_PACKAGE, &package) == LDAP_OPT_SUCCESS && package)
+    {
+        supported = strcmp(package, "OpenSSL") == 0;
+        ldap_memfree(package);
+    }
+
+    return supported;
+}
+
+static char *tls_cache_get_option(TALLOC_CTX *ctx, LDAP *ldap, int option)
+{
+    char *value = NULL;
+    char *result = NULL;
+
+    if (ldap_get_option(ldap, option, &value) == LDAP_OPT_SUCCESS && value)
+    {
+        result = talloc_strdup(ctx, value);
+        ldap_memfree(value);
+    }
+
+    return result;
+}
+
+static bool tls_cache_option_equal(TALLOC_CTX *ctx, LDAP *ldap, int option, const char *expected)
+{
+    char *value = tls_cache_get_option(ctx, ldap, option);
+    bool result = (!value || !*value) ? (!expected || !*expected) : (expected && strcmp(value, expected) == 0);
+
+    talloc_free(value);
+
+    return result;
+}
+
+static int tls_cache_destructor(tls_cache_t *cache)
+{
+    if (cache->tls_ctx)
+    {
+        SSL_CTX_set_app_data(cache->tls_ctx, NULL);
+        SSL_CTX_free(cache->tls_ctx);
+        cache->tls_ctx = NULL;
+    }
+
+    tls_cache_forget_session(cache);
+
+    return 0;
+}
+
+#endif
+
+/**
+ * @brief tls_cache_new Creates empty TLS cache.
+ * @param[in] ctx Memory context to allocate cache on.
+ * @return
+ *        - NULL on failure.
+ *        - tls_cache_t* on success.
+ */
+tls_cache_t *tls_cache_new(TALLOC_CTX *ctx)
+{
+    tls_cache_t *cache = talloc_zero(ctx, tls_cache_t);
+    if (!cache)
+    {
+        ld_error("Unable to allocate TLS cache.\n");
+        return NULL;
+    }
+
+#ifdef LIBDOMAIN_HAVE_OPENSSL
+    talloc_set_destructor(cache, tls_cache_destructor);
+#endif
+
+    return cache;
+}
+
+/**
+ * @brief tls_cache_matches Checks if connection may share context of the cache. Context freezes CA certificate,
+ * client certificate and key, so connections configured with other files must not use it.
+ * @param[in] cache Cache to use.
+ * @param[in] ldap  LDAP handle with TLS options already set.
+ * @return true if cache has no context yet or context was built with the same files.
+ */
+bool tls_cache_matches(tls_cache_t *cache, LDAP *ldap)
+{
+#ifdef LIBDOMAIN_HAVE_OPENSSL
+    if (!cache || !ldap)
+    {
+        return false;
+    }
+
+    return !cache->tls_ctx
+        || (tls_cache_option_equal(cache, ldap, LDAP_OPT_X_TLS_CACERTFILE, cache->ca_cert_file)
+            && tls_cache_option_equal(cache, ldap, LDAP_OPT_X_TLS_CERTFILE, cache->cert_file)
+            && tls_cache_option_equal(cache, ldap, LDAP_OPT_X_TLS_KEYFILE, cache->key_file));
+#else
+    (void)(cache);
+    (void)(ldap);
+
+    return false;
+#endif
+}
+
+/**
+ * @brief tls_cache_apply Makes connection use shared TLS context and resume cached session.
+ * TLS options of the connection must be already set, they are used to build context on first call.
+ * Connection with TLS settings other than the ones context was built with is refused.
+ * @param[in] cache Cache to use.
+ * @param[in] ldap  LDAP handle of connection which is not connected yet.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if context can't be shared, caller must create private context.
+ */
+enum OperationReturnCode tls_cache_apply(tls_cache_t *cache, LDAP *ldap)
+{
+#ifdef LIBDOMAIN_HAVE_OPENSSL
+    if (!cache || !ldap || !tls_cache_backend_supported())
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (!tls_cache_matches(cache, ldap))
+    {
+        ld_warning("TLS settings differ from shared TLS context, connection uses private context.\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (!cache->tls_ctx)
+    {
+        const int is_server = 0;
+        void *tls_ctx = NULL;
+
+        if (ldap_set_option(ldap, LDAP_OPT_X_TLS_NEWCTX, &is_server) != LDAP_OPT_SUCCESS
+            || ldap_get_option(ldap, LDAP_OPT_X_TLS_CTX, &tls_ctx) != LDAP_OPT_SUCCESS
+            || !tls_ctx)
+        {
+            ld_error("Unable to create shared TLS context.\n");
+            return RETURN_CODE_FAILURE;
+        }
+
+        // ldap_get_option took a reference for us, it is released by tls_cache_destructor.
+        cache->tls_ctx = tls_ctx;
+        cache->ca_cert_file = tls_cache_get_option(cache, ldap, LDAP_OPT_X_TLS_CACERTFILE);
+        cache->cert_file = tls_cache_get_option(cache, ldap, LDAP_OPT_X_TLS_CERTFILE);
+        cache->key_file = tls_cache_get_option(cache, ldap, LDAP_OPT_X_TLS_KEYFILE);
+
+        SSL_CTX_set_app_data(cache->tls_ctx, cache);
+        SSL_CTX_set_session_cache_mode(cache->tls_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(cache->tls_ctx, tls_cache_new_session);
+    }
+    else if (ldap_set_option(ldap, LDAP_OPT_X_TLS_CTX, cache->tls_ctx) != LDAP_OPT_SUCCESS)
+    {
+        ld_error("Unable to use shared TLS context.\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (ldap_set_option(ldap, LDAP_OPT_X_TLS_CONNECT_CB, (void *)tls_cache_on_connect) != LDAP_OPT_SUCCESS
+        || ldap_set_option(ldap, LDAP_OPT_X_TLS_CONNECT_ARG, cache) != LDAP_OPT_SUCCESS)
+    {
+        ld_warning("Unable to install TLS connect callback, sessions will not be resumed.\n");
+    }
+
+    return RETURN_CODE_SUCCESS;
+#else
+    (void)(cache);
+    (void)(ldap);
+
+    return RETURN_CODE_FAILURE;
+#endif
+}
+
+/**
+ * @brief tls_cache_forget_session Drops cached session, e.g. after server rejected it.
+ * @param[in] cache Cache to use.
+ */
+void tls_cache_forget_session(tls_cache_t *cache)
+{
+#ifdef LIBDOMAIN_HAVE_OPENSSL
+    if (cache && cache->session)
+    {
+        SSL_SESSION_free(cache->session);
+        cache->session = NULL;
+    }
+#else
+    (void)(cache);
+#endif
+}
+
+/**
+ * @brief tls_cache_session_resumed Checks if TLS handshake of connection resumed cached session.
+ * @param[in] ldap LDAP handle of connection with TLS established.
+ * @return true if session was resumed.
+ */
+bool tls_cache_session_resumed(LDAP *ldap)
+{
+#ifdef LIBDOMAIN_HAVE_OPENSSL
+    SSL *ssl = NULL;
+
+    return ldap && tls_cache_backend_supported()
+        && ldap_get_option(ldap, LDAP_OPT_X_TLS_SSL_CTX, &ssl) == LDAP_OPT_SUCCESS && ssl
+        && SSL_session_reused(ssl) == 1;
+#else
+    (void)(ldap);
+
+    return false;
+#endif
+}
@@ -0,0 +1,1100 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "transaction.h"
+
+#include "connection.h"
+#include "domain_p.h"
+#include "entry.h"
+#include "pipeline.h"
+#include "root_dse.h"
+#include "schema.h"
+
+#include <string.h>
+#include <strings.h>
+
+#ifndef LDAP_EXOP_TXN_START
+#define LDAP_EXOP_TXN_START "1.3.6.1.1.21.1"
+#endif
+
+#ifndef LDAP_CONTROL_TXN_SPEC
+#define LDAP_CONTROL_TXN_SPEC "1.3.6.1.1.21.2"
+#endif
+
+#ifndef LDAP_EXOP_TXN_END
+#define LDAP_EXOP_TXN_END "1.3.6.1.1.21.3"
+#endif
+
+/*!
+ * @brief transaction_step_t - Request transaction is waiting for.
+ */
+typedef enum transaction_step_e
+{
+    TRANSACTION_STEP_START,          //!< Start Transaction extended operation.
+    TRANSACTION_STEP_READ,           //!< Read of the entry state compensating operation is built from.
+    TRANSACTION_STEP_APPLY,          //!< Operation of the transaction.
+    TRANSACTION_STEP_END,            //!< End Transaction extended operation.
+    TRANSACTION_STEP_UNDO,           //!< Compensating operation.
+} transaction_step_t;
+
+/*!
+ * @brief transaction_operation_t - Operation of the transaction with its compensating operation.
+ */
+typedef struct transaction_operation_s
+{
+    ber_tag_t type;                  //!< LDAP_REQ_ADD, LDAP_REQ_MODIFY, LDAP_REQ_DELETE or LDAP_REQ_MODDN.
+    char *dn;                        //!< Target of the operation.
+    LDAPMod **mods;                  //!< Attributes of added entry or modifications.
+    char *new_rdn;                   //!< New rdn of renamed entry.
+    char *new_parent;                //!< New parent of renamed entry, NULL keeps the entry in place.
+    char **read_attributes;          //!< Attributes to read before operation is applied, NULL if nothing is read.
+    int msgid;                       //!< Message id operation was sent with, -1 if unknown.
+
+    ber_tag_t undo_type;             //!< Type of compensating operation, 0 if operation can not be reverted.
+    char *undo_dn;                   //!< Target of compensating operation.
+    LDAPMod **undo_mods;             //!< Attributes or modifications of compensating operation.
+    char *undo_rdn;                  //!< Rdn compensating rename restores.
+    char *undo_parent;               //!< Parent compensating rename restores.
+} transaction_operation_t;
+
+/*!
+ * @brief ld_transaction_t - Operations applied together. Server transaction (RFC 5805) is used when server
+ * advertises it, otherwise operations are applied one by one and applied ones are reverted by compensating
+ * operations once any operation fails.
+ */
+struct ld_transaction_s
+{
+    LDHandle *handle;                        //!< Handle transaction is performed with.
+    connection_identity_t identity;          //!< Identity and priority class requests of every step are sent with.
+    enum TransactionMode mode;               //!< Requested mode of the transaction.
+    bool server;                             //!< Transaction is performed by the server.
+
+    transaction_operation_t *operations;     //!< Operations in order of application.
+    int count;                               //!< Number of operations.
+
+    transaction_step_t step;                 //!< Request transaction is waiting for.
+    int index;                               //!< Operation current step works with.
+
+    struct berval *id;                       //!< Identifier assigned by server to the transaction.
+    LDAPControl control;                     //!< Transaction Specification control sent with every operation.
+    struct berval *end_request;              //!< Value of End Transaction request.
+    bool commit;                             //!< End Transaction request commits the transaction.
+
+    int result_code;                         //!< Result code of the failure.
+    int failed;                              //!< Index of failed operation, -1 if there is none.
+    int undo_failures;                       //!< Number of compensating operations which failed.
+
+    transaction_callback_fn callback;        //!< Callback to call once transaction is over.
+    void *user_data;                         //!< User data to pass to callback.
+};
+
+/*!
+ * @brief TRANSACTION_SERVER_ASSIGNED_ATTRIBUTES - Attributes server assigns to new entry itself.
+ */
+static const char *TRANSACTION_SERVER_ASSIGNED_ATTRIBUTES[] =
+{
+    "distinguishedName", "objectGUID", "objectSid", NULL
+};
+
+static void transaction_run(ld_transaction_t *transaction, transaction_step_t step);
+static void transaction_fail(ld_transaction_t *transaction, int result_code, int failed);
+
+static int transaction_destructor(TALLOC_CTX *ctx)
+{
+    ld_transaction_t *transaction = talloc_get_type_abort(ctx, ld_transaction_t);
+
+    ber_bvfree(transaction->id);
+    ber_bvfree(transaction->end_request);
+
+    return 0;
+}
+
+/**
+ * @brief transaction_dn_split Splits dn into first RDN and parent, escaped commas are not separators.
+ * @param[in]  ctx    Memory context to allocate RDN and parent on.
+ * @param[in]  dn     Dn to split.
+ * @param[out] rdn    First RDN of the dn.
+ * @param[out] parent Parent of the dn, empty string for single RDN.
+ */
+static void transaction_dn_split(TALLOC_CTX *ctx, const char *dn, char **rdn, char **parent)
+{
+    const char *c = dn;
+
+    for (; *c; ++c)
+    {
+        if (*c == '\\' && c[1])
+        {
+            ++c;
+        }
+        else if (*c == ',')
+        {
+            break;
+        }
+    }
+
+    *rdn = talloc_strndup(ctx, dn, c - dn);
+    *parent = talloc_strdup(ctx, *c ? c + 1 : c);
+}
+
+/**
+ * @brief transaction_restorable_attribute Checks if attribute may be supplied when deleted entry is added back.
+ * @param[in] schema Schema of the directory, can be NULL.
+ * @param[in] name   Name of the attribute.
+ * @return
+ *        - false if attribute is NO-USER-MODIFICATION or assigned by server.
+ *        - true otherwise.
+ */
+static bool transaction_restorable_attribute(const ldap_schema_t *schema, const char *name)
+{
+    for (int i = 0; TRANSACTION_SERVER_ASSIGNED_ATTRIBUTES[i]; ++i)
+    {
+        if (strcasecmp(TRANSACTION_SERVER_ASSIGNED_ATTRIBUTES[i], name) == 0)
+        {
+            return false;
+        }
+    }
+
+    LDAPAttributeType *attribute_type = schema ? ldap_schema_find_attributetype(schema, name) : NULL;
+
+    return !attribute_type || !attribute_type->at_no_user_mod;
+}
+
+static LDAPAttribute_t *transaction_find_attribute(LDAPAttribute_t **attributes, const char *name)
+{
+    for (int i = 0; attributes && attributes[i]; ++i)
+    {
+        if (strcasecmp(attributes[i]->name, name) == 0)
+        {
+            return attributes[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief transaction_mod_restores Checks if modification can only be reverted by restoring values the attribute
+ * had before, other modifications are reverted by opposite modification with the same values.
+ */
+static bool transaction_mod_restores(const LDAPMod *mod)
+{
+    int op = mod->mod_op & LDAP_MOD_OP;
+    bool has_values = (mod->mod_op & LDAP_MOD_BVALUES) ? mod->mod_bvalues && mod->mod_bvalues[0]
+                                                       : mod->mod_values && mod->mod_values[0];
+
+    return op != LDAP_MOD_ADD && (op != LDAP_MOD_DELETE || !has_values);
+}
+
+static bool transaction_is_read_attribute(const transaction_operation_t *operation, const char *name)
+{
+    for (int i = 0; operation->read_attributes && operation->read_attributes[i]; ++i)
+    {
+        if (strcasecmp(operation->read_attributes[i], name) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool transaction_add_read_attribute(TALLOC_CTX *ctx, transaction_operation_t *operation, const char *name)
+{
+    if (transaction_is_read_attribute(operation, name))
+    {
+        return true;
+    }
+
+    int count = 0;
+    while (operation->read_attributes && operation->read_attributes[count])
+    {
+        ++count;
+    }
+
+    char **attributes = talloc_realloc(ctx, operation->read_attributes, char*, count + 2);
+    if (!attributes)
+    {
+        return false;
+    }
+
+    operation->read_attributes = attributes;
+    operation->read_attributes[count] = talloc_strdup(attributes, name);
+    operation->read_attributes[count + 1] = NULL;
+
+    return operation->read_attributes[count] != NULL;
+}
+
+/**
+ * @brief transaction_build_undo_modify Builds modifications reverting the modify operation. Attributes which previous
+ * values had to be read are restored with replace, other modifications are reverted with opposite modification
+ * in reverse order.
+ * @param[in] ctx       Memory context to allocate compensating operation on.
+ * @param[in] operation Operation to build compensating operation of.
+ * @param[in] entry     Entry read before operation was applied, NULL when nothing was read or entry is absent.
+ * @return true on success.
+ */
+static bool transaction_build_undo_modify(TALLOC_CTX *ctx, transaction_operation_t *operation, ld_entry_t *entry)
+{
+    int count = 0;
+    while (operation->mods[count])
+    {
+        ++count;
+    }
+
+    int read_count = 0;
+    while (operation->read_attributes && operation->read_attributes[read_count])
+    {
+        ++read_count;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    LDAPMod **undo = talloc_zero_array(talloc_ctx, LDAPMod*, count + read_count + 1);
+    LDAPAttribute_t **attributes = entry ? ld_entry_get_attributes(entry) : NULL;
+    int undo_count = 0;
+
+    for (int i = count - 1; undo && i >= 0; --i)
+    {
+        LDAPMod *mod = operation->mods[i];
+
+        if (transaction_is_read_attribute(operation, mod->mod_type))
+        {
+            continue;
+        }
+
+        LDAPMod *opposite = talloc_zero(undo, LDAPMod);
+        if (!opposite)
+        {
+            undo = NULL;
+            break;
+        }
+
+        int op = mod->mod_op & LDAP_MOD_OP;
+        *opposite = *mod;
+        opposite->mod_op = (mod->mod_op & ~LDAP_MOD_OP) | (op == LDAP_MOD_ADD ? LDAP_MOD_DELETE : LDAP_MOD_ADD);
+        undo[undo_count++] = opposite;
+    }
+
+    for (int i = 0; undo && i < read_count; ++i)
+    {
+        LDAPAttribute_t *attribute = transaction_find_attribute(attributes, operation->read_attributes[i]);
+
+        LDAPMod *replace = talloc_zero(undo, LDAPMod);
+        if (!replace)
+        {
+            undo = NULL;
+            break;
+        }
+
+        // Replace without values removes attribute which was absent before.
+        replace->mod_op = LDAP_MOD_REPLACE;
+        replace->mod_type = operation->read_attributes[i];
+        replace->mod_values = attribute ? attribute->values : NULL;
+        undo[undo_count++] = replace;
+    }
+
+    // Copy owns its values, so they outlive the entry and modifications of the caller.
+    operation->undo_mods = undo ? entry_copy_mods(ctx, undo) : NULL;
+    operation->undo_type = operation->undo_mods ? LDAP_REQ_MODIFY : 0;
+    operation->undo_dn = operation->dn;
+
+    talloc_free(attributes);
+    talloc_free(talloc_ctx);
+
+    return operation->undo_mods != NULL;
+}
+
+/**
+ * @brief transaction_build_undo_delete Builds add request restoring deleted entry from its attributes read
+ * before deletion. Attributes assigned by server get new values when entry is restored.
+ * @param[in] ctx       Memory context to allocate compensating operation on.
+ * @param[in] operation Operation to build compensating operation of.
+ * @param[in] schema    Schema of the directory, can be NULL.
+ * @param[in] entry     Entry read before operation was applied, NULL if entry is absent.
+ * @return true on success.
+ */
+static bool transaction_build_undo_delete(TALLOC_CTX *ctx, transaction_operation_t *operation,
+                                          const ldap_schema_t *schema, ld_entry_t *entry)
+{
+    if (!entry)
+    {
+        return true;
+    }
+
+    LDAPAttribute_t **attributes = ld_entry_get_attributes(entry);
+
+    int count = 0;
+    while (attributes && attributes[count])
+    {
+        ++count;
+    }
+
+    LDAPMod **mods = talloc_zero_array(NULL, LDAPMod*, count + 1);
+    int mods_count = 0;
+
+    for (int i = 0; mods && i < count; ++i)
+    {
+        if (!attributes[i]->values || !transaction_restorable_attribute(schema, attributes[i]->name))
+        {
+            continue;
+        }
+
+        LDAPMod *mod = talloc_zero(mods, LDAPMod);
+        if (!mod)
+        {
+            talloc_free(mods);
+            mods = NULL;
+            break;
+        }
+
+        mod->mod_op = LDAP_MOD_ADD;
+        mod->mod_type = attributes[i]->name;
+        mod->mod_values = attributes[i]->values;
+        mods[mods_count++] = mod;
+    }
+
+    operation->undo_mods = mods ? entry_copy_mods(ctx, mods) : NULL;
+    operation->undo_type = operation->undo_mods ? LDAP_REQ_ADD : 0;
+    operation->undo_dn = operation->dn;
+
+    talloc_free(mods);
+    talloc_free(attributes);
+
+    return operation->undo_mods != NULL;
+}
+
+/**
+ * @brief transaction_on_read Builds compensating operation from the entry state and applies the operation.
+ */
+static enum OperationReturnCode transaction_on_read(struct ldap_connection_ctx_t *connection,
+                                                    ld_entry_t **entries,
+                                                    void *user_data)
+{
+    ld_transaction_t *transaction = talloc_get_type_abort(user_data, ld_transaction_t);
+    transaction_operation_t *operation = &transaction->operations[transaction->index];
+
+    // Last element is made of search result message and has no dn.
+    ld_entry_t *entry = entries && entries[0] && entries[1] ? entries[0] : NULL;
+
+    bool built = operation->type == LDAP_REQ_DELETE
+                 ? transaction_build_undo_delete(transaction, operation, connection->schema, entry)
+                 : transaction_build_undo_modify(transaction, operation, entry);
+
+    if (!built)
+    {
+        ld_error("ld_transaction_commit - unable to build compensating operation for %s!\n", operation->dn);
+        transaction_fail(transaction, LDAP_NO_MEMORY, transaction->index);
+        return RETURN_CODE_FAILURE;
+    }
+
+    transaction_run(transaction, TRANSACTION_STEP_APPLY);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void transaction_finish(ld_transaction_t *transaction, int result_code, int failed, bool reverted)
+{
+    if (transaction->callback)
+    {
+        transaction->callback(transaction->handle, result_code, failed, reverted, transaction->user_data);
+    }
+
+    talloc_free(transaction);
+}
+
+static void transaction_undo_next(ld_transaction_t *transaction)
+{
+    while (transaction->index >= 0 && transaction->operations[transaction->index].undo_type == 0)
+    {
+        ld_error("ld_transaction_commit - operation on %s can not be reverted!\n",
+                 transaction->operations[transaction->index].dn);
+        ++transaction->undo_failures;
+        --transaction->index;
+    }
+
+    if (transaction->index < 0)
+    {
+        transaction_finish(transaction, transaction->result_code, transaction->failed,
+                           transaction->undo_failures == 0);
+        return;
+    }
+
+    transaction_run(transaction, TRANSACTION_STEP_UNDO);
+}
+
+/**
+ * @brief transaction_fail Settles failed transaction. Server transaction is aborted, operations applied by client
+ * are reverted in reverse order.
+ * @param[in] transaction Transaction to work with.
+ * @param[in] result_code Result code of the failure.
+ * @param[in] failed      Index of operation which failed.
+ */
+static void transaction_fail(ld_transaction_t *transaction, int result_code, int failed)
+{
+    ld_warning("ld_transaction_commit - operation %d failed - code: %d %s\n", failed, result_code,
+               ldap_err2string(result_code));
+
+    transaction->result_code = result_code;
+    transaction->failed = failed;
+
+    if (transaction->server)
+    {
+        transaction->commit = false;
+        transaction_run(transaction, TRANSACTION_STEP_END);
+        return;
+    }
+
+    transaction->index = failed - 1;
+    transaction_undo_next(transaction);
+}
+
+static void transaction_apply_next(ld_transaction_t *transaction)
+{
+    if (transaction->index >= transaction->count)
+    {
+        if (transaction->server)
+        {
+            transaction->commit = true;
+            transaction_run(transaction, TRANSACTION_STEP_END);
+        }
+        else
+        {
+            transaction_finish(transaction, LDAP_SUCCESS, -1, false);
+        }
+        return;
+    }
+
+    transaction_operation_t *operation = &transaction->operations[transaction->index];
+
+    if (transaction->server)
+    {
+        transaction_run(transaction, TRANSACTION_STEP_APPLY);
+        return;
+    }
+
+    if (operation->read_attributes)
+    {
+        transaction_run(transaction, TRANSACTION_STEP_READ);
+        return;
+    }
+
+    switch (operation->type)
+    {
+    case LDAP_REQ_ADD:
+        operation->undo_type = LDAP_REQ_DELETE;
+        operation->undo_dn = operation->dn;
+        break;
+    case LDAP_REQ_MODDN:
+    {
+        char *parent = NULL;
+        transaction_dn_split(transaction, operation->dn, &operation->undo_rdn, &operation->undo_parent);
+
+        parent = operation->new_parent ? operation->new_parent : operation->undo_parent;
+        operation->undo_dn = strlen(parent) > 0 ? talloc_asprintf(transaction, "%s,%s", operation->new_rdn, parent)
+                                                : talloc_strdup(transaction, operation->new_rdn);
+        operation->undo_type = operation->undo_dn && operation->undo_rdn ? LDAP_REQ_MODDN : 0;
+    }
+        break;
+    case LDAP_REQ_MODIFY:
+        transaction_build_undo_modify(transaction, operation, NULL);
+        break;
+    default:
+        break;
+    }
+
+    transaction_run(transaction, TRANSACTION_STEP_APPLY);
+}
+
+static void transaction_on_read_failed(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    ld_transaction_t *transaction = talloc_get_type_abort(user_data, ld_transaction_t);
+
+    transaction_fail(transaction, result_code, transaction->index);
+}
+
+static void transaction_on_applied(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    ld_transaction_t *transaction = talloc_get_type_abort(user_data, ld_transaction_t);
+
+    // Deferred operation is known by client side handle until it is sent, End Transaction response names
+    // operation by message id it was sent with.
+    transaction->operations[transaction->index].msgid = connection->msgid;
+
+    if (result_code != LDAP_SUCCESS)
+    {
+        transaction_fail(transaction, result_code, transaction->index);
+        return;
+    }
+
+    ++transaction->index;
+    transaction_apply_next(transaction);
+}
+
+static void transaction_on_undone(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    ld_transaction_t *transaction = talloc_get_type_abort(user_data, ld_transaction_t);
+
+    if (result_code != LDAP_SUCCESS)
+    {
+        ld_error("ld_transaction_commit - unable to revert operation on %s - code: %d %s\n",
+                 transaction->operations[transaction->index].dn, result_code, ldap_err2string(result_code));
+        ++transaction->undo_failures;
+    }
+
+    --transaction->index;
+    transaction_undo_next(transaction);
+}
+
+static void transaction_on_started(struct ldap_connection_ctx_t *connection, int result_code, struct berval *data,
+                                   void *user_data)
+{
+    (void)(connection);
+
+    ld_transaction_t *transaction = talloc_get_type_abort(user_data, ld_transaction_t);
+
+    if (result_code == LDAP_SUCCESS && data && data->bv_len > 0 && (transaction->id = ber_bvdup(data)))
+    {
+        transaction->control.ldctl_oid = LDAP_CONTROL_TXN_SPEC;
+        transaction->control.ldctl_value = *transaction->id;
+        transaction->control.ldctl_iscritical = 1;
+
+        transaction_apply_next(transaction);
+        return;
+    }
+
+    // Server may advertise transactions while backend holding the entries does not support them.
+    if (transaction->mode == TRANSACTION_MODE_AUTO)
+    {
+        ld_info("ld_transaction_commit - server refused to start transaction - code: %d %s, compensating\n",
+                result_code, ldap_err2string(result_code));
+        transaction->server = false;
+        transaction_apply_next(transaction);
+        return;
+    }
+
+    transaction_finish(transaction, result_code == LDAP_SUCCESS ? LDAP_PROTOCOL_ERROR : result_code, -1, true);
+}
+
+/**
+ * @brief transaction_failed_operation Finds operation End Transaction response blames for the failure.
+ * @param[in] transaction Transaction to work with.
+ * @param[in] data        Value of End Transaction response, can be NULL.
+ * @return Index of the operation, -1 if response does not name it.
+ */
+static int transaction_failed_operation(ld_transaction_t *transaction, struct berval *data)
+{
+    BerElement *ber = data ? ber_init(data) : NULL;
+    if (!ber)
+    {
+        return -1;
+    }
+
+    ber_len_t length = 0;
+    ber_int_t msgid = -1;
+
+    if (ber_skip_tag(ber, &length) == LBER_SEQUENCE && ber_peek_tag(ber, &length) == LBER_INTEGER)
+    {
+        ber_get_int(ber, &msgid);
+    }
+
+    ber_free(ber, 1);
+
+    for (int i = 0; msgid >= 0 && i < transaction->count; ++i)
+    {
+        if (transaction->operations[i].msgid == msgid)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void transaction_on_ended(struct ldap_connection_ctx_t *connection, int result_code, struct berval *data,
+                                 void *user_data)
+{
+    (void)(connection);
+
+    ld_transaction_t *transaction = talloc_get_type_abort(user_data, ld_transaction_t);
+
+    if (!transaction->commit)
+    {
+        // Aborted transaction was never applied, even when abort request itself failed.
+        transaction_finish(transaction, transaction->result_code, transaction->failed, true);
+        return;
+    }
+
+    if (result_code == LDAP_SUCCESS)
+    {
+        transaction_finish(transaction, LDAP_SUCCESS, -1, false);
+        return;
+    }
+
+    // Outcome of commit is unknown when its response was not received.
+    transaction_finish(transaction, result_code, transaction_failed_operation(transaction, data),
+                       result_code != LDAP_TIMEOUT);
+}
+
+/**
+ * @brief transaction_encode_end Encodes value of End Transaction request.
+ */
+static bool transaction_encode_end(ld_transaction_t *transaction)
+{
+    BerElement *ber = ber_alloc_t(LBER_USE_DER);
+    if (!ber)
+    {
+        return false;
+    }
+
+    // Commit is the default value of the field, so DER omits it.
+    int rc = transaction->commit ? ber_printf(ber, "{O}", transaction->id)
+                                 : ber_printf(ber, "{bO}", (ber_int_t)0, transaction->id);
+
+    ber_bvfree(transaction->end_request);
+    transaction->end_request = NULL;
+
+    if (rc != -1)
+    {
+        rc = ber_flatten(ber, &transaction->end_request);
+    }
+
+    ber_free(ber, 1);
+
+    return rc != -1;
+}
+
+static enum OperationReturnCode transaction_apply(struct ldap_connection_ctx_t *connection,
+                                                  ld_transaction_t *transaction,
+                                                  transaction_operation_t *operation)
+{
+    LDAPControl *transaction_controls[] = { &transaction->control, NULL };
+    LDAPControl **controls = transaction->server ? transaction_controls : NULL;
+
+    enum OperationReturnCode rc = RETURN_CODE_FAILURE;
+
+    switch (operation->type)
+    {
+    case LDAP_REQ_ADD:
+        rc = add_ext(connection, operation->dn, operation->mods, controls, transaction_on_applied, transaction);
+        break;
+    case LDAP_REQ_MODIFY:
+        rc = modify_ext(connection, operation->dn, operation->mods, controls, transaction_on_applied, transaction);
+        break;
+    case LDAP_REQ_DELETE:
+        rc = delete_ext(connection, operation->dn, controls, transaction_on_applied, transaction);
+        break;
+    case LDAP_REQ_MODDN:
+        rc = rename_ext(connection, operation->dn, operation->new_rdn, operation->new_parent, true, controls,
+                        transaction_on_applied, transaction);
+        break;
+    default:
+        break;
+    }
+
+    return rc;
+}
+
+static enum OperationReturnCode transaction_undo(struct ldap_connection_ctx_t *connection,
+                                                 ld_transaction_t *transaction,
+                                                 transaction_operation_t *operation)
+{
+    switch (operation->undo_type)
+    {
+    case LDAP_REQ_ADD:
+        return add_ext(connection, operation->undo_dn, operation->undo_mods, NULL, transaction_on_undone,
+                       transaction);
+    case LDAP_REQ_MODIFY:
+        return modify_ext(connection, operation->undo_dn, operation->undo_mods, NULL, transaction_on_undone,
+                          transaction);
+    case LDAP_REQ_DELETE:
+        return delete_ext(connection, operation->undo_dn, NULL, transaction_on_undone, transaction);
+    case LDAP_REQ_MODDN:
+        return rename_ext(connection, operation->undo_dn, operation->undo_rdn, operation->undo_parent, true, NULL,
+                          transaction_on_undone, transaction);
+    default:
+        return RETURN_CODE_FAILURE;
+    }
+}
+
+static enum OperationReturnCode transaction_submit(struct ldap_connection_ctx_t *connection, int index,
+                                                   void *user_data)
+{
+    (void)(index);
+
+    ld_transaction_t *transaction = user_data;
+    transaction_operation_t *operation = &transaction->operations[transaction->index];
+
+    switch (transaction->step)
+    {
+    case TRANSACTION_STEP_START:
+        return extended_ext(connection, LDAP_EXOP_TXN_START, NULL, transaction_on_started, transaction);
+    case TRANSACTION_STEP_READ:
+        return search_ext(connection, operation->dn, LDAP_SCOPE_BASE, "(objectClass=*)",
+                          operation->read_attributes, false, transaction_on_read, transaction_on_read_failed,
+                          transaction);
+    case TRANSACTION_STEP_APPLY:
+        return transaction_apply(connection, transaction, operation);
+    case TRANSACTION_STEP_END:
+        return transaction_encode_end(transaction)
+               ? extended_ext(connection, LDAP_EXOP_TXN_END, transaction->end_request, transaction_on_ended,
+                              transaction)
+               : RETURN_CODE_FAILURE;
+    case TRANSACTION_STEP_UNDO:
+        return transaction_undo(connection, transaction, operation);
+    default:
+        return RETURN_CODE_FAILURE;
+    }
+}
+
+/**
+ * @brief transaction_on_not_submitted Handles request of the step which could not be sent.
+ */
+static void transaction_on_not_submitted(ld_transaction_t *transaction)
+{
+    switch (transaction->step)
+    {
+    case TRANSACTION_STEP_START:
+        transaction_on_started(transaction->handle->connection_ctx, LDAP_OTHER, NULL, transaction);
+        break;
+    case TRANSACTION_STEP_READ:
+    case TRANSACTION_STEP_APPLY:
+        transaction_fail(transaction, LDAP_OTHER, transaction->index);
+        break;
+    case TRANSACTION_STEP_END:
+        // Transaction which was not ended is never applied by the server.
+        transaction_finish(transaction, transaction->commit ? LDAP_OTHER : transaction->result_code,
+                           transaction->failed, true);
+        break;
+    case TRANSACTION_STEP_UNDO:
+        transaction_on_undone(transaction->handle->connection_ctx, LDAP_OTHER, transaction);
+        break;
+    }
+}
+
+static void transaction_on_submitted(struct ldap_connection_ctx_t *connection, int submitted, int failed,
+                                     void *user_data)
+{
+    (void)(connection);
+    (void)(submitted);
+
+    if (failed > 0)
+    {
+        transaction_on_not_submitted(talloc_get_type_abort(user_data, ld_transaction_t));
+    }
+}
+
+/**
+ * @brief transaction_run Sends request of the step, waiting for free slot in request window when needed.
+ */
+static void transaction_run(ld_transaction_t *transaction, transaction_step_t step)
+{
+    transaction->step = step;
+
+    if (pipeline_start(transaction, transaction->handle->connection_ctx, &transaction->identity, 1,
+                       transaction_submit, transaction_on_submitted, transaction) != RETURN_CODE_SUCCESS)
+    {
+        transaction_on_not_submitted(transaction);
+    }
+}
+
+/**
+ * @brief ld_transaction_new Creates empty transaction. Requests of the transaction are sent on behalf of identity
+ * and with priority class which are current when transaction is created.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @return
+ *        - Transaction allocated on handle's context, it is freed once commit is over.
+ *        - NULL on failure.
+ */
+ld_transaction_t *ld_transaction_new(LDHandle *handle)
+{
+    if (!handle)
+    {
+        ld_error("Handle is null - ld_transaction_new \n");
+        return NULL;
+    }
+
+    ld_transaction_t *transaction = talloc_zero(handle->talloc_ctx, ld_transaction_t);
+    if (!transaction)
+    {
+        ld_error("ld_transaction_new - out of memory!\n");
+        return NULL;
+    }
+
+    talloc_set_destructor((TALLOC_CTX*)transaction, transaction_destructor);
+
+    if (connection_save_identity(transaction, handle->connection_ctx, &transaction->identity) != RETURN_CODE_SUCCESS)
+    {
+        ld_error("ld_transaction_new - out of memory!\n");
+        talloc_free(transaction);
+        return NULL;
+    }
+
+    transaction->handle = handle;
+    transaction->mode = TRANSACTION_MODE_AUTO;
+    transaction->failed = -1;
+
+    return transaction;
+}
+
+/**
+ * @brief ld_transaction_set_mode Sets how operations of the transaction are made atomic.
+ * @param[in] transaction Transaction to work with.
+ * @param[in] mode        TRANSACTION_MODE_AUTO, TRANSACTION_MODE_SERVER or TRANSACTION_MODE_COMPENSATE.
+ */
+void ld_transaction_set_mode(ld_transaction_t *transaction, enum TransactionMode mode)
+{
+    if (transaction)
+    {
+        transaction->mode = mode;
+    }
+}
+
+/**
+ * @brief ld_supports_transactions Checks if server advertises LDAP transactions (RFC 5805) in rootDSE.
+ * @param[in] handle Pointer to libdomain session handle.
+ * @return true if transactions are supported.
+ */
+bool ld_supports_transactions(LDHandle *handle)
+{
+    return handle
+           && root_dse_supports_extension(handle->connection_ctx->root_dse, LDAP_EXOP_TXN_START)
+           && root_dse_supports_extension(handle->connection_ctx->root_dse, LDAP_EXOP_TXN_END)
+           && root_dse_supports_control(handle->connection_ctx->root_dse, LDAP_CONTROL_TXN_SPEC);
+}
+
+static transaction_operation_t *transaction_append(ld_transaction_t *transaction, ber_tag_t type, const char *dn,
+                                                   const char *function_name)
+{
+    if (!transaction)
+    {
+        ld_error("Transaction is null - %s \n", function_name);
+        return NULL;
+    }
+
+    if (transaction->callback)
+    {
+        ld_error("%s - transaction is already committed!\n", function_name);
+        return NULL;
+    }
+
+    if (!dn || strlen(dn) == 0)
+    {
+        ld_error("Dn is empty - %s \n", function_name);
+        return NULL;
+    }
+
+    transaction_operation_t *operations = talloc_realloc(transaction, transaction->operations,
+                                                         transaction_operation_t, transaction->count + 1);
+    if (!operations)
+    {
+        ld_error("%s - out of memory!\n", function_name);
+        return NULL;
+    }
+
+    transaction->operations = operations;
+
+    transaction_operation_t *operation = &operations[transaction->count];
+    memset(operation, 0, sizeof(transaction_operation_t));
+
+    operation->type = type;
+    operation->msgid = -1;
+    operation->dn = talloc_strdup(transaction, dn);
+
+    if (!operation->dn)
+    {
+        ld_error("%s - out of memory!\n", function_name);
+        return NULL;
+    }
+
+    return operation;
+}
+
+/**
+ * @brief ld_transaction_add Appends creation of the entry to transaction.
+ * @param[in] transaction Transaction to work with.
+ * @param[in] dn          Dn of the entry.
+ * @param[in] attrs       Attributes of the entry, copied.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_transaction_add(ld_transaction_t *transaction, const char *dn, LDAPMod **attrs)
+{
+    transaction_operation_t *operation = transaction_append(transaction, LDAP_REQ_ADD, dn, "ld_transaction_add");
+    if (!operation || !attrs || !(operation->mods = entry_copy_mods(transaction, attrs)))
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    ++transaction->count;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_transaction_modify Appends modification of the entry to transaction. When transaction is compensated
+ * previous values of replaced, incremented and deleted attributes are read before modification is applied.
+ * @param[in] transaction Transaction to work with.
+ * @param[in] dn          Dn of the entry.
+ * @param[in] mods        Modifications, copied.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_transaction_modify(ld_transaction_t *transaction, const char *dn, LDAPMod **mods)
+{
+    transaction_operation_t *operation = transaction_append(transaction, LDAP_REQ_MODIFY, dn,
+                                                            "ld_transaction_modify");
+    if (!operation || !mods || !(operation->mods = entry_copy_mods(transaction, mods)))
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    for (int i = 0; operation->mods[i]; ++i)
+    {
+        if (transaction_mod_restores(operation->mods[i])
+            && !transaction_add_read_attribute(transaction, operation, operation->mods[i]->mod_type))
+        {
+            ld_error("ld_transaction_modify - out of memory!\n");
+            return RETURN_CODE_FAILURE;
+        }
+    }
+
+    ++transaction->count;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_transaction_delete Appends deletion of the entry to transaction. When transaction is compensated
+ * the entry is read before deletion and added back on rollback.
+ * @param[in] transaction Transaction to work with.
+ * @param[in] dn          Dn of the entry.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_transaction_delete(ld_transaction_t *transaction, const char *dn)
+{
+    transaction_operation_t *operation = transaction_append(transaction, LDAP_REQ_DELETE, dn,
+                                                            "ld_transaction_delete");
+    if (!operation || !transaction_add_read_attribute(transaction, operation, "*"))
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    ++transaction->count;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_transaction_rename Appends rename of the entry to transaction.
+ * @param[in] transaction Transaction to work with.
+ * @param[in] dn          Dn of the entry.
+ * @param[in] new_rdn     New rdn of the entry.
+ * @param[in] new_parent  New parent of the entry, NULL keeps the entry in place.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_transaction_rename(ld_transaction_t *transaction,
+                                               const char *dn,
+                                               const char *new_rdn,
+                                               const char *new_parent)
+{
+    transaction_operation_t *operation = transaction_append(transaction, LDAP_REQ_MODDN, dn,
+                                                            "ld_transaction_rename");
+    if (!operation || !new_rdn || strlen(new_rdn) == 0)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    operation->new_rdn = talloc_strdup(transaction, new_rdn);
+    operation->new_parent = new_parent ? talloc_strdup(transaction, new_parent) : NULL;
+
+    if (!operation->new_rdn || (new_parent && !operation->new_parent))
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    ++transaction->count;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief ld_transaction_commit Applies operations of the transaction. Server transaction is used when mode
+ * requires it or, in TRANSACTION_MODE_AUTO, when server advertises it and accepts Start Transaction request.
+ * Otherwise operations are applied one by one and, once any fails, operations applied before it are reverted
+ * in reverse order. Compensation is best effort: restored entries get new values of server assigned attributes,
+ * and concurrent changes of the same entries by other clients may be overwritten.
+ * @param[in] transaction Transaction to commit, it is freed after callback returns.
+ * @param[in] callback    Callback to call once transaction is over, may be called before function returns.
+ * @param[in] user_data   User data to pass to callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS when transaction is started.
+ *        - RETURN_CODE_FAILURE on failure, transaction stays owned by the caller.
+ */
+enum OperationReturnCode ld_transaction_commit(ld_transaction_t *transaction,
+                                               transaction_callback_fn callback,
+                                               void *user_data)
+{
+    if (!transaction)
+    {
+        ld_error("Transaction is null - ld_transaction_commit \n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (!callback || transaction->callback || transaction->count == 0)
+    {
+        ld_error("ld_transaction_commit - transaction is empty, already committed or callback is missing!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    transaction->server = transaction->mode == TRANSACTION_MODE_SERVER
+                          || (transaction->mode == TRANSACTION_MODE_AUTO
+                              && ld_supports_transactions(transaction->handle));
+
+    if (transaction->mode == TRANSACTION_MODE_SERVER && !ld_supports_transactions(transaction->handle))
+    {
+        ld_error("ld_transaction_commit - server does not support transactions!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    transaction->callback = callback;
+    transaction->user_data = user_data;
+    transaction->index = 0;
+
+    if (transaction->server)
+    {
+        transaction_run(transaction, TRANSACTION_STEP_START);
+    }
+    else
+    {
+        transaction_apply_next(transaction);
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
@@ -0,0 +1,66 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_TRANSACTION_H
+#define LIB_DOMAIN_TRANSACTION_H
+
+#include "common.h"
+#include "domain.h"
+
+/*!
+ * @brief TransactionMode - How operations of the transaction are made atomic.
+ */
+enum TransactionMode
+{
+    TRANSACTION_MODE_AUTO       = 0, //!< Server transaction when server supports it, compensation otherwise.
+    TRANSACTION_MODE_SERVER     = 1, //!< Server transaction (RFC 5805) only.
+    TRANSACTION_MODE_COMPENSATE = 2, //!< Operations are applied one by one and reverted on failure by client.
+};
+
+typedef struct ld_transaction_s ld_transaction_t;
+
+/*!
+ * @brief transaction_callback_fn Callback which is called once transaction is over.
+ * @param handle      Handle transaction was performed with.
+ * @param result_code LDAP_SUCCESS when every operation was applied, result code of the failure otherwise.
+ * @param failed      Index of the operation which failed, -1 when failure is not caused by single operation.
+ * @param reverted    On failure tells that directory holds no changes of the transaction.
+ * @param user_data   User data passed to ld_transaction_commit.
+ */
+typedef void (*transaction_callback_fn)(LDHandle *handle, int result_code, int failed, bool reverted,
+                                        void *user_data);
+
+ld_transaction_t *ld_transaction_new(LDHandle *handle);
+void ld_transaction_set_mode(ld_transaction_t *transaction, enum TransactionMode mode);
+bool ld_supports_transactions(LDHandle *handle);
+
+enum OperationReturnCode ld_transaction_add(ld_transaction_t *transaction, const char *dn, LDAPMod **attrs);
+enum OperationReturnCode ld_transaction_modify(ld_transaction_t *transaction, const char *dn, LDAPMod **mods);
+enum OperationReturnCode ld_transaction_delete(ld_transaction_t *transaction, const char *dn);
+enum OperationReturnCode ld_transaction_rename(ld_transaction_t *transaction,
+                                               const char *dn,
+                                               const char *new_rdn,
+                                               const char *new_parent);
+
+enum OperationReturnCode ld_transaction_commit(ld_transaction_t *transaction,
+                                               transaction_callback_fn callback,
+                                               void *user_data);
+
+#endif //LIB_DOMAIN_TRANSACTION_H
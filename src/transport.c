@@ -0,0 +1,308 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "transport.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+enum
+{
+    COALESCING_FLUSH_THRESHOLD = 64 * 1024,
+};
+
+/*!
+ * @brief coalescing_transport_t - Sockbuf provider which delays sending of outgoing PDUs.
+ *
+ * Every request encoded by libldap is appended to output buffer. Connection flushes buffer once per event loop
+ * iteration, so operations submitted within the same iteration leave in a single send() call and share TCP
+ * segments. Buffer is also flushed before every read and when it grows past COALESCING_FLUSH_THRESHOLD.
+ */
+typedef struct coalescing_transport_s
+{
+    int fd;
+
+    char *tx;
+    size_t tx_len;
+} coalescing_transport_t;
+
+/**
+ * @brief transport_get_sockbuf Returns sockbuf of default connection.
+ * @param[in] ldap LDAP handle to use.
+ * @return
+ *        - NULL if connection is not established.
+ *        - sockbuf on success.
+ */
+static Sockbuf *transport_get_sockbuf(LDAP *ldap)
+{
+    Sockbuf *sb = NULL;
+
+    if (!ldap || ldap_get_option(ldap, LDAP_OPT_SOCKBUF, &sb) != LDAP_OPT_SUCCESS)
+    {
+        return NULL;
+    }
+
+    return sb;
+}
+
+/**
+ * @brief transport_replace_provider Replaces TCP provider of the sockbuf with custom provider.
+ * Must be called before any data is read from the connection by the new provider.
+ * @param[in] sb  Sockbuf to modify.
+ * @param[in] io  Provider to install.
+ * @param[in] arg Private data of the provider.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure, sockbuf keeps TCP provider.
+ */
+enum OperationReturnCode transport_replace_provider(Sockbuf *sb, Sockbuf_IO *io, void *arg)
+{
+    if (!sb || !io)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    // Debug layer shares provider level and expects TCP provider below it, so it goes away as well.
+    ber_sockbuf_remove_io(sb, &ber_sockbuf_io_debug, LBER_SBIOD_LEVEL_PROVIDER);
+
+    if (ber_sockbuf_remove_io(sb, &ber_sockbuf_io_tcp, LBER_SBIOD_LEVEL_PROVIDER) != 0)
+    {
+        ld_error("Unable to replace transport - connection does not use TCP provider.\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (ber_sockbuf_add_io(sb, io, LBER_SBIOD_LEVEL_PROVIDER, arg) != 0)
+    {
+        ld_error("Unable to install transport provider.\n");
+        ber_sockbuf_add_io(sb, &ber_sockbuf_io_tcp, LBER_SBIOD_LEVEL_PROVIDER, NULL);
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/**
+ * @brief transport_has_input Checks if provider holds data which was read from socket but not consumed yet.
+ * @param[in] ldap LDAP handle to use.
+ * @return true if data can be read without waiting for descriptor.
+ */
+bool transport_has_input(LDAP *ldap)
+{
+    Sockbuf *sb = transport_get_sockbuf(ldap);
+
+    return sb && ber_sockbuf_ctrl(sb, LBER_SB_OPT_DATA_READY, NULL) == 1;
+}
+
+/**
+ * @brief transport_has_output Checks if buffering provider holds data which was not sent yet.
+ * @param[in] ldap LDAP handle to use.
+ * @return true if data must be flushed.
+ */
+bool transport_has_output(LDAP *ldap)
+{
+    Sockbuf *sb = transport_get_sockbuf(ldap);
+
+    return sb && ber_sockbuf_ctrl(sb, LD_SB_OPT_HAS_OUTPUT, NULL) == 1;
+}
+
+/**
+ * @brief transport_flush Sends data held by buffering provider.
+ * @param[in] ldap LDAP handle to use.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode transport_flush(LDAP *ldap)
+{
+    Sockbuf *sb = transport_get_sockbuf(ldap);
+
+    if (!sb || !transport_has_output(ldap))
+    {
+        return RETURN_CODE_SUCCESS;
+    }
+
+    return ber_sockbuf_ctrl(sb, LD_SB_OPT_FLUSH, NULL) == 1 ? RETURN_CODE_SUCCESS : RETURN_CODE_FAILURE;
+}
+
+static int coalescing_transport_flush(coalescing_transport_t *transport)
+{
+    size_t offset = 0;
+
+    while (offset < transport->tx_len)
+    {
+        ssize_t result = send(transport->fd, transport->tx + offset, transport->tx_len - offset, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (result < 0)
+        {
+            break;
+        }
+
+        offset += result;
+    }
+
+    if (offset > 0)
+    {
+        memmove(transport->tx, transport->tx + offset, transport->tx_len - offset);
+        transport->tx_len -= offset;
+    }
+
+    // Socket buffer is full, the rest is sent once descriptor becomes writable.
+    if (transport->tx_len > 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int coalescing_transport_setup(Sockbuf_IO_Desc *sbiod, void *arg)
+{
+    sbiod->sbiod_pvt = arg;
+
+    return 0;
+}
+
+static int coalescing_transport_remove(Sockbuf_IO_Desc *sbiod)
+{
+    talloc_free(sbiod->sbiod_pvt);
+    sbiod->sbiod_pvt = NULL;
+
+    return 0;
+}
+
+static int coalescing_transport_ctrl(Sockbuf_IO_Desc *sbiod, int opt, void *arg)
+{
+    (void)(arg);
+
+    coalescing_transport_t *transport = sbiod->sbiod_pvt;
+
+    switch (opt)
+    {
+    case LD_SB_OPT_HAS_OUTPUT:
+        return transport->tx_len > 0;
+    case LD_SB_OPT_FLUSH:
+        return coalescing_transport_flush(transport) == 0 ? 1 : -1;
+    default:
+        return 0;
+    }
+}
+
+static ber_slen_t coalescing_transport_read(Sockbuf_IO_Desc *sbiod, void *buf, ber_len_t len)
+{
+    coalescing_transport_t *transport = sbiod->sbiod_pvt;
+
+    // Server will not answer requests we still hold.
+    if (transport->tx_len > 0 && coalescing_transport_flush(transport) != 0)
+    {
+        return -1;
+    }
+
+    return read(transport->fd, buf, len);
+}
+
+static ber_slen_t coalescing_transport_write(Sockbuf_IO_Desc *sbiod, void *buf, ber_len_t len)
+{
+    coalescing_transport_t *transport = sbiod->sbiod_pvt;
+
+    if (transport->tx_len >= COALESCING_FLUSH_THRESHOLD && coalescing_transport_flush(transport) != 0)
+    {
+        return -1;
+    }
+
+    // Buffer grows past threshold only while socket is not writable, request window bounds its size.
+    char *tx = talloc_realloc(transport, transport->tx, char, transport->tx_len + len);
+    if (!tx)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memcpy(tx + transport->tx_len, buf, len);
+    transport->tx = tx;
+    transport->tx_len += len;
+
+    return len;
+}
+
+static int coalescing_transport_close(Sockbuf_IO_Desc *sbiod)
+{
+    coalescing_transport_t *transport = sbiod->sbiod_pvt;
+
+    if (transport->tx_len > 0)
+    {
+        coalescing_transport_flush(transport);
+    }
+
+    return close(transport->fd);
+}
+
+static Sockbuf_IO coalescing_transport_io =
+{
+    coalescing_transport_setup,
+    coalescing_transport_remove,
+    coalescing_transport_ctrl,
+    coalescing_transport_read,
+    coalescing_transport_write,
+    coalescing_transport_close
+};
+
+/**
+ * @brief transport_install_coalescing Replaces TCP provider of established connection with provider which
+ * sends requests submitted during one event loop iteration together.
+ * @param[in] ctx  Memory context to allocate transport on.
+ * @param[in] ldap LDAP handle which connection to use.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure, connection keeps using TCP provider.
+ */
+enum OperationReturnCode transport_install_coalescing(TALLOC_CTX *ctx, LDAP *ldap)
+{
+    Sockbuf *sb = transport_get_sockbuf(ldap);
+    int fd = -1;
+
+    if (!sb || ber_sockbuf_ctrl(sb, LBER_SB_OPT_GET_FD, &fd) != 1 || fd < 0)
+    {
+        ld_error("Unable to install coalescing transport - connection is not established.\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    coalescing_transport_t *transport = talloc_zero(ctx, coalescing_transport_t);
+    if (!transport)
+    {
+        ld_error("Unable to allocate coalescing transport.\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    transport->fd = fd;
+
+    if (transport_replace_provider(sb, &coalescing_transport_io, transport) != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(transport);
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
@@ -0,0 +1,44 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#ifndef LIB_DOMAIN_TRANSPORT_H
+#define LIB_DOMAIN_TRANSPORT_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+/*
+ * Sockbuf controls understood by buffering provider layers of libdomain. Layers stacked on top of the provider,
+ * e.g. TLS, pass unknown controls down, so these work regardless of transport security.
+ */
+#define LD_SB_OPT_HAS_OUTPUT (LBER_SB_OPT_OPT_MAX + 1)      //!< Returns 1 if provider holds unsent data.
+#define LD_SB_OPT_FLUSH      (LBER_SB_OPT_OPT_MAX + 2)      //!< Sends buffered data, returns 1 on success.
+
+enum OperationReturnCode transport_replace_provider(Sockbuf *sb, Sockbuf_IO *io, void *arg);
+
+enum OperationReturnCode transport_install_uring(TALLOC_CTX *ctx, LDAP *ldap);
+enum OperationReturnCode transport_install_coalescing(TALLOC_CTX *ctx, LDAP *ldap);
+
+bool transport_has_input(LDAP *ldap);
+bool transport_has_output(LDAP *ldap);
+enum OperationReturnCode transport_flush(LDAP *ldap);
+
+#endif//LIB_DOMAIN_TRANSPORT_H
@@ -0,0 +1,351 @@
+/***********************************************************************************************************************
+**
+** Copyright (C) 2024 BaseALT Ltd. <org@basealt.ru>
+**
+** This program is free software; you can redistribute it and/or
+** modify it under the terms of the GNU General Public License
+** as published by the Free Software Foundation; either version 2
+** of the License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**
+***********************************************************************************************************************/
+
+#include "transport.h"
+
+#ifdef LIBDOMAIN_HAVE_IO_URING
+
+#include <errno.h>
+#include <liburing.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef RWF_NOWAIT
+#define RWF_NOWAIT 0x00000008
+#endif
+
+enum
+{
+    URING_QUEUE_DEPTH = 4,
+    URING_BUFFER_SIZE = 64 * 1024,
+    URING_RX_BUFFER   = 0,
+    URING_TX_BUFFER   = 1,
+};
+
+/*!
+ * @brief uring_transport_t - Sockbuf provider which performs socket I/O through io_uring.
+ *
+ * Both buffers are registered with the ring. Incoming data is read ahead into rx buffer with a single
+ * non-blocking fixed read, so one submission serves many small reads performed by liblber while it decodes
+ * PDUs. Outgoing PDUs are accumulated in tx buffer and submitted as a single fixed write when connection
+ * flushes, before the next read or when buffer fills up.
+ */
+typedef struct uring_transport_s
+{
+    struct io_uring ring;
+    int fd;
+
+    char *rx;
+    size_t rx_pos;
+    size_t rx_len;
+
+    char *tx;
+    size_t tx_len;
+} uring_transport_t;
+
+static long uring_transport_complete(uring_transport_t *transport)
+{
+    struct io_uring_cqe *cqe = NULL;
+
+    int rc = io_uring_submit_and_wait(&transport->ring, 1);
+    if (rc < 0)
+    {
+        return rc;
+    }
+
+    rc = io_uring_wait_cqe(&transport->ring, &cqe);
+    if (rc < 0)
+    {
+        return rc;
+    }
+
+    long result = cqe->res;
+
+    io_uring_cqe_seen(&transport->ring, cqe);
+
+    return result;
+}
+
+static int uring_transport_flush(uring_transport_t *transport)
+{
+    size_t offset = 0;
+
+    while (offset < transport->tx_len)
+    {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&transport->ring);
+        if (!sqe)
+        {
+            errno = EBUSY;
+            break;
+        }
+
+        io_uring_prep_write_fixed(sqe, transport->fd, transport->tx + offset, transport->tx_len - offset, 0,
+                                  URING_TX_BUFFER);
+
+        long result = uring_transport_complete(transport);
+        if (result == -EINTR)
+        {
+            continue;
+        }
+
+        if (result <= 0)
+        {
+            errno = result < 0 ? (int)-result : EPIPE;
+            break;
+        }
+
+        offset += result;
+    }
+
+    if (offset > 0)
+    {
+        memmove(transport->tx, transport->tx + offset, transport->tx_len - offset);
+        transport->tx_len -= offset;
+    }
+
+    return transport->tx_len == 0 ? 0 : -1;
+}
+
+static int uring_transport_setup(Sockbuf_IO_Desc *sbiod, void *arg)
+{
+    sbiod->sbiod_pvt = arg;
+
+    return 0;
+}
+
+static int uring_transport_remove(Sockbuf_IO_Desc *sbiod)
+{
+    uring_transport_t *transport = sbiod->sbiod_pvt;
+
+    io_uring_unregister_buffers(&transport->ring);
+    io_uring_queue_exit(&transport->ring);
+
+    talloc_free(transport);
+    sbiod->sbiod_pvt = NULL;
+
+    return 0;
+}
+
+static int uring_transport_ctrl(Sockbuf_IO_Desc *sbiod, int opt, void *arg)
+{
+    (void)(arg);
+
+    uring_transport_t *transport = sbiod->sbiod_pvt;
+
+    switch (opt)
+    {
+    case LBER_SB_OPT_DATA_READY:
+        return transport->rx_pos < transport->rx_len;
+    case LD_SB_OPT_HAS_OUTPUT:
+        return transport->tx_len > 0;
+    case LD_SB_OPT_FLUSH:
+        return uring_transport_flush(transport) == 0 ? 1 : -1;
+    default:
+        return 0;
+    }
+}
+
+static ber_slen_t uring_transport_read(Sockbuf_IO_Desc *sbiod, void *buf, ber_len_t len)
+{
+    uring_transport_t *transport = sbiod->sbiod_pvt;
+
+    // Server will not answer requests we still hold.
+    if (transport->tx_len > 0 && uring_transport_flush(transport) != 0)
+    {
+        return -1;
+    }
+
+    if (transport->rx_pos == transport->rx_len)
+    {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&transport->ring);
+        if (!sqe)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        io_uring_prep_read_fixed(sqe, transport->fd, transport->rx, URING_BUFFER_SIZE, 0, URING_RX_BUFFER);
+        sqe->rw_flags = RWF_NOWAIT;
+
+        long result = uring_transport_complete(transport);
+        if (result < 0)
+        {
+            errno = (int)-result;
+            return -1;
+        }
+
+        if (result == 0)
+        {
+            return 0;
+        }
+
+        transport->rx_pos = 0;
+        transport->rx_len = result;
+    }
+
+    size_t available = transport->rx_len - transport->rx_pos;
+    size_t count = len < available ? len : available;
+
+    memcpy(buf, transport->rx + transport->rx_pos, count);
+    transport->rx_pos += count;
+
+    return count;
+}
+
+static ber_slen_t uring_transport_write(Sockbuf_IO_Desc *sbiod, void *buf, ber_len_t len)
+{
+    uring_transport_t *transport = sbiod->sbiod_pvt;
+
+    if (transport->tx_len == URING_BUFFER_SIZE && uring_transport_flush(transport) != 0)
+    {
+        return -1;
+    }
+
+    // Partial writes are fine, liblber repeats the call with the rest of PDU.
+    size_t count = URING_BUFFER_SIZE - transport->tx_len;
+    if (len < count)
+    {
+        count = len;
+    }
+
+    memcpy(transport->tx + transport->tx_len, buf, count);
+    transport->tx_len += count;
+
+    return count;
+}
+
+static int uring_transport_close(Sockbuf_IO_Desc *sbiod)
+{
+    uring_transport_t *transport = sbiod->sbiod_pvt;
+
+    if (transport->tx_len > 0)
+    {
+        uring_transport_flush(transport);
+    }
+
+    return close(transport->fd);
+}
+
+static Sockbuf_IO uring_transport_io =
+{
+    uring_transport_setup,
+    uring_transport_remove,
+    uring_transport_ctrl,
+    uring_transport_read,
+    uring_transport_write,
+    uring_transport_close
+};
+
+/**
+ * @brief transport_install_uring Replaces TCP provider of established connection with io_uring provider.
+ * @param[in] ctx  Memory context to allocate transport on.
+ * @param[in] ldap LDAP handle which connection to use.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure, connection keeps using TCP provider.
+ */
+enum OperationReturnCode transport_install_uring(TALLOC_CTX *ctx, LDAP *ldap)
+{
+    Sockbuf *sb = NULL;
+    int fd = -1;
+
+    if (ldap_get_option(ldap, LDAP_OPT_SOCKBUF, &sb) != LDAP_OPT_SUCCESS || !sb
+        || ber_sockbuf_ctrl(sb, LBER_SB_OPT_GET_FD, &fd) != 1 || fd < 0)
+    {
+        ld_error("Unable to install io_uring transport - connection is not established.\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    uring_transport_t *transport = talloc_zero(ctx, uring_transport_t);
+    if (!transport)
+    {
+        ld_error("Unable to allocate io_uring transport.\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    transport->fd = fd;
+    transport->rx = talloc_array(transport, char, URING_BUFFER_SIZE);
+    transport->tx = talloc_array(transport, char, URING_BUFFER_SIZE);
+
+    if (!transport->rx || !transport->tx)
+    {
+        ld_error("Unable to allocate io_uring transport buffers.\n");
+        goto error_free;
+    }
+
+    int rc = io_uring_queue_init(URING_QUEUE_DEPTH, &transport->ring, 0);
+    if (rc < 0)
+    {
+        ld_error("Unable to create io_uring: %s\n", strerror(-rc));
+        goto error_free;
+    }
+
+    struct iovec buffers[] =
+    {
+        { transport->rx, URING_BUFFER_SIZE },
+        { transport->tx, URING_BUFFER_SIZE },
+    };
+
+    rc = io_uring_register_buffers(&transport->ring, buffers, 2);
+    if (rc < 0)
+    {
+        ld_error("Unable to register io_uring buffers: %s\n", strerror(-rc));
+        goto error_exit;
+    }
+
+    if (transport_replace_provider(sb, &uring_transport_io, transport) != RETURN_CODE_SUCCESS)
+    {
+        io_uring_unregister_buffers(&transport->ring);
+        goto error_exit;
+    }
+
+    ld_info("Connection uses io_uring transport.\n");
+
+    return RETURN_CODE_SUCCESS;
+
+    error_exit:
+        io_uring_queue_exit(&transport->ring);
+
+    error_free:
+        talloc_free(transport);
+
+        return RETURN_CODE_FAILURE;
+}
+
+#else
+
+/**
+ * @brief transport_install_uring Library was built without io_uring support.
+ * @param[in] ctx  Unused.
+ * @param[in] ldap Unused.
+ * @return RETURN_CODE_FAILURE.
+ */
+enum OperationReturnCode transport_install_uring(TALLOC_CTX *ctx, LDAP *ldap)
+{
+    (void)(ctx);
+    (void)(ldap);
+
+    ld_warning("Library was built without io_uring support, falling back to TCP transport.\n");
+
+    return RETURN_CODE_FAILURE;
+}
+
+#endif
@@ -5,8 +5,13 @@
 #include "directory.h"
 #include "domain_p.h"
 #include "entry.h"
+#include "filter.h"
+#include "pipeline.h"
+#include "schema.h"
 
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 
 enum UserAttributeIndex
@@ -233,3 +238,925 @@ enum OperationReturnCode ld_unblock_user(LDHandle *handle, const char *name, con
 
     return rc;
 }
+
+/*!
+ * @brief user_template_t - Attributes every user of the directory type receives unless batch provides them.
+ */
+typedef struct user_template_s
+{
+    const char **object_classes;     //!< Object classes of the user, NULL terminated.
+    const char *login_attribute;     //!< Attribute which holds login, derived from the name.
+    bool naming_attribute;           //!< Derive cn from the name, server does not add value of the rdn itself.
+    bool posix;                      //!< Derive uidNumber, gidNumber and homeDirectory.
+} user_template_t;
+
+static const char *USER_OBJECT_CLASSES_AD[] = { "top", "person", "organizationalPerson", "user", NULL };
+static const char *USER_OBJECT_CLASSES_OPENLDAP[] = { "top", "account", "posixAccount", "shadowAccount", NULL };
+
+static const user_template_t USER_TEMPLATE_AD = { USER_OBJECT_CLASSES_AD, "sAMAccountName", false, false };
+static const user_template_t USER_TEMPLATE_OPENLDAP = { USER_OBJECT_CLASSES_OPENLDAP, "uid", true, true };
+
+enum UserBatchDerivedIndex
+{
+    DERIVED_LOGIN          = 0,
+    DERIVED_NAME           = 1,
+    DERIVED_UID_NUMBER     = 2,
+    DERIVED_GID_NUMBER     = 3,
+    DERIVED_HOME_DIRECTORY = 4,
+    DERIVED_COUNT          = 5,
+};
+
+/*!
+ * @brief user_batch_t - State of bulk user creation. Modifications are built once and refilled for every row.
+ */
+typedef struct user_batch_s
+{
+    LDHandle *handle;                            //!< Handle users are created with.
+    const ld_user_batch_t *batch;                //!< Batch to create.
+    const user_template_t *template;             //!< Template of the directory type.
+    char *parent;                                //!< Parent dn of the users.
+
+    LDAPMod object_class_mod;                    //!< objectClass, NULL mod_type if batch provides it.
+    LDAPMod derived_mods[DERIVED_COUNT];         //!< Derived attributes, NULL mod_type if not derived.
+    char *derived_values[DERIVED_COUNT][2];      //!< Values of derived attributes.
+    LDAPMod *column_mods;                        //!< One mod per column.
+    char **column_values;                        //!< Two values per column, value and NULL.
+    LDAPMod **mods;                              //!< Mods of the current row, NULL terminated.
+
+    int outstanding;                             //!< Number of adds waiting for result.
+    int completed;                               //!< Number of users server created.
+    int failed;                                  //!< Number of users which were not submitted or were rejected.
+    bool submitted;                              //!< Every row was submitted.
+
+    user_batch_callback_fn callback;             //!< Callback to call once server answered for every user.
+    void *user_data;                             //!< User data to pass to callback.
+} user_batch_t;
+
+static bool user_batch_has_column(const ld_user_batch_t *batch, const char *name)
+{
+    for (int i = 0; i < batch->n_columns; ++i)
+    {
+        if (strcasecmp(batch->column_names[i], name) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief user_batch_validate Checks that every column of the batch is an attribute known to the schema.
+ * Validation is skipped when schema of the directory was not loaded.
+ * @param[in] connection Connection to work with.
+ * @param[in] batch      Batch to validate.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE if batch refers to unknown attribute.
+ */
+static enum OperationReturnCode user_batch_validate(struct ldap_connection_ctx_t *connection,
+                                                    const ld_user_batch_t *batch)
+{
+    if (!connection->schema || !ldap_schema_ready(connection))
+    {
+        return RETURN_CODE_SUCCESS;
+    }
+
+    LDAPAttributeType **attribute_types = ldap_schema_attribute_types(connection->schema);
+    bool schema_loaded = attribute_types && attribute_types[0];
+    talloc_free(attribute_types);
+
+    if (!schema_loaded)
+    {
+        return RETURN_CODE_SUCCESS;
+    }
+
+    for (int i = 0; i < batch->n_columns; ++i)
+    {
+        if (!ldap_schema_find_attributetype(connection->schema, batch->column_names[i]))
+        {
+            ld_error("ld_add_users - attribute %s is not defined in schema!\n", batch->column_names[i]);
+            return RETURN_CODE_FAILURE;
+        }
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void user_batch_derive(user_batch_t *state, enum UserBatchDerivedIndex index, const char *name)
+{
+    if (user_batch_has_column(state->batch, name))
+    {
+        return;
+    }
+
+    state->derived_mods[index].mod_op = LDAP_MOD_ADD;
+    state->derived_mods[index].mod_type = (char*)name;
+    state->derived_mods[index].mod_values = state->derived_values[index];
+}
+
+static void user_batch_on_result(struct ldap_connection_ctx_t *connection, int result_code, void *user_data);
+
+/**
+ * @brief user_batch_submit_row Creates user of the row.
+ * @param[in] connection Connection to work with.
+ * @param[in] row        Row of the batch.
+ * @param[in] user_data  State of the batch.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ *        - RETURN_CODE_WOULD_BLOCK if row should be submitted again once window opens.
+ */
+static enum OperationReturnCode user_batch_submit_row(struct ldap_connection_ctx_t *connection, int row,
+                                                      void *user_data)
+{
+    user_batch_t *state = user_data;
+    const ld_user_batch_t *batch = state->batch;
+    const char *name = batch->names[row];
+
+    if (!name || strlen(name) == 0)
+    {
+        ld_error("ld_add_users - user #%d has no name!\n", row);
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *row_ctx = talloc_new(state);
+    int mod_index = 0;
+
+    if (state->object_class_mod.mod_type)
+    {
+        state->mods[mod_index++] = &state->object_class_mod;
+    }
+
+    state->derived_values[DERIVED_LOGIN][0] = (char*)name;
+    state->derived_values[DERIVED_NAME][0] = (char*)name;
+    if (state->template->posix)
+    {
+        state->derived_values[DERIVED_UID_NUMBER][0] = talloc_asprintf(row_ctx, "%d", batch->first_uid_number + row);
+        state->derived_values[DERIVED_GID_NUMBER][0] = talloc_asprintf(row_ctx, "%d", batch->gid_number);
+        state->derived_values[DERIVED_HOME_DIRECTORY][0] = talloc_asprintf(row_ctx, "/home/%s", name);
+    }
+
+    for (int i = 0; i < DERIVED_COUNT; ++i)
+    {
+        if (state->derived_mods[i].mod_type)
+        {
+            state->mods[mod_index++] = &state->derived_mods[i];
+        }
+    }
+
+    for (int i = 0; i < batch->n_columns; ++i)
+    {
+        const char *value = batch->columns[i][row];
+        if (value)
+        {
+            state->column_values[2 * i] = (char*)value;
+            state->mods[mod_index++] = &state->column_mods[i];
+        }
+    }
+    state->mods[mod_index] = NULL;
+
+    const char *dn = talloc_asprintf(row_ctx, "cn=%s,%s", name, state->parent);
+
+    enum OperationReturnCode rc = add_ext(connection, dn, state->mods, NULL, user_batch_on_result, state);
+    if (rc == RETURN_CODE_SUCCESS)
+    {
+        ++state->outstanding;
+    }
+
+    talloc_free(row_ctx);
+
+    return rc;
+}
+
+static void user_batch_finish(user_batch_t *state)
+{
+    if (!state->submitted || state->outstanding > 0)
+    {
+        return;
+    }
+
+    if (state->callback)
+    {
+        state->callback(state->handle, state->completed, state->failed, state->user_data);
+    }
+
+    talloc_free(state);
+}
+
+static void user_batch_on_result(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    user_batch_t *state = talloc_get_type_abort(user_data, user_batch_t);
+
+    --state->outstanding;
+
+    if (result_code == LDAP_SUCCESS)
+    {
+        ++state->completed;
+    }
+    else
+    {
+        ++state->failed;
+    }
+
+    user_batch_finish(state);
+}
+
+static void user_batch_on_complete(struct ldap_connection_ctx_t *connection, int submitted, int failed,
+                                   void *user_data)
+{
+    (void)(connection);
+    (void)(submitted);
+
+    user_batch_t *state = user_data;
+
+    state->failed += failed;
+    state->submitted = true;
+
+    user_batch_finish(state);
+}
+
+/*!
+ * \brief ld_add_users Creates users of the columnar batch. Attributes of the directory template (object classes,
+ * login, and for OpenLDAP cn, uidNumber, gidNumber and homeDirectory) are added unless batch has column for them.
+ * Columns are validated against the schema once, then adds are pipelined up to the request window of the
+ * connection, next users are submitted as soon as window opens.
+ * \param[in] handle    Pointer to libdomain session handle.
+ * \param[in] batch     Users to create, must stay valid until callback is called.
+ * \param[in] parent    Parent dn of the users. Can be NULL than default parent will be selected.
+ * \param[in] callback  Callback to call once server answered for every user. Can be NULL.
+ * \param[in] user_data User data to pass to the callback.
+ * \return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_add_users(LDHandle *handle,
+                                      const ld_user_batch_t *batch,
+                                      const char *parent,
+                                      user_batch_callback_fn callback,
+                                      void *user_data)
+{
+    check_handle(handle, "ld_add_users");
+
+    if (!batch || batch->count < 0 || (batch->count > 0 && !batch->names)
+        || batch->n_columns < 0 || (batch->n_columns > 0 && (!batch->column_names || !batch->columns)))
+    {
+        ld_error("ld_add_users - invalid batch!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    struct ldap_connection_ctx_t *connection = handle->connection_ctx;
+
+    const user_template_t *template = NULL;
+    switch (connection->directory_type)
+    {
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        template = &USER_TEMPLATE_AD;
+        break;
+    case LDAP_TYPE_OPENLDAP:
+        template = &USER_TEMPLATE_OPENLDAP;
+        break;
+    default:
+        ld_error("Bulk user creation is not implemented for directory type %d!\n", connection->directory_type);
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (user_batch_validate(connection, batch) != RETURN_CODE_SUCCESS)
+    {
+        return RETURN_CODE_FAILURE;
+    }
+
+    user_batch_t *state = talloc_zero(handle->talloc_ctx, user_batch_t);
+    if (!state)
+    {
+        ld_error("ld_add_users - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    state->handle = handle;
+    state->batch = batch;
+    state->template = template;
+    state->parent = parent ? talloc_strdup(state, parent) : (char*)create_user_parent(state, handle);
+    state->callback = callback;
+    state->user_data = user_data;
+
+    if (!user_batch_has_column(batch, "objectClass"))
+    {
+        state->object_class_mod.mod_op = LDAP_MOD_ADD;
+        state->object_class_mod.mod_type = "objectClass";
+        state->object_class_mod.mod_values = (char**)template->object_classes;
+    }
+
+    user_batch_derive(state, DERIVED_LOGIN, template->login_attribute);
+    if (template->naming_attribute)
+    {
+        user_batch_derive(state, DERIVED_NAME, "cn");
+    }
+    if (template->posix)
+    {
+        user_batch_derive(state, DERIVED_UID_NUMBER, "uidNumber");
+        user_batch_derive(state, DERIVED_GID_NUMBER, "gidNumber");
+        user_batch_derive(state, DERIVED_HOME_DIRECTORY, "homeDirectory");
+    }
+
+    state->column_mods = talloc_zero_array(state, LDAPMod, batch->n_columns + 1);
+    state->column_values = talloc_zero_array(state, char*, 2 * batch->n_columns + 1);
+    state->mods = talloc_zero_array(state, LDAPMod*, 1 + DERIVED_COUNT + batch->n_columns + 1);
+
+    if (!state->parent || !state->column_mods || !state->column_values || !state->mods)
+    {
+        ld_error("ld_add_users - out of memory!\n");
+        talloc_free(state);
+        return RETURN_CODE_FAILURE;
+    }
+
+    for (int i = 0; i < batch->n_columns; ++i)
+    {
+        state->column_mods[i].mod_op = LDAP_MOD_ADD;
+        state->column_mods[i].mod_type = (char*)batch->column_names[i];
+        state->column_mods[i].mod_values = &state->column_values[2 * i];
+    }
+
+    if (pipeline_start(state, connection, NULL, batch->count, user_batch_submit_row, user_batch_on_complete,
+                       state) != RETURN_CODE_SUCCESS)
+    {
+        talloc_free(state);
+        return RETURN_CODE_FAILURE;
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+#define USER_LOCKOUT_LOOKUP_CHUNK 100
+#define AD_ACCOUNT_DISABLE 0x2
+
+/*!
+ * @brief user_lockout_t - State of blocking or unblocking several users. Single modification is reused for
+ * every user, on AD it only differs by value of userAccountControl.
+ */
+typedef struct user_lockout_s
+{
+    LDHandle *handle;                //!< Handle users are modified with.
+    connection_identity_t identity;  //!< Identity and priority class lookups and modifications are submitted with.
+    bool block;                      //!< Block users if true, unblock otherwise.
+    char *parent;                    //!< Parent dn of the users.
+
+    const char **names;              //!< Names of the users.
+    int n_names;                     //!< Number of the users.
+    int next_name;                   //!< First name of the next lookup, AD only.
+    int lookup_size;                 //!< Number of names in the lookup in flight, AD only.
+
+    char **dns;                      //!< Dns to modify.
+    char **values;                   //!< Value to set for each dn, NULL when the same value is used.
+    int count;                       //!< Number of dns to modify.
+
+    LDAPMod mod;                     //!< Modification applied to each dn.
+    char *modification_values[2];    //!< Values of modification.
+    LDAPMod *mods[2];                //!< Modifications, NULL terminated.
+    int tolerated_result;            //!< Result code which means user already is in requested state.
+
+    int outstanding;                 //!< Number of modifications waiting for result.
+    int completed;                   //!< Number of users which are in requested state.
+    int failed;                      //!< Number of users which were not found, not submitted or were rejected.
+    bool submitted;                  //!< Every modification was submitted.
+
+    user_batch_callback_fn callback; //!< Callback to call once server answered for every user.
+    void *user_data;                 //!< User data to pass to callback.
+} user_lockout_t;
+
+static void user_lockout_finish(user_lockout_t *state)
+{
+    if (!state->submitted || state->outstanding > 0)
+    {
+        return;
+    }
+
+    if (state->callback)
+    {
+        state->callback(state->handle, state->completed, state->failed, state->user_data);
+    }
+
+    talloc_free(state);
+}
+
+/**
+ * @brief user_lockout_abort Stops processing, users which were not modified yet are reported as failed.
+ * @param[in] state      State of the operation.
+ * @param[in] unresolved Number of users which were not looked up.
+ */
+static void user_lockout_abort(user_lockout_t *state, int unresolved)
+{
+    state->failed += unresolved + state->count;
+    state->submitted = true;
+
+    user_lockout_finish(state);
+}
+
+static void user_lockout_on_result(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+
+    user_lockout_t *state = talloc_get_type_abort(user_data, user_lockout_t);
+
+    --state->outstanding;
+
+    if (result_code == LDAP_SUCCESS || result_code == state->tolerated_result)
+    {
+        ++state->completed;
+    }
+    else
+    {
+        ++state->failed;
+    }
+
+    user_lockout_finish(state);
+}
+
+static enum OperationReturnCode user_lockout_submit(struct ldap_connection_ctx_t *connection, int index,
+                                                    void *user_data)
+{
+    user_lockout_t *state = user_data;
+
+    if (state->values)
+    {
+        state->modification_values[0] = state->values[index];
+    }
+
+    enum OperationReturnCode rc = modify_ext(connection, state->dns[index], state->mods, NULL,
+                                             user_lockout_on_result, state);
+    if (rc == RETURN_CODE_SUCCESS)
+    {
+        ++state->outstanding;
+    }
+
+    return rc;
+}
+
+static void user_lockout_on_submitted(struct ldap_connection_ctx_t *connection, int submitted, int failed,
+                                      void *user_data)
+{
+    (void)(connection);
+    (void)(submitted);
+
+    user_lockout_t *state = user_data;
+
+    state->failed += failed;
+    state->submitted = true;
+
+    user_lockout_finish(state);
+}
+
+static void user_lockout_modify(user_lockout_t *state)
+{
+    if (pipeline_start(state, state->handle->connection_ctx, &state->identity, state->count, user_lockout_submit,
+                       user_lockout_on_submitted, state) != RETURN_CODE_SUCCESS)
+    {
+        user_lockout_abort(state, 0);
+    }
+}
+
+static void user_lockout_lookup_next(user_lockout_t *state);
+
+/**
+ * @brief user_lockout_on_lookup Computes new userAccountControl of found users, only ACCOUNTDISABLE bit is changed.
+ * Users which are already in requested state are not modified.
+ */
+static enum OperationReturnCode user_lockout_on_lookup(struct ldap_connection_ctx_t *connection,
+                                                       ld_entry_t **entries,
+                                                       void *user_data)
+{
+    (void)(connection);
+
+    user_lockout_t *state = talloc_get_type_abort(user_data, user_lockout_t);
+
+    int found = 0;
+
+    for (int i = 0; entries && entries[i]; ++i)
+    {
+        const char *dn = ld_entry_get_dn(entries[i]);
+        const char *account_control = ld_entry_get_first_value(entries[i], "userAccountControl");
+
+        if (!dn || strlen(dn) == 0 || !account_control)
+        {
+            continue;
+        }
+
+        ++found;
+
+        unsigned long old_value = strtoul(account_control, NULL, 10);
+        unsigned long new_value = state->block ? old_value | AD_ACCOUNT_DISABLE : old_value & ~AD_ACCOUNT_DISABLE;
+
+        if (new_value == old_value)
+        {
+            ++state->completed;
+            continue;
+        }
+
+        state->dns[state->count] = talloc_strdup(state->dns, dn);
+        state->values[state->count] = talloc_asprintf(state->values, "%lu", new_value);
+        ++state->count;
+    }
+
+    if (found < state->lookup_size)
+    {
+        ld_warning("ld_block_users - %d users were not found!\n", state->lookup_size - found);
+        state->failed += state->lookup_size - found;
+    }
+
+    user_lockout_lookup_next(state);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void user_lockout_on_lookup_failed(struct ldap_connection_ctx_t *connection, int result_code,
+                                          void *user_data)
+{
+    (void)(connection);
+
+    user_lockout_t *state = talloc_get_type_abort(user_data, user_lockout_t);
+
+    ld_error("ld_block_users - unable to look up users: %s\n", ldap_err2string(result_code));
+
+    // Chunk in flight and every chunk after it are not resolved.
+    user_lockout_abort(state, state->n_names - state->next_name + state->lookup_size);
+}
+
+static enum OperationReturnCode user_lockout_lookup_submit(struct ldap_connection_ctx_t *connection, int index,
+                                                           void *user_data)
+{
+    (void)(index);
+
+    user_lockout_t *state = user_data;
+
+    int first = state->next_name;
+    int last = first + USER_LOCKOUT_LOOKUP_CHUNK < state->n_names ? first + USER_LOCKOUT_LOOKUP_CHUNK
+                                                                  : state->n_names;
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    char *filter = talloc_strdup(talloc_ctx, "(&(objectClass=user)(|");
+    for (int i = first; i < last; ++i)
+    {
+        char *escaped = ld_filter_escape(talloc_ctx, state->names[i]);
+        if (!escaped)
+        {
+            talloc_free(talloc_ctx);
+            return RETURN_CODE_FAILURE;
+        }
+
+        filter = talloc_asprintf_append(filter, "(cn=%s)", escaped);
+    }
+    filter = talloc_strdup_append(filter, "))");
+
+    char *attributes[] = { "userAccountControl", NULL };
+
+    enum OperationReturnCode rc = search_ext(connection, state->parent, LDAP_SCOPE_ONELEVEL, filter, attributes,
+                                             false, user_lockout_on_lookup, user_lockout_on_lookup_failed, state);
+    if (rc == RETURN_CODE_SUCCESS)
+    {
+        state->lookup_size = last - first;
+        state->next_name = last;
+    }
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
+
+static void user_lockout_on_lookup_submitted(struct ldap_connection_ctx_t *connection, int submitted, int failed,
+                                             void *user_data)
+{
+    (void)(connection);
+    (void)(submitted);
+
+    user_lockout_t *state = user_data;
+
+    if (failed > 0)
+    {
+        ld_error("ld_block_users - unable to look up users!\n");
+
+        user_lockout_abort(state, state->n_names - state->next_name);
+    }
+}
+
+/**
+ * @brief user_lockout_lookup_next Looks up next chunk of users, starts modifications once every user is looked up.
+ */
+static void user_lockout_lookup_next(user_lockout_t *state)
+{
+    if (state->next_name >= state->n_names)
+    {
+        user_lockout_modify(state);
+        return;
+    }
+
+    if (pipeline_start(state, state->handle->connection_ctx, &state->identity, 1, user_lockout_lookup_submit,
+                       user_lockout_on_lookup_submitted, state) != RETURN_CODE_SUCCESS)
+    {
+        user_lockout_abort(state, state->n_names - state->next_name);
+    }
+}
+
+/**
+ * @brief user_lockout_start Blocks or unblocks users. OpenLDAP users are modified with single prepared
+ * modification of pwdAccountLockedTime. AD users are looked up in chunks first to flip ACCOUNTDISABLE bit
+ * of their current userAccountControl.
+ */
+static enum OperationReturnCode user_lockout_start(LDHandle *handle,
+                                                   const char **names,
+                                                   const char *parent,
+                                                   bool block,
+                                                   user_batch_callback_fn callback,
+                                                   void *user_data)
+{
+    if (!names)
+    {
+        ld_error("ld_block_users - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    enum LdapDirectoryType directory_type = handle->connection_ctx->directory_type;
+    if (directory_type != LDAP_TYPE_OPENLDAP && directory_type != LDAP_TYPE_ACTIVE_DIRECTORY)
+    {
+        ld_error("Blocking users is not implemented for directory type %d!\n", directory_type);
+        return RETURN_CODE_FAILURE;
+    }
+
+    user_lockout_t *state = talloc_zero(handle->talloc_ctx, user_lockout_t);
+    if (!state)
+    {
+        ld_error("ld_block_users - out of memory!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    state->handle = handle;
+    state->block = block;
+    state->parent = parent ? talloc_strdup(state, parent) : (char*)create_user_parent(state, handle);
+    state->names = names;
+    state->tolerated_result = LDAP_SUCCESS;
+    state->callback = callback;
+    state->user_data = user_data;
+
+    while (names[state->n_names])
+    {
+        ++state->n_names;
+    }
+
+    state->dns = talloc_zero_array(state, char*, state->n_names + 1);
+    state->mods[0] = &state->mod;
+
+    if (!state->parent || !state->dns
+        || connection_save_identity(state, handle->connection_ctx, &state->identity) != RETURN_CODE_SUCCESS)
+    {
+        ld_error("ld_block_users - out of memory!\n");
+        talloc_free(state);
+        return RETURN_CODE_FAILURE;
+    }
+
+    if (directory_type == LDAP_TYPE_ACTIVE_DIRECTORY)
+    {
+        state->values = talloc_zero_array(state, char*, state->n_names + 1);
+        state->mod.mod_op = LDAP_MOD_REPLACE;
+        state->mod.mod_type = "userAccountControl";
+        state->mod.mod_values = state->modification_values;
+
+        user_lockout_lookup_next(state);
+
+        return RETURN_CODE_SUCCESS;
+    }
+
+    for (int i = 0; i < state->n_names; ++i)
+    {
+        state->dns[i] = talloc_asprintf(state->dns, "cn=%s,%s", names[i], state->parent);
+    }
+    state->count = state->n_names;
+
+    state->mod.mod_op = block ? LDAP_MOD_REPLACE : LDAP_MOD_DELETE;
+    state->mod.mod_type = "pwdAccountLockedTime";
+    state->modification_values[0] = block ? "000001010000Z" : NULL;
+    state->mod.mod_values = block ? state->modification_values : NULL;
+
+    // User which is not locked has no pwdAccountLockedTime to delete.
+    if (!block)
+    {
+        state->tolerated_result = LDAP_NO_SUCH_ATTRIBUTE;
+    }
+
+    user_lockout_modify(state);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+/*!
+ * \brief ld_block_users Blocks several users, modifications are pipelined through the request window.
+ * \param[in] handle    Pointer to libdomain session handle.
+ * \param[in] names     Names of the users, NULL terminated, must stay valid until callback is called.
+ * \param[in] parent    Parent dn of the users. Can be NULL than default parent will be selected.
+ * \param[in] callback  Callback to receive number of completed and failed users once server answered for
+ *                      every user. Can be NULL.
+ * \param[in] user_data User data to pass to the callback.
+ * \return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_block_users(LDHandle *handle,
+                                        const char **names,
+                                        const char *parent,
+                                        user_batch_callback_fn callback,
+                                        void *user_data)
+{
+    check_handle(handle, "ld_block_users");
+
+    return user_lockout_start(handle, names, parent, true, callback, user_data);
+}
+
+/*!
+ * \brief ld_unblock_users Unblocks several users, modifications are pipelined through the request window.
+ * \param[in] handle    Pointer to libdomain session handle.
+ * \param[in] names     Names of the users, NULL terminated, must stay valid until callback is called.
+ * \param[in] parent    Parent dn of the users. Can be NULL than default parent will be selected.
+ * \param[in] callback  Callback to receive number of completed and failed users once server answered for
+ *                      every user. Can be NULL.
+ * \param[in] user_data User data to pass to the callback.
+ * \return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_unblock_users(LDHandle *handle,
+                                          const char **names,
+                                          const char *parent,
+                                          user_batch_callback_fn callback,
+                                          void *user_data)
+{
+    check_handle(handle, "ld_unblock_users");
+
+    return user_lockout_start(handle, names, parent, false, callback, user_data);
+}
+
+#define USER_LIST_PAGE_SIZE 500
+
+static const char *USER_ATTRIBUTES_AD[] =
+{
+    "cn", "sAMAccountName", "displayName", "mail", "userAccountControl", NULL
+};
+
+static const char *USER_ATTRIBUTES_OPENLDAP[] =
+{
+    "cn", "uid", "displayName", "mail", "pwdAccountLockedTime", NULL
+};
+
+static const char *USER_FILTER_AD = "(&(objectClass=user)(!(objectClass=computer)))";
+static const char *USER_FILTER_OPENLDAP = "(objectClass=posixAccount)";
+
+static void *user_from_entry(TALLOC_CTX *ctx, int directory_type, ld_entry_t *entry)
+{
+    const char *dn = ld_entry_get_dn(entry);
+
+    // Last message of search result chain carries no entry.
+    if (!dn || strlen(dn) == 0)
+    {
+        return NULL;
+    }
+
+    ld_user_t *user = talloc_zero(ctx, ld_user_t);
+    if (!user)
+    {
+        return NULL;
+    }
+
+    // Attributes reference values stored in the entry, so user takes ownership of the entry.
+    talloc_steal(user, entry);
+    user->attributes = ld_entry_get_attributes(entry);
+
+    user->dn = talloc_strdup(user, dn);
+    user->name = ld_entry_get_first_value(entry, "cn");
+    user->display_name = ld_entry_get_first_value(entry, "displayName");
+    user->mail = ld_entry_get_first_value(entry, "mail");
+
+    if (directory_type == LDAP_TYPE_ACTIVE_DIRECTORY)
+    {
+        const char *account_control = ld_entry_get_first_value(entry, "userAccountControl");
+
+        user->login = ld_entry_get_first_value(entry, "sAMAccountName");
+        user->blocked = account_control && (strtoul(account_control, NULL, 10) & 0x2);
+    }
+    else
+    {
+        user->login = ld_entry_get_first_value(entry, "uid");
+        user->blocked = ld_entry_get_first_value(entry, "pwdAccountLockedTime") != NULL;
+    }
+
+    return user;
+}
+
+static enum OperationReturnCode user_search(LDHandle *handle,
+                                            const char *base_dn,
+                                            int scope,
+                                            const char **attributes,
+                                            user_list_callback_fn callback,
+                                            void *user_data)
+{
+    const char *filter = NULL;
+    const char **default_attributes = NULL;
+
+    switch (handle->connection_ctx->directory_type)
+    {
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        filter = USER_FILTER_AD;
+        default_attributes = USER_ATTRIBUTES_AD;
+        break;
+    case LDAP_TYPE_OPENLDAP:
+        filter = USER_FILTER_OPENLDAP;
+        default_attributes = USER_ATTRIBUTES_OPENLDAP;
+        break;
+    default:
+        ld_error("Listing users is not implemented for directory type %d!\n",
+                 handle->connection_ctx->directory_type);
+        return RETURN_CODE_FAILURE;
+    }
+
+    char **attrs = (char**)(attributes ? attributes : default_attributes);
+
+    return search_entry_views(handle, base_dn, scope, filter, attrs, USER_LIST_PAGE_SIZE, user_from_entry,
+                              (entry_view_callback_fn)callback, user_data);
+}
+
+/*!
+ * @brief ld_get_user Reads single user and passes it to the callback as a compact ld_user_t.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] name       Name of the user.
+ * @param[in] parent     Parent dn of the user. Can be NULL than default parent will be selected.
+ * @param[in] attributes Attributes to request from the server. Can be NULL than attributes needed to fill
+ *                       ld_user_t will be requested.
+ * @param[in] callback   Callback to receive the user.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_get_user(LDHandle *handle,
+                                     const char *name,
+                                     const char *parent,
+                                     const char **attributes,
+                                     user_list_callback_fn callback,
+                                     void *user_data)
+{
+    check_handle(handle, "ld_get_user");
+
+    if (!name || !callback)
+    {
+        ld_error("ld_get_user - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *dn = talloc_asprintf(talloc_ctx, "cn=%s,%s", name,
+                                     parent ? parent : create_user_parent(talloc_ctx, handle));
+
+    int rc = user_search(handle, dn, LDAP_SCOPE_BASE, attributes, callback, user_data);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
+
+/*!
+ * @brief ld_list_users Lists users of the container using paged search and passes them to the callback
+ * as compact ld_user_t.
+ * @param[in] handle     Pointer to libdomain session handle.
+ * @param[in] parent     Container to search users in. Can be NULL than default parent will be selected.
+ * @param[in] attributes Attributes to request from the server. Can be NULL than attributes needed to fill
+ *                       ld_user_t will be requested.
+ * @param[in] callback   Callback to receive the users.
+ * @param[in] user_data  User data to pass to the callback.
+ * @return
+ *        - RETURN_CODE_SUCCESS on success.
+ *        - RETURN_CODE_FAILURE on failure.
+ */
+enum OperationReturnCode ld_list_users(LDHandle *handle,
+                                       const char *parent,
+                                       const char **attributes,
+                                       user_list_callback_fn callback,
+                                       void *user_data)
+{
+    check_handle(handle, "ld_list_users");
+
+    if (!callback)
+    {
+        ld_error("ld_list_users - invalid parameters!\n");
+        return RETURN_CODE_FAILURE;
+    }
+
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *base_dn = parent ? parent : create_user_parent(talloc_ctx, handle);
+
+    int rc = user_search(handle, base_dn, LDAP_SCOPE_SUBTREE, attributes, callback, user_data);
+
+    talloc_free(talloc_ctx);
+
+    return rc;
+}
@@ -24,6 +24,48 @@
 #include "common.h"
 #include "domain.h"
 
+/*!
+ * @brief ld_user_t - Compact view of the user entry.
+ */
+typedef struct ld_user_s
+{
+    const char *dn;                  //!< Distinguished name of the user.
+    const char *name;                //!< Common name of the user.
+    const char *login;               //!< Login of the user, sAMAccountName or uid.
+    const char *display_name;        //!< Display name of the user.
+    const char *mail;                //!< E-mail of the user.
+    bool blocked;                    //!< Account of the user is blocked.
+    LDAPAttribute_t **attributes;    //!< All attributes returned by the server, NULL terminated.
+} ld_user_t;
+
+/*!
+ * @brief user_list_callback_fn Callback which receives users. Users are released after callback returns,
+ * use talloc_steal to keep them. On failure result_code holds error returned by the server, LDAP_NO_SUCH_OBJECT
+ * if requested user does not exist, and users are NULL.
+ */
+typedef enum OperationReturnCode (*user_list_callback_fn)(LDHandle *handle, int result_code, ld_user_t **users,
+                                                          void *user_data);
+
+/*!
+ * @brief ld_user_batch_t - Columnar batch of users to create. Row i of every column belongs to names[i].
+ */
+typedef struct ld_user_batch_s
+{
+    int count;                       //!< Number of users in the batch.
+    const char **names;              //!< Names (cn) of the users, count elements.
+    int n_columns;                   //!< Number of attribute columns.
+    const char **column_names;       //!< Attribute name of every column, n_columns elements.
+    const char ***columns;           //!< Values of every column, count elements each, NULL value skips attribute.
+    int first_uid_number;            //!< uidNumber of the first user when no uidNumber column is given, OpenLDAP only.
+    int gid_number;                  //!< gidNumber of the users when no gidNumber column is given, OpenLDAP only.
+} ld_user_batch_t;
+
+/*!
+ * @brief user_batch_callback_fn Callback which is called once server answered for every user of the batch.
+ * Completed users were accepted by the server, failed users were not submitted or were rejected by the server.
+ */
+typedef void (*user_batch_callback_fn)(LDHandle *handle, int completed, int failed, void *user_data);
+
 enum OperationReturnCode ld_add_user(LDHandle *handle,
                                      const char *name,
                                      LDAPAttribute_t **user_attrs,
@@ -43,4 +85,31 @@ enum OperationReturnCode ld_block_user(LDHandle *handle,
 enum OperationReturnCode ld_unblock_user(LDHandle *handle,
                                          const char *name,
                                          const char *parent);
+enum OperationReturnCode ld_add_users(LDHandle *handle,
+                                      const ld_user_batch_t *batch,
+                                      const char *parent,
+                                      user_batch_callback_fn callback,
+                                      void *user_data);
+enum OperationReturnCode ld_block_users(LDHandle *handle,
+                                        const char **names,
+                                        const char *parent,
+                                        user_batch_callback_fn callback,
+                                        void *user_data);
+enum OperationReturnCode ld_unblock_users(LDHandle *handle,
+                                          const char **names,
+                                          const char *parent,
+                                          user_batch_callback_fn callback,
+                                          void *user_data);
+
+enum OperationReturnCode ld_get_user(LDHandle *handle,
+                                     const char *name,
+                                     const char *parent,
+                                     const char **attributes,
+                                     user_list_callback_fn callback,
+                                     void *user_data);
+enum OperationReturnCode ld_list_users(LDHandle *handle,
+                                       const char *parent,
+                                       const char **attributes,
+                                       user_list_callback_fn callback,
+                                       void *user_data);
 #endif //LIB_DOMAIN_USER_H
@@ -0,0 +1,99 @@
+#include <cgreen/cgreen.h>
+
+#include <auth_pool.h>
+#include <directory.h>
+#include <domain.h>
+#include <domain_p.h>
+#include <talloc.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+const int POOL_SIZE = 2;
+
+static verto_ctx *base = NULL;
+static int valid_result = -1;
+static int invalid_result = -1;
+static int results_received = 0;
+
+static void auth_callback(int result_code, void *user_data)
+{
+    *(int*)user_data = result_code;
+
+    if (++results_received == 2)
+    {
+        verto_break(base);
+    }
+}
+
+static void on_deadline(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ev);
+
+    verto_break(ctx);
+}
+
+Ensure(Cgreen, auth_pool_test) {
+    TALLOC_CTX* talloc_ctx = talloc_new(NULL);
+
+    int current_directory_type = get_current_directory_type(get_environment_variable(talloc_ctx, "DIRECTORY_TYPE"));
+    char *server = get_environment_variable(talloc_ctx, "LDAP_SERVER");
+
+    char *password = NULL;
+    switch (current_directory_type)
+    {
+    case LDAP_TYPE_OPENLDAP:
+        password = "password";
+        break;
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        password = "password145Qw!";
+        break;
+    default:
+        fail_test("Unknown directory type, please check environment variables!\n");
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    ld_config_t *config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                           "", "", true, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                           "", "", "");
+
+    base = verto_default(NULL, VERTO_EV_TYPE_NONE);
+
+    ld_auth_pool_t *pool = ld_auth_pool_new(talloc_ctx, config, base, POOL_SIZE);
+    assert_that(pool, is_non_null);
+
+    // Checks submitted before connections are established wait for them.
+    assert_that(ld_authenticate(pool, "cn=admin,dc=domain,dc=alt", password, auth_callback, &valid_result),
+                is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_authenticate(pool, "cn=admin,dc=domain,dc=alt", "wrong_password", auth_callback,
+                                &invalid_result),
+                is_equal_to(RETURN_CODE_SUCCESS));
+
+    // Empty password would be accepted by server as unauthenticated bind.
+    assert_that(ld_authenticate(pool, "cn=admin,dc=domain,dc=alt", "", auth_callback, NULL),
+                is_equal_to(RETURN_CODE_FAILURE));
+
+    verto_add_timeout(base, VERTO_EV_FLAG_NONE, on_deadline, 10 * CONNECTION_UPDATE_INTERVAL);
+
+    verto_run(base);
+
+    assert_that(valid_result, is_equal_to(LDAP_SUCCESS));
+    assert_that(invalid_result, is_equal_to(LDAP_INVALID_CREDENTIALS));
+    assert_that(ld_auth_pool_ready(pool), is_equal_to(POOL_SIZE));
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, auth_pool_test);
+    return run_test_suite(suite, create_text_reporter());
+}
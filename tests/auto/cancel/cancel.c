@@ -0,0 +1,178 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <entry.h>
+#include <directory.h>
+#include <request_scheduler.h>
+#include <talloc.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+char* LDAP_DIRECTORY_ATTRS[] = { "objectClass", NULL };
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+static bool cancelled_callback_called = false;
+static bool control_callback_called = false;
+
+static void connection_on_search_message(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ev);
+
+    static int callcount = 0;
+
+    if (++callcount > 10)
+    {
+        verto_break(ctx);
+    }
+}
+
+static enum OperationReturnCode cancelled_search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
+{
+    (void)(connection);
+    (void)(entries);
+    (void)(user_data);
+
+    cancelled_callback_called = true;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static enum OperationReturnCode control_search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
+{
+    (void)(entries);
+    (void)(user_data);
+
+    control_callback_called = true;
+
+    verto_break(connection->base);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    csm_next_state(connection->state_machine);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        char* search_base = current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY
+                ? "cn=users,dc=domain,dc=alt"
+                : "dc=domain,dc=alt";
+
+        search(connection, search_base, LDAP_SCOPE_SUBTREE,
+               "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, cancelled_search_callback, NULL);
+
+        int request = connection_last_request(connection);
+
+        assert_that(connection_cancel_request(connection, request), is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(connection_cancel_request(connection, request), is_equal_to(RETURN_CODE_FAILURE));
+
+        search(connection, search_base, LDAP_SCOPE_SUBTREE,
+               "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, control_search_callback, NULL);
+
+        verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, connection_on_search_message, CONNECTION_UPDATE_INTERVAL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+static void connection_on_deferred_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    csm_next_state(connection->state_machine);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        char* search_base = current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY
+                ? "cn=users,dc=domain,dc=alt"
+                : "dc=domain,dc=alt";
+
+        // Admit single bulk operation at a time, so that subsequent operations are deferred.
+        request_scheduler_set_class(connection->scheduler, REQUEST_PRIORITY_BULK, 1, 1);
+        connection_set_priority(connection, REQUEST_PRIORITY_BULK);
+
+        search(connection, search_base, LDAP_SCOPE_BASE,
+               "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, control_search_callback, NULL);
+
+        // Operation which waits for its class is dropped before it is sent.
+        search(connection, search_base, LDAP_SCOPE_SUBTREE,
+               "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, cancelled_search_callback, NULL);
+
+        int queued = connection_last_request(connection);
+        assert_that(queued, is_less_than(-1));
+
+        assert_that(connection_cancel_request(connection, queued), is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(connection_cancel_request(connection, queued), is_equal_to(RETURN_CODE_FAILURE));
+        assert_that(request_scheduler_pending(connection->scheduler, REQUEST_PRIORITY_BULK), is_equal_to(0));
+
+        // Handle of deferred operation stays valid once operation is sent.
+        search(connection, search_base, LDAP_SCOPE_SUBTREE,
+               "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, cancelled_search_callback, NULL);
+
+        int sent = connection_last_request(connection);
+        assert_that(sent, is_less_than(-1));
+        assert_that(sent, is_not_equal_to(queued));
+
+        request_scheduler_set_class(connection->scheduler, REQUEST_PRIORITY_BULK, 1, 0);
+        connection_dispatch_deferred(connection);
+
+        assert_that(request_scheduler_pending(connection->scheduler, REQUEST_PRIORITY_BULK), is_equal_to(0));
+        assert_that(connection_last_request(connection), is_equal_to(sent));
+
+        assert_that(connection_cancel_request(connection, sent), is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(connection_cancel_request(connection, sent), is_equal_to(RETURN_CODE_FAILURE));
+
+        verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, connection_on_search_message, CONNECTION_UPDATE_INTERVAL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, cancel_search_test) {
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+
+    assert_that(control_callback_called, is_equal_to(true));
+    assert_that(cancelled_callback_called, is_equal_to(false));
+}
+
+Ensure(Cgreen, cancel_deferred_search_test) {
+    start_test(connection_on_deferred_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+
+    assert_that(control_callback_called, is_equal_to(true));
+    assert_that(cancelled_callback_called, is_equal_to(false));
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, cancel_search_test);
+    add_test_with_context(suite, Cgreen, cancel_deferred_search_test);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,234 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <directory.h>
+#include <domain.h>
+#include <domain_p.h>
+#include <entry.h>
+#include <talloc.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+char* LDAP_DIRECTORY_ATTRS[] = { "objectClass", NULL };
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+const int SEARCH_COUNT = 20;
+const int RELOADED_WINDOW = 16;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+static int searches_completed = 0;
+static int searches_abandoned = 0;
+static ld_config_t *reloaded_config = NULL;
+
+static enum OperationReturnCode search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
+{
+    (void)(entries);
+    (void)(user_data);
+
+    // Last search was submitted while connection was draining and is sent over the new connection.
+    if (++searches_completed == SEARCH_COUNT + 1)
+    {
+        assert_that(connection->draining, is_equal_to(false));
+
+        verto_break(connection->base);
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void search_on_failure(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+    (void)(user_data);
+
+    assert_that(result_code, is_equal_to(LDAP_SERVER_DOWN));
+
+    ++searches_abandoned;
+}
+
+static enum OperationReturnCode search_after_restart_callback(struct ldap_connection_ctx_t *connection,
+                                                              ld_entry_t** entries, void* user_data)
+{
+    (void)(entries);
+    (void)(user_data);
+
+    ++searches_completed;
+
+    verto_break(connection->base);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static const char *search_base(void)
+{
+    return current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY
+            ? "cn=users,dc=domain,dc=alt"
+            : "dc=domain,dc=alt";
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+
+        return;
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        for (int i = 0; i < SEARCH_COUNT; ++i)
+        {
+            search(connection, search_base(), LDAP_SCOPE_SUBTREE,
+                   "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, search_callback, NULL);
+        }
+
+        // Timeouts and window are applied to the running connection.
+        *reloaded_config = *connection->handle->global_config;
+        reloaded_config->operation_timeout = 60000;
+        reloaded_config->request_window = RELOADED_WINDOW;
+
+        assert_that(ld_reload_config(connection->handle, reloaded_config), is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(connection->draining, is_equal_to(false));
+        assert_that(connection->request_window, is_equal_to(RELOADED_WINDOW));
+        assert_that(connection->config->operation_timeout, is_equal_to(60000));
+
+        // Changed bind settings make connection reconnect once outstanding searches complete.
+        reloaded_config->use_anon = !reloaded_config->use_anon;
+
+        assert_that(ld_reload_config(connection->handle, reloaded_config), is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(connection->draining, is_equal_to(true));
+
+        search(connection, search_base(), LDAP_SCOPE_SUBTREE,
+               "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, search_callback, NULL);
+    }
+}
+
+static void connection_on_timeout_abandon(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+
+        return;
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        for (int i = 0; i < SEARCH_COUNT; ++i)
+        {
+            search_ext(connection, search_base(), LDAP_SCOPE_SUBTREE,
+                       "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, search_callback, search_on_failure, NULL);
+        }
+
+        *reloaded_config = *connection->handle->global_config;
+        reloaded_config->use_anon = !reloaded_config->use_anon;
+
+        assert_that(ld_reload_config(connection->handle, reloaded_config), is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(connection->draining, is_equal_to(true));
+
+        // Connection is driven by single update event however many times configuration is reloaded.
+        verto_ev *update_event = connection->handle->update_event;
+        assert_that(update_event, is_non_null);
+        assert_that(ld_reload_config(connection->handle, reloaded_config), is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(connection->handle->update_event, is_equal_to(update_event));
+
+        // Searches which did not complete before drain deadline fail instead of being silently dropped.
+        connection->drain_deadline = 0;
+        assert_that(connection_drained(connection), is_equal_to(true));
+        assert_that(searches_abandoned, is_equal_to(SEARCH_COUNT));
+
+        search(connection, search_base(), LDAP_SCOPE_SUBTREE,
+               "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, search_after_restart_callback, NULL);
+    }
+}
+
+static LDHandle *run_test(TALLOC_CTX *talloc_ctx, verto_callback *callback)
+{
+    current_directory_type = get_current_directory_type(get_environment_variable(talloc_ctx, "DIRECTORY_TYPE"));
+    char *server = get_environment_variable(talloc_ctx, "LDAP_SERVER");
+
+    ld_config_t *config = NULL;
+    switch (current_directory_type)
+    {
+    case LDAP_TYPE_OPENLDAP:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password", true, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password145Qw!", false, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    default:
+        fail_test("Unknown directory type, please check environment variables!\n");
+        return NULL;
+    }
+
+    reloaded_config = talloc_zero(talloc_ctx, ld_config_t);
+
+    LDHandle *handle = NULL;
+    ld_init(&handle, config);
+
+    ld_install_default_handlers(handle);
+    ld_install_handler(handle, callback, CONNECTION_UPDATE_INTERVAL);
+
+    ld_exec(handle);
+
+    assert_that(csm_is_in_state(handle->connection_ctx->state_machine, LDAP_CONNECTION_STATE_RUN), is_equal_to(true));
+
+    return handle;
+}
+
+Ensure(Cgreen, config_reload_test) {
+    TALLOC_CTX* talloc_ctx = talloc_new(NULL);
+
+    LDHandle *handle = run_test(talloc_ctx, connection_on_timeout);
+
+    assert_that(searches_completed, is_equal_to(SEARCH_COUNT + 1));
+
+    ld_free(handle);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, config_reload_abandons_undrained_operations_test) {
+    TALLOC_CTX* talloc_ctx = talloc_new(NULL);
+
+    LDHandle *handle = run_test(talloc_ctx, connection_on_timeout_abandon);
+
+    assert_that(searches_abandoned, is_equal_to(SEARCH_COUNT));
+    assert_that(searches_completed, is_equal_to(1));
+
+    ld_free(handle);
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, config_reload_test);
+    add_test_with_context(suite, Cgreen, config_reload_abandons_undrained_operations_test);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,118 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <directory.h>
+#include <domain.h>
+#include <domain_p.h>
+#include <entry.h>
+#include <talloc.h>
+
+#include <poll.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+char* LDAP_DIRECTORY_ATTRS[] = { "objectClass", NULL };
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+const int64_t TEST_TIMEOUT = 30000;
+
+static bool search_completed = false;
+
+static enum OperationReturnCode search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
+{
+    (void)(connection);
+    (void)(entries);
+    (void)(user_data);
+
+    search_completed = true;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+Ensure(Cgreen, external_loop_test) {
+    TALLOC_CTX* talloc_ctx = talloc_new(NULL);
+
+    int current_directory_type = get_current_directory_type(get_environment_variable(talloc_ctx, "DIRECTORY_TYPE"));
+    char *server = get_environment_variable(talloc_ctx, "LDAP_SERVER");
+
+    ld_config_t *config = NULL;
+    switch (current_directory_type)
+    {
+    case LDAP_TYPE_OPENLDAP:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password", true, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password145Qw!", false, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    default:
+        fail_test("Unknown directory type, please check environment variables!\n");
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    LDHandle *handle = NULL;
+    ld_init(&handle, config);
+
+    bool search_started = false;
+    int64_t test_deadline = ld_now() + TEST_TIMEOUT;
+
+    while (!search_completed && ld_now() < test_deadline)
+    {
+        int64_t now = ld_now();
+        int64_t deadline = ld_get_next_deadline(handle);
+        int timeout = deadline < 0 ? CONNECTION_UPDATE_INTERVAL : (int)(deadline > now ? deadline - now : 0);
+
+        struct pollfd descriptor = { ld_get_fd(handle), POLLIN, 0 };
+        if (descriptor.fd >= 0 && (ld_get_events(handle) & VERTO_EV_FLAG_IO_READ))
+        {
+            if (poll(&descriptor, 1, timeout) > 0 && (descriptor.revents & POLLIN))
+            {
+                ld_process_io(handle, VERTO_EV_FLAG_IO_READ);
+            }
+        }
+        else
+        {
+            poll(NULL, 0, timeout);
+        }
+
+        ld_process_timers(handle, ld_now());
+
+        assert_that(handle->connection_ctx->state_machine->state, is_not_equal_to(LDAP_CONNECTION_STATE_ERROR));
+
+        if (!search_started && handle->connection_ctx->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+        {
+            const char *search_base = current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY
+                    ? "cn=users,dc=domain,dc=alt"
+                    : "dc=domain,dc=alt";
+
+            search(handle->connection_ctx, search_base, LDAP_SCOPE_SUBTREE,
+                   "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, search_callback, NULL);
+
+            search_started = true;
+        }
+    }
+
+    assert_that(search_completed, is_equal_to(true));
+
+    ld_free(handle);
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, external_loop_test);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,221 @@
+#include <cgreen/cgreen.h>
+
+#include <filter.h>
+#include <talloc.h>
+
+#include <string.h>
+
+#define number_of_elements(x)  (sizeof(x) / sizeof((x)[0]))
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+static const char* VALID_FILTERS[] =
+{
+    "(cn=Babs Jensen)",
+    "(!(cn=Tim Howes))",
+    "(&(objectClass=Person)(|(sn=Jensen)(cn=Babs J*)))",
+    "(o=univ*of*mich*)",
+    "(seeAlso=)",
+    "(cn:caseExactMatch:=Fred Flintstone)",
+    "(cn:=Betty Rubble)",
+    "(sn:dn:2.4.6.8.10:=Barney Rubble)",
+    "(o:dn:=Ace Industry)",
+    "(:1.2.3:=Wilma Flintstone)",
+    "(:DN:2.4.6.8.10:=Dino)",
+    "(o=Parens R Us \\28for all your parenthetical needs\\29)",
+    "(cn=*\\2A*)",
+    "(filename=C:\\5cMyFile)",
+    "(sn=Lu\\c4\\8di\\c4\\87)",
+    "(1.3.6.1.4.1.1466.0=\\04\\02\\48\\69)",
+    "(cn;lang-en>=A)",
+    "(uidNumber<=1000)",
+    "(cn~=Jensen)",
+    "(objectClass=*)",
+    "(&)",
+    "(|)",
+};
+static const int NUMBER_OF_VALID_FILTERS = number_of_elements(VALID_FILTERS);
+
+static const char* INVALID_FILTERS[] =
+{
+    NULL,
+    "",
+    "cn=Babs Jensen",
+    "(cn=Babs Jensen",
+    "(cn=Babs Jensen))",
+    "(cn=Babs (Jensen))",
+    "(cn=\\zz)",
+    "(cn=\\2)",
+    "(o=univ**mich)",
+    "(=value)",
+    "(1cn=value)",
+    "(cn;=value)",
+    "(:=value)",
+    "(:dn:=value)",
+    "(cn>=a*b)",
+    "(!(cn=a)(cn=b))",
+    "(!)",
+};
+static const int NUMBER_OF_INVALID_FILTERS = number_of_elements(INVALID_FILTERS);
+
+Ensure(Cgreen, filter_escape_replaces_special_characters) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    assert_that(ld_filter_escape(talloc_ctx, "plain value"), is_equal_to_string("plain value"));
+    assert_that(ld_filter_escape(talloc_ctx, "a*(b)\\c"), is_equal_to_string("a\\2a\\28b\\29\\5cc"));
+    assert_that(ld_filter_escape(talloc_ctx, ""), is_equal_to_string(""));
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_escape_value_truncates_like_snprintf) {
+    char buffer[5];
+
+    size_t length = ld_filter_escape_value("ab*cd", buffer, sizeof(buffer));
+
+    assert_that(length, is_equal_to(7));
+    assert_that(buffer, is_equal_to_string("ab\\2"));
+
+    length = ld_filter_escape_value("ab*cd", NULL, 0);
+    assert_that(length, is_equal_to(7));
+}
+
+Ensure(Cgreen, filter_validate_accepts_valid_filters) {
+    for (int i = 0; i < NUMBER_OF_VALID_FILTERS; ++i)
+    {
+        bool rc = ld_filter_validate(VALID_FILTERS[i]);
+
+        if (rc != true)
+        {
+            ld_error("filter_validate_accepts_valid_filters - failed case %s.\n", VALID_FILTERS[i]);
+        }
+
+        assert_that(rc, is_true);
+    }
+}
+
+Ensure(Cgreen, filter_validate_rejects_invalid_filters) {
+    for (int i = 0; i < NUMBER_OF_INVALID_FILTERS; ++i)
+    {
+        bool rc = ld_filter_validate(INVALID_FILTERS[i]);
+
+        if (rc != false)
+        {
+            ld_error("filter_validate_rejects_invalid_filters - failed case %s.\n", INVALID_FILTERS[i]);
+        }
+
+        assert_that(rc, is_false);
+    }
+}
+
+Ensure(Cgreen, filter_parse_builds_tree) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    ld_filter_t *filter = ld_filter_parse(talloc_ctx, "(&(objectClass=user)(cn=ab*c\\2a*d)(!(mail=*)))");
+
+    assert_that(filter, is_non_null);
+    assert_that(filter->type, is_equal_to(LD_FILTER_AND));
+    assert_that(filter->children[0]->type, is_equal_to(LD_FILTER_EQUALITY));
+    assert_that(filter->children[0]->value, is_equal_to_string("user"));
+    assert_that(filter->children[1]->type, is_equal_to(LD_FILTER_SUBSTRINGS));
+    assert_that(filter->children[1]->initial, is_equal_to_string("ab"));
+    assert_that(filter->children[1]->any[0], is_equal_to_string("c*"));
+    assert_that(filter->children[1]->any[1], is_null);
+    assert_that(filter->children[1]->final, is_equal_to_string("d"));
+    assert_that(filter->children[2]->type, is_equal_to(LD_FILTER_NOT));
+    assert_that(filter->children[2]->children[0]->type, is_equal_to(LD_FILTER_PRESENT));
+    assert_that(filter->children[3], is_null);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_to_string_round_trips) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    for (int i = 0; i < NUMBER_OF_VALID_FILTERS; ++i)
+    {
+        ld_filter_t *filter = ld_filter_parse(talloc_ctx, VALID_FILTERS[i]);
+        assert_that(filter, is_non_null);
+
+        char *string = ld_filter_to_string(talloc_ctx, filter);
+        assert_that(ld_filter_validate(string), is_true);
+
+        char *again = ld_filter_to_string(talloc_ctx, ld_filter_parse(talloc_ctx, string));
+        assert_that(again, is_equal_to_string(string));
+    }
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_builders_escape_values) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *any[] = { "(x)", NULL };
+
+    ld_filter_t *children[] =
+    {
+        ld_filter_equal(talloc_ctx, "cn", "John*"),
+        ld_filter_not(talloc_ctx, ld_filter_present(talloc_ctx, "mail")),
+        ld_filter_substrings(talloc_ctx, "sn", "a", any, NULL),
+        NULL
+    };
+
+    ld_filter_t *filter = ld_filter_and(talloc_ctx, children);
+
+    assert_that(ld_filter_to_string(talloc_ctx, filter),
+                is_equal_to_string("(&(cn=John\\2a)(!(mail=*))(sn=a*\\28x\\29*))"));
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_template_renders_escaped_values) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    ld_filter_template_t *filter_template =
+        ld_filter_template_new(talloc_ctx, "(&(objectClass=user)(|(cn=%s)(description=100%%)(mail=%s)))");
+
+    assert_that(filter_template, is_non_null);
+    assert_that(ld_filter_template_arity(filter_template), is_equal_to(2));
+
+    const char *values[] = { "a*b", "c)d" };
+    const char *expected = "(&(objectClass=user)(|(cn=a\\2ab)(description=100%)(mail=c\\29d)))";
+
+    assert_that(ld_filter_template_format(filter_template, values), is_equal_to_string(expected));
+
+    char buffer[16];
+    size_t length = ld_filter_template_render(filter_template, values, buffer, sizeof(buffer));
+    assert_that(length, is_equal_to(strlen(expected)));
+    assert_that(strncmp(buffer, expected, sizeof(buffer) - 1), is_equal_to(0));
+    assert_that(buffer[sizeof(buffer) - 1], is_equal_to('\0'));
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_template_rejects_invalid_patterns) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    assert_that(ld_filter_template_new(talloc_ctx, "(cn=%s"), is_null);
+    assert_that(ld_filter_template_new(talloc_ctx, "(cn=%d)"), is_null);
+    assert_that(ld_filter_template_new(talloc_ctx, "(%s)"), is_null);
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, filter_escape_replaces_special_characters);
+    add_test_with_context(suite, Cgreen, filter_escape_value_truncates_like_snprintf);
+    add_test_with_context(suite, Cgreen, filter_validate_accepts_valid_filters);
+    add_test_with_context(suite, Cgreen, filter_validate_rejects_invalid_filters);
+    add_test_with_context(suite, Cgreen, filter_parse_builds_tree);
+    add_test_with_context(suite, Cgreen, filter_to_string_round_trips);
+    add_test_with_context(suite, Cgreen, filter_builders_escape_values);
+    add_test_with_context(suite, Cgreen, filter_template_renders_escaped_values);
+    add_test_with_context(suite, Cgreen, filter_template_rejects_invalid_patterns);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,192 @@
+#include <cgreen/cgreen.h>
+
+#include <domain.h>
+#include <entry.h>
+#include <filter_program.h>
+#include <schema.h>
+#include <talloc.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+static void add_attribute(TALLOC_CTX *ctx, ld_entry_t *entry, const char *name, const char *first,
+                          const char *second)
+{
+    LDAPAttribute_t *attribute = talloc_zero(ctx, LDAPAttribute_t);
+    attribute->name = talloc_strdup(attribute, name);
+    attribute->values = talloc_zero_array(attribute, char*, 3);
+    attribute->values[0] = talloc_strdup(attribute, first);
+    attribute->values[1] = second ? talloc_strdup(attribute, second) : NULL;
+
+    ld_entry_add_attribute(entry, attribute);
+}
+
+static LDAPAttributeType *add_attribute_type(TALLOC_CTX *ctx, ldap_schema_t *schema, const char *name, const char *oid,
+                               const char *equality, const char *syntax)
+{
+    LDAPAttributeType *attribute_type = talloc_zero(ctx, LDAPAttributeType);
+    attribute_type->at_names = talloc_zero_array(ctx, char*, 2);
+    attribute_type->at_names[0] = talloc_strdup(ctx, name);
+    attribute_type->at_oid = talloc_strdup(ctx, oid);
+    attribute_type->at_equality_oid = equality ? talloc_strdup(ctx, equality) : NULL;
+    attribute_type->at_syntax_oid = syntax ? talloc_strdup(ctx, syntax) : NULL;
+
+    ldap_schema_append_attributetype(schema, attribute_type);
+
+    return attribute_type;
+}
+
+static ldap_schema_t *create_schema(TALLOC_CTX *ctx)
+{
+    ldap_schema_t *schema = ldap_schema_new(ctx);
+
+    add_attribute_type(ctx, schema, "cn", "2.5.4.3", "caseIgnoreMatch", NULL);
+    add_attribute_type(ctx, schema, "uid", "0.9.2342.19200300.100.1.1", "2.5.13.5", NULL);
+    add_attribute_type(ctx, schema, "uidNumber", "1.3.6.1.1.1.1.0", "integerMatch", NULL);
+    add_attribute_type(ctx, schema, "manager", "0.9.2342.19200300.100.1.10", "distinguishedNameMatch", NULL);
+    add_attribute_type(ctx, schema, "userAccountControl", "1.2.840.113556.1.4.8", NULL,
+                       "1.3.6.1.4.1.1466.115.121.1.27");
+    add_attribute_type(ctx, schema, "objectGUID", "1.2.840.113556.1.4.2", NULL, "1.3.6.1.4.1.1466.115.121.1.40");
+
+    LDAPAttributeType *ordered = add_attribute_type(ctx, schema, "serialKey", "1.3.6.1.4.1.99999.1",
+                                                    "octetStringMatch", NULL);
+    ordered->at_ordering_oid = talloc_strdup(ctx, "octetStringOrderingMatch");
+
+    return schema;
+}
+
+static ld_entry_t *create_entry(TALLOC_CTX *ctx)
+{
+    ld_entry_t *entry = ld_entry_new(ctx, "cn=John  Smith,ou=People,dc=domain,dc=alt");
+
+    add_attribute(ctx, entry, "cn", "John  Smith", NULL);
+    add_attribute(ctx, entry, "uid", "JSmith", NULL);
+    add_attribute(ctx, entry, "uidNumber", "1500", NULL);
+    add_attribute(ctx, entry, "manager", "CN=Boss, OU=People, DC=domain, DC=alt", NULL);
+    add_attribute(ctx, entry, "userAccountControl", "512", NULL);
+    add_attribute(ctx, entry, "objectGUID", "guid", NULL);
+    add_attribute(ctx, entry, "serialKey", "key", NULL);
+    add_attribute(ctx, entry, "memberOf", "cn=admins,dc=domain,dc=alt", "cn=users,dc=domain,dc=alt");
+
+    return entry;
+}
+
+static bool matches(TALLOC_CTX *ctx, ldap_schema_t *schema, ld_entry_t *entry, const char *filter)
+{
+    ld_filter_program_t *program = ld_filter_compile_string(ctx, filter, schema);
+
+    assert_that(program, is_non_null);
+
+    return ld_filter_match(program, entry);
+}
+
+Ensure(Cgreen, filter_program_uses_schema_matching_rules) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ldap_schema_t *schema = create_schema(talloc_ctx);
+    ld_entry_t *entry = create_entry(talloc_ctx);
+
+    assert_that(matches(talloc_ctx, schema, entry, "(cn=john smith)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(CN=JOHN SMITH)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(uid=JSmith)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(uid=jsmith)"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(uidNumber=01500)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(uidNumber>=1000)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(uidNumber<=999)"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(userAccountControl=512)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(manager=cn=boss,ou=people,dc=domain,dc=alt)"), is_true);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_program_evaluates_operators) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ldap_schema_t *schema = create_schema(talloc_ctx);
+    ld_entry_t *entry = create_entry(talloc_ctx);
+
+    assert_that(matches(talloc_ctx, schema, entry, "(&(objectClass=*)(cn=J*Sm*th)(!(mail=*)))"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(|(uid=other)(memberOf=cn=users,dc=domain,dc=alt))"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(&(uid=JSmith)(mail=*))"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(cn=*smith)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(cn=smith*)"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(&)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(|)"), is_false);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_program_treats_undefined_as_no_match) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ldap_schema_t *schema = create_schema(talloc_ctx);
+    ld_entry_t *entry = create_entry(talloc_ctx);
+
+    assert_that(matches(talloc_ctx, schema, entry, "(uidNumber=abc)"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(!(uidNumber=abc))"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(cn:unknownMatch:=john smith)"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(|(uidNumber=abc)(uid=JSmith))"), is_true);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_program_evaluates_extensible_match) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ldap_schema_t *schema = create_schema(talloc_ctx);
+    ld_entry_t *entry = create_entry(talloc_ctx);
+
+    assert_that(matches(talloc_ctx, schema, entry, "(uid:caseIgnoreMatch:=jsmith)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(:caseExactMatch:=JSmith)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(ou:dn:=people)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(ou:=people)"), is_false);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_program_selects_matching_entries) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ldap_schema_t *schema = create_schema(talloc_ctx);
+
+    ld_entry_t *first = create_entry(talloc_ctx);
+    ld_entry_t *second = ld_entry_new(talloc_ctx, "cn=Jane,ou=People,dc=domain,dc=alt");
+    add_attribute(talloc_ctx, second, "uidNumber", "20", NULL);
+
+    ld_entry_t *entries[] = { first, second, NULL };
+
+    ld_filter_program_t *program = ld_filter_compile_string(talloc_ctx, "(uidNumber>=100)", schema);
+    ld_entry_t **result = ld_filter_select(talloc_ctx, program, entries);
+
+    assert_that(result, is_non_null);
+    assert_that(result[0], is_equal_to(first));
+    assert_that(result[1], is_null);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, filter_program_orders_only_ordered_rules) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ldap_schema_t *schema = create_schema(talloc_ctx);
+    ld_entry_t *entry = create_entry(talloc_ctx);
+
+    // Dns and octet strings without ordering rule make ordering items undefined.
+    assert_that(matches(talloc_ctx, schema, entry, "(manager>=cn=a)"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(!(manager>=cn=a))"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(objectGUID<=zzzz)"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(!(objectGUID<=zzzz))"), is_false);
+    assert_that(matches(talloc_ctx, schema, entry, "(serialKey>=a)"), is_true);
+    assert_that(matches(talloc_ctx, schema, entry, "(serialKey<=a)"), is_false);
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, filter_program_uses_schema_matching_rules);
+    add_test_with_context(suite, Cgreen, filter_program_evaluates_operators);
+    add_test_with_context(suite, Cgreen, filter_program_treats_undefined_as_no_match);
+    add_test_with_context(suite, Cgreen, filter_program_evaluates_extensible_match);
+    add_test_with_context(suite, Cgreen, filter_program_selects_matching_entries);
+    add_test_with_context(suite, Cgreen, filter_program_orders_only_ordered_rules);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,237 @@
+#include <cgreen/cgreen.h>
+
+#include <gss_cache.h>
+#include <talloc.h>
+
+#include <gssapi/gssapi.h>
+#include <ldap.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+#define KDC_REALM "LIBDOMAIN.TEST"
+#define KDC_PORT 61088
+#define SERVICE_NAME "ldap@localhost"
+
+static char kdc_directory[] = "/tmp/libdomain-kdc-XXXXXX";
+
+static void write_text(const char *path, const char *text)
+{
+    FILE *stream = fopen(path, "w");
+    fputs(text, stream);
+    fclose(stream);
+}
+
+static bool run(TALLOC_CTX *ctx, const char *command)
+{
+    char *quiet = talloc_asprintf(ctx, "%s >>%s/setup.log 2>&1", command, kdc_directory);
+
+    return system(quiet) == 0;
+}
+
+/**
+ * @brief start_kdc Creates realm with client and LDAP service principals in temporary directory, starts MIT KDC
+ * serving it and obtains ticket granting ticket of the client.
+ */
+static bool start_kdc(TALLOC_CTX *ctx)
+{
+    if (!mkdtemp(kdc_directory))
+    {
+        return false;
+    }
+
+    char *krb5_conf = talloc_asprintf(ctx, "%s/krb5.conf", kdc_directory);
+    write_text(krb5_conf, talloc_asprintf(ctx,
+        "[libdefaults]\n"
+        "    default_realm = " KDC_REALM "\n"
+        "    dns_lookup_kdc = false\n"
+        "    dns_lookup_realm = false\n"
+        "    dns_canonicalize_hostname = false\n"
+        "    rdns = false\n"
+        "[realms]\n"
+        "    " KDC_REALM " = {\n"
+        "        kdc = 127.0.0.1:%d\n"
+        "    }\n", KDC_PORT));
+
+    char *kdc_conf = talloc_asprintf(ctx, "%s/kdc.conf", kdc_directory);
+    write_text(kdc_conf, talloc_asprintf(ctx,
+        "[kdcdefaults]\n"
+        "    kdc_listen = %d\n"
+        "    kdc_tcp_listen = %d\n"
+        "[realms]\n"
+        "    " KDC_REALM " = {\n"
+        "        database_name = %s/principal\n"
+        "        key_stash_file = %s/stash\n"
+        "    }\n"
+        "[logging]\n"
+        "    kdc = FILE:%s/kdc.log\n", KDC_PORT, KDC_PORT, kdc_directory, kdc_directory, kdc_directory));
+
+    setenv("KRB5_CONFIG", krb5_conf, 1);
+    setenv("KRB5_KDC_PROFILE", kdc_conf, 1);
+    setenv("KRB5CCNAME", talloc_asprintf(ctx, "FILE:%s/ccache", kdc_directory), 1);
+    setenv("PATH", talloc_asprintf(ctx, "%s:/usr/sbin:/usr/local/sbin", getenv("PATH")), 1);
+
+    return run(ctx, "kdb5_util -r " KDC_REALM " create -s -P master")
+        && run(ctx, "kadmin.local -r " KDC_REALM " -q 'addprinc -randkey client'")
+        && run(ctx, "kadmin.local -r " KDC_REALM " -q 'addprinc -randkey ldap/localhost'")
+        && run(ctx, talloc_asprintf(ctx, "kadmin.local -r " KDC_REALM " -q 'ktadd -k %s/client.keytab client'",
+                                    kdc_directory))
+        && run(ctx, talloc_asprintf(ctx, "krb5kdc -r " KDC_REALM " -P %s/kdc.pid", kdc_directory))
+        && run(ctx, talloc_asprintf(ctx, "kinit -k -t %s/client.keytab client@" KDC_REALM, kdc_directory));
+}
+
+static void stop_kdc(TALLOC_CTX *ctx)
+{
+    run(ctx, talloc_asprintf(ctx, "test -f %s/kdc.pid && kill $(cat %s/kdc.pid)", kdc_directory, kdc_directory));
+    run(ctx, talloc_asprintf(ctx, "rm -rf %s", kdc_directory));
+}
+
+/**
+ * @brief count_ticket_requests Counts service ticket requests KDC has served.
+ */
+static int count_ticket_requests(void)
+{
+    char path[sizeof(kdc_directory) + 16];
+    snprintf(path, sizeof(path), "%s/kdc.log", kdc_directory);
+
+    FILE *stream = fopen(path, "r");
+    if (!stream)
+    {
+        return -1;
+    }
+
+    int count = 0;
+    char line[1024];
+
+    while (fgets(line, sizeof(line), stream))
+    {
+        if (strstr(line, "TGS_REQ"))
+        {
+            ++count;
+        }
+    }
+
+    fclose(stream);
+
+    return count;
+}
+
+/**
+ * @brief establish_context Starts security context with LDAP service using credential, as GSSAPI bind does.
+ */
+static bool establish_context(void *credential)
+{
+    OM_uint32 minor = 0;
+    gss_name_t target = GSS_C_NO_NAME;
+    gss_buffer_desc name = { strlen(SERVICE_NAME), SERVICE_NAME };
+
+    if (GSS_ERROR(gss_import_name(&minor, &name, GSS_C_NT_HOSTBASED_SERVICE, &target)))
+    {
+        return false;
+    }
+
+    gss_ctx_id_t context = GSS_C_NO_CONTEXT;
+    gss_buffer_desc token = GSS_C_EMPTY_BUFFER;
+
+    OM_uint32 major = gss_init_sec_context(&minor, credential, &context, target, GSS_C_NO_OID, 0, 0,
+                                           GSS_C_NO_CHANNEL_BINDINGS, GSS_C_NO_BUFFER, NULL, &token, NULL, NULL);
+
+    gss_release_buffer(&minor, &token);
+    gss_delete_sec_context(&minor, &context, GSS_C_NO_BUFFER);
+    gss_release_name(&minor, &target);
+
+    return !GSS_ERROR(major);
+}
+
+Ensure(Cgreen, gss_cache_shares_credential_between_handles) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    gss_cache_t *first = gss_cache_new(talloc_ctx);
+    gss_cache_t *second = gss_cache_new(talloc_ctx);
+
+    void *credential = gss_cache_credential(first);
+    assert_that(credential, is_non_null);
+    assert_that(gss_cache_credential(first), is_equal_to(credential));
+    assert_that(gss_cache_credential(second), is_equal_to(credential));
+
+    assert_that(establish_context(gss_cache_credential(first)), is_true);
+
+    int requests = count_ticket_requests();
+    assert_that(requests, is_greater_than(0));
+
+    // Service ticket obtained by the first handle is reused on reconnects and by other handles.
+    assert_that(establish_context(gss_cache_credential(first)), is_true);
+    assert_that(establish_context(gss_cache_credential(second)), is_true);
+    assert_that(count_ticket_requests(), is_equal_to(requests));
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, gss_cache_reacquires_forgotten_credential) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    gss_cache_t *first = gss_cache_new(talloc_ctx);
+    gss_cache_t *second = gss_cache_new(talloc_ctx);
+
+    void *credential = gss_cache_credential(first);
+    assert_that(gss_cache_credential(second), is_equal_to(credential));
+
+    gss_cache_forget_credential(first);
+
+    void *acquired = gss_cache_credential(first);
+    assert_that(acquired, is_non_null);
+    assert_that(acquired, is_not_equal_to(credential));
+    assert_that(gss_cache_credential(second), is_equal_to(acquired));
+    assert_that(establish_context(acquired), is_true);
+
+    // Credential outlives cache which acquired it while other handles use it.
+    talloc_free(first);
+    assert_that(gss_cache_credential(second), is_equal_to(acquired));
+    assert_that(establish_context(acquired), is_true);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, gss_cache_fails_without_tickets) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    setenv("KRB5CCNAME", talloc_asprintf(talloc_ctx, "FILE:%s/missing", kdc_directory), 1);
+
+    LDAP *ldap = NULL;
+    assert_that(ldap_initialize(&ldap, "ldap://localhost"), is_equal_to(LDAP_SUCCESS));
+
+    gss_cache_t *cache = gss_cache_new(talloc_ctx);
+    assert_that(gss_cache_credential(cache), is_null);
+    assert_that(gss_cache_apply(cache, ldap), is_equal_to(RETURN_CODE_FAILURE));
+
+    ldap_unbind_ext(ldap, NULL, NULL);
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, gss_cache_fails_without_tickets);
+    if (start_kdc(talloc_ctx))
+    {
+        add_test_with_context(suite, Cgreen, gss_cache_shares_credential_between_handles);
+        add_test_with_context(suite, Cgreen, gss_cache_reacquires_forgotten_credential);
+    }
+    else
+    {
+        fprintf(stderr, "MIT KDC is not available, skipping tests which require it.\n");
+    }
+    int result = run_test_suite(suite, create_text_reporter());
+    stop_kdc(talloc_ctx);
+    talloc_free(talloc_ctx);
+    return result;
+}
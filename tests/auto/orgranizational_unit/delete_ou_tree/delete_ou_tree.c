@@ -0,0 +1,153 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <directory.h>
+#include <domain.h>
+#include <organizational_unit.h>
+#include <root_dse.h>
+#include <talloc.h>
+
+#include <connection_state_machine.h>
+
+#include <test_common.h>
+
+#include "../ou_tree_fixture.h"
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+#define LDAP_CONTROL_TREE_DELETE_OID "1.2.840.113556.1.4.805"
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+static bool force_enumeration = false;
+static bool missing_tree = false;
+static int expected_processed = 0;
+static int expected_failed = 0;
+static bool tree_deleted = false;
+
+static void delete_tree_callback(LDHandle *handle, int processed, int failed, void *user_data)
+{
+    (void)(handle);
+    (void)(user_data);
+
+    // Tree Delete control removes whole subtree with one request, enumeration deletes every entry.
+    // Subtree which can't be enumerated is reported as single failed entry.
+    assert_that(processed, is_equal_to(expected_processed));
+    assert_that(failed, is_equal_to(expected_failed));
+
+    tree_deleted = true;
+}
+
+static void connection_on_delete_message(verto_ctx *ctx, verto_ev *ev)
+{
+    static int callcount = 0;
+
+    ++callcount;
+
+    if (callcount == 2)
+    {
+        // Tree is populated during previous iteration.
+        struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+        bool tree_delete_supported = connection->root_dse
+                && root_dse_supports_control(connection->root_dse, LDAP_CONTROL_TREE_DELETE_OID);
+
+        if (current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY)
+        {
+            assert_that(tree_delete_supported, is_equal_to(true));
+        }
+
+        expected_processed = tree_delete_supported && !force_enumeration ? 1 : OU_TREE_FIXTURE_SIZE;
+        expected_failed = 0;
+
+        if (missing_tree)
+        {
+            expected_processed = 0;
+            expected_failed = 1;
+        }
+
+        // Server capabilities are hidden so subtree is enumerated and deleted entry by entry.
+        ld_root_dse_t *root_dse = connection->root_dse;
+        if (force_enumeration)
+        {
+            connection->root_dse = NULL;
+        }
+
+        enum OperationReturnCode rc = ld_del_ou_tree(connection->handle,
+                                                     missing_tree ? "test_ou_tree_missing" : "test_ou_tree",
+                                                     OU_TREE_FIXTURE_PARENT, delete_tree_callback, NULL);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        connection->root_dse = root_dse;
+    }
+
+    if (tree_deleted || callcount > 10)
+    {
+        assert_that(tree_deleted, is_equal_to(true));
+
+        verto_break(ctx);
+    }
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        if (!missing_tree)
+        {
+            ou_tree_fixture_create(connection->handle, "test_ou_tree");
+        }
+
+        verto_ev *delete_event = verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, connection_on_delete_message,
+                                                   CONNECTION_UPDATE_INTERVAL);
+        verto_set_private(delete_event, connection, NULL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, ou_tree_delete_test)
+{
+    force_enumeration = false;
+
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+Ensure(Cgreen, ou_tree_delete_enumerated_test)
+{
+    force_enumeration = true;
+
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+Ensure(Cgreen, ou_tree_delete_missing_test)
+{
+    force_enumeration = true;
+    missing_tree = true;
+
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, ou_tree_delete_test);
+    add_test_with_context(suite, Cgreen, ou_tree_delete_enumerated_test);
+    add_test_with_context(suite, Cgreen, ou_tree_delete_missing_test);
+    return run_test_suite(suite, create_text_reporter());
+}
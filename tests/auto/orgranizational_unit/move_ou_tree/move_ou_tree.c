@@ -0,0 +1,201 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <directory.h>
+#include <domain.h>
+#include <organizational_unit.h>
+#include <root_dse.h>
+#include <subtree.h>
+#include <talloc.h>
+
+#include <connection_state_machine.h>
+
+#include <test_common.h>
+
+#include "../ou_tree_fixture.h"
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+#define MOVE_TARGET_DN "ou=test_ou_move_target," OU_TREE_FIXTURE_PARENT
+#define MOVED_CHILD_DN "ou=test_ou_move_source_child,ou=test_ou_move_source," MOVE_TARGET_DN
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+static bool force_copy = false;
+static bool missing_source = false;
+static bool tree_deleted = false;
+
+static void delete_tree_callback(LDHandle *handle, int processed, int failed, void *user_data)
+{
+    (void)(handle);
+    (void)(user_data);
+
+    assert_that(processed, is_greater_than(0));
+    assert_that(failed, is_equal_to(0));
+
+    tree_deleted = true;
+}
+
+static enum OperationReturnCode source_ou_callback(LDHandle *handle, int result_code, ld_ou_t **ous, void *user_data)
+{
+    (void)(user_data);
+
+    // Original subtree is removed once it was moved.
+    assert_that(result_code, is_equal_to(LDAP_NO_SUCH_OBJECT));
+    assert_that(ous, is_null);
+
+    enum OperationReturnCode rc = ld_del_ou_tree(handle, "test_ou_move_target", OU_TREE_FIXTURE_PARENT,
+                                                 delete_tree_callback, NULL);
+    assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static enum OperationReturnCode moved_ou_callback(LDHandle *handle, int result_code, ld_ou_t **ous, void *user_data)
+{
+    (void)(user_data);
+
+    // Deepest entry keeps its position below the root of the subtree.
+    assert_that(result_code, is_equal_to(LDAP_SUCCESS));
+    assert_that(ous, is_non_null);
+    assert_that(ous[0], is_non_null);
+
+    enum OperationReturnCode rc = ld_get_ou(handle, "test_ou_move_source", OU_TREE_FIXTURE_PARENT, NULL,
+                                            source_ou_callback, NULL);
+    assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void move_tree_callback(LDHandle *handle, int processed, int failed, void *user_data)
+{
+    (void)(user_data);
+
+    if (missing_source)
+    {
+        // Source which can't be enumerated is reported as single failed entry, target is left empty.
+        assert_that(processed, is_equal_to(0));
+        assert_that(failed, is_equal_to(1));
+
+        enum OperationReturnCode rc = ld_del_ou_tree(handle, "test_ou_move_target", OU_TREE_FIXTURE_PARENT,
+                                                     delete_tree_callback, NULL);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        return;
+    }
+
+    // Parents sharing naming context are moved with single ModDN request, otherwise every entry is copied.
+    assert_that(processed, is_equal_to(force_copy ? OU_TREE_FIXTURE_SIZE : 1));
+    assert_that(failed, is_equal_to(0));
+
+    enum OperationReturnCode rc = ld_get_ou(handle, "test_ou_move_source_grandchild", MOVED_CHILD_DN, NULL,
+                                            moved_ou_callback, NULL);
+    assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+}
+
+static void connection_on_move_message(verto_ctx *ctx, verto_ev *ev)
+{
+    static int callcount = 0;
+
+    ++callcount;
+
+    if (callcount == 2)
+    {
+        // Tree is populated during previous iteration.
+        struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+        // Target is advertised as separate naming context so subtree is copied and original is deleted.
+        char *naming_contexts[] = { OU_TREE_FIXTURE_PARENT, MOVE_TARGET_DN, NULL };
+        ld_root_dse_t copy_root_dse = { .naming_contexts = naming_contexts };
+
+        ld_root_dse_t *root_dse = connection->root_dse;
+        if (force_copy)
+        {
+            connection->root_dse = &copy_root_dse;
+        }
+
+        // Source is spelled differently from the server, so dns of copies must be built from server's spelling.
+        enum OperationReturnCode rc = ld_move_tree(connection->handle,
+                                                   missing_source
+                                                       ? "ou=test_ou_move_missing," OU_TREE_FIXTURE_PARENT
+                                                       : force_copy
+                                                           ? "OU=test_ou_move_source,DC=domain,DC=alt"
+                                                           : "ou=test_ou_move_source," OU_TREE_FIXTURE_PARENT,
+                                                   MOVE_TARGET_DN,
+                                                   move_tree_callback, NULL);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        connection->root_dse = root_dse;
+    }
+
+    if (tree_deleted || callcount > 10)
+    {
+        assert_that(tree_deleted, is_equal_to(true));
+
+        verto_break(ctx);
+    }
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        if (!missing_source)
+        {
+            ou_tree_fixture_create(connection->handle, "test_ou_move_source");
+        }
+        ou_tree_fixture_add_ou(connection->handle, "test_ou_move_target", OU_TREE_FIXTURE_PARENT);
+
+        verto_ev *move_event = verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, connection_on_move_message,
+                                                 CONNECTION_UPDATE_INTERVAL);
+        verto_set_private(move_event, connection, NULL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, ou_tree_move_test)
+{
+    force_copy = false;
+
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+Ensure(Cgreen, ou_tree_copy_test)
+{
+    force_copy = true;
+
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+Ensure(Cgreen, ou_tree_copy_missing_test)
+{
+    force_copy = true;
+    missing_source = true;
+
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, ou_tree_move_test);
+    add_test_with_context(suite, Cgreen, ou_tree_copy_test);
+    add_test_with_context(suite, Cgreen, ou_tree_copy_missing_test);
+    return run_test_suite(suite, create_text_reporter());
+}
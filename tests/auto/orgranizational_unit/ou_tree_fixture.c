@@ -0,0 +1,49 @@
+#include "ou_tree_fixture.h"
+
+#include <cgreen/cgreen.h>
+
+#include <organizational_unit.h>
+#include <talloc.h>
+
+static char* OU_OBJECTCLASS[] = { "top", "organizationalUnit", NULL };
+
+/**
+ * @brief ou_tree_fixture_add_ou Adds OU with given name under parent.
+ */
+void ou_tree_fixture_add_ou(LDHandle *handle, const char *name, const char *parent)
+{
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    char **ou = talloc_array(talloc_ctx, char*, 2);
+    ou[0] = talloc_strdup(ou, name);
+    ou[1] = NULL;
+
+    LDAPAttribute_t objectclass_attribute = { .name = "objectClass", .values = OU_OBJECTCLASS };
+    LDAPAttribute_t ou_attribute = { .name = "ou", .values = ou };
+    LDAPAttribute_t *attributes[] = { &objectclass_attribute, &ou_attribute, NULL };
+
+    enum OperationReturnCode rc = ld_add_ou(handle, name, attributes, parent);
+    assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+    talloc_free(talloc_ctx);
+}
+
+/**
+ * @brief ou_tree_fixture_create Creates tree of OU_TREE_FIXTURE_SIZE OUs: root under OU_TREE_FIXTURE_PARENT,
+ * root_child under root and root_grandchild under root_child.
+ */
+void ou_tree_fixture_create(LDHandle *handle, const char *root)
+{
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    const char *child = talloc_asprintf(talloc_ctx, "%s_child", root);
+    const char *grandchild = talloc_asprintf(talloc_ctx, "%s_grandchild", root);
+    const char *root_dn = talloc_asprintf(talloc_ctx, "ou=%s,%s", root, OU_TREE_FIXTURE_PARENT);
+    const char *child_dn = talloc_asprintf(talloc_ctx, "ou=%s,%s", child, root_dn);
+
+    ou_tree_fixture_add_ou(handle, root, OU_TREE_FIXTURE_PARENT);
+    ou_tree_fixture_add_ou(handle, child, root_dn);
+    ou_tree_fixture_add_ou(handle, grandchild, child_dn);
+
+    talloc_free(talloc_ctx);
+}
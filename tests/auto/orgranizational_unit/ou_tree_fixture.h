@@ -0,0 +1,13 @@
+#ifndef OU_TREE_FIXTURE_H
+#define OU_TREE_FIXTURE_H
+
+#include <domain.h>
+
+#define OU_TREE_FIXTURE_PARENT "dc=domain,dc=alt"
+#define OU_TREE_FIXTURE_SIZE 3
+
+void ou_tree_fixture_add_ou(LDHandle *handle, const char *name, const char *parent);
+
+void ou_tree_fixture_create(LDHandle *handle, const char *root);
+
+#endif//OU_TREE_FIXTURE_H
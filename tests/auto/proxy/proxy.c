@@ -0,0 +1,218 @@
+#include <cgreen/cgreen.h>
+
+#include <domain.h>
+#include <entry.h>
+#include <proxy.h>
+#include <talloc.h>
+
+#include <ldap.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+static proxy_request_t *decode_message(TALLOC_CTX *ctx, BerElement *message)
+{
+    struct berval *encoded = NULL;
+    ber_flatten(message, &encoded);
+    ber_free(message, 1);
+
+    // Server reads messages with ber_get_next, which leaves element positioned after envelope tag and length.
+    BerElement *ber = ber_init(encoded);
+    ber_len_t length = 0;
+    ber_skip_tag(ber, &length);
+
+    proxy_request_t *request = proxy_protocol_decode(ctx, ber);
+
+    ber_free(ber, 1);
+    ber_bvfree(encoded);
+
+    return request;
+}
+
+static proxy_request_t *decode_filter(TALLOC_CTX *ctx, const char *format, const char *type, const char *value)
+{
+    BerElement *message = ber_alloc_t(LBER_USE_DER);
+    ber_printf(message, "{it{seeiib", 1, (ber_tag_t)LDAP_REQ_SEARCH, "dc=domain,dc=alt", LDAP_SCOPE_SUBTREE,
+               LDAP_DEREF_NEVER, 0, 0, 0);
+    ber_printf(message, format, (ber_tag_t)LDAP_FILTER_EQUALITY, type, value);
+    ber_printf(message, "{}}}");
+
+    return decode_message(ctx, message);
+}
+
+static ld_entry_t *create_entry(TALLOC_CTX *ctx, const char *dn, const char *name, const char *value)
+{
+    ld_entry_t *entry = ld_entry_new(ctx, dn);
+
+    if (name)
+    {
+        LDAPAttribute_t *attribute = talloc_zero(entry, LDAPAttribute_t);
+        attribute->name = talloc_strdup(attribute, name);
+        attribute->values = talloc_zero_array(attribute, char*, 2);
+        attribute->values[0] = talloc_strdup(attribute, value);
+
+        ld_entry_add_attribute(entry, attribute);
+    }
+
+    return entry;
+}
+
+static proxy_result_t *create_result(TALLOC_CTX *ctx, const char *dn)
+{
+    ld_entry_t *entries[] = { create_entry(ctx, dn, "cn", "value"), NULL };
+
+    return proxy_protocol_encode_entries(ctx, entries, 1, false);
+}
+
+static char *create_key(TALLOC_CTX *ctx, const char *base, const char *filter)
+{
+    proxy_search_t search = { .base = (char *)base, .scope = LDAP_SCOPE_SUBTREE, .filter = (char *)filter };
+
+    return proxy_cache_key(ctx, &search);
+}
+
+Ensure(Cgreen, proxy_decodes_search_request) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    BerElement *message = ber_alloc_t(LBER_USE_DER);
+    ber_printf(message, "{it{seeiib", 42, (ber_tag_t)LDAP_REQ_SEARCH, "ou=People,dc=domain,dc=alt",
+               LDAP_SCOPE_ONELEVEL, LDAP_DEREF_NEVER, 10, 0, 0);
+    ber_printf(message, "t{", (ber_tag_t)LDAP_FILTER_AND);
+    ber_printf(message, "t{ss}", (ber_tag_t)LDAP_FILTER_EQUALITY, "objectClass", "person");
+    ber_printf(message, "t{s{tsts}}", (ber_tag_t)LDAP_FILTER_SUBSTRINGS, "cn",
+               (ber_tag_t)LDAP_SUBSTRING_INITIAL, "a", (ber_tag_t)LDAP_SUBSTRING_ANY, "b");
+    ber_printf(message, "t{ts}", (ber_tag_t)LDAP_FILTER_NOT, (ber_tag_t)LDAP_FILTER_PRESENT, "mail");
+    ber_printf(message, "}{ss}}}", "cn", "description");
+
+    proxy_request_t *request = decode_message(talloc_ctx, message);
+
+    assert_that(request, is_non_null);
+    assert_that(request->msgid, is_equal_to(42));
+    assert_that(request->operation, is_equal_to(LDAP_REQ_SEARCH));
+    assert_that(request->search->base, is_equal_to_string("ou=People,dc=domain,dc=alt"));
+    assert_that(request->search->scope, is_equal_to(LDAP_SCOPE_ONELEVEL));
+    assert_that(request->search->size_limit, is_equal_to(10));
+    assert_that(request->search->filter, is_equal_to_string("(&(objectClass=person)(cn=a*b*)(!(mail=*)))"));
+    assert_that(request->search->attributes[0], is_equal_to_string("cn"));
+    assert_that(request->search->attributes[1], is_equal_to_string("description"));
+    assert_that(request->search->attributes[2], is_null);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, proxy_escapes_and_validates_filters) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    proxy_request_t *request = decode_filter(talloc_ctx, "t{ss}", "cn", "a*(b)\\");
+    assert_that(request, is_non_null);
+    assert_that(request->search->filter, is_equal_to_string("(cn=a\\2a\\28b\\29\\5c)"));
+
+    assert_that(decode_filter(talloc_ctx, "t{ss}", "c)(n", "value"), is_null);
+    assert_that(decode_filter(talloc_ctx, "t{s}", "cn", NULL), is_null);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, proxy_encodes_entries_into_messages) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    ld_entry_t *entries[] =
+    {
+        create_entry(talloc_ctx, "cn=alice,dc=domain,dc=alt", "cn", "alice"),
+        create_entry(talloc_ctx, "ldap://other.domain.alt/dc=other,dc=alt", NULL, NULL),
+        create_entry(talloc_ctx, "", NULL, NULL),
+        NULL
+    };
+
+    proxy_result_t *result = proxy_protocol_encode_entries(talloc_ctx, entries, 3, false);
+    assert_that(result, is_non_null);
+    assert_that(result->n_entries, is_equal_to(1));
+
+    // Message id 200 has high bit set and needs leading zero octet to stay positive.
+    struct berval *message = proxy_protocol_message(talloc_ctx, 200, &result->entries[0]);
+    assert_that(message, is_non_null);
+
+    BerElement *ber = ber_init(message);
+    ber_int_t msgid = 0;
+    char *dn = NULL, *name = NULL, *value = NULL;
+    ber_len_t length = 0;
+
+    assert_that(ber_scanf(ber, "{i", &msgid), is_not_equal_to(LBER_ERROR));
+    assert_that(msgid, is_equal_to(200));
+    assert_that(ber_peek_tag(ber, &length), is_equal_to(LDAP_RES_SEARCH_ENTRY));
+    assert_that(ber_scanf(ber, "{a{{a[a]}}}}", &dn, &name, &value), is_not_equal_to(LBER_ERROR));
+    assert_that(dn, is_equal_to_string("cn=alice,dc=domain,dc=alt"));
+    assert_that(name, is_equal_to_string("cn"));
+    assert_that(value, is_equal_to_string("alice"));
+
+    ber_memfree(dn);
+    ber_memfree(name);
+    ber_memfree(value);
+    ber_free(ber, 1);
+
+    struct berval *done = proxy_protocol_result(talloc_ctx, 7, LDAP_RES_SEARCH_RESULT, LDAP_BUSY, "busy");
+    assert_that(done, is_non_null);
+
+    ber = ber_init(done);
+    ber_int_t code = 0;
+    assert_that(ber_scanf(ber, "{i", &msgid), is_not_equal_to(LBER_ERROR));
+    assert_that(ber_peek_tag(ber, &length), is_equal_to(LDAP_RES_SEARCH_RESULT));
+    assert_that(ber_scanf(ber, "{e", &code), is_not_equal_to(LBER_ERROR));
+    assert_that(msgid, is_equal_to(7));
+    assert_that(code, is_equal_to(LDAP_BUSY));
+    ber_free(ber, 1);
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, proxy_cache_expires_and_evicts_results) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    proxy_cache_t *cache = proxy_cache_new(talloc_ctx, 2, 1000);
+
+    char *first = create_key(talloc_ctx, "DC=Domain, DC=Alt", "(cn=first)");
+    char *second = create_key(talloc_ctx, "dc=domain,dc=alt", "(cn=second)");
+    char *third = create_key(talloc_ctx, "dc=domain,dc=alt", "(cn=third)");
+
+    assert_that(first, is_equal_to_string(create_key(talloc_ctx, "dc=domain,dc=alt", "(cn=first)")));
+    assert_that(first, is_not_equal_to_string(second));
+
+    proxy_cache_put(cache, first, create_result(talloc_ctx, "cn=first,dc=domain,dc=alt"), 0);
+    proxy_cache_put(cache, second, create_result(talloc_ctx, "cn=second,dc=domain,dc=alt"), 0);
+
+    const proxy_result_t *result = proxy_cache_get(cache, first, 500);
+    assert_that(result, is_non_null);
+    assert_that(result->n_entries, is_equal_to(1));
+
+    // First result was used recently, so second one is evicted.
+    proxy_cache_put(cache, third, create_result(talloc_ctx, "cn=third,dc=domain,dc=alt"), 500);
+    assert_that(proxy_cache_size(cache), is_equal_to(2));
+    assert_that(proxy_cache_get(cache, second, 500), is_null);
+    assert_that(proxy_cache_get(cache, first, 500), is_non_null);
+
+    assert_that(proxy_cache_get(cache, first, 1000), is_null);
+    assert_that(proxy_cache_get(cache, third, 1000), is_non_null);
+    assert_that(proxy_cache_size(cache), is_equal_to(1));
+
+    proxy_cache_clear(cache);
+    assert_that(proxy_cache_size(cache), is_equal_to(0));
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, proxy_decodes_search_request);
+    add_test_with_context(suite, Cgreen, proxy_escapes_and_validates_filters);
+    add_test_with_context(suite, Cgreen, proxy_encodes_entries_into_messages);
+    add_test_with_context(suite, Cgreen, proxy_cache_expires_and_evicts_results);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,257 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <directory.h>
+#include <domain.h>
+#include <entry.h>
+#include <request_scheduler.h>
+#include <user.h>
+#include <string.h>
+#include <talloc.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+#define PROXIED_IDENTITY "dn:cn=proxied_identity,dc=domain,dc=alt"
+
+#define OPERATION_COUNT 3
+
+static const char *OU_DNS[OPERATION_COUNT] = {
+    "ou=proxied_authorization_submitted,dc=domain,dc=alt",
+    "ou=proxied_authorization_deferred,dc=domain,dc=alt",
+    "ou=proxied_authorization_admin,dc=domain,dc=alt",
+};
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+static int results[OPERATION_COUNT] = { -1, -1, -1 };
+static int completed = 0;
+static int delete_result = -1;
+
+static void check_request_controls(struct ldap_connection_ctx_t *connection)
+{
+    LDAPControl *request_controls[CONNECTION_MAX_CONTROLS];
+
+    assert_that(connection_request_controls(connection, NULL, request_controls), is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(request_controls[0], is_equal_to(NULL));
+
+    assert_that(connection_set_proxy_authorization(connection, PROXIED_IDENTITY), is_equal_to(RETURN_CODE_SUCCESS));
+
+    LDAPControl *manage_dsa_it = NULL;
+    assert_that(ldap_control_create(LDAP_CONTROL_MANAGEDSAIT, 0, NULL, 1, &manage_dsa_it), is_equal_to(LDAP_SUCCESS));
+    LDAPControl *controls[] = { manage_dsa_it, NULL };
+
+    assert_that(connection_request_controls(connection, controls, request_controls), is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(request_controls[0], is_equal_to(manage_dsa_it));
+    assert_that(request_controls[1], is_not_equal_to(NULL));
+    assert_that(request_controls[1]->ldctl_oid, is_equal_to_string(LDAP_CONTROL_PROXY_AUTHZ));
+    assert_that(request_controls[1]->ldctl_iscritical, is_true);
+    assert_that(request_controls[1]->ldctl_value.bv_len, is_equal_to(strlen(PROXIED_IDENTITY)));
+    assert_that(request_controls[1]->ldctl_value.bv_val, is_equal_to_contents_of(PROXIED_IDENTITY,
+                                                                                strlen(PROXIED_IDENTITY)));
+    assert_that(request_controls[2], is_equal_to(NULL));
+
+    ldap_control_free(manage_dsa_it);
+
+    assert_that(connection_set_proxy_authorization(connection, NULL), is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(connection_request_controls(connection, NULL, request_controls), is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(request_controls[0], is_equal_to(NULL));
+}
+
+static void on_delete(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(user_data);
+
+    delete_result = result_code;
+
+    verto_break(connection->base);
+}
+
+static void on_add(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    int *result = user_data;
+
+    *result = result_code;
+
+    if (++completed < OPERATION_COUNT)
+    {
+        return;
+    }
+
+    if (results[OPERATION_COUNT - 1] != LDAP_SUCCESS
+        || delete_ext(connection, OU_DNS[OPERATION_COUNT - 1], NULL, on_delete, NULL) != RETURN_CODE_SUCCESS)
+    {
+        verto_break(connection->base);
+    }
+}
+
+static void add_ou(struct ldap_connection_ctx_t *connection, int index)
+{
+    char *object_class_values[] = { "top", "organizationalUnit", NULL };
+    char *ou_values[] = { "proxied_authorization", NULL };
+
+    LDAPMod object_class = { .mod_op = LDAP_MOD_ADD, .mod_type = "objectClass",
+                             .mod_values = object_class_values };
+    LDAPMod ou = { .mod_op = LDAP_MOD_ADD, .mod_type = "ou", .mod_values = ou_values };
+    LDAPMod *attrs[] = { &object_class, &ou, NULL };
+
+    assert_that(add_ext(connection, OU_DNS[index], attrs, NULL, on_add, &results[index]),
+                is_equal_to(RETURN_CODE_SUCCESS));
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    csm_next_state(connection->state_machine);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        check_request_controls(connection);
+
+        if (current_directory_type != LDAP_TYPE_OPENLDAP)
+        {
+            // Active Directory does not support Proxied Authorization control.
+            verto_break(ctx);
+            return;
+        }
+
+        // Admit single bulk operation at a time, so that subsequent operations are deferred.
+        assert_that(request_scheduler_set_class(connection->scheduler, REQUEST_PRIORITY_BULK, 1, 1),
+                    is_equal_to(OPERATION_SUCCESS));
+        assert_that(connection_set_priority(connection, REQUEST_PRIORITY_BULK), is_equal_to(RETURN_CODE_SUCCESS));
+
+        assert_that(connection_set_proxy_authorization(connection, PROXIED_IDENTITY),
+                    is_equal_to(RETURN_CODE_SUCCESS));
+        add_ou(connection, 0);
+
+        assert_that(connection_should_defer(connection), is_true);
+        add_ou(connection, 1);
+
+        // Deferred operation keeps identity it was submitted with.
+        assert_that(connection_set_proxy_authorization(connection, NULL), is_equal_to(RETURN_CODE_SUCCESS));
+        add_ou(connection, 2);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+#define BATCH_SIZE 3
+
+static const char *BATCH_USER_NAMES[BATCH_SIZE] =
+{
+    "test_proxied_batch_user_1", "test_proxied_batch_user_2", "test_proxied_batch_user_3"
+};
+
+// Batch is read until callback is called, so it must outlive the handler which submits it.
+static ld_user_batch_t batch;
+
+static int batch_completed = -1;
+static int batch_failed = -1;
+
+static void add_users_callback(LDHandle *handle, int completed, int failed, void *user_data)
+{
+    (void)(handle);
+
+    struct ldap_connection_ctx_t *connection = user_data;
+
+    batch_completed = completed;
+    batch_failed = failed;
+
+    verto_break(connection->base);
+}
+
+static void connection_on_batch_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    csm_next_state(connection->state_machine);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        if (current_directory_type != LDAP_TYPE_OPENLDAP)
+        {
+            // Active Directory does not support Proxied Authorization control.
+            verto_break(ctx);
+            return;
+        }
+
+        // Single operation in flight, so that batch is resumed once identity of the connection was changed.
+        ld_set_request_window(connection->handle, 1, false);
+
+        batch.count = BATCH_SIZE;
+        batch.names = BATCH_USER_NAMES;
+        batch.first_uid_number = 21000;
+        batch.gid_number = 21000;
+
+        assert_that(connection_set_proxy_authorization(connection, PROXIED_IDENTITY),
+                    is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(ld_add_users(connection->handle, &batch, NULL, add_users_callback, connection),
+                    is_equal_to(RETURN_CODE_SUCCESS));
+
+        // Rest of the batch keeps identity batch was started with.
+        assert_that(connection_set_proxy_authorization(connection, NULL), is_equal_to(RETURN_CODE_SUCCESS));
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, proxy_authorization_test) {
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+
+    if (current_directory_type != LDAP_TYPE_OPENLDAP)
+    {
+        return;
+    }
+
+    assert_that(completed, is_equal_to(OPERATION_COUNT));
+
+    // Proxied identity has read only access to the directory.
+    assert_that(results[0], is_equal_to(LDAP_INSUFFICIENT_ACCESS));
+    assert_that(results[1], is_equal_to(LDAP_INSUFFICIENT_ACCESS));
+    assert_that(results[2], is_equal_to(LDAP_SUCCESS));
+    assert_that(delete_result, is_equal_to(LDAP_SUCCESS));
+}
+
+Ensure(Cgreen, proxy_authorization_batch_test) {
+    start_test(connection_on_batch_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+
+    if (current_directory_type != LDAP_TYPE_OPENLDAP)
+    {
+        return;
+    }
+
+    // Proxied identity has read only access to the directory, so none of the users is created.
+    assert_that(batch_completed, is_equal_to(0));
+    assert_that(batch_failed, is_equal_to(BATCH_SIZE));
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, proxy_authorization_test);
+    add_test_with_context(suite, Cgreen, proxy_authorization_batch_test);
+    return run_test_suite(suite, create_text_reporter());
+}
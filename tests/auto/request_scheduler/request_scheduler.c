@@ -0,0 +1,138 @@
+#include <cgreen/cgreen.h>
+
+#include <talloc.h>
+#include <request_scheduler.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+static enum OperationReturnCode empty_dispatch(void *connection, void *operation)
+{
+    (void)(connection);
+    (void)(operation);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+Ensure(Cgreen, request_scheduler_submits_interactive_immediately) {
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    request_scheduler *scheduler = request_scheduler_new(ctx);
+
+    assert_that(request_scheduler_can_submit(scheduler, REQUEST_PRIORITY_INTERACTIVE), is_equal_to(true));
+    assert_that(request_scheduler_next(scheduler), is_equal_to(NULL));
+
+    talloc_free(ctx);
+}
+
+Ensure(Cgreen, request_scheduler_rejects_invalid_class) {
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    request_scheduler *scheduler = request_scheduler_new(ctx);
+
+    assert_that(request_scheduler_set_class(scheduler, REQUEST_PRIORITY_COUNT, 1, 1),
+                is_equal_to(OPERATION_ERROR_INVALID_PARAMETER));
+    assert_that(request_scheduler_set_class(scheduler, REQUEST_PRIORITY_BULK, 0, 1),
+                is_equal_to(OPERATION_ERROR_INVALID_PARAMETER));
+    assert_that(request_scheduler_defer(scheduler, REQUEST_PRIORITY_BULK, NULL, NULL, -2),
+                is_equal_to(OPERATION_ERROR_INVALID_PARAMETER));
+
+    talloc_free(ctx);
+}
+
+Ensure(Cgreen, request_scheduler_holds_class_at_limit) {
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    request_scheduler *scheduler = request_scheduler_new(ctx);
+
+    request_scheduler_set_class(scheduler, REQUEST_PRIORITY_BACKGROUND, 1, 1);
+    request_scheduler_on_submit(scheduler, REQUEST_PRIORITY_BACKGROUND);
+
+    assert_that(request_scheduler_can_submit(scheduler, REQUEST_PRIORITY_BACKGROUND), is_equal_to(false));
+
+    request_scheduler_defer(scheduler, REQUEST_PRIORITY_BACKGROUND, empty_dispatch, NULL, -2);
+    assert_that(request_scheduler_next(scheduler), is_equal_to(NULL));
+
+    request_scheduler_on_complete(scheduler, REQUEST_PRIORITY_BACKGROUND);
+
+    struct Deferred_Request_s *request = request_scheduler_next(scheduler);
+    assert_that(request, is_not_equal_to(NULL));
+    assert_that(request->priority, is_equal_to(REQUEST_PRIORITY_BACKGROUND));
+    assert_that(request_scheduler_pending(scheduler, REQUEST_PRIORITY_BACKGROUND), is_equal_to(0));
+
+    talloc_free(ctx);
+}
+
+Ensure(Cgreen, request_scheduler_shares_slots_by_weight) {
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    request_scheduler *scheduler = request_scheduler_new(ctx);
+
+    request_scheduler_set_class(scheduler, REQUEST_PRIORITY_BULK, 2, 0);
+    request_scheduler_set_class(scheduler, REQUEST_PRIORITY_BACKGROUND, 1, 0);
+
+    for (int i = 0; i < 6; ++i)
+    {
+        request_scheduler_defer(scheduler, REQUEST_PRIORITY_BULK, empty_dispatch, NULL, -2 - 2 * i);
+        request_scheduler_defer(scheduler, REQUEST_PRIORITY_BACKGROUND, empty_dispatch, NULL, -3 - 2 * i);
+    }
+
+    int dispatched[REQUEST_PRIORITY_COUNT] = { 0 };
+
+    for (int i = 0; i < 9; ++i)
+    {
+        struct Deferred_Request_s *request = request_scheduler_next(scheduler);
+        assert_that(request, is_not_equal_to(NULL));
+        ++dispatched[request->priority];
+        talloc_free(request);
+    }
+
+    assert_that(dispatched[REQUEST_PRIORITY_BULK], is_equal_to(6));
+    assert_that(dispatched[REQUEST_PRIORITY_BACKGROUND], is_equal_to(3));
+
+    talloc_free(ctx);
+}
+
+Ensure(Cgreen, request_scheduler_drops_cancelled_request) {
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    request_scheduler *scheduler = request_scheduler_new(ctx);
+
+    request_scheduler_set_class(scheduler, REQUEST_PRIORITY_BULK, 1, 1);
+    request_scheduler_on_submit(scheduler, REQUEST_PRIORITY_BULK);
+
+    request_scheduler_defer(scheduler, REQUEST_PRIORITY_BULK, empty_dispatch, NULL, -2);
+    request_scheduler_defer(scheduler, REQUEST_PRIORITY_BULK, empty_dispatch, NULL, -3);
+    request_scheduler_defer(scheduler, REQUEST_PRIORITY_BULK, empty_dispatch, NULL, -4);
+
+    assert_that(request_scheduler_cancel(scheduler, -4), is_equal_to(true));
+    assert_that(request_scheduler_cancel(scheduler, -2), is_equal_to(true));
+    assert_that(request_scheduler_cancel(scheduler, -2), is_equal_to(false));
+    assert_that(request_scheduler_pending(scheduler, REQUEST_PRIORITY_BULK), is_equal_to(1));
+
+    request_scheduler_on_complete(scheduler, REQUEST_PRIORITY_BULK);
+
+    // Only operation which was not cancelled is submitted.
+    struct Deferred_Request_s *request = request_scheduler_next(scheduler);
+    assert_that(request, is_not_equal_to(NULL));
+    assert_that(request->handle, is_equal_to(-3));
+    talloc_free(request);
+
+    assert_that(request_scheduler_next(scheduler), is_equal_to(NULL));
+
+    // Queue emptied by cancellation accepts new operations.
+    request_scheduler_defer(scheduler, REQUEST_PRIORITY_BULK, empty_dispatch, NULL, -5);
+    request = request_scheduler_next(scheduler);
+    assert_that(request, is_not_equal_to(NULL));
+    assert_that(request->handle, is_equal_to(-5));
+
+    talloc_free(ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, request_scheduler_submits_interactive_immediately);
+    add_test_with_context(suite, Cgreen, request_scheduler_rejects_invalid_class);
+    add_test_with_context(suite, Cgreen, request_scheduler_holds_class_at_limit);
+    add_test_with_context(suite, Cgreen, request_scheduler_shares_slots_by_weight);
+    add_test_with_context(suite, Cgreen, request_scheduler_drops_cancelled_request);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,214 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <directory.h>
+#include <domain.h>
+#include <domain_p.h>
+#include <entry.h>
+#include <talloc.h>
+#include <request_timer.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+static bool odd_requests_alive(int msgid, int64_t deadline, void *user_data)
+{
+    (void)(deadline);
+    (void)(user_data);
+
+    return msgid % 2 == 1;
+}
+
+Ensure(Cgreen, request_timer_push_with_null_timer) {
+    assert_that(request_timer_push(NULL, 1, 100), is_equal_to(OPERATION_ERROR_INVALID_PARAMETER));
+}
+
+Ensure(Cgreen, request_timer_pop_from_empty_timer) {
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    request_timer *timer = request_timer_new(ctx, 4);
+
+    struct Timer_Entry_s entry;
+
+    assert_that(request_timer_empty(timer), is_equal_to(true));
+    assert_that(request_timer_pop(timer, &entry), is_equal_to(OPERATION_ERROR_INVALID_PARAMETER));
+    assert_that(request_timer_peek(timer, &entry), is_equal_to(OPERATION_ERROR_INVALID_PARAMETER));
+
+    talloc_free(ctx);
+}
+
+Ensure(Cgreen, request_timer_pops_in_deadline_order) {
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    request_timer *timer = request_timer_new(ctx, 2);
+
+    const int64_t deadlines[] = { 500, 100, 400, 300, 200, 600 };
+
+    for (int i = 0; i < 6; ++i)
+    {
+        assert_that(request_timer_push(timer, i, deadlines[i]), is_equal_to(OPERATION_SUCCESS));
+    }
+
+    assert_that(request_timer_size(timer), is_equal_to(6));
+
+    struct Timer_Entry_s entry;
+    int64_t previous = 0;
+
+    while (!request_timer_empty(timer))
+    {
+        assert_that(request_timer_pop(timer, &entry), is_equal_to(OPERATION_SUCCESS));
+        assert_that(entry.deadline >= previous, is_equal_to(true));
+        assert_that(deadlines[entry.msgid], is_equal_to(entry.deadline));
+        previous = entry.deadline;
+    }
+
+    talloc_free(ctx);
+}
+
+Ensure(Cgreen, request_timer_purge_removes_stale_entries) {
+    TALLOC_CTX *ctx = talloc_new(NULL);
+    request_timer *timer = request_timer_new(ctx, 8);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        request_timer_push(timer, i, 1000 - i * 10);
+    }
+
+    assert_that(request_timer_purge(timer, odd_requests_alive, NULL), is_equal_to(4));
+    assert_that(request_timer_size(timer), is_equal_to(4));
+
+    struct Timer_Entry_s entry;
+
+    assert_that(request_timer_peek(timer, &entry), is_equal_to(OPERATION_SUCCESS));
+    assert_that(entry.msgid, is_equal_to(7));
+
+    talloc_free(ctx);
+}
+
+static const int CONNECTION_UPDATE_INTERVAL = 1000;
+static const int OPERATION_TIMEOUT = 1000;
+
+static char* LDAP_DIRECTORY_ATTRS[] = { "objectClass", NULL };
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+static int searches_completed = 0;
+static int timeouts_reported = 0;
+
+static enum OperationReturnCode expired_search_callback(struct ldap_connection_ctx_t *connection,
+                                                        ld_entry_t** entries, void* user_data)
+{
+    (void)(connection);
+    (void)(entries);
+    (void)(user_data);
+
+    ++searches_completed;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void expired_search_on_failure(struct ldap_connection_ctx_t *connection, int result_code, void *user_data)
+{
+    (void)(connection);
+    (void)(user_data);
+
+    assert_that(result_code, is_equal_to(LDAP_TIMEOUT));
+
+    ++timeouts_reported;
+}
+
+static void stop_loop(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ev);
+
+    verto_break(ctx);
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+
+        return;
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        assert_that(search_ext(connection, "dc=domain,dc=alt", LDAP_SCOPE_SUBTREE, "(objectClass=*)",
+                               LDAP_DIRECTORY_ATTRS, 0, expired_search_callback, expired_search_on_failure, NULL),
+                    is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(connection_requests_in_flight(connection), is_equal_to(1));
+
+        // Deadline passes before any result is read, request is abandoned and reported as timed out.
+        connection_process_timers(connection, ld_now() + OPERATION_TIMEOUT * 2);
+
+        assert_that(timeouts_reported, is_equal_to(1));
+        assert_that(connection_requests_in_flight(connection), is_equal_to(0));
+
+        // Late result of abandoned request must not reach search callback.
+        verto_add_timeout(ctx, VERTO_EV_FLAG_NONE, stop_loop, CONNECTION_UPDATE_INTERVAL);
+    }
+}
+
+Ensure(Cgreen, request_timer_abandons_expired_search) {
+    TALLOC_CTX* talloc_ctx = talloc_new(NULL);
+
+    current_directory_type = get_current_directory_type(get_environment_variable(talloc_ctx, "DIRECTORY_TYPE"));
+    char *server = get_environment_variable(talloc_ctx, "LDAP_SERVER");
+
+    ld_config_t *config = NULL;
+    switch (current_directory_type)
+    {
+    case LDAP_TYPE_OPENLDAP:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password", true, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password145Qw!", false, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    default:
+        fail_test("Unknown directory type, please check environment variables!\n");
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    LDHandle *handle = NULL;
+    ld_init(&handle, config);
+
+    ld_set_operation_timeout(handle, OPERATION_TIMEOUT);
+
+    ld_install_default_handlers(handle);
+    ld_install_handler(handle, connection_on_timeout, CONNECTION_UPDATE_INTERVAL);
+
+    ld_exec(handle);
+
+    assert_that(timeouts_reported, is_equal_to(1));
+    assert_that(searches_completed, is_equal_to(0));
+
+    ld_free(handle);
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, request_timer_push_with_null_timer);
+    add_test_with_context(suite, Cgreen, request_timer_pop_from_empty_timer);
+    add_test_with_context(suite, Cgreen, request_timer_pops_in_deadline_order);
+    add_test_with_context(suite, Cgreen, request_timer_purge_removes_stale_entries);
+    add_test_with_context(suite, Cgreen, request_timer_abandons_expired_search);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,96 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <entry.h>
+#include <directory.h>
+#include <talloc.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+char* LDAP_DIRECTORY_ATTRS[] = { "objectClass", NULL };
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+static bool writable_callback_called = false;
+
+static void connection_on_search_message(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ev);
+
+    static int callcount = 0;
+
+    if (++callcount > 10)
+    {
+        verto_break(ctx);
+    }
+}
+
+static void connection_on_writable(struct ldap_connection_ctx_t *connection, void *user_data)
+{
+    (void)(user_data);
+
+    writable_callback_called = true;
+
+    verto_break(connection->base);
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    csm_next_state(connection->state_machine);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        char* search_base = current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY
+                ? "cn=users,dc=domain,dc=alt"
+                : "dc=domain,dc=alt";
+
+        connection->request_window = 2;
+        connection_set_writable_callback(connection, connection_on_writable, NULL);
+
+        for (int i = 0; i < 2; ++i)
+        {
+            assert_that(search(connection, search_base, LDAP_SCOPE_SUBTREE,
+                               "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, NULL, NULL),
+                        is_equal_to(RETURN_CODE_SUCCESS));
+        }
+
+        assert_that(search(connection, search_base, LDAP_SCOPE_SUBTREE,
+                           "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, NULL, NULL),
+                    is_equal_to(RETURN_CODE_WOULD_BLOCK));
+
+        verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, connection_on_search_message, CONNECTION_UPDATE_INTERVAL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, request_window_test) {
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+
+    assert_that(writable_callback_called, is_equal_to(true));
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, request_window_test);
+    return run_test_suite(suite, create_text_reporter());
+}
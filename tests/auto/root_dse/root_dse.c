@@ -0,0 +1,66 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <directory.h>
+#include <domain.h>
+#include <root_dse.h>
+#include <talloc.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+
+        return;
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        const ld_root_dse_t *root_dse = connection->root_dse;
+
+        assert_that(root_dse, is_non_null);
+        assert_that(root_dse->naming_contexts, is_non_null);
+        assert_that(root_dse->supported_extensions, is_non_null);
+        assert_that(root_dse_supports_extension(root_dse, LDAP_EXOP_WHO_AM_I), is_equal_to(true));
+        assert_that(root_dse_supports_extension(root_dse, "1.2.3.4.5.6.7.8.9"), is_equal_to(false));
+
+        if (current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY)
+        {
+            assert_that(root_dse->dns_host_name, is_non_null);
+            assert_that(root_dse_supports_control(root_dse, LDAP_CONTROL_PAGEDRESULTS), is_equal_to(true));
+        }
+
+        verto_break(ctx);
+    }
+}
+
+Ensure(Cgreen, root_dse_test) {
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, root_dse_test);
+    return run_test_suite(suite, create_text_reporter());
+}
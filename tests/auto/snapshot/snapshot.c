@@ -0,0 +1,181 @@
+#include <cgreen/cgreen.h>
+
+#include <domain.h>
+#include <entry.h>
+#include <schema.h>
+#include <snapshot.h>
+#include <talloc.h>
+
+#include <ldap.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+static void add_attribute(ld_entry_t *entry, const char *name, const char *first, const char *second)
+{
+    LDAPAttribute_t *attribute = talloc_zero(entry, LDAPAttribute_t);
+    attribute->name = talloc_strdup(attribute, name);
+    attribute->values = talloc_zero_array(attribute, char*, 3);
+    attribute->values[0] = talloc_strdup(attribute, first);
+    attribute->values[1] = second ? talloc_strdup(attribute, second) : NULL;
+
+    ld_entry_add_attribute(entry, attribute);
+}
+
+static void put_user(TALLOC_CTX *ctx, ld_snapshot_t *snapshot, const char *name, const char *mail,
+                     const char *employee_id, const char *group)
+{
+    char *dn = talloc_asprintf(ctx, "cn=%s,ou=People,dc=domain,dc=alt", name);
+    ld_entry_t *entry = ld_entry_new(ctx, dn);
+
+    add_attribute(entry, "cn", name, NULL);
+    add_attribute(entry, "mail", mail, NULL);
+    add_attribute(entry, "employeeID", employee_id, NULL);
+    add_attribute(entry, "memberOf", "cn=users,dc=domain,dc=alt", group);
+
+    assert_that(ld_snapshot_put(snapshot, entry), is_equal_to(RETURN_CODE_SUCCESS));
+}
+
+static int count_entries(ld_entry_t **entries)
+{
+    int count = 0;
+    while (entries && entries[count])
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+static void add_attribute_type(TALLOC_CTX *ctx, ldap_schema_t *schema, const char *name, const char *oid,
+                               const char *equality, const char *syntax)
+{
+    LDAPAttributeType *attribute_type = talloc_zero(ctx, LDAPAttributeType);
+    attribute_type->at_names = talloc_zero_array(ctx, char*, 2);
+    attribute_type->at_names[0] = talloc_strdup(ctx, name);
+    attribute_type->at_oid = talloc_strdup(ctx, oid);
+    attribute_type->at_equality_oid = equality ? talloc_strdup(ctx, equality) : NULL;
+    attribute_type->at_syntax_oid = syntax ? talloc_strdup(ctx, syntax) : NULL;
+
+    ldap_schema_append_attributetype(schema, attribute_type);
+}
+
+static ld_snapshot_t *create_snapshot(TALLOC_CTX *ctx)
+{
+    ldap_schema_t *schema = ldap_schema_new(ctx);
+
+    add_attribute_type(ctx, schema, "memberOf", "1.2.840.113556.1.2.102", NULL, "1.3.6.1.4.1.1466.115.121.1.12");
+    add_attribute_type(ctx, schema, "employeeID", "1.2.840.113556.1.4.35", "integerMatch", NULL);
+
+    ld_snapshot_t *snapshot = ld_snapshot_new(ctx, schema);
+
+    put_user(ctx, snapshot, "alice", "Alice@Domain.alt", "100", "cn=admins,dc=domain,dc=alt");
+    put_user(ctx, snapshot, "bob", "bob@domain.alt", "20", NULL);
+    put_user(ctx, snapshot, "carol", "carol@other.alt", "3000", "cn=admins,dc=domain,dc=alt");
+
+    return snapshot;
+}
+
+Ensure(Cgreen, snapshot_hash_index_finds_equal_values) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ld_snapshot_t *snapshot = create_snapshot(talloc_ctx);
+
+    assert_that(ld_snapshot_add_index(snapshot, "mail", LD_SNAPSHOT_INDEX_HASH), is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_snapshot_add_index(snapshot, "memberOf", LD_SNAPSHOT_INDEX_HASH),
+                is_equal_to(RETURN_CODE_SUCCESS));
+
+    ld_entry_t **result = ld_snapshot_find_equal(talloc_ctx, snapshot, "MAIL", "alice@domain.alt");
+    assert_that(count_entries(result), is_equal_to(1));
+    assert_that(ld_entry_get_first_value(result[0], "cn"), is_equal_to_string("alice"));
+
+    result = ld_snapshot_find_equal(talloc_ctx, snapshot, "memberOf", "CN=admins, DC=domain, DC=alt");
+    assert_that(count_entries(result), is_equal_to(2));
+
+    result = ld_snapshot_find_equal(talloc_ctx, snapshot, "memberOf", "cn=users,dc=domain,dc=alt");
+    assert_that(count_entries(result), is_equal_to(3));
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, snapshot_sorted_index_finds_prefix_and_range) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ld_snapshot_t *snapshot = create_snapshot(talloc_ctx);
+
+    assert_that(ld_snapshot_add_index(snapshot, "mail", LD_SNAPSHOT_INDEX_SORTED), is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_snapshot_add_index(snapshot, "employeeID", LD_SNAPSHOT_INDEX_SORTED),
+                is_equal_to(RETURN_CODE_SUCCESS));
+
+    ld_entry_t **result = ld_snapshot_find_prefix(talloc_ctx, snapshot, "mail", "CAROL@");
+    assert_that(count_entries(result), is_equal_to(1));
+
+    result = ld_snapshot_find_range(talloc_ctx, snapshot, "mail", "b", "c");
+    assert_that(count_entries(result), is_equal_to(1));
+
+    result = ld_snapshot_find_range(talloc_ctx, snapshot, "employeeID", "100", NULL);
+    assert_that(count_entries(result), is_equal_to(2));
+
+    result = ld_snapshot_find_range(talloc_ctx, snapshot, "employeeID", "0020", "100");
+    assert_that(count_entries(result), is_equal_to(2));
+
+    result = ld_snapshot_find_equal(talloc_ctx, snapshot, "employeeID", "20");
+    assert_that(count_entries(result), is_equal_to(1));
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, snapshot_updates_indexes_on_changes) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ld_snapshot_t *snapshot = create_snapshot(talloc_ctx);
+
+    ld_snapshot_add_index(snapshot, "mail", LD_SNAPSHOT_INDEX_HASH | LD_SNAPSHOT_INDEX_SORTED);
+
+    char *new_mail[] = { "bob@new.alt", NULL };
+    LDAPMod replace_mail = { .mod_op = LDAP_MOD_REPLACE, .mod_type = "mail" };
+    replace_mail.mod_values = new_mail;
+    LDAPMod *modifications[] = { &replace_mail, NULL };
+
+    assert_that(ld_snapshot_modify(snapshot, "cn=bob,ou=People,dc=domain,dc=alt", modifications),
+                is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(count_entries(ld_snapshot_find_equal(talloc_ctx, snapshot, "mail", "bob@domain.alt")),
+                is_equal_to(0));
+    assert_that(count_entries(ld_snapshot_find_prefix(talloc_ctx, snapshot, "mail", "bob@new")), is_equal_to(1));
+
+    assert_that(ld_snapshot_rename(snapshot, "cn=bob,ou=People,dc=domain,dc=alt",
+                                   "cn=robert,ou=People,dc=domain,dc=alt"), is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_snapshot_get(snapshot, "CN=Robert,OU=People,DC=domain,DC=alt"), is_non_null);
+    assert_that(ld_snapshot_get(snapshot, "cn=bob,ou=People,dc=domain,dc=alt"), is_null);
+
+    assert_that(ld_snapshot_remove(snapshot, "cn=robert,ou=People,dc=domain,dc=alt"),
+                is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_snapshot_count(snapshot), is_equal_to(2));
+    assert_that(count_entries(ld_snapshot_find_equal(talloc_ctx, snapshot, "mail", "bob@new.alt")),
+                is_equal_to(0));
+
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, snapshot_without_index_scans_entries) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    ld_snapshot_t *snapshot = create_snapshot(talloc_ctx);
+
+    assert_that(count_entries(ld_snapshot_find_equal(talloc_ctx, snapshot, "cn", "CAROL")), is_equal_to(1));
+    assert_that(count_entries(ld_snapshot_find_prefix(talloc_ctx, snapshot, "mail", "a")), is_equal_to(1));
+
+    ld_filter_program_t *program = ld_filter_compile_string(talloc_ctx, "(|(cn=alice)(cn=bob))", NULL);
+    assert_that(count_entries(ld_snapshot_select(talloc_ctx, snapshot, program)), is_equal_to(2));
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, snapshot_hash_index_finds_equal_values);
+    add_test_with_context(suite, Cgreen, snapshot_sorted_index_finds_prefix_and_range);
+    add_test_with_context(suite, Cgreen, snapshot_updates_indexes_on_changes);
+    add_test_with_context(suite, Cgreen, snapshot_without_index_scans_entries);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,331 @@
+#include <cgreen/cgreen.h>
+
+#include <domain.h>
+#include <entry.h>
+#include <snapshot.h>
+#include <snapshot_file.h>
+#include <talloc.h>
+
+#include <ldap.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+static void add_attribute(ld_entry_t *entry, const char *name, const char *first, const char *second)
+{
+    LDAPAttribute_t *attribute = talloc_zero(entry, LDAPAttribute_t);
+    attribute->name = talloc_strdup(attribute, name);
+    attribute->values = talloc_zero_array(attribute, char*, 3);
+    attribute->values[0] = talloc_strdup(attribute, first);
+    attribute->values[1] = second ? talloc_strdup(attribute, second) : NULL;
+
+    ld_entry_add_attribute(entry, attribute);
+}
+
+static ld_entry_t *create_user(TALLOC_CTX *ctx, const char *name, const char *description)
+{
+    char *dn = talloc_asprintf(ctx, "cn=%s,ou=People,dc=domain,dc=alt", name);
+    ld_entry_t *entry = ld_entry_new(ctx, dn);
+
+    add_attribute(entry, "objectClass", "top", "person");
+    add_attribute(entry, "cn", name, NULL);
+    add_attribute(entry, "description", description, NULL);
+
+    return entry;
+}
+
+static char *temporary_path(TALLOC_CTX *ctx, const char *name)
+{
+    return talloc_asprintf(ctx, "%s/%s-%d", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp", name, (int)getpid());
+}
+
+static void write_text(const char *path, const char *text)
+{
+    FILE *stream = fopen(path, "w");
+    fputs(text, stream);
+    fclose(stream);
+}
+
+static char *read_text(TALLOC_CTX *ctx, const char *path)
+{
+    char *result = talloc_strdup(ctx, "");
+    char buffer[256];
+
+    FILE *stream = fopen(path, "r");
+    while (stream && fgets(buffer, sizeof(buffer), stream))
+    {
+        result = talloc_strdup_append(result, buffer);
+    }
+    if (stream)
+    {
+        fclose(stream);
+    }
+
+    return result;
+}
+
+Ensure(Cgreen, snapshot_file_round_trips_entries) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    char *path = temporary_path(talloc_ctx, "snapshot_file");
+
+    ld_snapshot_writer_t *writer = ld_snapshot_writer_open(talloc_ctx, path);
+    assert_that(writer, is_non_null);
+    assert_that(ld_snapshot_writer_add(writer, create_user(talloc_ctx, "alice", "first")),
+                is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_snapshot_writer_add(writer, create_user(talloc_ctx, "bob", "second")),
+                is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_snapshot_writer_close(writer), is_equal_to(RETURN_CODE_SUCCESS));
+
+    ld_snapshot_file_t *file = ld_snapshot_file_open(talloc_ctx, path);
+    assert_that(file, is_non_null);
+    assert_that(ld_snapshot_file_count(file), is_equal_to(2));
+
+    ld_entry_t *entry = ld_snapshot_file_entry(talloc_ctx, file, 1);
+    assert_that(ld_entry_get_dn(entry), is_equal_to_string("cn=bob,ou=People,dc=domain,dc=alt"));
+    assert_that(ld_entry_get_first_value(entry, "description"), is_equal_to_string("second"));
+
+    LDAPAttribute_t *object_class = ld_entry_get_attribute(entry, "objectClass");
+    assert_that(object_class, is_non_null);
+    assert_that(object_class->values[1], is_equal_to_string("person"));
+    assert_that(object_class->values[2], is_null);
+
+    assert_that(ld_snapshot_file_entry(talloc_ctx, file, 2), is_null);
+
+    unlink(path);
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, snapshot_writer_replaces_file_on_close_only) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    char *path = temporary_path(talloc_ctx, "snapshot_file_replace");
+
+    ld_snapshot_writer_t *writer = ld_snapshot_writer_open(talloc_ctx, path);
+    assert_that(ld_snapshot_writer_add(writer, create_user(talloc_ctx, "alice", "first")),
+                is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_snapshot_writer_close(writer), is_equal_to(RETURN_CODE_SUCCESS));
+
+    // Abandoned writer leaves previous file intact.
+    writer = ld_snapshot_writer_open(talloc_ctx, path);
+    assert_that(ld_snapshot_writer_add(writer, create_user(talloc_ctx, "bob", "second")),
+                is_equal_to(RETURN_CODE_SUCCESS));
+
+    ld_snapshot_file_t *file = ld_snapshot_file_open(talloc_ctx, path);
+    assert_that(ld_snapshot_file_count(file), is_equal_to(1));
+
+    talloc_free(writer);
+
+    file = ld_snapshot_file_open(talloc_ctx, path);
+    assert_that(ld_snapshot_file_count(file), is_equal_to(1));
+    assert_that(ld_entry_get_dn(ld_snapshot_file_entry(talloc_ctx, file, 0)),
+                is_equal_to_string("cn=alice,ou=People,dc=domain,dc=alt"));
+
+    assert_that(ld_snapshot_writer_open(talloc_ctx, "/nonexistent/snapshot"), is_null);
+
+    unlink(path);
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, snapshot_file_rejects_invalid_files) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    char *path = temporary_path(talloc_ctx, "snapshot_file_invalid");
+
+    write_text(path, "dn: cn=alice,dc=domain,dc=alt\n");
+    assert_that(ld_snapshot_file_open(talloc_ctx, path), is_null);
+
+    assert_that(ld_snapshot_file_open(talloc_ctx, "/nonexistent/snapshot"), is_null);
+
+    unlink(path);
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, snapshot_file_converts_ldif) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    char *ldif_path = temporary_path(talloc_ctx, "snapshot_file_input.ldif");
+    char *output_path = temporary_path(talloc_ctx, "snapshot_file_output.ldif");
+    char *path = temporary_path(talloc_ctx, "snapshot_file_ldif");
+
+    write_text(ldif_path,
+               "version: 1\n"
+               "\n"
+               "# first user\n"
+               "dn: cn=alice,ou=People,dc=domain,dc=alt\n"
+               "objectClass: top\n"
+               "cn: alice\n"
+               "objectClass: person\n"
+               "description: long descr\n"
+               " iption\n"
+               "\n"
+               "dn:: Y249YsO2YixvdT1QZW9wbGUsZGM9ZG9tYWluLGRjPWFsdA==\n"
+               "changetype: add\n"
+               "cn: b\xc3\xb6" "b\n");
+
+    assert_that(ld_snapshot_file_from_ldif(ldif_path, path), is_equal_to(RETURN_CODE_SUCCESS));
+
+    ld_snapshot_file_t *file = ld_snapshot_file_open(talloc_ctx, path);
+    assert_that(ld_snapshot_file_count(file), is_equal_to(2));
+
+    ld_entry_t *entry = ld_snapshot_file_entry(talloc_ctx, file, 0);
+    assert_that(ld_entry_get_first_value(entry, "description"), is_equal_to_string("long description"));
+    assert_that(ld_entry_get_attribute(entry, "objectClass")->values[1], is_equal_to_string("person"));
+
+    entry = ld_snapshot_file_entry(talloc_ctx, file, 1);
+    assert_that(ld_entry_get_dn(entry), is_equal_to_string("cn=b\xc3\xb6" "b,ou=People,dc=domain,dc=alt"));
+
+    assert_that(ld_snapshot_file_to_ldif(path, output_path), is_equal_to(RETURN_CODE_SUCCESS));
+
+    char *text = read_text(talloc_ctx, output_path);
+    assert_that(text, contains_string("version: 1\n"));
+    assert_that(text, contains_string("description: long description\n"));
+    assert_that(text, contains_string("dn:: Y249YsO2YixvdT1QZW9wbGUsZGM9ZG9tYWluLGRjPWFsdA==\n"));
+
+    write_text(ldif_path, "dn: cn=alice,dc=domain,dc=alt\nchangetype: delete\n");
+    assert_that(ld_snapshot_file_from_ldif(ldif_path, path), is_equal_to(RETURN_CODE_FAILURE));
+
+    unlink(ldif_path);
+    unlink(output_path);
+    unlink(path);
+    talloc_free(talloc_ctx);
+}
+
+Ensure(Cgreen, snapshot_imports_and_saves_file) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    char *path = temporary_path(talloc_ctx, "snapshot_file_store");
+
+    ld_snapshot_t *snapshot = ld_snapshot_new(talloc_ctx, NULL);
+    ld_snapshot_add_index(snapshot, "cn", LD_SNAPSHOT_INDEX_HASH);
+    ld_snapshot_put(snapshot, create_user(talloc_ctx, "alice", "first"));
+    ld_snapshot_put(snapshot, create_user(talloc_ctx, "bob", "second"));
+
+    assert_that(ld_snapshot_save(snapshot, path), is_equal_to(RETURN_CODE_SUCCESS));
+
+    ld_snapshot_t *restored = ld_snapshot_new(talloc_ctx, NULL);
+    ld_snapshot_add_index(restored, "cn", LD_SNAPSHOT_INDEX_HASH);
+
+    assert_that(ld_snapshot_import_file(restored, path), is_equal_to(2));
+    assert_that(ld_snapshot_count(restored), is_equal_to(2));
+
+    ld_entry_t **result = ld_snapshot_find_equal(talloc_ctx, restored, "cn", "BOB");
+    assert_that(result[0], is_non_null);
+    assert_that(ld_entry_get_first_value(result[0], "description"), is_equal_to_string("second"));
+
+    char *new_description[] = { "changed", NULL };
+    LDAPMod replace_description = { .mod_op = LDAP_MOD_REPLACE, .mod_type = "description" };
+    replace_description.mod_values = new_description;
+    LDAPMod *modifications[] = { &replace_description, NULL };
+    assert_that(ld_snapshot_modify(restored, "cn=bob,ou=People,dc=domain,dc=alt", modifications),
+                is_equal_to(RETURN_CODE_SUCCESS));
+    assert_that(ld_entry_get_first_value(ld_snapshot_get(restored, "cn=bob,ou=People,dc=domain,dc=alt"),
+                                         "description"), is_equal_to_string("changed"));
+
+    unlink(path);
+    talloc_free(talloc_ctx);
+}
+
+static void write_users(TALLOC_CTX *ctx, const char *path, const char **names, const char **descriptions)
+{
+    ld_snapshot_writer_t *writer = ld_snapshot_writer_open(ctx, path);
+    assert_that(writer, is_non_null);
+
+    for (int i = 0; names[i]; ++i)
+    {
+        assert_that(ld_snapshot_writer_add(writer, create_user(ctx, names[i], descriptions[i])),
+                    is_equal_to(RETURN_CODE_SUCCESS));
+    }
+
+    assert_that(ld_snapshot_writer_close(writer), is_equal_to(RETURN_CODE_SUCCESS));
+}
+
+/**
+ * @brief corrupt_entry Points entry of the offsets table past the entries, so file opens but entry is malformed.
+ */
+static void corrupt_entry(const char *path, int index)
+{
+    FILE *stream = fopen(path, "r+b");
+    assert_that(stream, is_non_null);
+
+    uint8_t footer[8];
+    fseek(stream, -32 + 8, SEEK_END);
+    assert_that(fread(footer, 1, sizeof(footer), stream), is_equal_to(sizeof(footer)));
+
+    uint64_t offsets = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        offsets = offsets << 8 | footer[i];
+    }
+
+    uint8_t invalid[8];
+    memset(invalid, 0xff, sizeof(invalid));
+    fseek(stream, (long)(offsets + (uint64_t)index * 8), SEEK_SET);
+    fwrite(invalid, 1, sizeof(invalid), stream);
+
+    fclose(stream);
+}
+
+Ensure(Cgreen, snapshot_import_is_all_or_nothing) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+    char *path = temporary_path(talloc_ctx, "snapshot_file_import");
+
+    ld_snapshot_t *snapshot = ld_snapshot_new(talloc_ctx, NULL);
+    ld_snapshot_add_index(snapshot, "cn", LD_SNAPSHOT_INDEX_SORTED);
+    ld_snapshot_add_index(snapshot, "description", LD_SNAPSHOT_INDEX_HASH | LD_SNAPSHOT_INDEX_SORTED);
+    ld_snapshot_put(snapshot, create_user(talloc_ctx, "alice", "first"));
+    ld_snapshot_put(snapshot, create_user(talloc_ctx, "carol", "third"));
+
+    // Malformed entry fails the import and leaves snapshot unchanged.
+    const char *names[] = { "bob", "alice", "dave", NULL };
+    const char *descriptions[] = { "second", "changed", "fourth" };
+    write_users(talloc_ctx, path, names, descriptions);
+    corrupt_entry(path, 2);
+
+    assert_that(ld_snapshot_import_file(snapshot, path), is_equal_to(-1));
+    assert_that(ld_snapshot_count(snapshot), is_equal_to(2));
+    assert_that(ld_snapshot_get(snapshot, "cn=bob,ou=People,dc=domain,dc=alt"), is_null);
+    assert_that(ld_entry_get_first_value(ld_snapshot_get(snapshot, "cn=alice,ou=People,dc=domain,dc=alt"),
+                                         "description"), is_equal_to_string("first"));
+
+    // Sorted indexes are ordered once, replaced entries and duplicate dns leave no stale items.
+    const char *valid_names[] = { "bob", "alice", "alice", NULL };
+    const char *valid_descriptions[] = { "second", "changed", "latest" };
+    write_users(talloc_ctx, path, valid_names, valid_descriptions);
+
+    assert_that(ld_snapshot_import_file(snapshot, path), is_equal_to(3));
+    assert_that(ld_snapshot_count(snapshot), is_equal_to(3));
+
+    ld_entry_t **result = ld_snapshot_find_range(talloc_ctx, snapshot, "cn", "a", NULL);
+    assert_that(result[0], is_non_null);
+    assert_that(ld_entry_get_first_value(result[0], "cn"), is_equal_to_string("alice"));
+    assert_that(ld_entry_get_first_value(result[1], "cn"), is_equal_to_string("bob"));
+    assert_that(ld_entry_get_first_value(result[2], "cn"), is_equal_to_string("carol"));
+    assert_that(result[3], is_null);
+
+    result = ld_snapshot_find_equal(talloc_ctx, snapshot, "description", "latest");
+    assert_that(result[0], is_non_null);
+    assert_that(result[1], is_null);
+
+    result = ld_snapshot_find_prefix(talloc_ctx, snapshot, "description", "first");
+    assert_that(result[0], is_null);
+
+    unlink(path);
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, snapshot_file_round_trips_entries);
+    add_test_with_context(suite, Cgreen, snapshot_writer_replaces_file_on_close_only);
+    add_test_with_context(suite, Cgreen, snapshot_file_rejects_invalid_files);
+    add_test_with_context(suite, Cgreen, snapshot_file_converts_ldif);
+    add_test_with_context(suite, Cgreen, snapshot_imports_and_saves_file);
+    add_test_with_context(suite, Cgreen, snapshot_import_is_all_or_nothing);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -5,6 +5,7 @@
 #include <entry.h>
 #include <domain_p.h>
 #include <talloc.h>
+#include <tls_cache.h>
 
 #include <test_common.h>
 
@@ -186,11 +187,121 @@ Ensure(Cgreen, tls_connection_test) {
     destroy_context(ctx);
 }
 
+static int connections_established = 0;
+
+static void connection_on_reconnect_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    csm_next_state(connection->state_machine);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        if (++connections_established == 1)
+        {
+            // Second connection of the handle shares TLS context and resumes session of the first one.
+            csm_set_state(connection->state_machine, LDAP_CONNECTION_STATE_ERROR);
+            return;
+        }
+
+        verto_del(ev);
+
+        assert_that(connection->tls_cache, is_equal_to(connection->handle->global_ctx->tls_cache));
+        assert_that(tls_cache_session_resumed(connection->ldap), is_equal_to(true));
+
+        verto_break(ctx);
+        return;
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR && connections_established == 0)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, tls_session_resumed_on_reconnect_test) {
+    struct context_t* ctx = create_context();
+
+    ctx->connection_ctx.handle->global_ctx = &ctx->global_ctx;
+
+    ctx->config.use_start_tls = true;
+
+    ctx->config.sasl_options = talloc(ctx->global_ctx.talloc_ctx, struct ldap_sasl_options_t);
+    ctx->config.sasl_options->mechanism = LDAP_SASL_SIMPLE;
+    ctx->config.sasl_options->passwd = "";
+
+    ctx->config.sasl_options->sasl_nocanon = true;
+    ctx->config.sasl_options->sasl_secprops = "minssf=56";
+    ctx->config.sasl_options->sasl_flags = LDAP_SASL_QUIET;
+    ctx->connection_ctx.ldap_params = talloc_zero(ctx->global_ctx.talloc_ctx, struct ldap_sasl_params_t);
+    ctx->connection_ctx.ldap_params->passwd = talloc_zero(ctx->global_ctx.talloc_ctx, struct berval);
+
+    assert_that(connection_configure(&ctx->global_ctx, &ctx->connection_ctx, &ctx->config),
+                is_equal_to(RETURN_CODE_SUCCESS));
+
+    verto_ev* ev = verto_add_timeout(ctx->connection_ctx.base, VERTO_EV_FLAG_PERSIST, connection_on_reconnect_timeout,
+                                     CONNECTION_UPDATE_INTERVAL);
+    verto_set_private(ev, &ctx->connection_ctx, NULL);
+
+    verto_run(ctx->connection_ctx.base);
+
+    assert_that(connections_established, is_equal_to(2));
+
+    destroy_context(ctx);
+}
+
+Ensure(Cgreen, tls_context_is_not_shared_between_different_settings_test) {
+    TALLOC_CTX *talloc_ctx = talloc_new(NULL);
+
+    char *server = get_environment_variable(talloc_ctx, "LDAPS_SERVER");
+    char *ca_cert = get_environment_variable(talloc_ctx, "LDAP_CA_CERT");
+
+    LDAP *first = NULL;
+    LDAP *second = NULL;
+    LDAP *other = NULL;
+    assert_that(ldap_initialize(&first, server), is_equal_to(LDAP_SUCCESS));
+    assert_that(ldap_initialize(&second, server), is_equal_to(LDAP_SUCCESS));
+    assert_that(ldap_initialize(&other, server), is_equal_to(LDAP_SUCCESS));
+
+    ldap_set_option(first, LDAP_OPT_X_TLS_CACERTFILE, ca_cert);
+    ldap_set_option(second, LDAP_OPT_X_TLS_CACERTFILE, ca_cert);
+    ldap_set_option(other, LDAP_OPT_X_TLS_CACERTFILE, "/etc/ssl/other-ca.pem");
+
+    tls_cache_t *cache = tls_cache_new(talloc_ctx);
+
+    if (tls_cache_apply(cache, first) == RETURN_CODE_SUCCESS)
+    {
+        void *first_ctx = NULL;
+        void *second_ctx = NULL;
+
+        assert_that(tls_cache_matches(cache, second), is_equal_to(true));
+        assert_that(tls_cache_apply(cache, second), is_equal_to(RETURN_CODE_SUCCESS));
+
+        ldap_get_option(first, LDAP_OPT_X_TLS_CTX, &first_ctx);
+        ldap_get_option(second, LDAP_OPT_X_TLS_CTX, &second_ctx);
+        assert_that(second_ctx, is_equal_to(first_ctx));
+
+        assert_that(tls_cache_matches(cache, other), is_equal_to(false));
+    }
+
+    assert_that(tls_cache_apply(cache, other), is_equal_to(RETURN_CODE_FAILURE));
+
+    ldap_unbind_ext(first, NULL, NULL);
+    ldap_unbind_ext(second, NULL, NULL);
+    ldap_unbind_ext(other, NULL, NULL);
+
+    talloc_free(talloc_ctx);
+}
+
 int main(int argc, char **argv) {
     (void)(argc);
     (void)(argv);
     (void)(contextForCgreen);
     TestSuite *suite = create_test_suite();
     add_test_with_context(suite, Cgreen, tls_connection_test);
+    add_test_with_context(suite, Cgreen, tls_session_resumed_on_reconnect_test);
+    add_test_with_context(suite, Cgreen, tls_context_is_not_shared_between_different_settings_test);
     return run_test_suite(suite, create_text_reporter());
 }
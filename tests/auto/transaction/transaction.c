@@ -0,0 +1,146 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <directory.h>
+#include <domain.h>
+#include <domain_p.h>
+#include <entry.h>
+#include <transaction.h>
+#include <talloc.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+char* LDAP_DIRECTORY_ATTRS[] = { "objectClass", NULL };
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+static LDHandle *handle = NULL;
+
+static int transaction_result = LDAP_SUCCESS;
+static int transaction_failed = -1;
+static bool transaction_reverted = false;
+static bool entry_found = true;
+
+static char* ou_object_class_values[] = { "top", "organizationalUnit", NULL };
+static char* ou_name_values[] = { "transaction_test", NULL };
+
+static LDAPMod ou_object_class = { LDAP_MOD_ADD, "objectClass", { ou_object_class_values } };
+static LDAPMod ou_name = { LDAP_MOD_ADD, "ou", { ou_name_values } };
+
+static LDAPMod *ou_attributes[] = { &ou_object_class, &ou_name, NULL };
+
+static const char* test_dn(void)
+{
+    return current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY
+            ? "ou=transaction_test,dc=domain,dc=alt"
+            : "ou=transaction_test,ou=users,dc=domain,dc=alt";
+}
+
+static enum OperationReturnCode search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
+{
+    (void)(user_data);
+
+    // Last element is made of search result message.
+    entry_found = entries && entries[0] && entries[1];
+
+    verto_break(connection->base);
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void transaction_callback(LDHandle *handle, int result_code, int failed, bool reverted, void *user_data)
+{
+    (void)(user_data);
+
+    transaction_result = result_code;
+    transaction_failed = failed;
+    transaction_reverted = reverted;
+
+    search(handle->connection_ctx, test_dn(), LDAP_SCOPE_BASE, "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0,
+           search_callback, NULL);
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+
+        return;
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        ld_transaction_t *transaction = ld_transaction_new(handle);
+
+        // Second operation fails, so entry added by the first one has to be removed.
+        assert_that(ld_transaction_add(transaction, test_dn(), ou_attributes), is_equal_to(RETURN_CODE_SUCCESS));
+        assert_that(ld_transaction_delete(transaction, "ou=transaction_missing,dc=domain,dc=alt"),
+                    is_equal_to(RETURN_CODE_SUCCESS));
+
+        assert_that(ld_transaction_commit(transaction, transaction_callback, NULL), is_equal_to(RETURN_CODE_SUCCESS));
+    }
+}
+
+Ensure(Cgreen, transaction_rollback_test) {
+    TALLOC_CTX* talloc_ctx = talloc_new(NULL);
+
+    current_directory_type = get_current_directory_type(get_environment_variable(talloc_ctx, "DIRECTORY_TYPE"));
+    char *server = get_environment_variable(talloc_ctx, "LDAP_SERVER");
+
+    ld_config_t *config = NULL;
+    switch (current_directory_type)
+    {
+    case LDAP_TYPE_OPENLDAP:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password", true, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password145Qw!", false, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    default:
+        fail_test("Unknown directory type, please check environment variables!\n");
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    ld_init(&handle, config);
+
+    ld_install_default_handlers(handle);
+    ld_install_handler(handle, connection_on_timeout, CONNECTION_UPDATE_INTERVAL);
+
+    ld_exec(handle);
+
+    assert_that(transaction_result, is_equal_to(LDAP_NO_SUCH_OBJECT));
+    assert_that(transaction_failed, is_equal_to(1));
+    assert_that(transaction_reverted, is_equal_to(true));
+    assert_that(entry_found, is_equal_to(false));
+
+    ld_free(handle);
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, transaction_rollback_test);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,161 @@
+#include <cgreen/cgreen.h>
+
+#include <directory.h>
+#include <domain.h>
+#include <schema.h>
+#include <user.h>
+#include <talloc.h>
+
+#include <connection_state_machine.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+#define NUMBER_OF_USERS 3
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+static const char *USER_NAMES[NUMBER_OF_USERS] =
+{
+    "test_bulk_user_1", "test_bulk_user_2", "test_bulk_user_3"
+};
+
+static const char *DISPLAY_NAMES[NUMBER_OF_USERS] =
+{
+    "Bulk User 1", NULL, "Bulk User 3"
+};
+
+static const char *LOGIN_SHELLS[NUMBER_OF_USERS] =
+{
+    "/bin/bash", "/bin/sh", "/bin/bash"
+};
+
+static const char *AD_COLUMN_NAMES[] = { "displayName" };
+static const char **AD_COLUMNS[] = { DISPLAY_NAMES };
+
+static const char *OPENLDAP_COLUMN_NAMES[] = { "loginShell", "gecos" };
+static const char **OPENLDAP_COLUMNS[] = { LOGIN_SHELLS, DISPLAY_NAMES };
+
+static const char *UNKNOWN_COLUMN_NAMES[] = { "noSuchAttributeInSchema" };
+static const char **UNKNOWN_COLUMNS[] = { DISPLAY_NAMES };
+
+// Batch is read until callback is called, so it must outlive the handler which submits it.
+static ld_user_batch_t batch;
+
+static bool batch_completed = false;
+static int users_found = 0;
+
+static enum OperationReturnCode get_user_callback(LDHandle *handle, int result_code, ld_user_t **users,
+                                                  void *user_data)
+{
+    (void)(handle);
+
+    assert_that(result_code, is_equal_to(LDAP_SUCCESS));
+    assert_that(users, is_non_null);
+    assert_that(users[0], is_non_null);
+    assert_that(users[0]->login, is_equal_to_string(user_data));
+
+    ++users_found;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void add_users_callback(LDHandle *handle, int completed, int failed, void *user_data)
+{
+    (void)(user_data);
+
+    // Every entry was accepted by the server, not only submitted.
+    assert_that(completed, is_equal_to(NUMBER_OF_USERS));
+    assert_that(failed, is_equal_to(0));
+
+    batch_completed = true;
+
+    for (int i = 0; i < NUMBER_OF_USERS; ++i)
+    {
+        assert_that(ld_get_user(handle, USER_NAMES[i], NULL, NULL, get_user_callback, (void*)USER_NAMES[i]),
+                    is_equal_to(RETURN_CODE_SUCCESS));
+    }
+}
+
+static void connection_on_add_message(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ev);
+
+    static int callcount = 0;
+
+    if (users_found == NUMBER_OF_USERS || ++callcount > 10)
+    {
+        assert_that(batch_completed, is_equal_to(true));
+        assert_that(users_found, is_equal_to(NUMBER_OF_USERS));
+
+        verto_break(ctx);
+    }
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        bool is_ad = current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY;
+
+        // Unknown column is rejected before anything is sent, on both directory types.
+        assert_that(ldap_schema_ready(connection), is_equal_to(true));
+
+        ld_user_batch_t unknown_batch =
+        {
+            .count = NUMBER_OF_USERS,
+            .names = USER_NAMES,
+            .n_columns = 1,
+            .column_names = UNKNOWN_COLUMN_NAMES,
+            .columns = UNKNOWN_COLUMNS,
+            .first_uid_number = 20000,
+            .gid_number = 20000,
+        };
+
+        enum OperationReturnCode rc = ld_add_users(connection->handle, &unknown_batch, NULL, NULL, NULL);
+        assert_that(rc, is_equal_to(RETURN_CODE_FAILURE));
+
+        batch.count = NUMBER_OF_USERS;
+        batch.names = USER_NAMES;
+        batch.n_columns = is_ad ? 1 : 2;
+        batch.column_names = is_ad ? AD_COLUMN_NAMES : OPENLDAP_COLUMN_NAMES;
+        batch.columns = is_ad ? AD_COLUMNS : OPENLDAP_COLUMNS;
+        batch.first_uid_number = 20000;
+        batch.gid_number = 20000;
+
+        rc = ld_add_users(connection->handle, &batch, NULL, add_users_callback, NULL);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        ld_install_handler(connection->handle, connection_on_add_message, CONNECTION_UPDATE_INTERVAL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, user_bulk_add_test)
+{
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, user_bulk_add_test);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,165 @@
+#include <cgreen/cgreen.h>
+
+#include <directory.h>
+#include <domain.h>
+#include <user.h>
+#include <talloc.h>
+
+#include <stdlib.h>
+#include <strings.h>
+
+#include <connection_state_machine.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+// Missing user is reported as failed while existing user is still processed.
+static const char *OPENLDAP_USERS[] = { "test_block_user", "test_block_missing_user", NULL };
+static const char *AD_USERS[] = { "test block", "test block missing", NULL };
+
+#define AD_ACCOUNT_DISABLE 0x2
+
+static int callbacks_received = 0;
+
+static bool user_is_blocked(ld_user_t *user)
+{
+    if (current_directory_type != LDAP_TYPE_ACTIVE_DIRECTORY)
+    {
+        for (int i = 0; user->attributes && user->attributes[i]; ++i)
+        {
+            if (strcasecmp(user->attributes[i]->name, "pwdAccountLockedTime") == 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    for (int i = 0; user->attributes && user->attributes[i]; ++i)
+    {
+        if (strcasecmp(user->attributes[i]->name, "userAccountControl") == 0)
+        {
+            return strtoul(user->attributes[i]->values[0], NULL, 10) & AD_ACCOUNT_DISABLE;
+        }
+    }
+
+    fail_test("userAccountControl is missing\n");
+
+    return false;
+}
+
+static enum OperationReturnCode unblocked_user_callback(LDHandle *handle, int result_code, ld_user_t **users,
+                                                        void *user_data)
+{
+    (void)(handle);
+    (void)(user_data);
+
+    assert_that(result_code, is_equal_to(LDAP_SUCCESS));
+    assert_that(users[0], is_non_null);
+    assert_that(user_is_blocked(users[0]), is_equal_to(false));
+
+    ++callbacks_received;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void unblock_users_callback(LDHandle *handle, int completed, int failed, void *user_data)
+{
+    const char **names = user_data;
+
+    assert_that(completed, is_equal_to(1));
+    assert_that(failed, is_equal_to(1));
+
+    ++callbacks_received;
+
+    enum OperationReturnCode rc = ld_get_user(handle, names[0], NULL, NULL, unblocked_user_callback, NULL);
+    assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+}
+
+static enum OperationReturnCode blocked_user_callback(LDHandle *handle, int result_code, ld_user_t **users,
+                                                      void *user_data)
+{
+    assert_that(result_code, is_equal_to(LDAP_SUCCESS));
+    assert_that(users[0], is_non_null);
+    assert_that(user_is_blocked(users[0]), is_equal_to(true));
+
+    ++callbacks_received;
+
+    enum OperationReturnCode rc = ld_unblock_users(handle, user_data, NULL, unblock_users_callback, user_data);
+    assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void block_users_callback(LDHandle *handle, int completed, int failed, void *user_data)
+{
+    const char **names = user_data;
+
+    assert_that(completed, is_equal_to(1));
+    assert_that(failed, is_equal_to(1));
+
+    ++callbacks_received;
+
+    enum OperationReturnCode rc = ld_get_user(handle, names[0], NULL, NULL, blocked_user_callback, user_data);
+    assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+}
+
+static void connection_on_block_message(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ev);
+
+    static int callcount = 0;
+
+    if (callbacks_received == 4 || ++callcount > 10)
+    {
+        assert_that(callbacks_received, is_equal_to(4));
+
+        verto_break(ctx);
+    }
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        const char **names = current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY ? AD_USERS : OPENLDAP_USERS;
+
+        enum OperationReturnCode rc = ld_block_users(connection->handle, names, NULL, block_users_callback, names);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        ld_install_handler(connection->handle, connection_on_block_message, CONNECTION_UPDATE_INTERVAL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, users_block_test)
+{
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, users_block_test);
+    return run_test_suite(suite, create_text_reporter());
+}
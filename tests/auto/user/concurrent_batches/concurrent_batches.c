@@ -0,0 +1,122 @@
+#include <cgreen/cgreen.h>
+
+#include <directory.h>
+#include <domain.h>
+#include <user.h>
+#include <talloc.h>
+
+#include <connection_state_machine.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+#define NUMBER_OF_BATCHES 2
+#define NUMBER_OF_USERS 4
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+// Users don't exist, so every user of both batches is reported as failed and directory is left intact.
+static const char *FIRST_BATCH[] =
+{
+    "test_concurrent_missing_1", "test_concurrent_missing_2", "test_concurrent_missing_3",
+    "test_concurrent_missing_4", NULL
+};
+
+static const char *SECOND_BATCH[] =
+{
+    "test_concurrent_missing_5", "test_concurrent_missing_6", "test_concurrent_missing_7",
+    "test_concurrent_missing_8", NULL
+};
+
+static int batches_completed[NUMBER_OF_BATCHES] = { 0, 0 };
+static int writable_callbacks_received = 0;
+
+static void on_writable(void *connection, void *user_data)
+{
+    (void)(connection);
+    (void)(user_data);
+
+    ++writable_callbacks_received;
+}
+
+static void block_users_callback(LDHandle *handle, int completed, int failed, void *user_data)
+{
+    (void)(handle);
+
+    int *batch_completed = user_data;
+
+    assert_that(completed, is_equal_to(0));
+    assert_that(failed, is_equal_to(NUMBER_OF_USERS));
+
+    ++(*batch_completed);
+}
+
+static void connection_on_batch_message(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ev);
+
+    static int callcount = 0;
+
+    bool done = batches_completed[0] && batches_completed[1];
+
+    if (done || ++callcount > 10)
+    {
+        // Each batch is completed exactly once, neither of them stalls while the other one waits for window.
+        assert_that(batches_completed[0], is_equal_to(1));
+        assert_that(batches_completed[1], is_equal_to(1));
+
+        // Handler installed by user is called even though batches waited for the window as well.
+        assert_that(writable_callbacks_received, is_greater_than(0));
+
+        verto_break(ctx);
+    }
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        // Single operation in flight makes both batches wait for the window in turn.
+        ld_set_request_window(connection->handle, 1, false);
+        ld_install_writable_handler(connection->handle, on_writable, NULL);
+
+        enum OperationReturnCode rc = ld_block_users(connection->handle, FIRST_BATCH, NULL, block_users_callback,
+                                                     &batches_completed[0]);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        rc = ld_block_users(connection->handle, SECOND_BATCH, NULL, block_users_callback, &batches_completed[1]);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        ld_install_handler(connection->handle, connection_on_batch_message, CONNECTION_UPDATE_INTERVAL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, concurrent_batches_test)
+{
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, concurrent_batches_test);
+    return run_test_suite(suite, create_text_reporter());
+}
@@ -0,0 +1,137 @@
+#include <cgreen/cgreen.h>
+
+#include <directory.h>
+#include <domain.h>
+#include <user.h>
+#include <talloc.h>
+
+#include <connection_state_machine.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+
+static int callbacks_received = 0;
+
+static enum OperationReturnCode list_users_callback(LDHandle *handle, int result_code, ld_user_t **users,
+                                                    void *user_data)
+{
+    (void)(handle);
+    (void)(user_data);
+
+    assert_that(result_code, is_equal_to(LDAP_SUCCESS));
+
+    assert_that(users, is_non_null);
+    assert_that(users[0], is_non_null);
+
+    for (int i = 0; users[i] != NULL; ++i)
+    {
+        assert_that(users[i]->dn, is_non_null);
+        assert_that(users[i]->login, is_non_null);
+        assert_that(users[i]->attributes, is_non_null);
+    }
+
+    ++callbacks_received;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static enum OperationReturnCode get_user_callback(LDHandle *handle, int result_code, ld_user_t **users,
+                                                  void *user_data)
+{
+    (void)(handle);
+
+    assert_that(result_code, is_equal_to(LDAP_SUCCESS));
+
+    assert_that(users, is_non_null);
+    assert_that(users[0], is_non_null);
+    assert_that(users[1], is_null);
+    assert_that(users[0]->name, is_equal_to_string(user_data));
+
+    // Only requested attribute is returned by the server.
+    assert_that(users[0]->mail, is_null);
+
+    ++callbacks_received;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static enum OperationReturnCode get_missing_user_callback(LDHandle *handle, int result_code, ld_user_t **users,
+                                                          void *user_data)
+{
+    (void)(handle);
+    (void)(user_data);
+
+    // Missing user is reported with result code, not as an empty list.
+    assert_that(result_code, is_equal_to(LDAP_NO_SUCH_OBJECT));
+    assert_that(users, is_null);
+
+    ++callbacks_received;
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void connection_on_list_message(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)(ev);
+
+    static int callcount = 0;
+
+    if (callbacks_received == 3 || ++callcount > 10)
+    {
+        assert_that(callbacks_received, is_equal_to(3));
+
+        verto_break(ctx);
+    }
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        const char *name = current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY ? "test block" : "test_block_user";
+        const char *attributes[] = { "cn", NULL };
+
+        enum OperationReturnCode rc = ld_list_users(connection->handle, NULL, NULL, list_users_callback, NULL);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        rc = ld_get_user(connection->handle, name, NULL, attributes, get_user_callback, (void*)name);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        rc = ld_get_user(connection->handle, "missing_list_user", NULL, NULL, get_missing_user_callback, NULL);
+        assert_that(rc, is_equal_to(RETURN_CODE_SUCCESS));
+
+        ld_install_handler(connection->handle, connection_on_list_message, CONNECTION_UPDATE_INTERVAL);
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+    }
+}
+
+Ensure(Cgreen, user_list_test)
+{
+    start_test(connection_on_timeout, CONNECTION_UPDATE_INTERVAL, &current_directory_type, false);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, user_list_test);
+    return run_test_suite(suite, create_text_reporter());
+}
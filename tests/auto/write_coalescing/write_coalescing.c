@@ -0,0 +1,127 @@
+#include <cgreen/cgreen.h>
+
+#include <connection.h>
+#include <connection_state_machine.h>
+#include <directory.h>
+#include <domain.h>
+#include <domain_p.h>
+#include <entry.h>
+#include <talloc.h>
+#include <transport.h>
+
+#include <test_common.h>
+
+Describe(Cgreen);
+BeforeEach(Cgreen) {}
+AfterEach(Cgreen) {}
+
+char* LDAP_DIRECTORY_ATTRS[] = { "objectClass", NULL };
+
+const int CONNECTION_UPDATE_INTERVAL = 1000;
+const int SEARCH_COUNT = 100;
+
+static int current_directory_type = LDAP_TYPE_UNKNOWN;
+static int searches_completed = 0;
+
+static enum OperationReturnCode search_callback(struct ldap_connection_ctx_t *connection, ld_entry_t** entries, void* user_data)
+{
+    (void)(entries);
+    (void)(user_data);
+
+    if (++searches_completed == SEARCH_COUNT)
+    {
+        verto_break(connection->base);
+    }
+
+    return RETURN_CODE_SUCCESS;
+}
+
+static void connection_on_timeout(verto_ctx *ctx, verto_ev *ev)
+{
+    struct ldap_connection_ctx_t* connection = verto_get_private(ev);
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_ERROR)
+    {
+        verto_break(ctx);
+
+        fail_test("Error encountered during bind\n");
+
+        return;
+    }
+
+    if (connection->state_machine->state == LDAP_CONNECTION_STATE_RUN)
+    {
+        verto_del(ev);
+
+        assert_that(connection->buffered_transport, is_equal_to(true));
+
+        const char *search_base = current_directory_type == LDAP_TYPE_ACTIVE_DIRECTORY
+                ? "cn=users,dc=domain,dc=alt"
+                : "dc=domain,dc=alt";
+
+        // Requests submitted in one iteration are sent together.
+        for (int i = 0; i < SEARCH_COUNT; ++i)
+        {
+            search(connection, search_base, LDAP_SCOPE_SUBTREE,
+                   "(objectClass=*)", LDAP_DIRECTORY_ATTRS, 0, search_callback, NULL);
+        }
+
+        // Nothing was written yet, requests wait in transport until the loop iteration ends.
+        assert_that(transport_has_output(connection->ldap), is_equal_to(true));
+
+        connection_process_write(connection);
+
+        assert_that(transport_has_output(connection->ldap), is_equal_to(false));
+    }
+}
+
+Ensure(Cgreen, write_coalescing_test) {
+    TALLOC_CTX* talloc_ctx = talloc_new(NULL);
+
+    current_directory_type = get_current_directory_type(get_environment_variable(talloc_ctx, "DIRECTORY_TYPE"));
+    char *server = get_environment_variable(talloc_ctx, "LDAP_SERVER");
+
+    ld_config_t *config = NULL;
+    switch (current_directory_type)
+    {
+    case LDAP_TYPE_OPENLDAP:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password", true, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    case LDAP_TYPE_ACTIVE_DIRECTORY:
+        config = ld_create_config(talloc_ctx, server, 0, LDAP_VERSION3, "dc=domain,dc=alt",
+                                  "admin", "password145Qw!", false, false, true, false, CONNECTION_UPDATE_INTERVAL,
+                                  "", "", "");
+        break;
+    default:
+        fail_test("Unknown directory type, please check environment variables!\n");
+        talloc_free(talloc_ctx);
+        return;
+    }
+
+    config->coalesce_writes = true;
+
+    LDHandle *handle = NULL;
+    ld_init(&handle, config);
+
+    ld_install_default_handlers(handle);
+    ld_install_handler(handle, connection_on_timeout, CONNECTION_UPDATE_INTERVAL);
+
+    ld_exec(handle);
+
+    assert_that(searches_completed, is_equal_to(SEARCH_COUNT));
+
+    ld_free(handle);
+
+    talloc_free(talloc_ctx);
+}
+
+int main(int argc, char **argv) {
+    (void)(argc);
+    (void)(argv);
+    (void)(contextForCgreen);
+    TestSuite *suite = create_test_suite();
+    add_test_with_context(suite, Cgreen, write_coalescing_test);
+    return run_test_suite(suite, create_text_reporter());
+}